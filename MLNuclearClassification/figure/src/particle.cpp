@@ -20,6 +20,34 @@ inline bool _fltEqual(float f1, float f2)
 	return fabs(f1 - f2) <= MACHINE_EPSILON;
 }
 
+// Reads the byte offset of the last record from the luabound index file next to the output file, which is
+//     the magic "LBDI", a uint32 version, then 24-byte records of (double time, int64 step, uint64 offset)
+bool _getLastRecordOffset(const char* path, std::streamoff fileSize, std::streamoff& offset)
+{
+	FileStream index(std::string(path) + ".idx", std::ios::binary | std::ios::ate);
+	if (!index.is_open())
+		return false;
+
+	const std::streamoff RECORD_SIZE = 24;
+	const std::streamoff records = (static_cast<std::streamoff>(index.tellg()) - 8) / RECORD_SIZE;
+	char header[8];
+	index.seekg(0);
+	if (records <= 0 || !index.read(header, 8) || std::string(header, 4) != "LBDI")
+		return false;
+
+	// The index is little-endian, like the machines that the simulations are run on
+	unsigned char bytes[8];
+	index.seekg(8 + ((records - 1) * RECORD_SIZE) + 16);
+	if (!index.read(reinterpret_cast<char*>(bytes), 8))
+		return false;
+	unsigned long long value = 0;
+	for (int i = 7; i >= 0; --i)
+		value = (value << 8) | bytes[i];
+
+	offset = static_cast<std::streamoff>(value);
+	return offset < fileSize;
+}
+
 
 namespace part
 {
@@ -57,11 +85,23 @@ bool loadOrbitInfo(const char* path, OrbitList& orbits)
 				  << "'#st,#sc,{#pa,#pe,#pi,#pO,#po,}'." << std::endl;
 	}
 
-	// Read to the last non-empty line, and use that as the data line
+	// Seek straight to the last record if there is an index, otherwise read to the last non-empty line,
+	//     and use that as the data line
 	std::string dataline;
-	for (std::string line; std::getline(file, line); ) {
-		if (!line.empty())
-			dataline = line;
+	const std::streampos dataStart = file.tellg();
+	file.seekg(0, std::ios::end);
+	const std::streamoff fileSize = file.tellg();
+	std::streamoff lastOffset = 0;
+	if (_getLastRecordOffset(path, fileSize, lastOffset)) {
+		file.seekg(lastOffset);
+		std::getline(file, dataline);
+	}
+	else {
+		file.seekg(dataStart);
+		for (std::string line; std::getline(file, line); ) {
+			if (!line.empty())
+				dataline = line;
+		}
 	}
 	if (dataline.empty()) {
 		std::cerr << "ERROR: Could not find the orbit information in the input file." << std::endl;
@@ -0,0 +1,87 @@
+/*
+ * This file is part of the ReboundU project, and is licensed under the GNU GPL v3 license, the text of which can be 
+ *     found in the LICENSE file distributed with the ReboundU source code, or online at 
+ *     <https://opensource.org/licenses/GPL-3.0>. In the event of redistruction of this code, this header, or the 
+ *     text of the license itself, must not be removed from the source files.
+ * Copyright © 2017 Sean Moss
+ */
+
+#include <reboundu.h>
+#include <format_parser.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <sstream>
+
+
+// Times OutputFormat::generateOutput for a few formats on a fixed disk of particles, and reports the best time per
+//     particle. Usage: bench [particle count = 100000] [rounds = 6] [runs per round = 15]
+// The particles are placed deterministically, so the output bytes can be compared between builds, and the byte
+//     count of each record is printed next to its time for that.
+
+namespace
+{
+
+const char * const FORMATS[] = {
+	"{#ph }",
+	"{#ph,#ph,#ph,#ph;}",
+	"{#pm,#px,#py,#pz;}",
+	"#st #sc: {#ph,#pm;} #sG"
+};
+
+double time_format(reb_simulation *sim, OutputFormat& format, int runs, size_t& bytes)
+{
+	double best = 1e300;
+	std::stringstream ss;
+	for (int ii = 0; ii < runs; ++ii) {
+		ss.str("");
+		const auto start = std::chrono::high_resolution_clock::now();
+		format.generateOutput(sim, ss);
+		const auto end = std::chrono::high_resolution_clock::now();
+		best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count());
+	}
+	bytes = ss.str().size();
+	return best;
+}
+
+} // namespace
+
+
+int main(int argc, char **argv)
+{
+	const int count = (argc > 1) ? std::atoi(argv[1]) : 100000;
+	const int rounds = (argc > 2) ? std::atoi(argv[2]) : 6;
+	const int runs = (argc > 3) ? std::atoi(argv[3]) : 15;
+
+	reb_simulation *sim = reb_create_simulation();
+	sim->G = 1;
+	reb_particle bh = {};
+	bh.m = 1;
+	reb_add(sim, bh);
+	for (int ii = 0; ii < count; ++ii) {
+		const double a = 1.1 + 0.6 * ((ii * 7919) % 1000) / 1000.0;
+		const double e = 0.6 + 0.1 * ((ii * 104729) % 1000) / 1000.0;
+		const double inc = 0.01 * ((ii * 31) % 7);
+		const double f = 6.0 * ((ii * 15485863) % 1000) / 1000.0;
+		reb_add(sim, reb_tools_orbit_to_particle(1, bh, 1e-8, a, e, inc, 0, 0, f));
+	}
+
+	std::printf("%d particles, best of %dx%d runs\n", count + 1, rounds, runs);
+	for (const char *fmt : FORMATS) {
+		OutputFormat format;
+		if (!format.loadFormat(fmt)) {
+			std::printf("Could not load the format '%s'\n", fmt);
+			return -1;
+		}
+
+		double best = 1e300;
+		size_t bytes = 0;
+		for (int ii = 0; ii < rounds; ++ii)
+			best = std::min(best, time_format(sim, format, runs, bytes));
+		std::printf("  %-26s %8.1f ns/particle (%zu bytes)\n", fmt, best / (count + 1), bytes);
+	}
+
+	reb_free_simulation(sim);
+	return 0;
+}
\ No newline at end of file
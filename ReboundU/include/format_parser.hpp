@@ -18,15 +18,17 @@ private:
 	using FormatNode = format_ast::base_node;
 	using ASTList = std::vector<std::unique_ptr<FormatNode>>;
 
-	ASTList m_formats;
+	FormatPlan m_plan;
 
 public:
 	OutputFormat() { }
 	~OutputFormat() {
-		m_formats.clear();
+		m_plan.clear();
 	}
 
 	bool loadFormat(const std::string& fmt);
 
+	inline void setPrecision(int precision) { m_plan.setPrecision(precision); }
+
 	void generateOutput(reb_simulation *sim, std::stringstream& out);
 };
\ No newline at end of file
@@ -10,6 +10,7 @@
 #define FORMAT_TOKEN_HPP_
 
 #include <reboundu.h>
+#include <number_format.hpp>
 #include <cstdint>
 #include <vector>
 #include <memory>
@@ -108,20 +109,89 @@ enum class ValueDataType :
 // Forward declaration of LbdSimulation class
 class LbdSimulation;
 
+
+// The operations that make up a compiled format plan
+enum class PlanOp :
+	std::uint8_t
+{
+	Literal,        // Write a literal string
+	Separator,      // Write a literal string, unless on the last particle of a loop
+	ParticleValue,  // Write a value for the current loop particle
+	AggregateValue, // Write an average or standard deviation over all of the particles
+	SimValue,       // Write a simulation value
+	LoopBegin,      // Start looping over the particles, skipping past the matching LoopEnd if there are none
+	LoopEnd         // Move to the next particle, jumping back to the matching LoopBegin if there are any left
+};
+
+// A single instruction in a compiled format plan
+struct plan_instruction
+{
+	PlanOp op;
+	ValueGroup group; // Only used by AggregateValue
+	ValuePType ptype; // Only used by ParticleValue and AggregateValue
+	ValueSType stype; // Only used by SimValue
+	std::uint32_t arg; // The literal index for Literal and Separator, or the jump target for LoopBegin and LoopEnd
+};
+
+// A format string that has been lowered from its parsed tree into a flat list of instructions, which
+//     is run by a single switch-dispatched loop instead of walking the tree for every particle. All of
+//     the decisions that can be made when the format is loaded (such as trimming trailing list 
+//     punctuation) are baked into the instructions.
+class FormatPlan
+{
+public:
+	using InstructionList = std::vector<plan_instruction>;
+
+private:
+	InstructionList m_instructions;
+	std::vector<std::string> m_literals;
+	int m_precision; // The significant digits for text values, or NUMFMT_ROUNDTRIP
+
+public:
+	FormatPlan() : m_precision{NUMFMT_ROUNDTRIP} { }
+	~FormatPlan() { }
+
+	FormatPlan(const FormatPlan&) = delete;
+	FormatPlan& operator = (const FormatPlan&) = delete;
+
+	inline const InstructionList& getInstructions() const { return m_instructions; }
+
+	void addLiteral(const std::string& str);
+	void addSeparator(const std::string& str);
+	void addParticleValue(ValuePType type);
+	void addAggregateValue(ValueGroup group, ValuePType type);
+	void addSimValue(ValueSType type);
+	std::uint32_t beginLoop(); // Returns the index of the LoopBegin instruction, to pass to endLoop()
+	void endLoop(std::uint32_t begin);
+
+	void clear();
+
+	inline int getPrecision() const { return m_precision; }
+	inline void setPrecision(int precision) { m_precision = precision; }
+
+	void execute(reb_simulation *sim, std::stringstream& out) const;
+
+private:
+	plan_instruction& addInstruction(PlanOp op);
+};
+
+
 namespace format_ast
 {
 
 struct base_node
 {
 public:
-	std::uint32_t pIndex; // Only used by pvalue nodes, but defined here for speed
+	const TokenType tokenType;
 
 public:
-	base_node() :
-		pIndex{0}
+	base_node(TokenType type) :
+		tokenType{type}
 	{ }
+	virtual ~base_node() { }
 
-	virtual void generateOutput(reb_simulation *sim, std::stringstream& out) = 0;
+	// Appends the instructions for this node to the end of the plan
+	virtual void lower(FormatPlan& plan) const = 0;
 };
 
 struct punctuation_node :
@@ -132,10 +202,10 @@ public:
 
 public:
 	punctuation_node(const std::string& pstr) :
-		pstring{pstr}
+		base_node(TokenType::Punctuation), pstring{pstr}
 	{ }
 
-	void generateOutput(reb_simulation *sim, std::stringstream& out) override;
+	void lower(FormatPlan& plan) const override;
 };
 
 struct pvalue_token_node :
@@ -147,10 +217,10 @@ public:
 
 public:
 	pvalue_token_node(ValueGroup vg, ValuePType vt) :
-		valueGroup{vg}, valueType{vt}
+		base_node(TokenType::ValueToken), valueGroup{vg}, valueType{vt}
 	{ }
 
-	void generateOutput(reb_simulation *sim, std::stringstream& out) override;
+	void lower(FormatPlan& plan) const override;
 };
 
 struct svalue_token_node :
@@ -161,10 +231,10 @@ public:
 
 public:
 	svalue_token_node(ValueSType vt) :
-		valueType{vt}
+		base_node(TokenType::ValueToken), valueType{vt}
 	{ }
 
-	void generateOutput(reb_simulation *sim, std::stringstream& out) override;
+	void lower(FormatPlan& plan) const override;
 };
 
 struct list_node :
@@ -180,10 +250,11 @@ public:
 
 public:
 	list_node(node_ptr_list& list, bool lastn) :
-		nodeList(std::move(constructVector(list))), count(list.size()), last{lastn}
+		base_node(TokenType::ListSpecifier), nodeList(std::move(constructVector(list))), count(list.size()), 
+		last{lastn}
 	{ }
 
-	void generateOutput(reb_simulation *sim, std::stringstream& out) override;
+	void lower(FormatPlan& plan) const override;
 
 private:
 	static node_list constructVector(node_ptr_list& list)
@@ -33,6 +33,7 @@ public:
 	bool isStdOut() const { return m_isStdOut; }
 
 	rebu_error_code_t loadFormat(const std::string& fmt);
+	inline void setPrecision(int precision) { m_format->setPrecision(precision); }
 	void update();
 };
 
@@ -49,6 +50,6 @@ public:
 	OutputManager(reb_simulation *sim);
 	~OutputManager();
 
-	rebu_error_code_t addOutput(const std::string& file, const std::string& format, double time);
+	rebu_error_code_t addOutput(const std::string& file, const std::string& format, double time, int precision);
 	void update();
 };
\ No newline at end of file
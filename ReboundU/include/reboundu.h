@@ -34,6 +34,13 @@ typedef enum
 } rebu_error_code_t;
 
 
+// The output precision that writes the shortest values that read back exactly the same
+#define REBU_PRECISION_ROUNDTRIP (0)
+
+// Set the number of significant digits (1 to 17) written by the outputs added after this call, or
+//     REBU_PRECISION_ROUNDTRIP (the default) for the shortest values that read back exactly the same
+extern void rebu_set_output_precision(int precision);
+
 // Add an output file to a simulation with the given format
 extern rebu_error_code_t rebu_add_output_file(reb_simulation *sim, const char *path, const char *format, double time);
 
@@ -126,6 +126,7 @@ bool OutputFormat::loadFormat(const std::string& fmt)
 	std::smatch match;
 	size_t currentStart = 0;
 	std::string currentFmtString = fmt;
+	ASTList formats;
 	while (std::regex_search(currentFmtString, match, FULL_REGEX, 
 			std::regex_constants::match_continuous | std::regex_constants::match_not_null)) {
 		currentStart += match.length();
@@ -147,7 +148,7 @@ bool OutputFormat::loadFormat(const std::string& fmt)
 			node = new format_ast::punctuation_node(puncStr);
 		}
 
-		m_formats.emplace_back(std::move(std::unique_ptr<FormatNode>(node)));
+		formats.emplace_back(std::move(std::unique_ptr<FormatNode>(node)));
 		currentFmtString = fmt.substr(currentStart);
 	}
 
@@ -156,13 +157,17 @@ bool OutputFormat::loadFormat(const std::string& fmt)
 		return false;
 	}
 
+	// Lower the parsed tree into the flat plan, the tree is not needed after this
+	m_plan.clear();
+	for (auto& nodeptr : formats) {
+		nodeptr->lower(m_plan);
+	}
+
 	return true;
 }
 
 // ================================================================================================
 void OutputFormat::generateOutput(reb_simulation *sim, std::stringstream& out)
 {
-	for (auto& nodeptr : m_formats) {
-		nodeptr->generateOutput(sim, out);
-	}
+	m_plan.execute(sim, out);
 }
\ No newline at end of file
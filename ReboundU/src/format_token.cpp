@@ -11,6 +11,7 @@
 #include <cmath>
 #include <iostream>
 #include <algorithm>
+#include <numeric>
 
 
 namespace
@@ -27,8 +28,25 @@ int _getOrbitForParticle(reb_simulation *sim, const reb_particle *part, reb_orbi
 #define VT_DOUBLE (1)
 #define VT_INT (2)
 
-#define SIMEXT_(token, value) case ValueSType::token: { ss << (value); break; }
-void _printSimulationValue(reb_simulation *sim, ValueSType type, std::stringstream& ss)
+// Writes a single value as text, with numbers going through the fast formatting instead of the stream
+inline void _printValue(std::stringstream& out, int precision, double value) { numfmt::append(out, value, precision); }
+inline void _printValue(std::stringstream& out, int /*precision*/, int value) { numfmt::append(out, value); }
+inline void _printValue(std::stringstream& out, int /*precision*/, std::uint32_t value) { numfmt::append(out, value); }
+
+// Writes a vector value in the "{{x|y|z}}" format
+void _printVector(std::stringstream& out, int precision, double x, double y, double z)
+{
+	out << "{{";
+	numfmt::append(out, x, precision);
+	out << '|';
+	numfmt::append(out, y, precision);
+	out << '|';
+	numfmt::append(out, z, precision);
+	out << "}}";
+}
+
+#define SIMEXT_(token, value) case ValueSType::token: { _printValue(ss, precision, (value)); break; }
+void _printSimulationValue(reb_simulation *sim, ValueSType type, int precision, std::stringstream& ss)
 {
 	switch (type)
 	{
@@ -46,7 +64,7 @@ void _printSimulationValue(reb_simulation *sim, ValueSType type, std::stringstre
 }
 #undef SIMEXT_
 
-#define PARTEXT_(token, value) case ValuePType::token: { out << (value); break; }
+#define PARTEXT_(token, value) case ValuePType::token: { _printValue(out, precision, (value)); break; }
 #define PARTOEXT_(token, omember) case ValuePType::token: { \
 	reb_orbit orbit; \
 	int err = _getOrbitForParticle(sim, &part, orbit); \
@@ -54,14 +72,14 @@ void _printSimulationValue(reb_simulation *sim, ValueSType type, std::stringstre
 		std::cerr << "Could not get the orbital value, reason: \"" << orbitErrMsg[err] << "\"." << std::endl; \
 		throw "Orbit value get error."; \
 	} \
-	out << (orbit.omember); \
+	_printValue(out, precision, orbit.omember); \
 	break; \
 }
 const char *orbitErrMsg[2] = {
 	"The particle has no mass.",
 	"The particle is in the same place as the primary particle."
 };
-void _printParticleValue(reb_simulation *sim, std::uint32_t index, ValuePType type, std::stringstream& out)
+void _printParticleValue(reb_simulation *sim, std::uint32_t index, ValuePType type, int precision, std::stringstream& out)
 {
 	static const auto getEccentricityVector = [sim](const reb_particle& part) -> reb_vec3d {
 		using namespace vecmath;
@@ -113,7 +131,7 @@ void _printParticleValue(reb_simulation *sim, std::uint32_t index, ValuePType ty
 		PARTEXT_(EccZ, getEccentricityVector(part).z)
 		case ValuePType::EccVec: {
 			const reb_vec3d ecc = getEccentricityVector(part);
-			out << "{{" << ecc.x << "|" << ecc.y << "|" << ecc.z << "}}";
+			_printVector(out, precision, ecc.x, ecc.y, ecc.z);
 			break;
 		}
 		PARTOEXT_(AngMom, h)
@@ -122,7 +140,7 @@ void _printParticleValue(reb_simulation *sim, std::uint32_t index, ValuePType ty
 		PARTEXT_(AMZ, getAngMomVector(part).z)
 		case ValuePType::AMVec: {
 			const reb_vec3d am = getAngMomVector(part);
-			out << "{{" << am.x << "|" << am.y << "|" << am.z << "}}";
+			_printVector(out, precision, am.x, am.y, am.z);
 			break;
 		}
 		default: out << "INVALID"; break;
@@ -221,104 +239,210 @@ void _extractParticleValues(reb_simulation *sim, ValuePType type, double *vals)
 #undef PARTEXT_
 #undef PARTOEXT_
 
+// Writes the average or standard deviation of a particle value over all of the particles
+void _printAggregateValue(reb_simulation *sim, ValueGroup group, ValuePType type, int precision, std::stringstream& out)
+{
+	const int PCOUNT = sim->N;
+	const bool ISVEC = (type == ValuePType::EccVec || type == ValuePType::AMVec);
+	double *vals = new double[PCOUNT * (ISVEC ? 3 : 1)];
+	_extractParticleValues(sim, type, vals);
+
+	if (ISVEC) {
+		double sumx = 0, sumy = 0, sumz = 0;
+		for (int i = 0; i < PCOUNT; ++i) {
+			const int IDX = i * 3;
+			sumx += vals[IDX + 0];
+			sumy += vals[IDX + 1];
+			sumz += vals[IDX + 2];
+		}
+		const double MEANX = sumx / PCOUNT;
+		const double MEANY = sumy / PCOUNT;
+		const double MEANZ = sumz / PCOUNT;
+
+		if (group == ValueGroup::StdDev) {
+			sumx = sumy = sumz = 0;
+			for (int i = 0; i < PCOUNT; ++i) {
+				const int IDX = i * 3;
+				sumx += pow(vals[IDX + 0] - MEANX, 2);
+				sumy += pow(vals[IDX + 1] - MEANY, 2);
+				sumz += pow(vals[IDX + 2] - MEANZ, 2);
+			}
+			_printVector(out, precision, sqrt(sumx / PCOUNT), sqrt(sumy / PCOUNT), sqrt(sumz / PCOUNT));
+		}
+		else
+			_printVector(out, precision, MEANX, MEANY, MEANZ);
+	}
+	else {
+		double sum = std::accumulate(&(vals[0]), &(vals[PCOUNT]), 0.0);
+		const double MEAN = sum / PCOUNT;
+
+		if (group == ValueGroup::StdDev) {
+			sum = 0;
+			for (int i = 0; i < PCOUNT; ++i) {
+				sum += pow(vals[i] - MEAN, 2);
+			}
+			numfmt::append(out, sqrt(sum / PCOUNT), precision);
+		}
+		else
+			numfmt::append(out, MEAN, precision);
+	}
+
+	delete[] vals;
+}
+
 } // namespace 
 
 
-namespace format_ast
+// ================================================================================================
+plan_instruction& FormatPlan::addInstruction(PlanOp op)
 {
+	plan_instruction inst;
+	inst.op = op;
+	inst.group = ValueGroup::INVALID;
+	inst.ptype = ValuePType::INVALID;
+	inst.stype = ValueSType::INVALID;
+	inst.arg = 0;
+	m_instructions.push_back(inst);
+	return m_instructions.back();
+}
 
 // ================================================================================================
-void punctuation_node::generateOutput(reb_simulation *sim, std::stringstream& out)
+void FormatPlan::addLiteral(const std::string& str)
 {
-	out << pstring;
+	// Merge runs of literals into one, so they are written with a single instruction
+	if (m_instructions.size() && m_instructions.back().op == PlanOp::Literal) {
+		m_literals[m_instructions.back().arg] += str;
+		return;
+	}
+
+	addInstruction(PlanOp::Literal).arg = static_cast<std::uint32_t>(m_literals.size());
+	m_literals.push_back(str);
 }
 
 // ================================================================================================
-void pvalue_token_node::generateOutput(reb_simulation *sim, std::stringstream& out)
+void FormatPlan::addSeparator(const std::string& str)
 {
-	if (valueGroup == ValueGroup::Particle)
-		_printParticleValue(sim, pIndex, valueType, out);
-	else {
-		const int PCOUNT = sim->N;
-		const bool ISVEC = (valueType == ValuePType::EccVec || valueType == ValuePType::AMVec);
-		double *vals = new double[PCOUNT * (ISVEC ? 3 : 1)];
-		_extractParticleValues(sim, valueType, vals);
+	addInstruction(PlanOp::Separator).arg = static_cast<std::uint32_t>(m_literals.size());
+	m_literals.push_back(str);
+}
 
-		if (ISVEC) {
-			double sumx = 0, sumy = 0, sumz = 0;
-			for (int i = 0; i < PCOUNT; ++i) {
-				const int IDX = i * 3;
-				sumx += vals[IDX + 0];
-				sumy += vals[IDX + 1];
-				sumz += vals[IDX + 2];
+// ================================================================================================
+void FormatPlan::addParticleValue(ValuePType type)
+{
+	addInstruction(PlanOp::ParticleValue).ptype = type;
+}
+
+// ================================================================================================
+void FormatPlan::addAggregateValue(ValueGroup group, ValuePType type)
+{
+	plan_instruction& inst = addInstruction(PlanOp::AggregateValue);
+	inst.group = group;
+	inst.ptype = type;
+}
+
+// ================================================================================================
+void FormatPlan::addSimValue(ValueSType type)
+{
+	addInstruction(PlanOp::SimValue).stype = type;
+}
+
+// ================================================================================================
+std::uint32_t FormatPlan::beginLoop()
+{
+	addInstruction(PlanOp::LoopBegin);
+	return static_cast<std::uint32_t>(m_instructions.size() - 1);
+}
+
+// ================================================================================================
+void FormatPlan::endLoop(std::uint32_t begin)
+{
+	addInstruction(PlanOp::LoopEnd).arg = begin;
+	m_instructions[begin].arg = static_cast<std::uint32_t>(m_instructions.size() - 1);
+}
+
+// ================================================================================================
+void FormatPlan::clear()
+{
+	m_instructions.clear();
+	m_literals.clear();
+}
+
+// ================================================================================================
+void FormatPlan::execute(reb_simulation *sim, std::stringstream& out) const
+{
+	const std::uint32_t PCOUNT = static_cast<std::uint32_t>(sim->N);
+	const plan_instruction *INSTS = m_instructions.data();
+	const size_t ICOUNT = m_instructions.size();
+
+	std::uint32_t pIndex = 0;
+	for (size_t ip = 0; ip < ICOUNT; ++ip) {
+		const plan_instruction& inst = INSTS[ip];
+		switch (inst.op) {
+			case PlanOp::Literal: out << m_literals[inst.arg]; break;
+			case PlanOp::Separator: {
+				if ((pIndex + 1) < PCOUNT)
+					out << m_literals[inst.arg];
+				break;
 			}
-			const double MEANX = sumx / PCOUNT;
-			const double MEANY = sumy / PCOUNT;
-			const double MEANZ = sumz / PCOUNT;
-
-			if (valueGroup == ValueGroup::StdDev) {
-				sumx = sumy = sumz = 0;
-				for (int i = 0; i < PCOUNT; ++i) {
-					const int IDX = i * 3;
-					sumx += pow(vals[IDX + 0] - MEANX, 2);
-					sumy += pow(vals[IDX + 1] - MEANY, 2);
-					sumz += pow(vals[IDX + 2] - MEANZ, 2);
-				}
-				out << "{{" << sqrt(sumx / PCOUNT) << "|" << sqrt(sumy / PCOUNT) << "|" 
-					<< sqrt(sumz / PCOUNT) << "}}";
+			case PlanOp::ParticleValue: _printParticleValue(sim, pIndex, inst.ptype, m_precision, out); break;
+			case PlanOp::AggregateValue: _printAggregateValue(sim, inst.group, inst.ptype, m_precision, out); break;
+			case PlanOp::SimValue: _printSimulationValue(sim, inst.stype, m_precision, out); break;
+			case PlanOp::LoopBegin: {
+				pIndex = 0;
+				if (PCOUNT == 0)
+					ip = inst.arg; // Skip to the LoopEnd, which is then stepped past
+				break;
 			}
-			else
-				out << "{{" << MEANX << "|" << MEANY << "|" << MEANZ << "}}";
-		}
-		else {
-			double sum = std::accumulate(&(vals[0]), &(vals[PCOUNT]), 0.0);
-			const double MEAN = sum / PCOUNT;
-
-			if (valueGroup == ValueGroup::StdDev) {
-				sum = 0;
-				for (int i = 0; i < PCOUNT; ++i) {
-					sum += pow(vals[i] - MEAN, 2);
-				}
-				out << sqrt(sum / PCOUNT);
+			case PlanOp::LoopEnd: {
+				if (++pIndex < PCOUNT)
+					ip = inst.arg; // Jump to the LoopBegin, which is then stepped past into the body
+				break;
 			}
-			else
-				out << MEAN;
 		}
-
-		delete vals;
 	}
 }
 
+
+
+
+namespace format_ast
+{
+
 // ================================================================================================
-void svalue_token_node::generateOutput(reb_simulation *sim, std::stringstream& out)
+void punctuation_node::lower(FormatPlan& plan) const
 {
-	_printSimulationValue(sim, valueType, out);
+	plan.addLiteral(pstring);
 }
 
 // ================================================================================================
-void list_node::generateOutput(reb_simulation *sim, std::stringstream& out)
+void pvalue_token_node::lower(FormatPlan& plan) const
 {
-	const int pCount = sim->N;
+	if (valueGroup == ValueGroup::Particle)
+		plan.addParticleValue(valueType);
+	else
+		plan.addAggregateValue(valueGroup, valueType);
+}
 
-	std::stringstream listss;
-	for (int i = 0; i < pCount; ++i) {
-		for (auto& node : nodeList) {
-			node->pIndex = static_cast<std::uint32_t>(i);
-			node->generateOutput(sim, listss);
-		}
-	}
+// ================================================================================================
+void svalue_token_node::lower(FormatPlan& plan) const
+{
+	plan.addSimValue(valueType);
+}
 
-	std::string liststr = listss.str();
-	if (last) { // Trim the last punctuation token if necessary
-		base_node *node = nodeList.at(nodeList.size() - 1).get();
-		punctuation_node *pnode = nullptr;
-		if ((pnode = dynamic_cast<punctuation_node*>(node)) != nullptr) {
-			size_t len = pnode->pstring.length();
-			liststr.erase(liststr.size() - len);
-		}
+// ================================================================================================
+void list_node::lower(FormatPlan& plan) const
+{
+	const std::uint32_t begin = plan.beginLoop();
+	for (size_t i = 0; i < count; ++i) {
+		const base_node *node = nodeList[i].get();
+		
+		// The trailing punctuation of the last list is only written between particles, not after them
+		if (last && (i == (count - 1)) && (node->tokenType == TokenType::Punctuation))
+			plan.addSeparator(static_cast<const punctuation_node*>(node)->pstring);
+		else
+			node->lower(plan);
 	}
-
-	out << liststr;
+	plan.endLoop(begin);
 }
 
 } // namespace format_ast
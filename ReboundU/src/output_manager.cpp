@@ -130,7 +130,8 @@ OutputManager::~OutputManager()
 }
 
 // ================================================================================================
-rebu_error_code_t OutputManager::addOutput(const std::string& file, const std::string& format, double time)
+rebu_error_code_t OutputManager::addOutput(const std::string& file, const std::string& format, double time, 
+	int precision)
 {
 	OutputFile *outFile = new OutputFile(m_sim, file, time);
 	rebu_error_code_t err = outFile->loadFormat(format);
@@ -138,6 +139,7 @@ rebu_error_code_t OutputManager::addOutput(const std::string& file, const std::s
 		delete outFile;
 		return err;
 	}
+	outFile->setPrecision(precision);
 	m_files.push_back(std::shared_ptr<OutputFile>(outFile));
 
 	return REBU_ERROR_NONE;
@@ -7,12 +7,14 @@
  */
 
 #include <rebu_output.hpp>
+#include <algorithm>
 
 
 namespace
 {
 
 OutputManager *_outputManager = nullptr;
+int _outputPrecision = REBU_PRECISION_ROUNDTRIP;
 
 }
 
@@ -23,13 +25,19 @@ OutputManager* _rebu_get_output_manager()
 	return _outputManager;
 }
 
+// ====================================================================================================================
+void rebu_set_output_precision(int precision)
+{
+	_outputPrecision = (precision < 0) ? REBU_PRECISION_ROUNDTRIP : std::min(precision, NUMFMT_MAX_PRECISION);
+}
+
 // ====================================================================================================================
 rebu_error_code_t rebu_add_output_file(reb_simulation *sim, const char *path, const char *format, double time)
 {
 	if (!_outputManager)
 		_outputManager = new OutputManager(sim);
 
-	return _outputManager->addOutput(path, format, time);
+	return _outputManager->addOutput(path, format, time, _outputPrecision);
 }
 
 // ====================================================================================================================
@@ -38,5 +46,5 @@ rebu_error_code_t rebu_add_terminal_output(reb_simulation *sim, const char *form
 	if (!_outputManager)
 		_outputManager = new OutputManager(sim);
 
-	return _outputManager->addOutput("", format, time);
+	return _outputManager->addOutput("", format, time, _outputPrecision);
 }
\ No newline at end of file
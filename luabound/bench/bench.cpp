@@ -0,0 +1,42 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file implements the timing helpers shared by the benchmarks.
+ */
+
+#include "bench.hpp"
+#include <chrono>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace bench
+{
+
+// ================================================================================================
+double TimeBest(uint32 runs, const std::function<void()>& func)
+{
+	double best = 1e300;
+	for (uint32 i = 0; i < runs; ++i) {
+		const auto start = std::chrono::steady_clock::now();
+		func();
+		const auto end = std::chrono::steady_clock::now();
+		best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+	}
+	return best;
+}
+
+// ================================================================================================
+void SetThreadCount(int threads)
+{
+#ifdef _OPENMP
+	omp_set_num_threads(threads);
+#else
+	(void)threads;
+#endif
+}
+
+} // namespace bench
\ No newline at end of file
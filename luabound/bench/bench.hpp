@@ -0,0 +1,34 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file declares the timing helpers shared by the benchmarks, and the benchmarks themselves, which
+ *     are run by the benchmark executable.
+ */
+
+#ifndef LUABOUND_BENCH_HPP_
+#define LUABOUND_BENCH_HPP_
+
+#include "../test/test.hpp"
+#include <functional>
+
+namespace bench
+{
+
+// Runs the function the given number of times, and returns the time of the fastest run in milliseconds
+double TimeBest(uint32 runs, const std::function<void()>& func);
+
+// Sets the OpenMP thread count for the following parallel regions, does nothing without OpenMP
+void SetThreadCount(int threads);
+
+} // namespace bench
+
+// The benchmarks, which are listed in main.cpp
+void bench_format();
+void bench_lookup();
+void bench_populate();
+void bench_sink();
+
+#endif // LUABOUND_BENCH_HPP_
\ No newline at end of file
@@ -0,0 +1,76 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file times the text output formats on a large list, with each OpenMP thread count, and checks that the
+ *     threads write exactly the same text.
+ */
+
+#include "bench.hpp"
+#include "../src/runtime/output/format_parser.hpp"
+#include "../src/runtime/output/output_tick.hpp"
+
+namespace
+{
+
+const char * const SCRIPT = R"(
+new_simulation {
+	name = "format_bench",
+	seed = 5,
+	constants = { G = 1, max_time = 1 },
+	integrator = { name = "ias15" },
+	output = { },
+	populate = function()
+		sim.addParticle(1, 1e-4, place.cartesian(0.0, 0.0, 0.0), nil, "sun")
+		sim.setPrimaryParticle("sun")
+		local disk = place.kepler3d(dist.uniform(0.5, 2.0), dist.uniform(0.0, 0.9), dist.normal(0.1), 0.0, 0.0,
+			dist.uniform(0, 2 * math.pi))
+		sim.addParticles(100000, dist.uniform(1e-9, 1e-6), 1e-4, disk, sim.getParticle("sun"), "star")
+	end
+}
+)";
+
+const char * const FORMATS[] = {
+	"{#px,#py,#pz,#pvx,#pvy,#pvz;}",
+	"{[star* & e<0.5] #pn,#pa,#pe,#ae[e<1],#me[e<0.5];}"
+};
+const int THREAD_COUNTS[] = { 1, 2, 4 };
+const uint32 RUNS = 5;
+
+} // namespace
+
+
+// ================================================================================================
+void bench_format()
+{
+	StlUniquePtr<LbdSimulation> sim = test::LoadSimulation(SCRIPT);
+	if (!sim)
+		return;
+
+	for (const char *fmt : FORMATS) {
+		OutputFormat format;
+		if (!format.loadFormat(fmt))
+			return;
+		std::cout << "  " << fmt << std::endl;
+
+		// Each record is timed from the capture, since the orbits and the aggregates are calculated in the tick
+		String serial;
+		for (int threads : THREAD_COUNTS) {
+			bench::SetThreadCount(threads);
+			StringStream out;
+			const double ms = bench::TimeBest(RUNS, [&]() {
+				OutputTick tick{sim.get()};
+				tick.capture(format.getPlan().usesParticleNames());
+				out.str("");
+				format.generateOutput(tick, out);
+			});
+			const String text = out.str();
+			if (threads == 1)
+				serial = text;
+			std::cout << strfmt("    %d thread(s): %8.2f ms/record, %zu bytes, %s", threads, ms, text.length(),
+				(text == serial) ? "identical" : "DIFFERENT") << std::endl;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file times the particle lookups of the particle manager, in a loop that adds and removes particles like a
+ *     script that replaces particles during a run, and looks up both existing and missing particles.
+ */
+
+#include "bench.hpp"
+#include "../src/runtime/particle/particle_manager.hpp"
+#include <random>
+
+namespace
+{
+
+const uint32 PARTICLE_COUNT = 1000;
+const uint32 STEP_COUNT = 20000;
+// Each step looks up 12 particles by hash and 4 by name, and one of each is missing (1 in 8)
+const uint32 HASH_LOOKUPS = 12;
+const uint32 NAME_LOOKUPS = 4;
+const uint32 MISSING_HASH = 0xFFFFFFF0;
+const uint32 RUNS = 3;
+
+String _name(uint32 hash)
+{
+	return strfmt("p%u", hash);
+}
+
+} // namespace
+
+
+// ================================================================================================
+void bench_lookup()
+{
+	std::cout << strfmt("  %u particles, each step adds one, removes one, and looks up %u by hash and %u by name",
+		PARTICLE_COUNT, HASH_LOOKUPS, NAME_LOOKUPS) << std::endl;
+
+	uint64 found = 0;
+	const double ms = bench::TimeBest(RUNS, [&]() {
+		reb_simulation *sim = reb_create_simulation();
+		{
+			ParticleManager manager{sim};
+			StlVector<uint32> live;
+			uint32 nextHash = 1;
+			for (; nextHash <= PARTICLE_COUNT; ++nextHash) {
+				reb_particle part{};
+				part.m = 1e-9;
+				part.x = nextHash;
+				part.hash = nextHash;
+				manager.addParticle(_name(nextHash), part);
+				live.push_back(nextHash);
+			}
+
+			std::mt19937 gen{25};
+			found = 0;
+			for (uint32 step = 0; step < STEP_COUNT; ++step) {
+				reb_particle part{};
+				part.m = 1e-9;
+				part.x = nextHash;
+				part.hash = nextHash;
+				manager.addParticle(_name(nextHash), part);
+				live.push_back(nextHash++);
+
+				const uint32 removed = gen() % live.size();
+				manager.removeParticleByHash(live[removed], nullptr);
+				live[removed] = live.back();
+				live.pop_back();
+
+				for (uint32 i = 0; i < HASH_LOOKUPS; ++i) {
+					const uint32 hash = (i == 0) ? MISSING_HASH : live[gen() % live.size()];
+					found += manager.getParticleByHash(hash) ? 1 : 0;
+				}
+				for (uint32 i = 0; i < NAME_LOOKUPS; ++i) {
+					const String name = (i == 0) ? String("missing") : _name(live[gen() % live.size()]);
+					found += manager.getParticleByName(name) ? 1 : 0;
+				}
+			}
+		}
+		reb_free_simulation(sim);
+	});
+
+	const uint32 lookups = STEP_COUNT * (HASH_LOOKUPS + NAME_LOOKUPS);
+	std::cout << strfmt("    %7.3f us/step, %llu of %u lookups found", ms * 1000 / STEP_COUNT,
+		static_cast<unsigned long long>(found), lookups) << std::endl;
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file is the entry point for the benchmark executable, which runs all of the benchmarks, or only the ones
+ *     named on the command line. The benchmarks print their own timings. Run it from a writable directory,
+ *     since the benchmarks write their scripts and output files there.
+ */
+
+#include "bench.hpp"
+#include <cstring>
+
+struct benchmark
+{
+	const char *name;
+	void (*run)();
+};
+
+static const benchmark BENCHMARKS[] = {
+	{ "format", bench_format },
+	{ "lookup", bench_lookup },
+	{ "populate", bench_populate },
+	{ "sink", bench_sink }
+};
+
+
+int main(int argc, char **argv)
+{
+	for (const benchmark& bench : BENCHMARKS) {
+		bool selected = (argc < 2);
+		for (int i = 1; i < argc; ++i)
+			selected = selected || (strcmp(argv[i], bench.name) == 0);
+		if (!selected)
+			continue;
+
+		std::cout << "Running '" << bench.name << "'..." << std::endl;
+		bench.run();
+	}
+
+	return 0;
+}
\ No newline at end of file
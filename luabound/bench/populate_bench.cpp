@@ -0,0 +1,76 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file times the generation of a large orbital population with different populate thread counts, and checks
+ *     that every thread count gives the same particles.
+ */
+
+#include "bench.hpp"
+#include <cstring>
+
+namespace
+{
+
+// The mass is drawn from a power law, and the orbital elements from uniform, rayleigh, and normal distributions
+const char * const SCRIPT = R"(
+new_simulation {
+	name = "populate_bench",
+	seed = 11,
+	populate_threads = %THREADS%,
+	constants = { G = 1, max_time = 1 },
+	integrator = { name = "ias15" },
+	output = { },
+	populate = function()
+		sim.addParticle(1, 1e-4, place.cartesian(0.0, 0.0, 0.0), nil, "sun")
+		sim.setPrimaryParticle("sun")
+		sim.addParticles(1000000, dist.power(1e-9, 1e-6, -2.5), 1e-5, place.kepler3d(dist.uniform(0.5, 3.0),
+			dist.rayleigh(0.1), dist.normal(1e-3), dist.uniform(0, 2 * math.pi), dist.uniform(0, 2 * math.pi),
+			dist.uniform(0, 2 * math.pi)), sim.getParticle("sun"), "p")
+	end
+}
+)";
+
+const uint32 THREAD_COUNTS[] = { 1, 2, 4 };
+const uint32 RUNS = 3;
+
+// Combines the bits of every particle value, so that any difference between the thread counts is seen
+uint64 _checksum(const reb_simulation *sim)
+{
+	uint64 sum = 1469598103934665603ULL;
+	for (int i = 0; i < sim->N; ++i) {
+		const reb_particle& p = sim->particles[i];
+		const double vals[8] = { p.x, p.y, p.z, p.vx, p.vy, p.vz, p.m, p.r };
+		for (const double val : vals) {
+			uint64 bits;
+			memcpy(&bits, &val, sizeof(bits));
+			sum = (sum ^ bits) * 1099511628211ULL;
+		}
+	}
+	return sum;
+}
+
+} // namespace
+
+
+// ================================================================================================
+void bench_populate()
+{
+	std::cout << "  1000000 kepler3d particles, loaded with each populate thread count" << std::endl;
+	uint64 expected = 0;
+	for (const uint32 threads : THREAD_COUNTS) {
+		String script = SCRIPT;
+		script.replace(script.find("%THREADS%"), 9, strfmt("%u", threads));
+		uint64 checksum = 0;
+		const double ms = bench::TimeBest(RUNS, [&]() {
+			StlUniquePtr<LbdSimulation> sim = test::LoadSimulation(script);
+			checksum = sim ? _checksum(sim->getSimulation()) : 0;
+		});
+		if (threads == THREAD_COUNTS[0])
+			expected = checksum;
+		std::cout << strfmt("    %u thread(s)  %8.1f ms  checksum %016llx%s", threads, ms,
+			static_cast<unsigned long long>(checksum), (checksum == expected) ? "" : " (DIFFERENT)") << std::endl;
+	}
+}
\ No newline at end of file
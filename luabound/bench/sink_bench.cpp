@@ -0,0 +1,155 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file times the buffered file sinks that the output files write through, with each flush policy, and the
+ *     ways of moving large text records and list chunks between the buffers.
+ */
+
+#include "bench.hpp"
+#include "../src/runtime/output/output_manager.hpp"
+#include "../src/runtime/output/output_tick.hpp"
+#include "../src/util/file_sink.hpp"
+#include <cstdio>
+
+namespace
+{
+
+const char * const SCRIPT = R"(
+new_simulation {
+	name = "sink_bench",
+	seed = 7,
+	constants = { G = 1, max_time = 1 },
+	integrator = { name = "ias15" },
+	output = { },
+	populate = function()
+		sim.addParticle(1, 1e-4, place.cartesian(0.0, 0.0, 0.0), nil, "sun")
+		sim.setPrimaryParticle("sun")
+		sim.addParticles(100, 1e-9, 1e-4, place.kepler3d(dist.uniform(0.5, 2.0), 0.1, 0.0, 0.0, 0.0,
+			dist.uniform(0, 2 * math.pi)), sim.getParticle("sun"), "p")
+	end
+}
+)";
+
+const uint32 FILE_COUNT = 200;
+const uint32 TICK_COUNT = 2000;
+const size_t LINE_SIZE = 25600000;
+const uint32 CHUNK_COUNT = 4;
+const uint32 RUNS = 3;
+
+struct flush_case
+{
+	const char *name;
+	FlushPolicy policy;
+	double interval;
+};
+
+const flush_case FLUSH_CASES[] = {
+	{ "line", FlushPolicy::Line, 0 },
+	{ "tick", FlushPolicy::Tick, 0 },
+	{ "seconds:0.5", FlushPolicy::Seconds, 0.5 },
+	{ "close", FlushPolicy::Close, 0 }
+};
+
+String _fileName(uint32 index)
+{
+	return strfmt("bench_sink_%u.dat", index);
+}
+
+// Fills the stream with lines of numbers, up to about the size
+void _fillText(StringStream& out, size_t size)
+{
+	uint32 line = 0;
+	while (static_cast<size_t>(out.tellp()) < size)
+		out << "1.2345678901234567," << line++ << ",-0.98765432109876543;";
+}
+
+} // namespace
+
+
+// ================================================================================================
+void bench_sink()
+{
+	StlUniquePtr<LbdSimulation> sim = test::LoadSimulation(SCRIPT);
+	if (!sim)
+		return;
+
+	// Many small text files with indexes, which are written and flushed once per tick like the output manager does
+	std::cout << strfmt("  %u indexed files of \"#st #sc #sG\", %u ticks", FILE_COUNT, TICK_COUNT) << std::endl;
+	OutputTick tick{sim.get()};
+	tick.capture(false);
+	for (const flush_case& fcase : FLUSH_CASES) {
+		bool good = true;
+		const double ms = bench::TimeBest(RUNS, [&]() {
+			StlVector<StlUniquePtr<OutputFile>> files;
+			for (uint32 i = 0; i < FILE_COUNT; ++i) {
+				files.emplace_back(new OutputFile(sim.get(), _fileName(i), 1, false));
+				good = good && files.back()->loadFormat("#st #sc #sG");
+				files.back()->setIndexed(true);
+				files.back()->setFlushPolicy(fcase.policy, fcase.interval, false);
+			}
+			for (uint32 t = 0; good && (t < TICK_COUNT); ++t) {
+				for (auto& file : files)
+					good = good && file->write(tick);
+				for (auto& file : files)
+					good = good && file->flushTick();
+			}
+			for (auto& file : files)
+				good = file->close() && good;
+		});
+		std::cout << strfmt("    %-12s %6.3f us/record%s", fcase.name, ms * 1000 / (FILE_COUNT * TICK_COUNT),
+			good ? "" : " (FAILED)") << std::endl;
+	}
+	for (uint32 i = 0; i < FILE_COUNT; ++i) {
+		std::remove(_fileName(i).c_str());
+		std::remove((_fileName(i) + INDEX_FILE_EXTENSION).c_str());
+	}
+
+	// One very large list line, which goes around the sink buffer
+	StringStream line;
+	_fillText(line, LINE_SIZE);
+	const size_t lineSize = static_cast<size_t>(line.tellp());
+	bool lineGood = true;
+	const double streamMs = bench::TimeBest(RUNS, [&]() {
+		FileSink sink;
+		size_t size = 0;
+		line.seekg(0);
+		lineGood = sink.open(_fileName(0)) && sink.write(line.rdbuf(), size) && sink.close() && lineGood;
+	});
+	const double copyMs = bench::TimeBest(RUNS, [&]() {
+		FileSink sink;
+		const String text = line.str();
+		lineGood = sink.open(_fileName(0)) && sink.write(text.data(), text.size()) && sink.close() && lineGood;
+	});
+	std::remove(_fileName(0).c_str());
+	std::cout << strfmt("  One %.1f MB line, written and closed%s", lineSize / 1e6, lineGood ? "" : " (FAILED)")
+		<< std::endl;
+	std::cout << strfmt("    from the stream buffer  %7.2f ms", streamMs) << std::endl;
+	std::cout << strfmt("    copied out with str()   %7.2f ms", copyMs) << std::endl;
+
+	// The OpenMP list chunks, which are appended to the record stream in order
+	StlVector<StringStream> chunks(CHUNK_COUNT);
+	for (auto& chunk : chunks)
+		_fillText(chunk, LINE_SIZE / CHUNK_COUNT);
+	StringStream record;
+	const double chunkCopyMs = bench::TimeBest(RUNS, [&]() {
+		record.str("");
+		for (auto& chunk : chunks) {
+			const String text = chunk.str();
+			record.write(text.data(), text.size());
+		}
+	});
+	const double chunkStreamMs = bench::TimeBest(RUNS, [&]() {
+		record.str("");
+		for (auto& chunk : chunks) {
+			chunk.seekg(0);
+			record << chunk.rdbuf();
+		}
+	});
+	std::cout << strfmt("  %u list chunks of %.1f MB, appended to the record", CHUNK_COUNT,
+		LINE_SIZE / CHUNK_COUNT / 1e6) << std::endl;
+	std::cout << strfmt("    str() and write()       %7.2f ms", chunkCopyMs) << std::endl;
+	std::cout << strfmt("    << rdbuf()              %7.2f ms", chunkStreamMs) << std::endl;
+}
\ No newline at end of file
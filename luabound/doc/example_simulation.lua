@@ -4,6 +4,16 @@ new_simulation {
 	-- This is the name of the simulation (not quite sure what will be done with this yet)
 	name = "example_simulation",
 
+	-- The seed for all of the random values in the distributions. Each random value only depends on the seed,
+	--     the particle it is for, and which value of that particle it is, so the same seed always creates the
+	--     same particles. Without a seed, a random one is picked, and written to the log so the run can be repeated.
+	seed = 42,
+
+	-- The number of threads that generate the particles in sim.addParticles(), in the OpenMP builds. Since the
+	--     random values of each particle do not depend on the others, the particles are the same for any number
+	--     of threads. The default, 0, uses all of the OpenMP threads (set with OMP_NUM_THREADS).
+	populate_threads = 0,
+
 	-- These are the constants that can be set for the simulation
 	constants = {
 		G = 1, -- Set G = 1
@@ -30,7 +40,9 @@ new_simulation {
 		-- The first output file. This one tracks only the average eccentricity of the simulation
 		["avg_e.dat"] = { -- Sets the output filename to be "avg_e.dat"
 			format = "#ae", -- Format of output, in this case the global average e, one per line
-			time = math.pi / 2.0 -- Create output every pi/2 times (every 1/4 orbit, with G=1, a=1 units)
+			time = math.pi / 2.0, -- Create output every pi/2 times (every 1/4 orbit, with G=1, a=1 units)
+			precision = 6 -- Write 6 significant digits. The default, "roundtrip", writes the shortest value
+						  --     that reads back as exactly the same number.
 		},
 		-- The second output file, which creates a list of each particle's semi-major axis
 		["all_a.dat"] = { -- Sets the output filename to be "all_a.dat"
@@ -43,6 +55,118 @@ new_simulation {
 			format = "#st, #sc: {#pa,#pe;} #sG, #ajv, #djv: {#pj,}",
 			time = math.pi / 2.0
 		},
+		-- Binary output, which writes the raw values instead of text. Each list is written as one
+		--     contiguous column per value token, so this is much faster and smaller for big lists.
+		--     String values (#pn, #sn, #si) cannot be used in binary files. Load with luabound.py.
+		["all_pos.bin"] = {
+			format = "#st, #sc: {#ph,#px,#py,#pz;}",
+			time = math.pi / 2.0,
+			binary = true
+		},
+		-- Compressed output is binary output where each value is XOR encoded against the same value in the last
+		--     record, so values that change slowly take only a few bits. The records are written in blocks of
+		--     "keyframe" records (default 64), and each block can be read on its own. The values are exact by
+		--     default. Setting "mantissa_bits" (1 to 52) rounds the doubles to that many mantissa bits before
+		--     encoding, which loses precision, but compresses much better than the exact values (27 bits keeps
+		--     about 8 significant digits). The bits are recorded in the file, and luabound.py reports them.
+		--     Reading these files with luabound.py needs the io library that is built with luabound.
+		["orbits.lbz"] = {
+			format = "#st, #sc: {#pa,#pe,#pi,#pO,#po;}",
+			time = math.pi / 2.0,
+			compress = true,
+			keyframe = 64,
+			mantissa_bits = 27
+		},
+		-- Every output file also gets an index file ("all_a.dat.idx"), with the time, timestep, and byte offset of
+		--     each record, so that readers can jump straight to any record. Set index = false to turn this off.
+		["last_a.dat"] = {
+			format = "#st, #sc: {#pa;}",
+			time = math.pi / 2.0,
+			index = false
+		},
+		-- Statistics over all particles. Besides the average (#a) and standard deviation (#d), there is the
+		--     minimum (#n), maximum (#x), median (#m), mass-weighted average (#w), and any percentile
+		--     (#q<percent>, like #q90 or #q2.5). All statistics for one value share a single pass over the particles.
+		["stats_e.dat"] = {
+			format = "#st #ae #de #ne #xe #me #q10e #q90e #wa",
+			time = math.pi / 2.0
+		},
+		-- Particle filters select which particles a list or statistic uses, and are written in square brackets at
+		--     the start of a list, or right after a statistic token. A filter is a name pattern ("star*"), or a test
+		--     on a particle value ("e<1", "a>=0.5", or a range "h=100..199"), and clauses are joined with "&". Each
+		--     filter is only checked once per output, no matter how many tokens use it. Text files can only have
+		--     one list if it is filtered, because the list lengths are not written, but binary files can have many.
+		--     Particles that have no orbit, like the primary particle, never pass a test on an orbital value.
+		["stars.dat"] = {
+			format = "#st #ae[star*] #ne[star*&e<1]: {[star* & e<1] #pn,#pa,#pe;}",
+			time = math.pi / 2.0
+		},
+		-- The positions and velocities (#px, #pvx, #pR, ...) are written in the simulation (inertial) coordinates,
+		--     unless a frame is given: "barycentric" (relative to the center of mass), "heliocentric" (relative to
+		--     the first particle), "jacobi", or "democratic" (democratic heliocentric: heliocentric positions and
+		--     barycentric velocities). The frame is used by every token and filter in the file, and all of the
+		--     particles are converted once per output, no matter how many files use the same frame.
+		["helio_pos.dat"] = {
+			format = "#st: {#pn,#px,#py,#pz,#pvx,#pvy,#pvz;}",
+			time = math.pi / 2.0,
+			frame = "heliocentric"
+		},
+		-- For very large simulations, the lists can write only a random sample of the particles. The sample is
+		--     picked from the particle hashes, so each particle stays in or out of it for the whole run, and
+		--     removed particles simply leave it. The "fraction" of the particles are kept, and the "seed" (default
+		--     0) picks which ones. The sample is on top of any list filters, and the statistics and histograms
+		--     still use all of the particles.
+		["sample_orbits.dat"] = {
+			format = "#st #ae: {#ph,#pa,#pe;}",
+			time = math.pi / 2.0,
+			sample = { fraction = 0.01, seed = 7 }
+		},
+		-- Histograms count the particles in evenly spaced bins of a value, and are written as a single vector
+		--     of all of the bins. "#h(value, min, max, bins)" bins one value, and "#h2(xvalue, yvalue, xmin, xmax,
+		--     xbins, ymin, ymax, ybins)" bins two values (row-major). Adding a 'w' ("#hw", "#h2w") adds up the
+		--     particle masses instead of counting, and histograms can be filtered like the statistics.
+		["profiles.dat"] = {
+			format = "#st #hw(R,0,2,64) #h2(a,e,0.5,1.5,32,0,1,20)[star*]",
+			time = math.pi / 2.0
+		},
+		-- Triggered output is only written when something happens, instead of at a fixed time. The trigger is
+		--     "collision" (a collision was resolved), "escape" (a particle has e >= 1), or any particle filter, which
+		--     fires when at least one particle starts passing it. The trigger is checked every heartbeat, and the
+		--     last "pre" heartbeats before it fired and the next "post" heartbeats after are written with it (both
+		--     default to 0). Triggered files cannot have a time.
+		["close_encounters.dat"] = {
+			format = "#st #sc: {#pn,#px,#py,#pz;}",
+			trigger = "star* & R<0.05",
+			pre = 4,
+			post = 4
+		},
+		["collisions.dat"] = {
+			format = "#st #sc",
+			trigger = "collision"
+		},
+		-- The records are buffered, and "flush" sets when they are written out to the file (and its index):
+		--     "line" (after every record), "tick" (after every heartbeat that wrote the file, the default for
+		--     text), "seconds:N" (at most every N seconds), or "close" (only when the buffer fills, and at the
+		--     end, the default for binary). Setting "sync" also waits for the data to reach the disk at every
+		--     flush, so a crash never loses more than what was written since the last flush.
+		["checkpoint.bin"] = {
+			format = "#st #sc: {#ph,#px,#py,#pz,#pvx,#pvy,#pvz;}",
+			time = 100 * math.pi,
+			binary = true,
+			flush = "seconds:60",
+			sync = true
+		},
+		-- Output that starts with "shm:" is published to a ring buffer in shared memory with the rest of the name,
+		--     instead of being written to a file, so other processes can watch the run live. Readers can attach
+		--     and detach at any time with attach_lbd_shm() in luabound.py, and never slow down the simulation,
+		--     but lose the oldest records if they fall more than "shm_size" MiB (default 64) behind. Shared
+		--     memory output can be text or binary, but not compressed, and is only supported on Linux and macOS.
+		["shm:live_orbits"] = {
+			format = "#st #sc: {#ph,#pa,#pe;}",
+			time = math.pi / 2.0,
+			binary = true,
+			shm_size = 16
+		},
 		-- Output specified to go to stdout, instead of to a file
 		["stdout0"] = {
 			format = "#st",
@@ -50,6 +174,23 @@ new_simulation {
 		}
 	},
 
+	-- Optional settings that control how the output files are written.
+	output_settings = {
+		-- Output times are always a whole number of file times after the start, so they do not drift. With
+		--     exact timing, the timestep before each output time is shortened so that the output is written
+		--     at exactly that time, at the cost of some extra timesteps. The default is false.
+		exact = true,
+		-- Format and write the output on a separate thread, so the simulation only has to stop long
+		--     enough to copy the particles. The default is false. In the OpenMP builds, large text lists are
+		--     also split between the OpenMP threads (set with OMP_NUM_THREADS) either way.
+		threaded = true,
+		-- The number of particle snapshots that can be waiting to be written at once. The default is 4.
+		queue = 4,
+		-- What to do when all of the snapshots are waiting to be written. "block" (the default) waits for
+		--     one to be written, and "drop" skips the output and reports how many were skipped at the end.
+		overflow = "block"
+	},
+
 	-- This is the function that is called immediately after new_simulation, which works to
 	--    actually populate the simulation with the various bodies. This function is not called
 	--    right away because the programmer may want to react to changing things, such as center
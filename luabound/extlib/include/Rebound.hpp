@@ -25,6 +25,13 @@ extern "C" {
 
 #include <rebound.h>
 
+// The bulk coordinate transformations from transformations.c, which are compiled into the library, but are
+//     not declared by the rebound headers in this version
+void reb_transformations_inertial_to_jacobi_posvel(const struct reb_particle* const particles, 
+	struct reb_particle* const p_j, const struct reb_particle* const p_mass, const int N);
+void reb_transformations_inertial_to_democraticheliocentric_posvel(const struct reb_particle* const particles,
+	struct reb_particle* const p_h, const int N);
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus
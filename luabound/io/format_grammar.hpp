@@ -0,0 +1,29 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file defines the regex patterns of the format string grammar. This code does not depend on the rest of
+ *     luabound, so the format parser of the application and the text reader of the io library share it.
+ */
+
+#ifndef LUABOUND_IO_FORMAT_GRAMMAR_HPP_
+#define LUABOUND_IO_FORMAT_GRAMMAR_HPP_
+
+// The patterns are string literals, so that they can be joined into the full pattern at compile time
+#define LBDIO_PUNCTUATION_TOKEN_REGEX R"([,;:\/\\ \t]+)"
+#define LBDIO_VALUE_TOKEN_REGEX R"(#(q\d+(?:\.\d+)?|\w)(\w\w?)(?:\[([^\[\]\{\}]*)\])?)"
+// The whitespace after the filter is skipped
+#define LBDIO_LIST_FILTER_REGEX R"(^\s*\[([^\[\]]*)\]\s*)"
+#define LBDIO_LIST_SPECIFIER_REGEX R"(\{(.*?)\})"
+// Histogram tokens are matched without capture groups, so they do not change the group numbers of the other
+//     patterns, and are then parsed with LBDIO_HISTOGRAM_PARTS_REGEX
+#define LBDIO_HISTOGRAM_TOKEN_REGEX R"(#h2?w?\([^\(\)]*\)(?:\[[^\[\]\{\}]*\])?)"
+#define LBDIO_HISTOGRAM_PARTS_REGEX R"(^#h(2?)(w?)\(([^\(\)]*)\)(?:\[([^\[\]\{\}]*)\])?$)"
+// Matches any one token, where the list specifiers are captured in group 1, and the value tokens in groups 2 to 4
+#define LBDIO_FORMAT_REGEX_FULL \
+	"(?:" LBDIO_LIST_SPECIFIER_REGEX ")|(?:" LBDIO_HISTOGRAM_TOKEN_REGEX ")|(?:" LBDIO_VALUE_TOKEN_REGEX \
+	")|(?:" LBDIO_PUNCTUATION_TOKEN_REGEX ")"
+
+#endif // LUABOUND_IO_FORMAT_GRAMMAR_HPP_
\ No newline at end of file
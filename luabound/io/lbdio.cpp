@@ -0,0 +1,350 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file implements the C interface of the luabound io library, which reads the luabound output
+ *     files that are too slow to read in python.
+ */
+
+#include "lbdio.hpp"
+#include "shm_ring.hpp"
+#include "text_reader.hpp"
+#include "xor_codec.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace lbdio;
+
+
+namespace
+{
+
+thread_local std::string g_error{};
+
+// The state behind a shared memory reader handle
+struct shm_handle
+{
+	ShmRingReader reader;
+	shm_record record;
+};
+
+// Gives the record to the caller, if one was read
+inline int _returnRecord(int result, const shm_record& record, double *time, std::int64_t *timestep,
+	const std::uint8_t **data, std::uint64_t *size)
+{
+	if (result > 0) {
+		*time = record.time;
+		*timestep = record.timestep;
+		*data = record.data.data();
+		*size = record.data.size();
+	}
+	return result;
+}
+
+// Reads bytes from the file, appending them to the buffer if it is given
+bool _readBytes(std::ifstream& file, std::size_t count, std::vector<std::uint8_t> *buffer, std::uint8_t *dst = nullptr)
+{
+	std::uint8_t local[8];
+	std::uint8_t *target = dst ? dst : local;
+	std::vector<std::uint8_t> large;
+	if (!dst && count > sizeof(local)) {
+		large.resize(count);
+		target = large.data();
+	}
+	if (!file.read(reinterpret_cast<char*>(target), count))
+		return false;
+	if (buffer)
+		buffer->insert(buffer->end(), target, target + count);
+	return true;
+}
+
+// Reads a little-endian value from the bytes
+inline std::uint64_t _getLE(const std::uint8_t *bytes, std::uint32_t size)
+{
+	std::uint64_t value = 0;
+	for (std::uint32_t b = 0; b < size; ++b)
+		value |= static_cast<std::uint64_t>(bytes[b]) << (8 * b);
+	return value;
+}
+
+inline void _putLE(std::vector<std::uint8_t>& out, std::uint64_t value, std::uint32_t size)
+{
+	for (std::uint32_t b = 0; b < size; ++b)
+		out.push_back(static_cast<std::uint8_t>(value >> (8 * b)));
+}
+
+// Reads the header of a compressed file, writing the binary file header into the output, and gives the
+//     keyframe interval and the mantissa bits
+bool _readCompressedHeader(std::ifstream& file, std::vector<std::uint8_t>& out, std::vector<column_desc>& columns,
+	std::uint32_t& keyframe, std::uint32_t& mantissaBits)
+{
+	std::uint8_t bytes[8];
+	if (!_readBytes(file, 8, nullptr, bytes) || memcmp(bytes, LBDIO_COMPRESSED_MAGIC, 4) != 0) {
+		g_error = "The file is not a compressed luabound output file.";
+		return false;
+	}
+	const std::uint64_t version = _getLE(bytes + 4, 4);
+	if (version != LBDIO_COMPRESSED_VERSION) {
+		g_error = "The compressed file version is not supported.";
+		return false;
+	}
+	out.insert(out.end(), LBDIO_BINARY_MAGIC, LBDIO_BINARY_MAGIC + 4);
+	_putLE(out, LBDIO_BINARY_VERSION, 4);
+
+	// The file name, timestamp, output time, and format string
+	for (int i = 0; i < 4; ++i) {
+		const std::uint32_t size = (i == 2) ? 8 : 4;
+		if (!_readBytes(file, size, &out, bytes))
+			break;
+		if (i != 2 && !_readBytes(file, static_cast<std::size_t>(_getLE(bytes, 4)), &out))
+			break;
+	}
+
+	// The column descriptions
+	columns.clear();
+	bool good = !file.fail() && _readBytes(file, 4, &out, bytes);
+	const std::uint32_t columnCount = good ? static_cast<std::uint32_t>(_getLE(bytes, 4)) : 0;
+	for (std::uint32_t i = 0; good && i < columnCount; ++i) {
+		good = _readBytes(file, 4, &out, bytes);
+		column_desc col{ bytes[0], bytes[1], bytes[2], bytes[3] };
+		if (good && col.width == 0) {
+			good = _readBytes(file, 4, &out, bytes);
+			col.width = static_cast<std::uint32_t>(_getLE(bytes, 4));
+		}
+		if (col.type != LBDIO_TYPE_DOUBLE && col.type != LBDIO_TYPE_INT && col.type != LBDIO_TYPE_LONG)
+			good = false;
+		columns.push_back(col);
+	}
+
+	// The keyframe interval, then the mantissa bits. Neither is needed to decode the records, but the bits tell
+	//     the readers if the values are exact.
+	good = good && _readBytes(file, 4, nullptr, bytes);
+	keyframe = good ? static_cast<std::uint32_t>(_getLE(bytes, 4)) : 0;
+	good = good && _readBytes(file, 4, nullptr, bytes);
+	mantissaBits = good ? static_cast<std::uint32_t>(_getLE(bytes, 4)) : 0;
+	good = good && (mantissaBits <= LBDIO_MAX_MANTISSA_BITS);
+	if (!good) {
+		g_error = "The compressed file header is truncated or invalid.";
+		return false;
+	}
+	return true;
+}
+
+} // namespace
+
+
+// ================================================================================================
+int lbdio_decode_compressed(const char *path, std::uint64_t offset, std::uint64_t skip, std::uint64_t count,
+	std::uint8_t **data, std::uint64_t *size)
+{
+	*data = nullptr;
+	*size = 0;
+
+	std::ifstream file(path, std::ios_base::in | std::ios_base::binary);
+	if (!file.is_open()) {
+		g_error = std::string("Could not open the file \"") + path + "\".";
+		return 0;
+	}
+
+	std::vector<std::uint8_t> out;
+	std::vector<column_desc> columns;
+	std::uint32_t keyframe, mantissaBits;
+	if (!_readCompressedHeader(file, out, columns, keyframe, mantissaBits))
+		return 0;
+	if (offset > 0 && !file.seekg(static_cast<std::streamoff>(offset))) {
+		g_error = "The block offset is past the end of the file.";
+		return 0;
+	}
+
+	XorDecoder decoder;
+	decoder.setColumns(columns);
+	std::vector<std::uint8_t> block;
+	std::vector<std::uint8_t> scratch;
+	std::uint64_t written = 0;
+	std::uint8_t bytes[12];
+	while ((count == 0 || written < count) && _readBytes(file, 12, nullptr, bytes)) {
+		// Each block is the record count, the encoded size, then the encoded records
+		const std::uint32_t records = static_cast<std::uint32_t>(_getLE(bytes, 4));
+		const std::uint64_t encoded = _getLE(bytes + 4, 8);
+		block.resize(static_cast<std::size_t>(encoded));
+		if (!_readBytes(file, block.size(), nullptr, block.data()))
+			break; // Partial block at the end of the file, from a run that is still going or was killed
+
+		BitReader reader(block.data(), block.size());
+		decoder.reset();
+		for (std::uint32_t r = 0; r < records && (count == 0 || written < count); ++r) {
+			std::vector<std::uint8_t>& target = (skip > 0) ? scratch : out;
+			scratch.clear();
+			if (!decoder.decode(reader, target)) {
+				g_error = "The compressed file has an invalid block.";
+				return 0;
+			}
+			if (skip > 0)
+				--skip;
+			else
+				++written;
+		}
+	}
+
+	*data = static_cast<std::uint8_t*>(malloc(out.size()));
+	if (!*data) {
+		g_error = "Could not allocate the decoded data.";
+		return 0;
+	}
+	memcpy(*data, out.data(), out.size());
+	*size = out.size();
+	return 1;
+}
+
+// ================================================================================================
+int lbdio_get_compressed_info(const char *path, std::uint32_t *keyframe, std::uint32_t *mantissaBits)
+{
+	std::ifstream file(path, std::ios_base::in | std::ios_base::binary);
+	if (!file.is_open()) {
+		g_error = std::string("Could not open the file \"") + path + "\".";
+		return 0;
+	}
+
+	std::vector<std::uint8_t> header;
+	std::vector<column_desc> columns;
+	return _readCompressedHeader(file, header, columns, *keyframe, *mantissaBits) ? 1 : 0;
+}
+
+// ================================================================================================
+void* lbdio_shm_attach(const char *name)
+{
+	shm_handle *handle = new shm_handle;
+	if (!handle->reader.attach(name)) {
+		g_error = handle->reader.getError();
+		delete handle;
+		return nullptr;
+	}
+	return handle;
+}
+
+// ================================================================================================
+void lbdio_shm_detach(void *handle)
+{
+	delete static_cast<shm_handle*>(handle);
+}
+
+// ================================================================================================
+void lbdio_shm_get_header(void *handle, const std::uint8_t **data, std::uint64_t *size, int *binary)
+{
+	const ShmRingReader& reader = static_cast<shm_handle*>(handle)->reader;
+	*data = reader.getBlob();
+	*size = reader.getBlobSize();
+	*binary = reader.isBinary() ? 1 : 0;
+}
+
+// ================================================================================================
+int lbdio_shm_is_closed(void *handle)
+{
+	return static_cast<shm_handle*>(handle)->reader.isClosed() ? 1 : 0;
+}
+
+// ================================================================================================
+int lbdio_shm_latest(void *handle, double *time, std::int64_t *timestep, const std::uint8_t **data,
+	std::uint64_t *size)
+{
+	shm_handle *shm = static_cast<shm_handle*>(handle);
+	if (shm->reader.getCount() == 0)
+		return 0;
+	if (!shm->reader.latest(shm->record)) {
+		g_error = shm->reader.getError();
+		return -1;
+	}
+	return _returnRecord(1, shm->record, time, timestep, data, size);
+}
+
+// ================================================================================================
+int lbdio_shm_next(void *handle, double *time, std::int64_t *timestep, const std::uint8_t **data,
+	std::uint64_t *size)
+{
+	shm_handle *shm = static_cast<shm_handle*>(handle);
+	const int result = shm->reader.next(shm->record);
+	if (result < 0)
+		g_error = "The reader fell behind, and records were overwritten before they were read.";
+	return _returnRecord(result, shm->record, time, timestep, data, size);
+}
+
+// ================================================================================================
+void* lbdio_text_open(const char *path, std::uint64_t offset)
+{
+	TextReader *reader = new TextReader;
+	if (!reader->open(path, offset)) {
+		g_error = reader->getError();
+		delete reader;
+		return nullptr;
+	}
+	return reader;
+}
+
+// ================================================================================================
+void lbdio_text_close(void *handle)
+{
+	delete static_cast<TextReader*>(handle);
+}
+
+// ================================================================================================
+std::uint32_t lbdio_text_get_column_count(void *handle)
+{
+	return static_cast<std::uint32_t>(static_cast<TextReader*>(handle)->getColumns().size());
+}
+
+// ================================================================================================
+void lbdio_text_get_column(void *handle, std::uint32_t column, int *type, std::uint32_t *width, std::uint32_t *list)
+{
+	const text_column& col = static_cast<TextReader*>(handle)->getColumns()[column];
+	*type = col.type;
+	*width = col.width;
+	*list = col.list;
+}
+
+// ================================================================================================
+std::int64_t lbdio_text_read(void *handle, std::uint64_t maxRecords, std::uint64_t maxBytes,
+	const std::uint32_t **counts)
+{
+	TextReader *reader = static_cast<TextReader*>(handle);
+	const std::int64_t records = reader->read(maxRecords, maxBytes);
+	if (records < 0)
+		g_error = reader->getError();
+	*counts = reader->getCounts().data();
+	return records;
+}
+
+// ================================================================================================
+int lbdio_text_fill(void *handle, double **values)
+{
+	TextReader *reader = static_cast<TextReader*>(handle);
+	if (!reader->fill(values)) {
+		g_error = reader->getError();
+		return 0;
+	}
+	return 1;
+}
+
+// ================================================================================================
+void lbdio_text_get_strings(void *handle, std::uint32_t column, const char **data, std::uint64_t *size)
+{
+	const std::string& strings = static_cast<TextReader*>(handle)->getStrings(column);
+	*data = strings.data();
+	*size = strings.size();
+}
+
+// ================================================================================================
+void lbdio_free(std::uint8_t *data)
+{
+	free(data);
+}
+
+// ================================================================================================
+const char* lbdio_get_error()
+{
+	return g_error.c_str();
+}
\ No newline at end of file
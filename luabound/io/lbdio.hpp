@@ -0,0 +1,90 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file declares the C interface of the luabound io library, which reads the luabound output
+ *     files that are too slow to read in python, and the shared memory output. The functions are
+ *     loaded by luabound.py.
+ */
+
+#ifndef LUABOUND_IO_LBDIO_HPP_
+#define LUABOUND_IO_LBDIO_HPP_
+
+#include <cstdint>
+
+#if defined(_WIN32)
+#	define LBDIO_API extern "C" __declspec(dllexport)
+#else
+#	define LBDIO_API extern "C" __attribute__((visibility("default")))
+#endif
+
+// The first bytes and the version of the compressed output files, which match the luabound source
+#define LBDIO_COMPRESSED_MAGIC ("LBDZ")
+#define LBDIO_COMPRESSED_VERSION (1)
+// The first bytes and the version of the binary output files that are decoded from the compressed files
+#define LBDIO_BINARY_MAGIC ("LBDB")
+#define LBDIO_BINARY_VERSION (1)
+
+// Decodes a compressed output file into the bytes of the binary output file with the same records. The
+//     decoding starts at the block at the byte offset (or the first block, for 0), skips the first
+//     skip records, and then decodes up to count records (or all of them, for 0). A partial block at
+//     the end of the file is ignored. On success, the data must be freed with lbdio_free(). Returns 1
+//     on success, and 0 on failure, with the reason given by lbdio_get_error().
+LBDIO_API int lbdio_decode_compressed(const char *path, std::uint64_t offset, std::uint64_t skip, 
+	std::uint64_t count, std::uint8_t **data, std::uint64_t *size);
+// Reads the header of a compressed output file, and gives the number of records in each block, and the mantissa
+//     bits that the doubles were rounded to before encoding (0 if the values are exact). Returns 1 on success,
+//     and 0 on failure.
+LBDIO_API int lbdio_get_compressed_info(const char *path, std::uint32_t *keyframe, std::uint32_t *mantissaBits);
+// Attaches to the shared memory output with the name (the output name without "shm:"), and returns the reader
+//     handle, or null on failure. The reader starts at the last record that was written.
+LBDIO_API void* lbdio_shm_attach(const char *name);
+// Detaches the reader, and frees the handle
+LBDIO_API void lbdio_shm_detach(void *handle);
+// Gets the file header that the output was created with (the text header lines, or the binary file header),
+//     and if the records are binary. The header is valid until the reader is detached.
+LBDIO_API void lbdio_shm_get_header(void *handle, const std::uint8_t **data, std::uint64_t *size, int *binary);
+// Gets if the writer has closed the output, so no more records will be published
+LBDIO_API int lbdio_shm_is_closed(void *handle);
+// Copies the last record that was published. The data is owned by the reader, and is valid until the next
+//     record is read. Returns 1 for a record, 0 if there are no records yet, and -1 on failure.
+LBDIO_API int lbdio_shm_latest(void *handle, double *time, std::int64_t *timestep, const std::uint8_t **data,
+	std::uint64_t *size);
+// Copies the next record after the last one read, like lbdio_shm_latest(). Returns 1 for a record, 0 if there
+//     are no new records, and -1 if records were overwritten before they were read (the reader then skips
+//     to the last record).
+LBDIO_API int lbdio_shm_next(void *handle, double *time, std::int64_t *timestep, const std::uint8_t **data,
+	std::uint64_t *size);
+// Opens a text output file to be read in chunks, starting at the record at the byte offset (or the first record,
+//     for 0). Returns the reader handle, or null on failure.
+LBDIO_API void* lbdio_text_open(const char *path, std::uint64_t offset);
+// Closes the file, and frees the handle
+LBDIO_API void lbdio_text_close(void *handle);
+// Gets the number of value columns in the format string of the file
+LBDIO_API std::uint32_t lbdio_text_get_column_count(void *handle);
+// Gets the type (the binary column types, or 4 for strings), the number of components (3 for vectors,
+//     or the bin count for histograms), and the list index (0xFF for no list) of a column
+LBDIO_API void lbdio_text_get_column(void *handle, std::uint32_t column, int *type, std::uint32_t *width,
+	std::uint32_t *list);
+// Loads the next chunk of records, up to the record count (0 for no limit) and about the number of bytes of
+//     text, and gives the list length of each record, which is valid until the next chunk is read. Returns
+//     the number of records, 0 at the end of the file, and -1 on failure. A partial record at the end of the
+//     file is skipped.
+LBDIO_API std::int64_t lbdio_text_read(void *handle, std::uint64_t maxRecords, std::uint64_t maxBytes,
+	const std::uint32_t **counts);
+// Parses the values of the loaded chunk into the arrays for each column, or skips the columns with null arrays.
+//     Columns outside of lists need (records * width) values, and list columns need (sum(counts) * width).
+//     String columns are loaded into the reader instead, if their array is not null. Returns 1 on success,
+//     and 0 on failure.
+LBDIO_API int lbdio_text_fill(void *handle, double **values);
+// Gets the string values of a column that were loaded by the last fill, separated by '\0'. The data is valid
+//     until the next chunk is filled.
+LBDIO_API void lbdio_text_get_strings(void *handle, std::uint32_t column, const char **data, std::uint64_t *size);
+// Frees the data returned by the decode functions
+LBDIO_API void lbdio_free(std::uint8_t *data);
+// Gets the reason that the last function on this thread failed
+LBDIO_API const char* lbdio_get_error();
+
+#endif // LUABOUND_IO_LBDIO_HPP_
\ No newline at end of file
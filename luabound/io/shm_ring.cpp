@@ -0,0 +1,288 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file implements the writer and reader for the shared memory ring buffer that output records are
+ *     published to for live readers in other processes.
+ */
+
+#include "shm_ring.hpp"
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <thread>
+#if !defined(_WIN32)
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "The shared memory ring needs lock-free 64-bit atomics.");
+
+
+namespace
+{
+
+// The number of times a reader retries a read that raced with the writer before giving up
+const int READ_RETRIES = 1000;
+
+inline std::uint64_t _align(std::uint64_t value, std::uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+
+namespace lbdio
+{
+
+// ================================================================================================
+bool ShmRingWriter::create(const std::string& name, std::uint64_t capacity, const std::uint8_t *blob, 
+	std::size_t blobSize, bool binary)
+{
+	close();
+	m_name = "/" + name;
+
+#if defined(_WIN32)
+	m_error = "Shared memory output is not supported on Windows.";
+	return false;
+#else
+	// Replace any old memory, readers still attached to it will see that it was closed
+	shm_unlink(m_name.c_str());
+	const int fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (fd < 0) {
+		m_error = std::string("Could not create the shared memory, reason: ") + strerror(errno);
+		return false;
+	}
+
+	capacity = _align(capacity, 4096);
+	const std::uint64_t blobOffset = _align(sizeof(shm_ring_header), 64);
+	const std::uint64_t dataOffset = _align(blobOffset + blobSize, 64);
+	m_size = static_cast<std::size_t>(dataOffset + capacity);
+	if (ftruncate(fd, static_cast<off_t>(m_size)) != 0) {
+		m_error = std::string("Could not size the shared memory, reason: ") + strerror(errno);
+		::close(fd);
+		shm_unlink(m_name.c_str());
+		return false;
+	}
+	void *memory = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (memory == MAP_FAILED) {
+		m_error = std::string("Could not map the shared memory, reason: ") + strerror(errno);
+		shm_unlink(m_name.c_str());
+		return false;
+	}
+
+	m_memory = static_cast<std::uint8_t*>(memory);
+	m_header = new (m_memory) shm_ring_header;
+	m_header->version = LBDIO_SHM_VERSION;
+	m_header->capacity = capacity;
+	m_header->blobOffset = blobOffset;
+	m_header->blobSize = blobSize;
+	m_header->dataOffset = dataOffset;
+	m_header->binary = binary ? 1 : 0;
+	m_header->reserved0 = 0;
+	m_header->sequence.store(0, std::memory_order_relaxed);
+	m_header->reserved.store(0, std::memory_order_relaxed);
+	m_header->committed.store(0, std::memory_order_relaxed);
+	m_header->last.store(0, std::memory_order_relaxed);
+	m_header->count.store(0, std::memory_order_relaxed);
+	m_header->closed.store(0, std::memory_order_relaxed);
+	memcpy(m_memory + blobOffset, blob, blobSize);
+	m_data = m_memory + dataOffset;
+
+	// The magic is written last, so readers never see a ring that is not set up
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy(m_header->magic, LBDIO_SHM_MAGIC, 4);
+	return true;
+#endif
+}
+
+// ================================================================================================
+void ShmRingWriter::close()
+{
+#if !defined(_WIN32)
+	if (m_header) {
+		m_header->closed.store(1, std::memory_order_release);
+		munmap(m_memory, m_size);
+	}
+#endif
+	m_memory = nullptr;
+	m_header = nullptr;
+	m_data = nullptr;
+}
+
+// ================================================================================================
+bool ShmRingWriter::write(const std::uint8_t *data, std::size_t size, double time, std::int64_t timestep)
+{
+	const std::uint64_t CAPACITY = m_header->capacity;
+	const std::uint64_t recordSize = _align(sizeof(shm_record_header) + size, 8);
+	if (recordSize > CAPACITY) {
+		m_error = "The record is larger than the shared memory.";
+		return false;
+	}
+
+	// Records are never split, if one does not fit before the end of the ring it starts at the beginning
+	const std::uint64_t pos = m_header->committed.load(std::memory_order_relaxed);
+	const std::uint64_t offset = pos % CAPACITY;
+	const bool wrap = (offset + recordSize) > CAPACITY;
+	const std::uint64_t start = wrap ? (pos + (CAPACITY - offset)) : pos;
+	const std::uint64_t end = start + recordSize;
+
+	const std::uint64_t sequence = m_header->sequence.load(std::memory_order_relaxed);
+	m_header->sequence.store(sequence + 1, std::memory_order_relaxed);
+	m_header->reserved.store(end, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	if (wrap) {
+		const std::uint64_t marker = LBDIO_SHM_WRAP;
+		memcpy(m_data + offset, &marker, sizeof(marker));
+	}
+	const shm_record_header rheader{ static_cast<std::uint64_t>(size), time, timestep };
+	std::uint8_t *target = m_data + (start % CAPACITY);
+	memcpy(target, &rheader, sizeof(rheader));
+	memcpy(target + sizeof(rheader), data, size);
+
+	m_header->committed.store(end, std::memory_order_release);
+	m_header->last.store(start, std::memory_order_release);
+	m_header->count.store(m_header->count.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	m_header->sequence.store(sequence + 2, std::memory_order_release);
+	return true;
+}
+
+// ================================================================================================
+bool ShmRingReader::attach(const std::string& name)
+{
+	detach();
+
+#if defined(_WIN32)
+	m_error = "Shared memory output is not supported on Windows.";
+	return false;
+#else
+	const std::string path = "/" + name;
+	const int fd = shm_open(path.c_str(), O_RDONLY, 0);
+	if (fd < 0) {
+		m_error = std::string("Could not open the shared memory, reason: ") + strerror(errno);
+		return false;
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(shm_ring_header))) {
+		m_error = "The shared memory is not a luabound output ring.";
+		::close(fd);
+		return false;
+	}
+	m_size = static_cast<std::size_t>(info.st_size);
+	void *memory = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (memory == MAP_FAILED) {
+		m_error = std::string("Could not map the shared memory, reason: ") + strerror(errno);
+		return false;
+	}
+
+	m_memory = static_cast<const std::uint8_t*>(memory);
+	m_header = reinterpret_cast<const shm_ring_header*>(m_memory);
+	const bool valid = (memcmp(m_header->magic, LBDIO_SHM_MAGIC, 4) == 0);
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (!valid || m_header->version != LBDIO_SHM_VERSION || (m_header->dataOffset + m_header->capacity) > m_size) {
+		m_error = "The shared memory is not a supported luabound output ring.";
+		detach();
+		return false;
+	}
+
+	m_data = m_memory + m_header->dataOffset;
+	m_cursor = (getCount() > 0) ? m_header->last.load(std::memory_order_acquire) : 
+		m_header->committed.load(std::memory_order_acquire);
+	return true;
+#endif
+}
+
+// ================================================================================================
+void ShmRingReader::detach()
+{
+#if !defined(_WIN32)
+	if (m_memory)
+		munmap(const_cast<std::uint8_t*>(m_memory), m_size);
+#endif
+	m_memory = nullptr;
+	m_header = nullptr;
+	m_data = nullptr;
+}
+
+// ================================================================================================
+bool ShmRingReader::latest(shm_record& record)
+{
+	for (int i = 0; i < READ_RETRIES; ++i) {
+		const std::uint64_t sequence = m_header->sequence.load(std::memory_order_acquire);
+		if (sequence & 1) {
+			std::this_thread::yield();
+			continue;
+		}
+		const std::uint64_t count = m_header->count.load(std::memory_order_acquire);
+		const std::uint64_t last = m_header->last.load(std::memory_order_acquire);
+		if (m_header->sequence.load(std::memory_order_acquire) != sequence)
+			continue;
+		if (count == 0)
+			return false;
+
+		std::uint64_t nextPos = 0;
+		if (copyRecord(last, record, nextPos)) {
+			m_cursor = nextPos;
+			return true;
+		}
+	}
+
+	m_error = "Could not read the last record, because the writer kept overwriting it.";
+	return false;
+}
+
+// ================================================================================================
+int ShmRingReader::next(shm_record& record)
+{
+	const std::uint64_t committed = m_header->committed.load(std::memory_order_acquire);
+	if (m_cursor >= committed)
+		return 0;
+
+	std::uint64_t nextPos = 0;
+	if (copyRecord(m_cursor, record, nextPos)) {
+		m_cursor = nextPos;
+		return 1;
+	}
+
+	// The record was overwritten before it was read, so skip to the newest record
+	m_cursor = m_header->last.load(std::memory_order_acquire);
+	return -1;
+}
+
+// ================================================================================================
+bool ShmRingReader::copyRecord(std::uint64_t pos, shm_record& record, std::uint64_t& nextPos) const
+{
+	const std::uint64_t CAPACITY = m_header->capacity;
+	std::uint64_t start = pos;
+	shm_record_header rheader;
+	memcpy(&rheader, m_data + (start % CAPACITY), sizeof(rheader.size));
+	if (rheader.size == LBDIO_SHM_WRAP) {
+		start += CAPACITY - (start % CAPACITY);
+		memcpy(&rheader, m_data + (start % CAPACITY), sizeof(rheader.size));
+	}
+
+	bool good = (rheader.size <= CAPACITY) && ((start % CAPACITY) + sizeof(rheader) + rheader.size) <= CAPACITY;
+	if (good) {
+		const std::uint8_t *source = m_data + (start % CAPACITY);
+		memcpy(&rheader, source, sizeof(rheader));
+		record.time = rheader.time;
+		record.timestep = rheader.timestep;
+		record.data.assign(source + sizeof(rheader), source + sizeof(rheader) + static_cast<std::size_t>(rheader.size));
+	}
+
+	// The copy is only whole if the writer has not started writing over it
+	std::atomic_thread_fence(std::memory_order_acquire);
+	good = good && (m_header->reserved.load(std::memory_order_relaxed) <= (pos + CAPACITY));
+	nextPos = start + _align(sizeof(rheader) + rheader.size, 8);
+	return good;
+}
+
+} // namespace lbdio
\ No newline at end of file
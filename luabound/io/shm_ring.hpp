@@ -0,0 +1,154 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file declares the shared memory ring buffer that output records are published to for live
+ *     readers in other processes, and the writer and reader for it. This code does not depend on the
+ *     rest of luabound, so it is shared by the application and the io library.
+ */
+
+#ifndef LUABOUND_IO_SHM_RING_HPP_
+#define LUABOUND_IO_SHM_RING_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace lbdio
+{
+
+// The first bytes and the version of the shared memory ring
+#define LBDIO_SHM_MAGIC ("LBDS")
+#define LBDIO_SHM_VERSION (1)
+// The record size that marks the rest of the ring as unused, and the reader should go back to the start
+#define LBDIO_SHM_WRAP (~0ull)
+
+// The header at the start of the shared memory. The positions are byte counts since the ring was created,
+//     which only ever increase, and are wrapped to the ring capacity to find the bytes. The writer marks
+//     the end of the record that it is writing as reserved before it touches the ring, so a reader
+//     knows a record that it copied is still whole if the reserved position is not more than the
+//     capacity past its start. The sequence is odd while a record is being written, so the reader can
+//     read the last record position and count together, like a seqlock.
+struct shm_ring_header
+{
+	char magic[4];
+	std::uint32_t version;
+	std::uint64_t capacity; // The size of the ring, in bytes
+	std::uint64_t blobOffset; // The offset from the start of the memory of the file header
+	std::uint64_t blobSize;
+	std::uint64_t dataOffset; // The offset from the start of the memory of the ring
+	std::uint32_t binary; // If the records are binary records, instead of text lines
+	std::uint32_t reserved0;
+
+	alignas(64) std::atomic<std::uint64_t> sequence;
+	std::atomic<std::uint64_t> reserved; // The end of the record being written
+	std::atomic<std::uint64_t> committed; // The end of the last whole record
+	std::atomic<std::uint64_t> last; // The start of the last whole record
+	std::atomic<std::uint64_t> count; // The number of whole records written
+	std::atomic<std::uint32_t> closed; // Set when the writer is done, and no more records will be written
+};
+
+// The header written before each record in the ring, records are padded to 8 bytes
+struct shm_record_header
+{
+	std::uint64_t size; // The size of the record, or LBDIO_SHM_WRAP
+	double time;
+	std::int64_t timestep;
+};
+
+// A record copied out of the ring by a reader
+struct shm_record
+{
+	double time;
+	std::int64_t timestep;
+	std::vector<std::uint8_t> data;
+};
+
+// Creates and writes to a shared memory ring. Writing never waits for the readers, which instead detect
+//     when the records they are reading have been overwritten.
+class ShmRingWriter
+{
+private:
+	std::string m_name;
+	std::uint8_t *m_memory;
+	std::size_t m_size;
+	shm_ring_header *m_header;
+	std::uint8_t *m_data;
+	std::string m_error;
+
+public:
+	ShmRingWriter() :
+		m_name{}, m_memory{nullptr}, m_size{0}, m_header{nullptr}, m_data{nullptr}, m_error{}
+	{ }
+	~ShmRingWriter() { close(); }
+
+	ShmRingWriter(const ShmRingWriter&) = delete;
+	ShmRingWriter& operator = (const ShmRingWriter&) = delete;
+
+	// Creates the shared memory with the name (without the leading '/'), replacing any old memory with
+	//     the same name, and copies the file header into it
+	bool create(const std::string& name, std::uint64_t capacity, const std::uint8_t *blob, std::size_t blobSize,
+		bool binary);
+	// Marks the ring as closed and unmaps it, the memory is left for any readers until it is replaced
+	void close();
+
+	inline bool isOpen() const { return m_header != nullptr; }
+	inline const std::string& getError() const { return m_error; }
+
+	// Publishes a record, returns false if the record is larger than the ring
+	bool write(const std::uint8_t *data, std::size_t size, double time, std::int64_t timestep);
+};
+
+// Reads from a shared memory ring, which can be attached and detached at any time. The reader only maps the
+//     memory as read-only, so it never slows down the writer.
+class ShmRingReader
+{
+private:
+	const std::uint8_t *m_memory;
+	std::size_t m_size;
+	const shm_ring_header *m_header;
+	const std::uint8_t *m_data;
+	std::uint64_t m_cursor; // The position of the next record to read
+	std::string m_error;
+
+public:
+	ShmRingReader() :
+		m_memory{nullptr}, m_size{0}, m_header{nullptr}, m_data{nullptr}, m_cursor{0}, m_error{}
+	{ }
+	~ShmRingReader() { detach(); }
+
+	ShmRingReader(const ShmRingReader&) = delete;
+	ShmRingReader& operator = (const ShmRingReader&) = delete;
+
+	// Attaches to the ring with the name, starting the reads at the last record written
+	bool attach(const std::string& name);
+	void detach();
+
+	inline bool isAttached() const { return m_header != nullptr; }
+	inline const std::string& getError() const { return m_error; }
+	// Gets the file header that was given to the writer (the text header lines, or the binary file header)
+	inline const std::uint8_t* getBlob() const { return m_memory + m_header->blobOffset; }
+	inline std::size_t getBlobSize() const { return static_cast<std::size_t>(m_header->blobSize); }
+	inline bool isBinary() const { return m_header->binary != 0; }
+	// Gets if the writer has closed the ring, which means no more records will be written to it
+	inline bool isClosed() const { return m_header->closed.load(std::memory_order_acquire) != 0; }
+	inline std::uint64_t getCount() const { return m_header->count.load(std::memory_order_acquire); }
+
+	// Copies the last whole record, returns false if there are no records yet
+	bool latest(shm_record& record);
+	// Copies the next record after the last one read, returns 1 for a record, 0 if there are no new records,
+	//     and -1 if the reader fell behind and records were lost (the reader then skips to the last record)
+	int next(shm_record& record);
+
+private:
+	// Copies the record at the position, returns false if it was overwritten while it was copied
+	bool copyRecord(std::uint64_t pos, shm_record& record, std::uint64_t& nextPos) const;
+};
+
+} // namespace lbdio
+
+#endif // LUABOUND_IO_SHM_RING_HPP_
\ No newline at end of file
@@ -0,0 +1,655 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file implements the reader for the text output files, which parses the format string in the file
+ *     header and streams the records into contiguous arrays for each value.
+ */
+
+#include "text_reader.hpp"
+#include "format_grammar.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <regex>
+
+// The size of each read from the file
+#define TEXT_READ_SIZE (4 << 20)
+
+
+namespace
+{
+
+// The characters that separate the values in the records, which are the punctuation in the format grammar
+struct punctuation_table
+{
+	bool table[256];
+
+	punctuation_table() :
+		table{}
+	{
+		for (const char c : { ',', ';', ':', '/', '\\', ' ', '\t' })
+			table[static_cast<unsigned char>(c)] = true;
+	}
+
+	inline bool operator () (char c) const { return table[static_cast<unsigned char>(c)]; }
+};
+const punctuation_table IS_PUNCTUATION{};
+
+// The particle values, where the names are strings, the hashes are integers, and the vectors have 3 components
+const char* const PARTICLE_VALUES[] = {
+	"m", "r", "n", "h", "a", "e", "i", "O", "o", "f", "M", "x", "y", "z", "vx", "vy", "vz", "ax", "ay", "az",
+	"R", "Rc", "ex", "ey", "ez", "ev", "j", "jx", "jy", "jz", "jv"
+};
+
+// Gets the column for a value token, from the group and value parts of the token, returns false if the token
+//     is not valid. Only the aggregate values can have a filter.
+bool _getValueColumn(const std::string& group, const std::string& value, bool filtered, bool list,
+	lbdio::text_column& column)
+{
+	column.type = LBDIO_TYPE_DOUBLE;
+	column.width = 1;
+	if (group == "s") {
+		if (filtered)
+			return false;
+		if (value == "n" || value == "i")
+			column.type = LBDIO_TYPE_STRING;
+		else if (value == "c")
+			column.type = LBDIO_TYPE_INT;
+		else if (value == "ts")
+			column.type = LBDIO_TYPE_LONG;
+		else if (value != "t" && value != "dt" && value != "G" && value != "w" && value != "wr")
+			return false;
+		return true;
+	}
+
+	const bool aggregate = (group == "a" || group == "d" || group == "n" || group == "x" || group == "m" ||
+		group == "w" || group[0] == 'q');
+	if (!aggregate && !(group == "p" && list && !filtered))
+		return false;
+	if (group[0] == 'q' && atof(group.c_str() + 1) > 100)
+		return false;
+	if (std::find(std::begin(PARTICLE_VALUES), std::end(PARTICLE_VALUES), value) == std::end(PARTICLE_VALUES))
+		return false;
+	if (value == "n" || value == "h") {
+		if (aggregate)
+			return false;
+		column.type = (value == "n") ? LBDIO_TYPE_STRING : LBDIO_TYPE_INT;
+	}
+	else if (value == "ev" || value == "jv") {
+		column.width = 3;
+		column.braced = true;
+	}
+	return true;
+}
+
+// Gets the column for a histogram token, which has a value for each bin
+bool _getHistogramColumn(const std::string& token, lbdio::text_column& column)
+{
+	static const std::regex PARTS_REGEX(LBDIO_HISTOGRAM_PARTS_REGEX, std::regex_constants::ECMAScript);
+
+	std::smatch match;
+	if (!std::regex_match(token, match, PARTS_REGEX))
+		return false;
+	const std::uint32_t dims = (match[1].length() > 0) ? 2 : 1;
+	std::vector<std::string> args(1);
+	for (const char c : match[3].str()) {
+		if (c == ',')
+			args.emplace_back();
+		else if (!isspace(static_cast<unsigned char>(c)))
+			args.back().push_back(c);
+	}
+	if (args.size() != (dims * 4))
+		return false;
+
+	column.type = LBDIO_TYPE_DOUBLE;
+	column.width = 1;
+	column.braced = true;
+	for (std::uint32_t d = 0; d < dims; ++d) {
+		const std::string& binStr = args[dims + (d * 3) + 2];
+		char *binEnd = nullptr;
+		const long bins = strtol(binStr.c_str(), &binEnd, 10);
+		if (binStr.empty() || *binEnd || bins < 1)
+			return false;
+		column.width *= static_cast<std::uint32_t>(bins);
+	}
+	return true;
+}
+
+// Parses the tokens of the format string or a list specifier, adding the columns for the value tokens
+bool _parseTokens(const std::string& format, std::uint8_t list, std::uint8_t& listCount,
+	std::vector<lbdio::text_column>& columns, std::string& error)
+{
+	static const std::regex FULL_REGEX(LBDIO_FORMAT_REGEX_FULL,
+			std::regex_constants::ECMAScript | std::regex_constants::optimize);
+	static const std::regex FILTER_REGEX(LBDIO_LIST_FILTER_REGEX, std::regex_constants::ECMAScript);
+
+	const bool inList = (list != LBDIO_NO_LIST);
+	std::smatch match;
+	std::size_t start = 0;
+	if (inList && std::regex_search(format, match, FILTER_REGEX))
+		start = match.length();
+	std::string rest = format.substr(start);
+	while (std::regex_search(rest, match, FULL_REGEX,
+			std::regex_constants::match_continuous | std::regex_constants::match_not_null)) {
+		start += match.length();
+
+		const std::string token = match.str();
+		lbdio::text_column column{ LBDIO_TYPE_DOUBLE, 1, list, false };
+		if (token[0] == '#' && token[1] == 'h') { // Histogram token
+			if (inList || !_getHistogramColumn(token, column)) {
+				error = "The histogram token " + token + " is invalid.";
+				return false;
+			}
+			columns.push_back(column);
+		}
+		else if (token[0] == '#') { // Value token
+			if (!_getValueColumn(match[2].str(), match[3].str(), match[4].matched, inList, column)) {
+				error = "The value token " + token + " is invalid.";
+				return false;
+			}
+			columns.push_back(column);
+		}
+		else if (token[0] == '{') { // List specifier
+			if (inList) {
+				error = "The format cannot have a list specifier inside of another list specifier.";
+				return false;
+			}
+			const std::uint8_t index = listCount++;
+			if (!_parseTokens(match[1].str(), index, listCount, columns, error))
+				return false;
+		}
+
+		rest = format.substr(start);
+	}
+
+	if (!rest.empty()) {
+		error = "Could not parse the format string, failed on \"" + rest + "\".";
+		return false;
+	}
+	return true;
+}
+
+// Finds the next value in the record, returns false at the end of the record
+inline bool _nextField(const char *& pos, const char *end, const char *& fieldEnd)
+{
+	while (pos < end && IS_PUNCTUATION(*pos))
+		++pos;
+	if (pos == end)
+		return false;
+	fieldEnd = pos;
+	while (fieldEnd < end && !IS_PUNCTUATION(*fieldEnd))
+		++fieldEnd;
+	return true;
+}
+
+#ifdef __SIZEOF_INT128__
+typedef unsigned __int128 uint128;
+
+// The powers of five that fit in 64 bits, which are the odd part of the powers of ten up to 10^27, their
+//     reciprocals, and the powers of ten that are exact doubles
+struct power_table
+{
+	std::uint64_t table[28];
+	uint128 reciprocal[28]; // floor(2^scale / 5^i), which has its top bit set
+	std::int32_t scale[28];
+	double exact[23];
+
+	power_table() :
+		table{}, reciprocal{}, scale{}, exact{}
+	{
+		table[0] = 1;
+		exact[0] = 1;
+		for (std::uint32_t i = 1; i < 28; ++i)
+			table[i] = table[i - 1] * 5;
+		for (std::uint32_t i = 1; i < 23; ++i)
+			exact[i] = exact[i - 1] * 10;
+
+		// The reciprocals are found with long division, one bit at a time
+		for (std::uint32_t i = 1; i < 28; ++i) {
+			scale[i] = 127 + (64 - __builtin_clzll(table[i]));
+			std::uint64_t remainder = 0;
+			for (std::int32_t b = scale[i]; b >= 0; --b) {
+				remainder = (remainder << 1) | ((b == scale[i]) ? 1 : 0);
+				reciprocal[i] <<= 1;
+				if (remainder >= table[i]) {
+					remainder -= table[i];
+					reciprocal[i] |= 1;
+				}
+			}
+		}
+	}
+
+	inline std::uint64_t operator [] (std::int32_t i) const { return table[i]; }
+};
+const power_table POWERS_OF_FIVE{};
+
+// Converts mantissa * 10^exponent to the nearest double, for a non-zero mantissa and |exponent| <= 27. This is
+//     exact: mantissa * 5^exponent (or the quotient for negative exponents, with at least 64 bits) is found
+//     with integer math, and then rounded once to 53 bits, with the remainder breaking the ties.
+inline double _exactDouble(std::uint64_t mantissa, std::int32_t exponent, bool negative)
+{
+	// When the mantissa and the power of ten are both exact doubles, a single multiply or divide is already
+	//     correctly rounded
+	if (mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22) {
+		const double value = static_cast<double>(mantissa);
+		const double result = (exponent < 0) ? (value / POWERS_OF_FIVE.exact[-exponent]) :
+			(value * POWERS_OF_FIVE.exact[exponent]);
+		return negative ? -result : result;
+	}
+
+	// Otherwise, dividing by 5^k is a multiply by the reciprocal, which is slightly too small. The missing
+	//     part only changes the bits below the top 128 bits of the product by less than 2 units, so the
+	//     rounding is exact unless the rounded bits are within 2 units of the halfway point, or of carrying
+	//     into the mantissa, which almost never happens and falls back to the division below.
+	if (exponent < 0) {
+		const uint128 reciprocal = POWERS_OF_FIVE.reciprocal[-exponent];
+		const uint128 low = static_cast<uint128>(mantissa) * static_cast<std::uint64_t>(reciprocal);
+		const uint128 high = (static_cast<uint128>(mantissa) * static_cast<std::uint64_t>(reciprocal >> 64)) +
+			(low >> 64);
+		const std::uint64_t top = static_cast<std::uint64_t>(high >> 64);
+		const std::int32_t drop = (top ? (128 - __builtin_clzll(top)) :
+			(64 - __builtin_clzll(static_cast<std::uint64_t>(high)))) - 53;
+		std::uint64_t bits53 = static_cast<std::uint64_t>(high >> drop);
+		const uint128 rest = high & ((static_cast<uint128>(1) << drop) - 1);
+		const uint128 half = static_cast<uint128>(1) << (drop - 1);
+		const bool roundUp = (rest >= half);
+		if ((roundUp && (rest + 2) <= (half << 1)) || (!roundUp && (rest + 2) <= half)) {
+			std::int32_t binary = drop + 64 - POWERS_OF_FIVE.scale[-exponent] + exponent;
+			if (roundUp && (++bits53 == (1ull << 53))) {
+				bits53 >>= 1;
+				++binary;
+			}
+			const std::uint64_t biased = static_cast<std::uint64_t>(binary + 52 + 1023);
+			const std::uint64_t raw = (negative ? (1ull << 63) : 0) | (biased << 52) | (bits53 & ((1ull << 52) - 1));
+			double result;
+			memcpy(&result, &raw, sizeof(double));
+			return result;
+		}
+	}
+
+	uint128 value;
+	std::int32_t binary;
+	bool inexact = false;
+	if (exponent >= 0) {
+		value = static_cast<uint128>(mantissa) * POWERS_OF_FIVE[exponent];
+		binary = exponent;
+	}
+	else {
+		const std::int32_t shift = 64 + __builtin_clzll(mantissa);
+		const uint128 numerator = static_cast<uint128>(mantissa) << shift;
+		value = numerator / POWERS_OF_FIVE[-exponent];
+		inexact = (numerator % POWERS_OF_FIVE[-exponent]) != 0;
+		binary = exponent - shift;
+	}
+
+	const std::uint64_t high = static_cast<std::uint64_t>(value >> 64);
+	const std::int32_t bits = high ? (128 - __builtin_clzll(high)) :
+		(64 - __builtin_clzll(static_cast<std::uint64_t>(value)));
+	std::int32_t drop = bits - 53;
+	std::uint64_t bits53;
+	if (drop <= 0)
+		bits53 = static_cast<std::uint64_t>(value) << -drop;
+	else {
+		bits53 = static_cast<std::uint64_t>(value >> drop);
+		const uint128 rest = value & ((static_cast<uint128>(1) << drop) - 1);
+		const uint128 half = static_cast<uint128>(1) << (drop - 1);
+		if (rest > half || (rest == half && (inexact || (bits53 & 1))))
+			++bits53;
+		if (bits53 == (1ull << 53)) {
+			bits53 >>= 1;
+			++drop;
+		}
+	}
+
+	const std::uint64_t biased = static_cast<std::uint64_t>(drop + binary + 52 + 1023);
+	const std::uint64_t raw = (negative ? (1ull << 63) : 0) | (biased << 52) | (bits53 & ((1ull << 52) - 1));
+	double result;
+	memcpy(&result, &raw, sizeof(double));
+	return result;
+}
+#endif // __SIZEOF_INT128__
+
+// Parses a decimal number, and returns the end of the number, or nullptr if there is not one. The numbers with
+//     up to 19 significant digits and a decimal exponent within 27 (which is nearly all of the values written
+//     with the default roundtrip precision) are converted exactly with integer math, which is much faster
+//     than strtod. Everything else, and every number on compilers without 128-bit integers, uses strtod.
+inline const char* _parseDouble(const char *pos, const char *end, double *out)
+{
+#ifdef __SIZEOF_INT128__
+	const char *cur = pos;
+	const bool negative = (cur < end) && (*cur == '-');
+	if ((cur < end) && (*cur == '-' || *cur == '+'))
+		++cur;
+	std::uint64_t mantissa = 0;
+	std::int32_t digits = 0; // The significant digits, without the leading zeros
+	std::int32_t exponent = 0;
+	const char *digitStart = cur;
+	for (; (cur < end) && (static_cast<unsigned>(*cur - '0') < 10); ++cur) {
+		if (digits > 0 || *cur != '0') {
+			mantissa = (mantissa * 10) + static_cast<std::uint64_t>(*cur - '0');
+			++digits;
+		}
+	}
+	bool found = (cur != digitStart);
+	if ((cur < end) && (*cur == '.')) {
+		const char *fractionStart = ++cur;
+		for (; (cur < end) && (static_cast<unsigned>(*cur - '0') < 10); ++cur, --exponent) {
+			if (digits > 0 || *cur != '0') {
+				mantissa = (mantissa * 10) + static_cast<std::uint64_t>(*cur - '0');
+				++digits;
+			}
+		}
+		found = found || (cur != fractionStart);
+	}
+	if (found && (cur < end) && (*cur == 'e' || *cur == 'E')) {
+		const char *expCur = cur + 1;
+		const bool expNegative = (expCur < end) && (*expCur == '-');
+		if ((expCur < end) && (*expCur == '-' || *expCur == '+'))
+			++expCur;
+		if ((expCur < end) && (static_cast<unsigned>(*expCur - '0') < 10)) {
+			std::int32_t value = 0;
+			for (; (expCur < end) && (static_cast<unsigned>(*expCur - '0') < 10); ++expCur)
+				value = std::min((value * 10) + (*expCur - '0'), 100000);
+			exponent += expNegative ? -value : value;
+			cur = expCur;
+		}
+	}
+	if (found && digits <= 19) {
+		if (mantissa == 0) {
+			*out = negative ? -0.0 : 0.0;
+			return cur;
+		}
+		if (exponent >= -27 && exponent <= 27) {
+			*out = _exactDouble(mantissa, exponent, negative);
+			return cur;
+		}
+	}
+#endif // __SIZEOF_INT128__
+
+	char *valueEnd = nullptr;
+	*out = strtod(pos, &valueEnd);
+	return (valueEnd == pos) ? nullptr : valueEnd;
+}
+
+// Parses a value with the width, which is written as "{{a|b|...}}" if it is braced, at the start of a field. Returns
+//     the end of the field, or nullptr if the field is not a valid value.
+inline const char* _parseValue(const char *pos, const char *end, const lbdio::text_column& column, double *out)
+{
+	const char *valueEnd = pos;
+	if (!column.braced)
+		valueEnd = _parseDouble(pos, end, out);
+	else {
+		if ((end - pos) < 4 || pos[0] != '{' || pos[1] != '{')
+			return nullptr;
+		pos += 2;
+		for (std::uint32_t i = 0; i < column.width; ++i) {
+			valueEnd = _parseDouble(pos, end, out + i);
+			if (!valueEnd || valueEnd >= end || *valueEnd != ((i + 1 == column.width) ? '}' : '|'))
+				return nullptr;
+			pos = valueEnd + 1;
+		}
+		valueEnd = ((pos < end) && (*pos == '}')) ? (pos + 1) : nullptr;
+	}
+	return (valueEnd && (valueEnd == end || IS_PUNCTUATION(*valueEnd))) ? valueEnd : nullptr;
+}
+
+} // namespace
+
+
+namespace lbdio
+{
+
+// ================================================================================================
+bool ParseTextFormat(const std::string& format, std::vector<text_column>& columns, std::string& error)
+{
+	columns.clear();
+	std::uint8_t listCount = 0;
+	return _parseTokens(format, LBDIO_NO_LIST, listCount, columns, error);
+}
+
+// ================================================================================================
+bool TextReader::open(const std::string& path, std::uint64_t offset)
+{
+	close();
+	m_file = std::fopen(path.c_str(), "rb");
+	if (!m_file)
+		return setError("Could not open the file \"" + path + "\".");
+	if (std::fseek(m_file, 0, SEEK_END) == 0) {
+		const long size = std::ftell(m_file);
+		m_remaining = (size > 0) ? static_cast<std::uint64_t>(size) : 0;
+		std::rewind(m_file);
+	}
+	if (!readHeader())
+		return false;
+
+	m_scalarFields = m_listFields = 0;
+	for (const auto& col : m_columns) {
+		if (col.list == LBDIO_NO_LIST)
+			++m_scalarFields;
+		else
+			++m_listFields;
+	}
+
+	// The header lines are dropped from the buffer, unless the reading starts somewhere else
+	if (offset > 0) {
+		if (std::fseek(m_file, static_cast<long>(offset), SEEK_SET) != 0)
+			return setError("The record offset is past the end of the file.");
+		m_remaining += m_used;
+		m_remaining -= std::min<std::uint64_t>(m_remaining, offset);
+		m_used = m_next = 0;
+		m_eof = false;
+	}
+	return true;
+}
+
+// ================================================================================================
+void TextReader::close()
+{
+	if (m_file) {
+		std::fclose(m_file);
+		m_file = nullptr;
+	}
+	m_used = m_next = m_remaining = 0;
+	m_eof = false;
+	m_lines.clear();
+	m_counts.clear();
+	m_strings.clear();
+}
+
+// ================================================================================================
+std::int64_t TextReader::read(std::uint64_t maxRecords, std::uint64_t maxBytes)
+{
+	m_lines.clear();
+	m_counts.clear();
+	if (!m_file)
+		return 0;
+
+	// Drop the last chunk, and keep the start of the next line
+	if (m_next > 0) {
+		memmove(m_buffer.get(), m_buffer.get() + m_next, m_used - m_next);
+		m_used -= m_next;
+		m_next = 0;
+	}
+	// The whole chunk is read at once if it fits in memory, to avoid copying the buffer as it grows
+	const std::uint64_t chunkSize = std::min<std::uint64_t>(maxBytes, m_remaining);
+	if (chunkSize < (SIZE_MAX / 2))
+		reserve(m_used + static_cast<std::size_t>(chunkSize) + TEXT_READ_SIZE);
+
+	std::size_t pos = 0;
+	while ((maxRecords == 0) || (m_counts.size() < maxRecords)) {
+		if (!m_counts.empty() && (pos >= maxBytes))
+			break;
+		const char *start = m_buffer.get() + pos;
+		const char *newline = static_cast<const char*>(memchr(start, '\n', m_used - pos));
+		if (!newline) {
+			// A partial line at the end of the file is from a run that is still going or was killed, and is skipped
+			if (!readMore())
+				break;
+			continue;
+		}
+
+		// Count the values to find the list length, which are the places where the punctuation ends, and the
+		//     blank lines are skipped
+		std::uint64_t fields = 0;
+		bool separated = true;
+		for (const char *c = start; c < newline; ++c) {
+			const bool punctuation = IS_PUNCTUATION(*c);
+			fields += (separated && !punctuation) ? 1 : 0;
+			separated = punctuation;
+		}
+		pos = static_cast<std::size_t>(newline - m_buffer.get()) + 1;
+		if (fields == 0)
+			continue;
+
+		const std::uint64_t listValues = fields - std::min<std::uint64_t>(fields, m_scalarFields);
+		const bool valid = (fields >= m_scalarFields) &&
+			((m_listFields == 0) ? (listValues == 0) : ((listValues % m_listFields) == 0));
+		if (!valid) {
+			setError("A record has " + std::to_string(fields) + " values, which does not match the format.");
+			return -1;
+		}
+		m_lines.push_back(static_cast<std::size_t>(start - m_buffer.get()));
+		m_lines.push_back(static_cast<std::size_t>(newline - m_buffer.get()));
+		m_counts.push_back(static_cast<std::uint32_t>((m_listFields == 0) ? 0 : (listValues / m_listFields)));
+	}
+
+	m_next = pos;
+	return static_cast<std::int64_t>(m_counts.size());
+}
+
+// ================================================================================================
+bool TextReader::fill(double * const *values)
+{
+	m_strings.assign(m_columns.size(), std::string{});
+	const std::size_t records = m_counts.size();
+	const std::size_t columnCount = m_columns.size();
+	std::uint64_t listBase = 0; // The list values in the records before this one
+	for (std::size_t r = 0; r < records; ++r) {
+		const char *pos = m_buffer.get() + m_lines[r * 2];
+		const char *end = m_buffer.get() + m_lines[(r * 2) + 1];
+		const std::uint32_t count = m_counts[r];
+
+		// The columns are walked in the order of the format, and each list is a block of columns that is
+		//     repeated for each particle
+		std::size_t c = 0;
+		while (c < columnCount) {
+			std::size_t blockEnd = c + 1;
+			const std::uint8_t list = m_columns[c].list;
+			if (list != LBDIO_NO_LIST) {
+				while (blockEnd < columnCount && m_columns[blockEnd].list == list)
+					++blockEnd;
+			}
+			const std::uint32_t repeats = (list == LBDIO_NO_LIST) ? 1 : count;
+			const std::uint64_t base = (list == LBDIO_NO_LIST) ? r : listBase;
+
+			for (std::uint32_t p = 0; p < repeats; ++p) {
+				for (std::size_t bc = c; bc < blockEnd; ++bc) {
+					// The numbers are parsed in place, which also finds the end of the field
+					const char *fieldEnd = nullptr;
+					while (pos < end && IS_PUNCTUATION(*pos))
+						++pos;
+					if (pos == end)
+						return setError("A record ended before all of its values were read.");
+					const text_column& col = m_columns[bc];
+					if (values[bc] && col.type != LBDIO_TYPE_STRING) {
+						fieldEnd = _parseValue(pos, end, col, values[bc] + ((base + p) * col.width));
+						if (!fieldEnd) {
+							_nextField(pos, end, fieldEnd);
+							return setError("The value \"" + std::string(pos, fieldEnd) + "\" could not be parsed.");
+						}
+					}
+					else {
+						_nextField(pos, end, fieldEnd);
+						if (values[bc]) {
+							m_strings[bc].append(pos, fieldEnd);
+							m_strings[bc].push_back('\0');
+						}
+					}
+					pos = fieldEnd;
+				}
+			}
+			c = blockEnd;
+		}
+		listBase += count;
+	}
+
+	return true;
+}
+
+// ================================================================================================
+bool TextReader::readHeader()
+{
+	static const char* const HEADER_KEYS[4] = { "# filename: ", "# timestamp: ", "# output timing: ", "# format: " };
+
+	// The header lines are found the same way as the records, so the buffer is ready for the first record
+	std::size_t pos = 0;
+	for (std::uint32_t line = 0; line < 4; ) {
+		const char *start = m_buffer.get() + pos;
+		const char *newline = m_used ? static_cast<const char*>(memchr(start, '\n', m_used - pos)) : nullptr;
+		if (!newline) {
+			if (!readMore())
+				return setError("The file does not have a complete header.");
+			continue;
+		}
+		const std::string text(start, newline);
+		pos = static_cast<std::size_t>(newline - m_buffer.get()) + 1;
+		const std::size_t keyLength = strlen(HEADER_KEYS[line]);
+		if (text.compare(0, keyLength, HEADER_KEYS[line]) != 0)
+			return setError("The file has a malformed header.");
+		m_header[line++] = text.substr(keyLength);
+	}
+	m_next = pos;
+
+	std::string error;
+	if (!ParseTextFormat(m_header[3], m_columns, error))
+		return setError(error);
+	std::uint32_t lists = 0;
+	for (const auto& col : m_columns)
+		lists = std::max<std::uint32_t>(lists, (col.list == LBDIO_NO_LIST) ? 0 : (col.list + 1));
+	static const std::regex FILTERED_LIST_REGEX(R"(\{\s*\[)", std::regex_constants::ECMAScript);
+	if (lists > 1 && std::regex_search(m_header[3], FILTERED_LIST_REGEX))
+		return setError("Text files can only have one list when using particle filters, because the list lengths "
+			"are not written. Use binary output instead.");
+	return true;
+}
+
+// ================================================================================================
+bool TextReader::readMore()
+{
+	if (m_eof)
+		return false;
+
+	if ((m_capacity - m_used) < TEXT_READ_SIZE)
+		reserve(std::max(m_capacity * 2, m_used + TEXT_READ_SIZE));
+	const std::size_t count = std::fread(m_buffer.get() + m_used, 1, m_capacity - m_used, m_file);
+	m_used += count;
+	m_remaining -= std::min<std::uint64_t>(m_remaining, count);
+	if (count == 0)
+		m_eof = true;
+	return count > 0;
+}
+
+// ================================================================================================
+void TextReader::reserve(std::size_t size)
+{
+	if (size <= m_capacity)
+		return;
+
+	std::unique_ptr<char[]> buffer{ new char[size] };
+	if (m_used > 0)
+		memcpy(buffer.get(), m_buffer.get(), m_used);
+	m_buffer = std::move(buffer);
+	m_capacity = size;
+}
+
+// ================================================================================================
+bool TextReader::setError(const std::string& error)
+{
+	m_error = error;
+	return false;
+}
+
+} // namespace lbdio
\ No newline at end of file
@@ -0,0 +1,106 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file declares the reader for the text output files, which parses the format string in the file
+ *     header and streams the records into contiguous arrays for each value. This code does not depend
+ *     on the rest of luabound, so it is only built into the io library.
+ */
+
+#ifndef LUABOUND_IO_TEXT_READER_HPP_
+#define LUABOUND_IO_TEXT_READER_HPP_
+
+#include "xor_codec.hpp"
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lbdio
+{
+
+// The column type of string values, which can only be in text files
+#define LBDIO_TYPE_STRING (4)
+
+// The description of a single value in the text records, in the same order as the format string. Vectors
+//     have 3 components, and histograms have one for each bin, which are all written as "{{a|b|...}}".
+struct text_column
+{
+	std::uint8_t type; // LBDIO_TYPE_*
+	std::uint32_t width; // The number of components in each value
+	std::uint8_t list; // The list index, or LBDIO_NO_LIST
+	bool braced; // If the values are written as "{{a|b|...}}", which is every vector and histogram
+};
+
+// Parses a format string into the columns that it writes, with the same grammar as the format parser in the
+//     luabound source. Returns false if the format is invalid, with the reason in the error.
+bool ParseTextFormat(const std::string& format, std::vector<text_column>& columns, std::string& error);
+
+// Reads the records of a text output file in chunks. Each chunk is read in two steps: read() loads whole
+//     lines and counts the values in each to find the list lengths, so the caller can size the arrays,
+//     then fill() parses the values straight into the arrays. The memory use only depends on the chunk
+//     size (or the longest line, if it is larger), not on the file size.
+class TextReader
+{
+private:
+	std::FILE *m_file;
+	std::string m_header[4]; // The file name, timestamp, output timing, and format string
+	std::vector<text_column> m_columns;
+	std::uint32_t m_scalarFields; // The fields in each record outside of the lists
+	std::uint32_t m_listFields; // The fields for each particle in the lists
+	std::unique_ptr<char[]> m_buffer; // The text of the current chunk, and the start of the next line after it
+	std::size_t m_capacity;
+	std::size_t m_used; // The bytes in the buffer
+	std::uint64_t m_remaining; // The bytes left in the file, which sizes the buffer for the next chunk
+	std::size_t m_next; // The start of the text after the current chunk
+	bool m_eof;
+	std::vector<std::size_t> m_lines; // The start and end of each record in the current chunk
+	std::vector<std::uint32_t> m_counts; // The list length of each record in the current chunk
+	std::vector<std::string> m_strings; // The values of the string columns in the current chunk
+	std::string m_error;
+
+public:
+	TextReader() :
+		m_file{nullptr}, m_header{}, m_columns{}, m_scalarFields{0}, m_listFields{0}, m_buffer{}, m_capacity{0},
+		m_used{0}, m_remaining{0}, m_next{0}, m_eof{false}, m_lines{}, m_counts{}, m_strings{}, m_error{}
+	{ }
+	~TextReader() { close(); }
+
+	TextReader(const TextReader&) = delete;
+	TextReader& operator = (const TextReader&) = delete;
+
+	// Opens the file and parses the header, then starts reading at the record at the byte offset, or the
+	//     first record for 0
+	bool open(const std::string& path, std::uint64_t offset);
+	void close();
+
+	inline const std::string& getError() const { return m_error; }
+	inline const std::string& getHeader(std::uint32_t line) const { return m_header[line]; }
+	inline const std::vector<text_column>& getColumns() const { return m_columns; }
+
+	// Loads the next chunk of records, up to the record count (0 for no limit) and about the number of bytes
+	//     of text. Returns the number of records, 0 at the end of the file, or -1 for an invalid record.
+	std::int64_t read(std::uint64_t maxRecords, std::uint64_t maxBytes);
+	// The list length of each record in the current chunk, which all of the lists share
+	inline const std::vector<std::uint32_t>& getCounts() const { return m_counts; }
+	// Parses the values of the current chunk into the arrays for each column (nullptr skips the column). The
+	//     arrays for the values outside of lists need (records * width) values, and the arrays for the list
+	//     values need (sum(counts) * width). String columns are kept in the reader instead.
+	bool fill(double * const *values);
+	// The string values of a column, separated by '\0', which are loaded by fill()
+	inline const std::string& getStrings(std::uint32_t column) const { return m_strings[column]; }
+
+private:
+	bool readHeader();
+	// Reads more of the file into the buffer, returns false at the end of the file
+	bool readMore();
+	// Grows the buffer to at least the size, without touching the new memory
+	void reserve(std::size_t size);
+	bool setError(const std::string& error);
+};
+
+} // namespace lbdio
+
+#endif // LUABOUND_IO_TEXT_READER_HPP_
\ No newline at end of file
@@ -0,0 +1,251 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file implements the XOR codec for compressed output files, which encodes each value of a binary
+ *     output record against the same value in the previous record, Gorilla-style.
+ */
+
+#include "xor_codec.hpp"
+
+
+namespace
+{
+
+enum WalkState
+{
+	WALK_COUNT,     // The next field is the particle count
+	WALK_COLUMN,    // The next field is the start of the current column
+	WALK_LISTCOUNT, // The last field was the count of a filtered list
+	WALK_VALUES,    // The next field is in the middle of the current column
+	WALK_END
+};
+
+inline std::uint32_t _typeSize(std::uint8_t type)
+{
+	return (type == LBDIO_TYPE_INT) ? 4 : 8;
+}
+
+inline std::uint32_t _leadingZeros(std::uint64_t value)
+{
+	std::uint32_t count = 0;
+	for (std::uint64_t mask = 1ull << 63; !(value & mask); mask >>= 1)
+		++count;
+	return count;
+}
+
+inline std::uint32_t _trailingZeros(std::uint64_t value)
+{
+	std::uint32_t count = 0;
+	for (; !(value & 1); value >>= 1)
+		++count;
+	return count;
+}
+
+#if defined(__GNUC__)
+#define _LEADING_ZEROS(v) (static_cast<std::uint32_t>(__builtin_clzll(v)))
+#define _TRAILING_ZEROS(v) (static_cast<std::uint32_t>(__builtin_ctzll(v)))
+#else
+#define _LEADING_ZEROS(v) (_leadingZeros(v))
+#define _TRAILING_ZEROS(v) (_trailingZeros(v))
+#endif
+
+} // namespace
+
+
+namespace lbdio
+{
+
+// ================================================================================================
+void FieldWalker::setColumns(const std::vector<column_desc>& columns)
+{
+	m_columns = &columns;
+
+	std::uint32_t listCount = 0;
+	m_listStarts.assign(columns.size(), false);
+	for (std::size_t i = 0; i < columns.size(); ++i) {
+		if (columns[i].list == LBDIO_NO_LIST)
+			continue;
+		if (columns[i].list >= listCount) {
+			listCount = columns[i].list + 1u;
+			m_listStarts[i] = (columns[i].flags & LBDIO_FILTERED_LIST) != 0;
+		}
+	}
+	m_listCounts.assign(listCount, 0);
+}
+
+// ================================================================================================
+void FieldWalker::begin()
+{
+	m_column = 0;
+	m_remaining = 0;
+	m_state = WALK_COUNT;
+}
+
+// ================================================================================================
+std::uint32_t FieldWalker::next(std::uint64_t previous)
+{
+	const std::vector<column_desc>& COLS = *m_columns;
+
+	switch (m_state) {
+		case WALK_COUNT: {
+			m_state = WALK_COLUMN;
+			return 4;
+		}
+		case WALK_LISTCOUNT: {
+			m_listCounts[COLS[m_column].list] = static_cast<std::uint32_t>(previous);
+			m_remaining = static_cast<std::uint64_t>(COLS[m_column].width) * previous;
+			m_state = WALK_VALUES;
+			break;
+		}
+		case WALK_COLUMN: {
+			// The particle count is the previous field for the first column, and the list size for unfiltered lists
+			if (m_column == 0) {
+				for (std::size_t i = 0; i < m_listCounts.size(); ++i)
+					m_listCounts[i] = static_cast<std::uint32_t>(previous);
+			}
+			break;
+		}
+		case WALK_VALUES: break;
+		default: return 0;
+	}
+
+	// Move to the next column with values, checking for filtered list counts
+	while (m_state != WALK_VALUES || m_remaining == 0) {
+		if (m_state == WALK_VALUES) {
+			++m_column;
+			m_state = WALK_COLUMN;
+		}
+		if (m_column >= COLS.size()) {
+			m_state = WALK_END;
+			return 0;
+		}
+
+		const column_desc& col = COLS[m_column];
+		if (m_listStarts[m_column] && m_state == WALK_COLUMN) {
+			m_state = WALK_LISTCOUNT;
+			return 4;
+		}
+		if (m_state == WALK_COLUMN) {
+			m_remaining = static_cast<std::uint64_t>(col.width) * 
+				((col.list == LBDIO_NO_LIST) ? 1 : m_listCounts[col.list]);
+		}
+		m_state = WALK_VALUES;
+	}
+
+	--m_remaining;
+	return _typeSize(COLS[m_column].type);
+}
+
+// ================================================================================================
+std::uint8_t FieldWalker::getType() const
+{
+	return (m_state == WALK_VALUES) ? (*m_columns)[m_column].type : static_cast<std::uint8_t>(LBDIO_TYPE_INT);
+}
+
+// ================================================================================================
+void XorEncoder::setMantissaBits(std::uint32_t bits)
+{
+	m_roundMask = (bits == 0 || bits >= 52) ? ~0ull : ~((1ull << (52 - bits)) - 1);
+}
+
+// ================================================================================================
+bool XorEncoder::encode(const std::uint8_t *record, std::size_t size, BitWriter& out)
+{
+	std::size_t pos = 0;
+	std::size_t field = 0;
+	std::uint64_t value = 0;
+	m_walker.begin();
+	for (std::uint32_t fsize; (fsize = m_walker.next(value)) != 0; ++field) {
+		if ((pos + fsize) > size)
+			return false;
+		value = 0;
+		for (std::uint32_t b = 0; b < fsize; ++b)
+			value |= static_cast<std::uint64_t>(record[pos + b]) << (8 * b);
+		pos += fsize;
+
+		// Round to nearest by adding half of the dropped bits, which carries into the exponent if needed,
+		//     and leave the infinite and NaN values alone
+		if (m_roundMask != ~0ull && m_walker.getType() == LBDIO_TYPE_DOUBLE && ((value >> 52) & 0x7FF) != 0x7FF) {
+			const std::uint64_t rounded = (value + ((~m_roundMask + 1) >> 1)) & m_roundMask;
+			if (((rounded >> 52) & 0x7FF) != 0x7FF)
+				value = rounded;
+		}
+
+		if (field >= m_states.size())
+			m_states.push_back({ 0, 0, 0 });
+		xor_state& state = m_states[field];
+		const std::uint64_t diff = value ^ state.value;
+		state.value = value;
+		if (diff == 0) {
+			out.write(0, 1);
+			continue;
+		}
+
+		const std::uint32_t leading = _LEADING_ZEROS(diff);
+		const std::uint32_t trailing = _TRAILING_ZEROS(diff);
+		if (state.length > 0 && leading >= state.leading && trailing >= (64u - state.leading - state.length)) {
+			out.write(0x2, 2);
+			out.write64(diff >> (64 - state.leading - state.length), state.length);
+		}
+		else {
+			const std::uint32_t length = 64 - leading - trailing;
+			out.write(0x3, 2);
+			out.write(leading, 6);
+			out.write(length - 1, 6);
+			out.write64(diff >> trailing, length);
+			state.leading = static_cast<std::uint8_t>(leading);
+			state.length = static_cast<std::uint8_t>(length);
+		}
+	}
+
+	return (pos == size);
+}
+
+// ================================================================================================
+bool XorDecoder::decode(BitReader& in, std::vector<std::uint8_t>& out)
+{
+	std::size_t field = 0;
+	std::uint64_t value = 0;
+	m_walker.begin();
+	for (std::uint32_t fsize; (fsize = m_walker.next(value)) != 0; ++field) {
+		if (field >= m_states.size())
+			m_states.push_back({ 0, 0, 0 });
+		xor_state& state = m_states[field];
+
+		if (!in.canRead(1))
+			return false;
+		if (in.read(1) != 0) {
+			if (!in.canRead(1))
+				return false;
+			if (in.read(1) == 0) {
+				if (state.length == 0 || !in.canRead(state.length))
+					return false;
+				state.value ^= in.read(state.length) << (64 - state.leading - state.length);
+			}
+			else {
+				if (!in.canRead(12))
+					return false;
+				const std::uint32_t leading = static_cast<std::uint32_t>(in.read(6));
+				const std::uint32_t length = static_cast<std::uint32_t>(in.read(6)) + 1;
+				if ((leading + length) > 64 || !in.canRead(length))
+					return false;
+				state.value ^= in.read(length) << (64 - leading - length);
+				state.leading = static_cast<std::uint8_t>(leading);
+				state.length = static_cast<std::uint8_t>(length);
+			}
+		}
+
+		value = state.value;
+		if (fsize == 4 && (value >> 32) != 0)
+			return false;
+		for (std::uint32_t b = 0; b < fsize; ++b)
+			out.push_back(static_cast<std::uint8_t>(value >> (8 * b)));
+	}
+
+	return true;
+}
+
+} // namespace lbdio
\ No newline at end of file
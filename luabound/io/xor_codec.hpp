@@ -0,0 +1,204 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file declares the XOR codec for compressed output files, which encodes each value of a binary
+ *     output record against the same value in the previous record, Gorilla-style. This code does
+ *     not depend on the rest of luabound, so it is shared by the application and the io library.
+ */
+
+#ifndef LUABOUND_IO_XOR_CODEC_HPP_
+#define LUABOUND_IO_XOR_CODEC_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace lbdio
+{
+
+// The binary column data types, which match the ValueDataType enum in the luabound source
+#define LBDIO_TYPE_DOUBLE (1)
+#define LBDIO_TYPE_INT (2)
+#define LBDIO_TYPE_LONG (3)
+// The binary column list index and flags, which match the binary output in the luabound source
+#define LBDIO_NO_LIST (0xFF)
+#define LBDIO_FILTERED_LIST (0x01)
+// The most mantissa bits that double values can be rounded to, anything more (or 0) is lossless
+#define LBDIO_MAX_MANTISSA_BITS (52)
+
+// The description of a single column in a binary output record
+struct column_desc
+{
+	std::uint8_t type;
+	std::uint32_t width; // The number of components in each value
+	std::uint8_t list; // The list index, or LBDIO_NO_LIST
+	std::uint8_t flags;
+};
+
+// Walks the fields of a binary output record one at a time, which is the particle count, then each
+//     column, where filtered lists have their count before their first column. Because the counts are
+//     part of the record, the value of each field has to be given before the size of the next is known.
+class FieldWalker
+{
+private:
+	const std::vector<column_desc> *m_columns;
+	std::vector<std::uint32_t> m_listCounts;
+	std::vector<bool> m_listStarts; // If the column is the first column of a filtered list
+	std::size_t m_column;
+	std::uint64_t m_remaining; // The values left in the current column
+	int m_state;
+
+public:
+	FieldWalker() :
+		m_columns{nullptr}, m_listCounts{}, m_listStarts{}, m_column{0}, m_remaining{0}, m_state{0}
+	{ }
+
+	void setColumns(const std::vector<column_desc>& columns);
+	// Starts walking a new record
+	void begin();
+	// Gets the size in bytes of the next field (4 or 8), or 0 at the end of the record, where previous
+	//     is the value of the last field that was returned (ignored for the first field)
+	std::uint32_t next(std::uint64_t previous);
+	// Gets the data type of the field that was last returned by next(), counts are LBDIO_TYPE_INT
+	std::uint8_t getType() const;
+};
+
+// Writes bit fields into a byte buffer, starting from the highest bit of each byte
+class BitWriter
+{
+private:
+	std::vector<std::uint8_t> m_data;
+	std::uint64_t m_bits; // The bits that do not yet make up a full byte, in the low bits
+	std::uint32_t m_count;
+
+public:
+	BitWriter() :
+		m_data{}, m_bits{0}, m_count{0}
+	{ }
+
+	inline const std::vector<std::uint8_t>& getData() const { return m_data; }
+	// Clears the contents, but keeps the allocated memory for reuse
+	inline void clear() { m_data.clear(); m_bits = 0; m_count = 0; }
+
+	// Writes the low count bits of the value, where count is at most 32
+	inline void write(std::uint32_t value, std::uint32_t count)
+	{
+		if (count == 0)
+			return;
+		m_bits = (m_bits << count) | (value & (0xFFFFFFFFu >> (32 - count)));
+		m_count += count;
+		while (m_count >= 8) {
+			m_count -= 8;
+			m_data.push_back(static_cast<std::uint8_t>(m_bits >> m_count));
+		}
+	}
+	// Writes the low count bits of the value, where count is at most 64
+	inline void write64(std::uint64_t value, std::uint32_t count)
+	{
+		if (count > 32) {
+			write(static_cast<std::uint32_t>(value >> 32), count - 32);
+			count = 32;
+		}
+		write(static_cast<std::uint32_t>(value), count);
+	}
+	// Pads the last byte with zero bits
+	inline void flush()
+	{
+		if (m_count > 0)
+			write(0, 8 - m_count);
+	}
+};
+
+// Reads bit fields written by the BitWriter
+class BitReader
+{
+private:
+	const std::uint8_t *m_data;
+	std::size_t m_size;
+	std::size_t m_pos; // The next bit to read
+
+public:
+	BitReader(const std::uint8_t *data, std::size_t size) :
+		m_data{data}, m_size{size}, m_pos{0}
+	{ }
+
+	// Gets if count more bits can be read
+	inline bool canRead(std::uint32_t count) const { return (m_pos + count) <= (m_size * 8); }
+
+	// Reads count bits, where count is at most 64, the caller must check canRead() first
+	inline std::uint64_t read(std::uint32_t count)
+	{
+		std::uint64_t value = 0;
+		while (count > 0) {
+			const std::uint32_t offset = static_cast<std::uint32_t>(m_pos & 7);
+			const std::uint32_t take = (count < (8 - offset)) ? count : (8 - offset);
+			const std::uint32_t bits = (m_data[m_pos >> 3] >> (8 - offset - take)) & ((1u << take) - 1);
+			value = (value << take) | bits;
+			m_pos += take;
+			count -= take;
+		}
+		return value;
+	}
+};
+
+// The state kept for each field position, which is the last value and the last bit window
+struct xor_state
+{
+	std::uint64_t value;
+	std::uint8_t leading; // The leading zero bits of the window
+	std::uint8_t length; // The number of meaningful bits in the window, or 0 if there is no window
+};
+
+// Encodes records against the previous record. Each field is XORed with the field at the same position
+//     in the previous record, and the result is written as a single 0 bit if the field did not
+//     change, as '10' and the meaningful bits if they fit in the last window for the position, or as
+//     '11', the leading zeros (6 bits), the meaningful bit count (6 bits), and the meaningful bits. The
+//     first record after reset() is encoded against zeros, so it can be decoded on its own.
+class XorEncoder
+{
+private:
+	FieldWalker m_walker;
+	std::vector<xor_state> m_states;
+	std::uint64_t m_roundMask; // The mantissa bits kept for double values, all bits for lossless encoding
+
+public:
+	XorEncoder() :
+		m_walker{}, m_states{}, m_roundMask{~0ull}
+	{ }
+
+	inline void setColumns(const std::vector<column_desc>& columns) { m_walker.setColumns(columns); }
+	inline void reset() { m_states.clear(); }
+	// Rounds double values to the number of mantissa bits (1 to 52) before encoding, which makes the
+	//     low bits that only change from round-off zero, or 0 to encode the exact values
+	void setMantissaBits(std::uint32_t bits);
+
+	// Encodes a single binary output record, returns false if the record does not match the columns
+	bool encode(const std::uint8_t *record, std::size_t size, BitWriter& out);
+};
+
+// Decodes the records written by the XorEncoder
+class XorDecoder
+{
+private:
+	FieldWalker m_walker;
+	std::vector<xor_state> m_states;
+
+public:
+	XorDecoder() :
+		m_walker{}, m_states{}
+	{ }
+
+	inline void setColumns(const std::vector<column_desc>& columns) { m_walker.setColumns(columns); }
+	inline void reset() { m_states.clear(); }
+
+	// Decodes a single record, appending the binary output record to the output, returns false if the
+	//     encoded data is truncated or invalid
+	bool decode(BitReader& in, std::vector<std::uint8_t>& out);
+};
+
+} // namespace lbdio
+
+#endif // LUABOUND_IO_XOR_CODEC_HPP_
\ No newline at end of file
@@ -20,15 +20,42 @@ This script is designed to work on the raw output from the luabound tool. If you
     only ever return the first occurance, but all occurances of the tag will still be loaded
     into memory.
 
-Note: There are no promises made as to how performant the code is. When working with very large
-    files, there is a chance that this code will get slow. It does not do any loading tricks to
-    make it faster, such as streaming from the hard drive; the entire contents of the files
-    are loaded into memory all at once.
+Note: There are no promises made as to how performant ``load_lbd_file()`` is with text files. When
+    working with very large files, it will get slow, and the entire contents of the files are loaded
+    into memory all at once. ``load_lbd_text()`` parses the text files in the luabound io library
+    (see below) instead, and is much faster, and ``iter_lbd_file()`` streams the records in chunks,
+    so only one chunk is in memory at a time. Both return :py:class:`LuaboundBinaryFile` objects.
+
+Binary output files (``binary = true`` in the output table) are detected automatically by
+    ``load_lbd_file()``, and are returned as a :py:class:`LuaboundBinaryFile`. These files are
+    memory mapped instead of being read in, and each value token is exposed as a numpy array with
+    one entry per output record, so they are much faster to load and use than the text files.
+
+Output files are written with an index file next to them (the file name plus ".idx"), which has the
+    time, timestep, and byte offset of each output record. ``load_lbd_snapshot()`` uses the index to
+    load a single record out of a text file without reading the rest of it, and ``load_lbd_index()``
+    returns the index itself.
+
+Compressed output files (``compress = true`` in the output table) are binary files where each record
+    is XOR encoded against the record before it. These are decoded by the luabound io library (built
+    as "lbdio" with the rest of luabound), which is found in the OUT folder next to this script, or at
+    the path in the LUABOUND_IO_LIB environment variable. They are returned by ``load_lbd_file()`` as
+    a :py:class:`LuaboundBinaryFile`, just like the uncompressed binary files. The values are exact,
+    unless the file was written with ``mantissa_bits``, which is given by the ``mantissa_bits`` property.
+
+Shared memory output (output names that start with "shm:") is published to a ring buffer in memory
+    instead of a file, so other processes can watch a run while it is going. ``attach_lbd_shm()``
+    attaches to the output with the rest of the name, and returns a :py:class:`LbdSharedMemoryReader`
+    that reads the records as single-record :py:class:`LuaboundFile` or :py:class:`LuaboundBinaryFile`
+    objects. This also uses the luabound io library.
 """
 
 
+import ctypes
 import os
 import re
+import struct
+import sys
 import numpy as np
 
 
@@ -37,6 +64,11 @@ __PARTICLE_OUTPUT_TOKENS = [
     'M', 'x', 'y', 'z', 'vx', 'vy', 'vz', 'ax', 'ay', 'az',
     'R', 'Rc', 'ex', 'ey', 'ez', 'ev', 'j', 'jx', 'jy', 'jz', 'jv'
 ]
+__PARTICLE_GROUPS = [ # Particle values, and the statistics over all particles
+    'p', 'a', 'd', 'n', 'x', 'm', 'w'
+]
+__PERCENTILE_REGEX = re.compile(r'q\d+(?:\.\d+)?') # Percentile statistics, such as #q90a
+__HISTOGRAM_REGEX = re.compile(r'h2?w?\(([^()]*)\)(?:\[[^\[\]{}]*\])?') # Histograms, such as #h(R,0,2,64)
 __SIM_OUTPUT_TOKENS = [
     'n', 't', 'dt', 'c', 'i', 'G', 'ts', 'w', 'wr'
 ]
@@ -50,6 +82,27 @@ __STR_TOKENS = [
 __VECTOR_TOKENS = [
     'ev', 'jv'
 ]
+__BINARY_MAGIC = b'LBDB'
+__BINARY_VERSION = 1
+__BINARY_NO_LIST = 0xFF
+__BINARY_FILTERED_LIST = 0x01
+__BINARY_WIDE_COLUMN = 0 # The column width is given after the column description, as a uint32
+__COMPRESSED_MAGIC = b'LBDZ'
+__IO_LIBRARY_NAMES = ['liblbdio.so', 'liblbdio.dylib', 'lbdio.dll']
+__IO_LIBRARY = [None] # The loaded io library, which is only loaded when it is first needed
+__INDEX_EXTENSION = '.idx'
+__INDEX_MAGIC = b'LBDI'
+__INDEX_VERSIONS = [1]
+__INDEX_DTYPE = np.dtype([('time', '<f8'), ('timestep', '<i8'), ('offset', '<u8')])
+__FILTERED_LIST_REGEX = re.compile(r'\{\s*\[') # A list specifier that starts with a particle filter
+__TEXT_STRING_TYPE = 4 # The column type of string values from the io library text reader
+__TEXT_CHUNK_BYTES = 16 << 20 # The default amount of text parsed at once when iterating over a text file
+__TEXT_NO_LIMIT = (1 << 64) - 1
+__BINARY_DTYPES = { # Indexed by the ValueDataType enum from the luabound source
+    1: np.dtype('<f8'), # Double
+    2: np.dtype('<u4'), # Int
+    3: np.dtype('<i8')  # Long
+}
 
 
 class LuaboundFileLoadError(Exception):
@@ -375,6 +428,253 @@ class LuaboundFile(object):
             raise TypeError('The key to the data must be an integer, string, or slice')
 
 
+class LbdBinaryList(object):
+    """
+    Represents a list specifier "{}" from a binary output file. Indexing it with a format tag gives
+        the values for that tag for every particle in every record.
+    """
+    def __init__(self, columns, counts):
+        """
+        *Note: This class should only be instantiated internally, users of this code should*
+            ***NEVER** create an instance of this class themselves.*
+
+        Args:
+            columns (dict(str, np.array)): The arrays for each of the tags in the list.
+            counts (np.array(int)): The number of particles in the list for each record.
+        """
+        self._columns = columns
+        self._counts = counts
+
+    @property
+    def counts(self):
+        """
+        Returns the number of particles in the list for each record, which is only different from
+            the file counts if the list has a particle filter.
+        """
+        return self._counts
+
+    @property
+    def tags(self):
+        """
+        Returns the tags in this list.
+        """
+        return list(self._columns.keys())
+
+    def __getitem__(self, key):
+        """
+        Returns the values for a tag in the list. If every record in the file has the same particle
+            count, this is a 2D array (record, particle), or 3D (record, particle, component) for
+            vectors. Otherwise it is an object array with one array per record.
+
+        Raises:
+            IndexError: If the tag is not in the list.
+        """
+        if not key in self._columns:
+            raise IndexError('The tag %s was not in the list' % (key))
+        return self._columns[key]
+
+
+class LuaboundBinaryFile(object):
+    """
+    Represents the data loaded from a luabound binary output file. The file is memory mapped, so
+        the values are only read from the disk when they are used.
+    """
+    def __init__(self, filename, timestamp, outrate, outfmt, counts, columns):
+        """
+        *Note: This class should only be instantiated internally, users of this code should*
+            ***NEVER** create an instance of this class themselves.*
+
+        Args:
+            filename (str): The name of the file that this object represents.
+            timestamp (str): The time the file was created, formatted as "DD/MM/YY HH:MM:SS".
+            outrate (float): The output rate for the file in simulation time.
+            outfmt (str): The raw format string used by the file.
+            counts (np.array(int)): The particle count for each record.
+            columns (dict): The arrays for the tags, and the LbdBinaryList objects for the lists.
+        """
+        self._filename = filename
+        self._timestamp = timestamp
+        self._outrate = outrate
+        self._outfmt = outfmt
+        self._counts = counts
+        self._columns = columns
+        self._mantissa_bits = 0
+
+    @property
+    def filename(self):
+        """
+        The name of the file on the disk represented by this object.
+        """
+        return self._filename
+
+    @property
+    def timestamp(self):
+        """
+        The creation timestamp of this file, formatted as "DD/MM/YY HH:MM:SS".
+        """
+        return self._timestamp
+
+    @property
+    def outrate(self):
+        """
+        The rate at which the output file was updated, in simulation time.
+        """
+        return self._outrate
+
+    @property
+    def outfmt(self):
+        """
+        The raw output format string used by the file.
+        """
+        return self._outfmt
+
+    @property
+    def datalen(self):
+        """
+        The number of records (timestamps) in the data file.
+        """
+        return len(self._counts)
+
+    @property
+    def mantissa_bits(self):
+        """
+        The mantissa bits that the double values were rounded to before a compressed file was encoded,
+            or 0 if the values are exact.
+        """
+        return self._mantissa_bits
+
+    @property
+    def counts(self):
+        """
+        The particle count for each of the records in the file.
+        """
+        return self._counts
+
+    @property
+    def tags(self):
+        """
+        The tags available in the file, with lists named as "l0", "l1", ...
+        """
+        return list(self._columns.keys())
+
+    def __getitem__(self, key):
+        """
+        Returns the values for a tag as an array with one entry per record, or the
+            :py:class:`LbdBinaryList` for a list tag ("l0", "l1", ...).
+
+        Raises:
+            TypeError: If the key is not a string.
+            IndexError: If the key is not a tag in the file.
+        """
+        if not isinstance(key, str):
+            raise TypeError('The key to the data must be a string')
+        if not key in self._columns:
+            raise IndexError('The tag %s is not in the file' % (key))
+        return self._columns[key]
+
+
+class LbdSharedMemoryReader(object):
+    """
+    Reads the records from a luabound shared memory output. The reader can be attached and detached
+        at any time, and never slows down the simulation. If the reader falls behind by more than
+        the size of the ring, the records it missed are lost.
+    """
+    def __init__(self, name, lib, handle, load_record):
+        """
+        *Note: This class should only be instantiated internally, use* ``attach_lbd_shm()`` *instead.*
+
+        Args:
+            name (str): The name of the shared memory output, without the "shm:".
+            lib (ctypes.CDLL): The luabound io library.
+            handle (ctypes.c_void_p): The reader handle from the io library.
+            load_record (function): Loads the bytes of a record into a file object.
+        """
+        self._name = name
+        self._lib = lib
+        self._handle = handle
+        self._load_record = load_record
+        self._lost = False
+
+    @property
+    def name(self):
+        """
+        The name of the shared memory output, without the "shm:".
+        """
+        return self._name
+
+    @property
+    def closed(self):
+        """
+        If the simulation has finished writing to the output, so there will be no more records.
+        """
+        return bool(self._lib.lbdio_shm_is_closed(self._handle)) if self._handle else True
+
+    @property
+    def lost(self):
+        """
+        If records were lost because the reader fell behind, since the last time this was checked.
+        """
+        lost = self._lost
+        self._lost = False
+        return lost
+
+    def latest(self):
+        """
+        Reads the last record that was published, and moves the reader to after it.
+
+        Returns:
+            tuple: The time, timestep, and the record loaded as a single-record file object, or
+                `None` if there are no records yet.
+        """
+        return self._read(self._lib.lbdio_shm_latest)
+
+    def next(self):
+        """
+        Reads the next record after the last one read. The first record read after attaching is
+            the last one published before attaching.
+
+        Returns:
+            tuple: The time, timestep, and the record loaded as a single-record file object, or
+                `None` if there are no new records.
+        """
+        return self._read(self._lib.lbdio_shm_next)
+
+    def detach(self):
+        """
+        Detaches the reader from the shared memory, after which it cannot be used.
+        """
+        if self._handle:
+            self._lib.lbdio_shm_detach(self._handle)
+            self._handle = None
+
+    def _read(self, func):
+        if not self._handle:
+            raise LuaboundFileLoadError(self._name, 'The reader has been detached.')
+        time = ctypes.c_double(0)
+        timestep = ctypes.c_int64(0)
+        data = ctypes.POINTER(ctypes.c_uint8)()
+        size = ctypes.c_uint64(0)
+        result = func(self._handle, ctypes.byref(time), ctypes.byref(timestep), ctypes.byref(data),
+                      ctypes.byref(size))
+        if result < 0:
+            # Either the reader fell behind, or the last record could not be read, both can be retried
+            self._lost = True
+            return None
+        if result == 0:
+            return None
+        record = ctypes.string_at(data, size.value)
+        return time.value, timestep.value, self._load_record(record)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.detach()
+
+    def __del__(self):
+        self.detach()
+
+
 def load_lbd_file(filepath):
     """
     Attempts to load the luabound output file at the given path. On success, returns a
@@ -396,6 +696,14 @@ def load_lbd_file(filepath):
     if not os.path.isfile(filepath):
         raise LuaboundFileLoadError(filepath, 'The file could not be found.')
 
+    # Binary files have their own loader
+    with open(filepath, 'rb') as lbdFile:
+        magic = lbdFile.read(len(__BINARY_MAGIC))
+        if magic == __BINARY_MAGIC:
+            return __load_binary_file(filepath)
+        elif magic == __COMPRESSED_MAGIC:
+            return __load_compressed_file(filepath)
+
     # Read in the lines from the file
     with open(filepath, 'r') as lbdFile:
         line_count = sum(1 for line in lbdFile if line.rstrip())
@@ -423,50 +731,699 @@ def load_lbd_file(filepath):
                 data_lines[data_index] = line.rstrip()
                 data_index += 1
 
-    # Validate header information
-    if header_lines[0][0:11] != '# filename:':
+    header, format_list, tag_map = __parse_text_header(filepath, header_lines)
+
+    # Parse out the data
+    file_data = __parse_data(format_list, data_lines)
+
+    # Return the completed object
+    return LuaboundFile(header[0], header[1], header[2], header[3], tag_map, file_data)
+
+
+def load_lbd_index(filepath):
+    """
+    Loads the index file for the luabound output file at the given path, which has the time,
+        timestep, and byte offset of each record in the output file. Records in the index that
+        point past the end of the output file (from a run that is still going) are left out. For
+        compressed files, the offset is the start of the block that has the record.
+
+    Args:
+        filepath (str): The relative path to the luabound output file (not the index file).
+
+    Returns:
+        np.array: A structured array with the 'time', 'timestep', and 'offset' fields for each
+            record, or `None` if the output file does not have an index.
+
+    Raises:
+        :py:class:`LuaboundFileLoadError`: If the index file exists, but could not be read.
+    """
+    index_path = filepath + __INDEX_EXTENSION
+    if not os.path.isfile(index_path) or not os.path.isfile(filepath):
+        return None
+
+    with open(index_path, 'rb') as idxFile:
+        header = idxFile.read(8)
+        if len(header) < 8 or header[0:4] != __INDEX_MAGIC:
+            raise LuaboundFileLoadError(index_path, 'The file is not a luabound index file.')
+        if not struct.unpack('<I', header[4:8])[0] in __INDEX_VERSIONS:
+            raise LuaboundFileLoadError(index_path, 'The index file version is not supported.')
+        raw = idxFile.read()
+
+    records = np.frombuffer(raw, dtype=__INDEX_DTYPE, count=(len(raw) // __INDEX_DTYPE.itemsize))
+    return records[records['offset'] < os.path.getsize(filepath)]
+
+
+def load_lbd_snapshot(filepath, time=None):
+    """
+    Loads a single record from the luabound text or compressed output file at the given path. If the
+        file has an index, only the header and the one record (or its block, for compressed files)
+        are read from the file, so this is fast for any file size. Without an index, the last record
+        of a text file can still be found by reading the file.
+
+    Args:
+        filepath (str): The relative path to the luabound output file to load.
+        time (float): The simulation time to load, which selects the last record at or before the
+            time (or the first record, for earlier times). `None` loads the last record.
+
+    Returns:
+        :py:class:`LuaboundFile`: The loaded file, with a single line of data, or a
+            :py:class:`LuaboundBinaryFile` with a single record for compressed files.
+
+    Raises:
+        :py:class:`LuaboundFileLoadError`: In the event that the data could not be loaded for any
+            reason, an error is thrown with a message explaining the nature of the load problem.
+    """
+    if not os.path.isfile(filepath):
+        raise LuaboundFileLoadError(filepath, 'The file could not be found.')
+    with open(filepath, 'rb') as lbdFile:
+        magic = lbdFile.read(len(__BINARY_MAGIC))
+    if magic == __BINARY_MAGIC:
+        raise LuaboundFileLoadError(filepath, 'Binary files are memory mapped, use load_lbd_file() instead.')
+    compressed = (magic == __COMPRESSED_MAGIC)
+
+    index = load_lbd_index(filepath)
+    if index is None and (time is not None or compressed):
+        raise LuaboundFileLoadError(filepath, 'The file does not have an index, so it cannot be searched.')
+    if index is not None and len(index) == 0:
+        raise LuaboundFileLoadError(filepath, 'The file does not have any records.')
+    if index is not None:
+        if time is None:
+            record = len(index) - 1
+        else:
+            record = max(int(np.searchsorted(index['time'], time, side='right')) - 1, 0)
+
+    # Compressed records are indexed by their block, so the records before it in the block are skipped
+    if compressed:
+        offset = int(index['offset'][record])
+        skip = record - int(np.searchsorted(index['offset'], offset, side='left'))
+        return __load_compressed_file(filepath, offset, skip, 1)
+
+    with open(filepath, 'rb') as lbdFile:
+        header_lines = [lbdFile.readline().decode('utf-8').rstrip() for _ in range(4)]
+        if not all(header_lines):
+            raise LuaboundFileLoadError(filepath, 'The file has a malformed header.')
+
+        if index is not None:
+            lbdFile.seek(int(index['offset'][record]))
+            data_line = lbdFile.readline().decode('utf-8').rstrip()
+        else:
+            data_line = ''
+            for line in lbdFile:
+                if line.rstrip():
+                    data_line = line.decode('utf-8').rstrip()
+        if not data_line:
+            raise LuaboundFileLoadError(filepath, 'The file does not have any records.')
+
+    header, format_list, tag_map = __parse_text_header(filepath, header_lines)
+    data_lines = np.empty((1), dtype=object)
+    data_lines[0] = data_line
+    file_data = __parse_data(format_list, data_lines)
+    return LuaboundFile(header[0], header[1], header[2], header[3], tag_map, file_data)
+
+
+def load_lbd_text(filepath):
+    """
+    Loads a text output file with the luabound io library, which parses the values straight into numpy
+        arrays, and is many times faster than ``load_lbd_file()`` for large files. The values are returned
+        the same way as the binary files, with one array per tag, so the file can be used the same way
+        no matter which way it was written.
+
+    Args:
+        filepath (str): The relative path to the luabound text output file to load.
+
+    Returns:
+        :py:class:`LuaboundBinaryFile`: The values from the file. The counts are the list lengths of
+            each record (or zero, if the format does not have any lists).
+
+    Raises:
+        :py:class:`LuaboundFileLoadError`: In the event that the data could not be loaded for any
+            reason, an error is thrown with a message explaining the nature of the load problem.
+    """
+    return next(iter_lbd_file(filepath, records=0))
+
+
+def iter_lbd_file(filepath, records=None, time=None):
+    """
+    Reads a text output file in chunks of records with the luabound io library, so that files larger than
+        memory can be processed. Only one chunk is in memory at a time, and each is loaded the same way
+        as ``load_lbd_text()``.
+
+    Args:
+        filepath (str): The relative path to the luabound text output file to load.
+        records (int): The number of records in each chunk, `None` for chunks of about 16 MiB of text, or
+            0 to load the whole file as one chunk.
+        time (float): The simulation time to start at, which uses the index to start at the last record
+            at or before the time. `None` starts at the first record.
+
+    Yields:
+        :py:class:`LuaboundBinaryFile`: The values from each chunk of records. The last chunk may be
+            smaller, and a file without any records gives a single empty chunk.
+
+    Raises:
+        :py:class:`LuaboundFileLoadError`: In the event that the data could not be loaded for any
+            reason, an error is thrown with a message explaining the nature of the load problem.
+    """
+    if not os.path.isfile(filepath):
+        raise LuaboundFileLoadError(filepath, 'The file could not be found.')
+    with open(filepath, 'rb') as lbdFile:
+        magic = lbdFile.read(len(__BINARY_MAGIC))
+        if magic in [__BINARY_MAGIC, __COMPRESSED_MAGIC]:
+            raise LuaboundFileLoadError(filepath, 'Binary and compressed files are loaded with load_lbd_file().')
+        lbdFile.seek(0)
+        header_lines = [lbdFile.readline().decode('utf-8').rstrip() for _ in range(4)]
+    if not all(header_lines):
+        raise LuaboundFileLoadError(filepath, 'The file has a malformed header.')
+    header, format_list, _ = __parse_text_header(filepath, header_lines)
+    column_tags, list_tags = __format_columns(format_list)
+
+    offset = 0
+    if time is not None:
+        index = load_lbd_index(filepath)
+        if index is None:
+            raise LuaboundFileLoadError(filepath, 'The file does not have an index, so it cannot be searched.')
+        if len(index) > 0:
+            offset = int(index['offset'][max(int(np.searchsorted(index['time'], time, side='right')) - 1, 0)])
+
+    lib = __load_io_library(filepath)
+    handle = lib.lbdio_text_open(filepath.encode(sys.getfilesystemencoding()), offset)
+    if not handle:
+        raise LuaboundFileLoadError(filepath, lib.lbdio_get_error().decode('utf-8'))
+    handle = ctypes.c_void_p(handle)
+    try:
+        if lib.lbdio_text_get_column_count(handle) != len(column_tags):
+            raise LuaboundFileLoadError(filepath, 'The text columns do not match the format string.')
+        columns = []
+        for cindex in range(len(column_tags)):
+            ctype, width, lidx = ctypes.c_int(0), ctypes.c_uint32(0), ctypes.c_uint32(0)
+            lib.lbdio_text_get_column(handle, cindex, ctypes.byref(ctype), ctypes.byref(width), ctypes.byref(lidx))
+            columns.append((ctype.value, width.value, lidx.value))
+
+        max_records = __TEXT_NO_LIMIT if records == 0 else (records or 0)
+        max_bytes = __TEXT_CHUNK_BYTES if records is None else __TEXT_NO_LIMIT
+        first = True
+        while True:
+            chunk = __load_text_chunk(filepath, lib, handle, header, column_tags, list_tags, columns,
+                                      max_records, max_bytes)
+            if chunk.datalen == 0 and not first:
+                break
+            first = False
+            yield chunk
+            if chunk.datalen == 0:
+                break
+    finally:
+        lib.lbdio_text_close(handle)
+
+
+def attach_lbd_shm(name):
+    """
+    Attaches to the luabound shared memory output with the given name, which is the name of the output
+        without the "shm:" at the start. The output must have been written at least once by the
+        simulation, and stays available after the simulation ends until it is written again.
+
+    Args:
+        name (str): The name of the shared memory output.
+
+    Returns:
+        :py:class:`LbdSharedMemoryReader`: The reader, which starts at the last record published.
+
+    Raises:
+        :py:class:`LuaboundFileLoadError`: If the shared memory could not be attached to, or does not
+            have a valid header.
+    """
+    lib = __load_io_library(name)
+    handle = lib.lbdio_shm_attach(name.encode('utf-8'))
+    if not handle:
+        raise LuaboundFileLoadError(name, lib.lbdio_get_error().decode('utf-8'))
+    handle = ctypes.c_void_p(handle)
+
+    data = ctypes.POINTER(ctypes.c_uint8)()
+    size = ctypes.c_uint64(0)
+    binary = ctypes.c_int(0)
+    lib.lbdio_shm_get_header(handle, ctypes.byref(data), ctypes.byref(size), ctypes.byref(binary))
+    blob = ctypes.string_at(data, size.value)
+
+    if binary.value:
+        # The records are appended to the binary file header, and loaded like a decoded file with one record
+        def load_record(record):
+            return __load_binary_file(name, np.frombuffer(blob + record, dtype=np.uint8))
+    else:
+        header_lines = blob.decode('utf-8').split('\n')[0:4]
+        if len(header_lines) < 4 or not all(header_lines):
+            lib.lbdio_shm_detach(handle)
+            raise LuaboundFileLoadError(name, 'The shared memory has a malformed header.')
+        header, format_list, tag_map = __parse_text_header(name, header_lines)
+        def load_record(record):
+            data_lines = np.empty((1), dtype=object)
+            data_lines[0] = record.decode('utf-8')
+            file_data = __parse_data(format_list, data_lines)
+            return LuaboundFile(header[0], header[1], header[2], header[3], tag_map, file_data)
+
+    return LbdSharedMemoryReader(name, lib, handle, load_record)
+
+
+def __parse_text_header(filepath, header_lines):
+    """
+    Validates the four header lines from a text output file, and parses the format string.
+
+    This function is private and should not be called from outside of this module.
+
+    Args:
+        filepath (str): The path to the file, used for the error messages.
+        header_lines (list): The four header lines, with the newlines removed.
+
+    Returns:
+        tuple: The filename, timestamp, output rate, and format string from the header, the parsed
+            format list, and the tag map for the data.
+    """
+    header = list(header_lines)
+    if header[0][0:11] != '# filename:':
         raise LuaboundFileLoadError(filepath, 'The filename header line is malformed.')
-    header_lines[0] = header_lines[0][12:]
-    if header_lines[1][0:12] != '# timestamp:':
+    header[0] = header[0][12:]
+    if header[1][0:12] != '# timestamp:':
         raise LuaboundFileLoadError(filepath, 'The timestamp header line is malformed.')
-    header_lines[1] = header_lines[1][13:]
-    if header_lines[2][0:16] != '# output timing:':
+    header[1] = header[1][13:]
+    if header[2][0:16] != '# output timing:':
         raise LuaboundFileLoadError(filepath, 'The output timing header line is malformed.')
     try:
-        header_lines[2] = float(header_lines[2][17:])
+        header[2] = float(header[2][17:])
     except ValueError:
         raise LuaboundFileLoadError(filepath, 'The output timing header entry is not a float.')
-    if header_lines[3][0:9] != '# format:':
+    if header[3][0:9] != '# format:':
         raise LuaboundFileLoadError(filepath, 'The format header line is malformed.')
-    header_lines[3] = header_lines[3][10:]
+    header[3] = header[3][10:]
 
     # Parse the format string
-    format_list = __parse_format(header_lines[0], header_lines[3], False)
+    format_list = __parse_format(header[0], header[3], False)
+    if __FILTERED_LIST_REGEX.search(header[3]) and\
+            sum(1 for entry in format_list if isinstance(entry, list)) > 1:
+        raise LuaboundFileLoadError(filepath, 'Text files can only have one list when using ' +\
+            'particle filters, because the list lengths are not written. Use binary output instead.')
 
     # Create the tagmap
-    def _next_tag(tagmap, token):
-        if not token in tagmap:
-            return token
-        token_index = 1
-        while '%s%d' % (token, token_index) in tagmap:
-            token_index += 1
-        return '%s%d' % (token, token_index)
     tag_map = dict()
     _list_index = 0
     for format_entry in format_list:
         if isinstance(format_entry, str):
-            tag_map[_next_tag(tag_map, format_entry)] = len(tag_map)
+            tag_map[__next_tag(tag_map, format_entry)] = len(tag_map)
         elif isinstance(format_entry, list):
             tag_map['l%d' % (_list_index)] = len(tag_map)
             _list_index += 1
 
-    # Parse out the data
-    file_data = __parse_data(format_list, data_lines)
+    return header, format_list, tag_map
 
-    # Return the completed object
-    return LuaboundFile(
-        header_lines[0], header_lines[1], header_lines[2], header_lines[3], tag_map, file_data
-    )
+
+def __next_tag(tagmap, token):
+    """
+    Gets the next unused name for a token in the tag map, adding a number to repeated tokens.
+
+    This function is private and should not be called from outside of this module.
+    """
+    if not token in tagmap:
+        return token
+    token_index = 1
+    while '%s%d' % (token, token_index) in tagmap:
+        token_index += 1
+    return '%s%d' % (token, token_index)
+
+
+def __load_io_library(filepath):
+    """
+    Loads the luabound io library, which decodes the compressed output files, reads the shared memory output, and
+        parses the text output files.
+
+    This function is private and should not be called from outside of this module.
+    """
+    if __IO_LIBRARY[0] is not None:
+        return __IO_LIBRARY[0]
+
+    search = [os.environ['LUABOUND_IO_LIB']] if 'LUABOUND_IO_LIB' in os.environ else []
+    out_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'OUT')
+    search += [os.path.join(out_dir, name) for name in __IO_LIBRARY_NAMES]
+    for path in search:
+        if os.path.isfile(path):
+            lib = ctypes.CDLL(path)
+            break
+    else:
+        raise LuaboundFileLoadError(filepath, 'Compressed, shared memory, and fast text loading need the luabound io library (lbdio), ' +\
+            'build it with luabound or set LUABOUND_IO_LIB to its path.')
+
+    lib.lbdio_decode_compressed.argtypes = [ctypes.c_char_p, ctypes.c_uint64, ctypes.c_uint64, ctypes.c_uint64,
+        ctypes.POINTER(ctypes.POINTER(ctypes.c_uint8)), ctypes.POINTER(ctypes.c_uint64)]
+    lib.lbdio_decode_compressed.restype = ctypes.c_int
+    lib.lbdio_get_compressed_info.argtypes = [ctypes.c_char_p, ctypes.POINTER(ctypes.c_uint32),
+        ctypes.POINTER(ctypes.c_uint32)]
+    lib.lbdio_get_compressed_info.restype = ctypes.c_int
+    lib.lbdio_free.argtypes = [ctypes.POINTER(ctypes.c_uint8)]
+    lib.lbdio_free.restype = None
+    lib.lbdio_get_error.argtypes = []
+    lib.lbdio_get_error.restype = ctypes.c_char_p
+
+    record_args = [ctypes.POINTER(ctypes.c_double), ctypes.POINTER(ctypes.c_int64),
+                   ctypes.POINTER(ctypes.POINTER(ctypes.c_uint8)), ctypes.POINTER(ctypes.c_uint64)]
+    lib.lbdio_shm_attach.argtypes = [ctypes.c_char_p]
+    lib.lbdio_shm_attach.restype = ctypes.c_void_p
+    lib.lbdio_shm_detach.argtypes = [ctypes.c_void_p]
+    lib.lbdio_shm_detach.restype = None
+    lib.lbdio_shm_get_header.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.POINTER(ctypes.c_uint8)),
+        ctypes.POINTER(ctypes.c_uint64), ctypes.POINTER(ctypes.c_int)]
+    lib.lbdio_shm_get_header.restype = None
+    lib.lbdio_shm_is_closed.argtypes = [ctypes.c_void_p]
+    lib.lbdio_shm_is_closed.restype = ctypes.c_int
+    lib.lbdio_shm_latest.argtypes = [ctypes.c_void_p] + record_args
+    lib.lbdio_shm_latest.restype = ctypes.c_int
+    lib.lbdio_shm_next.argtypes = [ctypes.c_void_p] + record_args
+    lib.lbdio_shm_next.restype = ctypes.c_int
+
+    lib.lbdio_text_open.argtypes = [ctypes.c_char_p, ctypes.c_uint64]
+    lib.lbdio_text_open.restype = ctypes.c_void_p
+    lib.lbdio_text_close.argtypes = [ctypes.c_void_p]
+    lib.lbdio_text_close.restype = None
+    lib.lbdio_text_get_column_count.argtypes = [ctypes.c_void_p]
+    lib.lbdio_text_get_column_count.restype = ctypes.c_uint32
+    lib.lbdio_text_get_column.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.POINTER(ctypes.c_int),
+        ctypes.POINTER(ctypes.c_uint32), ctypes.POINTER(ctypes.c_uint32)]
+    lib.lbdio_text_get_column.restype = None
+    lib.lbdio_text_read.argtypes = [ctypes.c_void_p, ctypes.c_uint64, ctypes.c_uint64,
+        ctypes.POINTER(ctypes.POINTER(ctypes.c_uint32))]
+    lib.lbdio_text_read.restype = ctypes.c_int64
+    lib.lbdio_text_fill.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.POINTER(ctypes.c_double))]
+    lib.lbdio_text_fill.restype = ctypes.c_int
+    lib.lbdio_text_get_strings.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.POINTER(ctypes.POINTER(ctypes.c_char)),
+        ctypes.POINTER(ctypes.c_uint64)]
+    lib.lbdio_text_get_strings.restype = None
+    __IO_LIBRARY[0] = lib
+    return lib
+
+
+def __decode_compressed_file(filepath, offset=0, skip=0, count=0):
+    """
+    Decodes a compressed output file into the bytes of a binary output file with the same records, using
+        the luabound io library. Decoding starts at the block at the offset (or the first block), skips
+        the first records, then decodes up to count records (or all of them).
+
+    This function is private and should not be called from outside of this module.
+
+    Returns:
+        np.array: The bytes of the decoded binary file.
+    """
+    lib = __load_io_library(filepath)
+    data = ctypes.POINTER(ctypes.c_uint8)()
+    size = ctypes.c_uint64(0)
+    if not lib.lbdio_decode_compressed(filepath.encode(sys.getfilesystemencoding()), offset, skip, count,
+                                       ctypes.byref(data), ctypes.byref(size)):
+        raise LuaboundFileLoadError(filepath, lib.lbdio_get_error().decode('utf-8'))
+    try:
+        return np.ctypeslib.as_array(data, shape=(size.value,)).copy()
+    finally:
+        lib.lbdio_free(data)
+
+
+def __load_compressed_file(filepath, offset=0, skip=0, count=0):
+    """
+    Decodes the records of a compressed output file like ``__decode_compressed_file()``, and loads them with the
+        mantissa bits from the file header.
+
+    This function is private and should not be called from outside of this module.
+
+    Returns:
+        :py:class:`LuaboundBinaryFile`: The decoded records.
+    """
+    lib = __load_io_library(filepath)
+    keyframe = ctypes.c_uint32(0)
+    bits = ctypes.c_uint32(0)
+    if not lib.lbdio_get_compressed_info(filepath.encode(sys.getfilesystemencoding()), ctypes.byref(keyframe),
+                                         ctypes.byref(bits)):
+        raise LuaboundFileLoadError(filepath, lib.lbdio_get_error().decode('utf-8'))
+
+    lbd_file = __load_binary_file(filepath, __decode_compressed_file(filepath, offset, skip, count))
+    lbd_file._mantissa_bits = bits.value
+    return lbd_file
+
+
+def __load_text_chunk(filepath, lib, handle, header, column_tags, list_tags, columns, max_records, max_bytes):
+    """
+    Reads the next chunk of records from an open io library text reader, and parses them into new arrays.
+
+    This function is private and should not be called from outside of this module.
+
+    Returns:
+        :py:class:`LuaboundBinaryFile`: The records in the chunk, which has no records at the end of the file.
+    """
+    counts_ptr = ctypes.POINTER(ctypes.c_uint32)()
+    record_count = lib.lbdio_text_read(handle, max_records, max_bytes, ctypes.byref(counts_ptr))
+    if record_count < 0:
+        raise LuaboundFileLoadError(filepath, lib.lbdio_get_error().decode('utf-8'))
+    counts = np.ctypeslib.as_array(counts_ptr, shape=(record_count,)).copy() if record_count > 0 else\
+        np.empty(0, dtype=np.uint32)
+    list_total = int(counts.sum(dtype=np.uint64))
+
+    # The library fills the arrays in place, the string columns only need a non-null pointer
+    values = []
+    pointers = (ctypes.POINTER(ctypes.c_double) * len(columns))()
+    string_marker = np.empty(1, dtype=np.float64)
+    for cindex, (ctype, width, lidx) in enumerate(columns):
+        if ctype == __TEXT_STRING_TYPE:
+            values.append(None)
+            pointers[cindex] = string_marker.ctypes.data_as(ctypes.POINTER(ctypes.c_double))
+        else:
+            size = (record_count if lidx == __BINARY_NO_LIST else list_total) * width
+            values.append(np.empty(size, dtype=np.float64))
+            pointers[cindex] = values[-1].ctypes.data_as(ctypes.POINTER(ctypes.c_double))
+    if not lib.lbdio_text_fill(handle, pointers):
+        raise LuaboundFileLoadError(filepath, lib.lbdio_get_error().decode('utf-8'))
+
+    # Shape the arrays the same way as the binary files
+    uniform = record_count > 0 and np.all(counts == counts[0])
+    splits = np.cumsum(counts, dtype=np.int64)[:-1]
+    file_columns = dict()
+    list_columns = [dict() for _ in list_tags]
+    for cindex, (tag, (ctype, width, lidx)) in enumerate(zip(column_tags, columns)):
+        if ctype == __TEXT_STRING_TYPE:
+            data = ctypes.POINTER(ctypes.c_char)()
+            size = ctypes.c_uint64(0)
+            lib.lbdio_text_get_strings(handle, cindex, ctypes.byref(data), ctypes.byref(size))
+            strings = ctypes.string_at(data, size.value).decode('utf-8').split('\0')[:-1]
+            view = np.empty(len(strings), dtype=object)
+            view[:] = strings
+        else:
+            view = values[cindex]
+            if ctype in __BINARY_DTYPES and ctype != 1:
+                view = view.astype(__BINARY_DTYPES[ctype])
+            if width > 1:
+                view = view.reshape((-1,) + __column_shape(tag, width))
+        if lidx == __BINARY_NO_LIST:
+            file_columns[tag] = view
+        elif uniform:
+            list_columns[lidx][tag] = view.reshape((record_count, int(counts[0])) + view.shape[1:])
+        else:
+            record_views = np.empty(record_count, dtype=object)
+            for rindex, record_view in enumerate(np.split(view, splits) if record_count > 0 else []):
+                record_views[rindex] = record_view
+            list_columns[lidx][tag] = record_views
+
+    for lindex, list_tag in enumerate(list_tags):
+        file_columns[list_tag] = LbdBinaryList(list_columns[lindex], counts)
+    return LuaboundBinaryFile(header[0], header[1], header[2], header[3], counts, file_columns)
+
+
+def __load_binary_file(filepath, raw=None):
+    """
+    Loads a binary luabound output file. The header is read directly, and then the records are
+        memory mapped. If all of the records have the same particle count, each tag is a single
+        strided view into the mapped file, otherwise the records are walked once to find them. The
+        index file, if there is one, is used to find the records instead of walking them.
+
+    This function is private and should not be called from outside of this module.
+
+    Args:
+        filepath (str): The path to the binary file.
+        raw (np.array): The bytes of the binary file, which have been decoded from a compressed file,
+            or `None` to memory map the file.
+
+    Returns:
+        :py:class:`LuaboundBinaryFile`: The loaded file.
+    """
+    decoded = raw is not None
+    if not decoded:
+        raw = np.memmap(filepath, dtype=np.uint8, mode='r')
+
+    # Read the header
+    header_pos = [len(__BINARY_MAGIC)]
+    def _read(fmt):
+        size = struct.calcsize(fmt)
+        if header_pos[0] + size > len(raw):
+            raise LuaboundFileLoadError(filepath, 'The binary header is truncated.')
+        value = struct.unpack_from(fmt, raw, header_pos[0])
+        header_pos[0] += size
+        return value if len(value) > 1 else value[0]
+    def _read_str():
+        length = _read('<I')
+        value = bytes(raw[header_pos[0]:(header_pos[0] + length)]).decode('utf-8')
+        header_pos[0] += length
+        return value
+
+    if _read('<I') != __BINARY_VERSION:
+        raise LuaboundFileLoadError(filepath, 'The binary file version is not supported.')
+    filename = _read_str()
+    timestamp = _read_str()
+    outrate = _read('<d')
+    outfmt = _read_str()
+    column_count = _read('<I')
+    columns = []
+    for _ in range(column_count):
+        dtype, width, lidx, flags = _read('<BBBB')
+        if width == __BINARY_WIDE_COLUMN:
+            width = _read('<I')
+        columns.append((dtype, width, lidx, flags))
+    header_size = header_pos[0]
+
+    # Match the columns to the tokens in the format string
+    column_tags, list_tags = __format_columns(__parse_format(filename, outfmt, False))
+    if len(column_tags) != column_count:
+        raise LuaboundFileLoadError(filepath, 'The binary columns do not match the format string.')
+    for dtype, _, _, _ in columns:
+        if not dtype in __BINARY_DTYPES:
+            raise LuaboundFileLoadError(filepath, 'The binary file has an unknown column type.')
+
+    # Filtered lists write their particle count before their first column
+    list_starts = [None for _ in list_tags]
+    for cindex, (_, _, lidx, flags) in enumerate(columns):
+        if lidx != __BINARY_NO_LIST and (flags & __BINARY_FILTERED_LIST) and list_starts[lidx] is None:
+            list_starts[lidx] = cindex
+    column_starts = [(l != __BINARY_NO_LIST and list_starts[l] == c) for c, (_, _, l, _) in enumerate(columns)]
+    any_filtered = any(start is not None for start in list_starts)
+
+    # Walk the records to find the particle counts, which only reads the count at the start of each,
+    #     unless there are filtered lists, which need the columns before them to find their counts
+    scalar_size = sum(__BINARY_DTYPES[d].itemsize * w for d, w, l, _ in columns if l == __BINARY_NO_LIST)
+    particle_size = sum(__BINARY_DTYPES[d].itemsize * w for d, w, l, _ in columns if l != __BINARY_NO_LIST)
+    record_offsets = []
+    counts = []
+    list_counts = [[] for _ in list_tags]
+    offset = header_size
+
+    # The index has the offset of each record, so the counts can all be read at once without walking
+    index = None if (any_filtered or decoded) else load_lbd_index(filepath)
+    if index is not None and len(index) > 0 and int(index['offset'][0]) == header_size:
+        index_offsets = index['offset'].astype(np.int64)
+        index_counts = raw[index_offsets[:, None] + np.arange(4)].copy().view('<u4').ravel()
+        index_ends = index_offsets + 4 + scalar_size + (index_counts.astype(np.int64) * particle_size)
+        valid = (index_ends <= len(raw)) & (np.append(index_offsets[1:], index_ends[-1]) == index_ends)
+        valid_count = len(valid) if np.all(valid) else int(np.argmin(valid))
+        if valid_count > 0:
+            record_offsets = [int(o) for o in index_offsets[:valid_count]]
+            counts = list(index_counts[:valid_count])
+            list_counts = [list(counts) for _ in list_tags]
+            offset = int(index_ends[valid_count - 1])
+
+    # Walk any records that are not in the index
+    while offset + 4 <= len(raw):
+        count = struct.unpack_from('<I', raw, offset)[0]
+        record_lists = [count for _ in list_tags]
+        if any_filtered:
+            record_size = 4
+            for (dtype, width, lidx, _), start in zip(columns, column_starts):
+                if start:
+                    if offset + record_size + 4 > len(raw):
+                        break
+                    record_lists[lidx] = struct.unpack_from('<I', raw, offset + record_size)[0]
+                    record_size += 4
+                values = width * (1 if lidx == __BINARY_NO_LIST else record_lists[lidx])
+                record_size += __BINARY_DTYPES[dtype].itemsize * values
+        else:
+            record_size = 4 + scalar_size + (count * particle_size)
+        if offset + record_size > len(raw):
+            break # Partial record at the end of the file, from a run that is still going or was killed
+        record_offsets.append(offset)
+        counts.append(count)
+        for lindex, lcount in enumerate(record_lists):
+            list_counts[lindex].append(lcount)
+        offset += record_size
+    counts = np.array(counts, dtype=np.uint32)
+    list_counts = [np.array(lcounts, dtype=np.uint32) for lcounts in list_counts]
+
+    # Build the views for each column
+    file_columns = dict()
+    list_columns = [dict() for _ in list_tags]
+    if len(counts) > 0 and np.all(counts == counts[0]) and not any_filtered:
+        # Every record is the same size, so the whole file can be viewed as one structured array
+        fields = [('_count', '<u4')]
+        for tag, (dtype, width, lidx, _) in zip(column_tags, columns):
+            shape = () if lidx == __BINARY_NO_LIST else (int(counts[0]),)
+            shape = shape + __column_shape(tag, width)
+            fields.append(('%d_%s' % (len(fields), tag), __BINARY_DTYPES[dtype], shape))
+        records = np.ndarray(shape=(len(counts),), dtype=np.dtype(fields), buffer=raw, offset=header_size)
+        for index, (tag, (_, _, lidx, _)) in enumerate(zip(column_tags, columns)):
+            view = records[fields[index + 1][0]]
+            if lidx == __BINARY_NO_LIST:
+                file_columns[tag] = view
+            else:
+                list_columns[lidx][tag] = view
+    else:
+        # The particle count changes, so each record gets its own views
+        scalar_values = [np.empty(len(counts), dtype=object) for _ in column_tags]
+        for rindex, roffset in enumerate(record_offsets):
+            offset = roffset + 4
+            for cindex, (dtype, width, lidx, _) in enumerate(columns):
+                if column_starts[cindex]:
+                    offset += 4 # The list count, which was already read
+                values = (1 if lidx == __BINARY_NO_LIST else int(list_counts[lidx][rindex])) * width
+                view = np.frombuffer(raw, dtype=__BINARY_DTYPES[dtype], count=values, offset=offset)
+                if width > 1:
+                    view = view.reshape((-1,) + __column_shape(column_tags[cindex], width))
+                scalar_values[cindex][rindex] = view[0] if lidx == __BINARY_NO_LIST else view
+                offset += view.nbytes
+        for tag, (dtype, _, lidx, _), values in zip(column_tags, columns, scalar_values):
+            if lidx == __BINARY_NO_LIST:
+                file_columns[tag] = np.array(list(values)) if len(values) else values
+            else:
+                list_columns[lidx][tag] = values
+
+    for lindex, list_tag in enumerate(list_tags):
+        file_columns[list_tag] = LbdBinaryList(list_columns[lindex], list_counts[lindex])
+    return LuaboundBinaryFile(filename, timestamp, outrate, outfmt, counts, file_columns)
+
+
+def __format_columns(format_list):
+    """
+    Gets the tag for each value token in the parsed format, in the same order as the columns in the
+        binary files and the io library, and the tags for the lists.
+
+    This function is private and should not be called from outside of this module.
+
+    Returns:
+        tuple: The list of column tags, and the list of list tags.
+    """
+    column_tags = []
+    list_tags = []
+    tag_map = dict()
+    for format_entry in format_list:
+        if isinstance(format_entry, str):
+            column_tags.append(__next_tag(tag_map, format_entry))
+            tag_map[column_tags[-1]] = None
+        elif isinstance(format_entry, list):
+            list_tags.append('l%d' % (len(list_tags)))
+            tag_map[list_tags[-1]] = None
+            sub_map = dict()
+            for sub_entry in format_entry:
+                if isinstance(sub_entry, str):
+                    column_tags.append(__next_tag(sub_map, sub_entry))
+                    sub_map[column_tags[-1]] = None
+    return column_tags, list_tags
+
+
+def __column_shape(tag, width):
+    """
+    Gets the shape of a single value of the tag, which is a 2D array of the bins for 2D histograms.
+
+    This function is private and should not be called from outside of this module.
+    """
+    if width == 1:
+        return ()
+    if tag.startswith('h2'):
+        hist_args = __HISTOGRAM_REGEX.match(tag).group(1).split(',')
+        return (int(hist_args[4]), int(hist_args[7]))
+    return (width,)
 
 
 def __parse_format(filename, fmtstr, inlist):
@@ -488,23 +1445,44 @@ def __parse_format(filename, fmtstr, inlist):
     while curr_index < len(fmtstr):
         sub_str = fmtstr[curr_index:]
 
-        if sub_str[0] == '#': # An output token
-            token_type = sub_str[1]
-            if len(sub_str) > 3 and sub_str[3].isalpha():
-                token_value = sub_str[2:4]
-            elif len(sub_str) > 2 and sub_str[2].isalpha():
-                token_value = sub_str[2]
+        histogram_match = __HISTOGRAM_REGEX.match(sub_str[1:]) if sub_str[0] == '#' else None
+        if histogram_match: # A histogram token, the whole token is used as the tag
+            if inlist:
+                raise LuaboundFileLoadError(filename, 'Cannot use a histogram in a list (%d)' %\
+                    (curr_index))
+            token_list.append(histogram_match.group(0).replace(' ', ''))
+            curr_index += (len(histogram_match.group(0)) + 1)
+
+        elif sub_str[0] == '#': # An output token
+            percentile_match = __PERCENTILE_REGEX.match(sub_str[1:])
+            token_type = percentile_match.group(0) if percentile_match else sub_str[1]
+            value_start = len(token_type) + 1
+            if len(sub_str) > value_start + 1 and sub_str[value_start + 1].isalpha():
+                token_value = sub_str[value_start:value_start + 2]
+            elif len(sub_str) > value_start and sub_str[value_start].isalpha():
+                token_value = sub_str[value_start]
             else:
                 raise LuaboundFileLoadError(filename, 'Expected value token at %d' % (curr_index))
 
+            # Aggregate tokens can have a particle filter, which is kept as part of the tag
+            token_filter = ''
+            filter_start = value_start + len(token_value)
+            if len(sub_str) > filter_start and sub_str[filter_start] == '[':
+                filter_end = sub_str.find(']', filter_start)
+                if filter_end < 0 or token_type in ['s', 'p']:
+                    raise LuaboundFileLoadError(filename, 'Invalid particle filter at %d' %\
+                        (curr_index + filter_start))
+                token_filter = sub_str[filter_start:(filter_end + 1)]
+
             if token_type == 's' and token_value in __SIM_OUTPUT_TOKENS:
                 token_list.append('%s%s' % (token_type, token_value))
-            elif token_type in ['p', 'd', 'a'] and token_value in __PARTICLE_OUTPUT_TOKENS:
-                token_list.append('%s%s' % (token_type, token_value))
+            elif (token_type in __PARTICLE_GROUPS or percentile_match) and\
+                    token_value in __PARTICLE_OUTPUT_TOKENS:
+                token_list.append('%s%s%s' % (token_type, token_value, token_filter))
             else:
                 raise LuaboundFileLoadError(filename, 'The token #%s%s is invalid' %\
                     (token_type, token_value))
-            curr_index += (len(token_value) + 2)
+            curr_index += (len(token_value) + value_start + len(token_filter))
 
         elif sub_str[0] == '{': # Beginning of a list specifier
             if inlist:
@@ -520,7 +1498,10 @@ def __parse_format(filename, fmtstr, inlist):
                 curr_index += 2
             else:
                 list_str = sub_str[1:list_index]
-                token_list.append(__parse_format(filename, list_str, True))
+                token_str = list_str
+                if list_str.lstrip().startswith('['): # Skip the particle filter
+                    token_str = list_str[(list_str.find(']') + 1):].lstrip()
+                token_list.append(__parse_format(filename, token_str, True))
                 curr_index += (len(list_str) + 2)
 
         elif sub_str[0] in __PUNCTUATION_CHARACTERS: # Beginning of punctuation list
@@ -565,7 +1546,13 @@ def __parse_data(token_list, data_lines):
 
     # Function for parsing a single string into the correct datatype
     def _parseStrToData(linenum, token, dvalue):
-        token_type = token[1:]
+        if token[0] == 'h': # Histograms are written in the vector format, with any number of values
+            if dvalue[0:2] != '{{':
+                raise Exception('Invalid histogram value parsed in line %d' % (linenum))
+            bins = np.array([float(val) for val in str(dvalue).strip('{}').split('|')])
+            return bins.reshape(__column_shape(token, len(bins))) if token[1] == '2' else bins
+        token_tag = token.split('[')[0] # Remove the particle filter
+        token_type = token_tag[__PERCENTILE_REGEX.match(token_tag).end():] if token_tag[0] == 'q' else token_tag[1:]
         if token_type in __STR_TOKENS:
             return str(dvalue)
         elif token_type in __VECTOR_TOKENS:
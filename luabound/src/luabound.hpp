@@ -77,6 +77,11 @@ template <
 	class T,
 	class Container = std::deque<T>
 > using StlQueue = std::queue<T, Container>;
+template <
+	class T,
+	class Container = std::vector<T>,
+	class Compare = std::less<typename Container::value_type>
+> using StlPriorityQueue = std::priority_queue<T, Container, Compare>;
 template <
 	class T,
 	class Container = std::deque<T>
@@ -124,6 +129,7 @@ String strfmt(const String& fmt, ...);
 
 void linfo(const String& msg);
 void lsim(const String& msg); // This should only ever be used by luabound internally for stdout output
+String lsimTag(); // The tag and prefix that lsim() starts each message with, for stdout output that skips lsim()
 void lplugin(const String& msg); // This should only ever be used for plugin output
 void lwarn(const String& msg);
 void lerr(const String& msg);
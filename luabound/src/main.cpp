@@ -10,12 +10,13 @@
 #include "luabound.hpp"
 #include "runtime/simulation.hpp"
 #include "util/cmd_line.hpp"
+#include "util/counter_rng.hpp"
 
 void initialize_random();
 
 int main(int argc, char **argv)
 {
-	// Temporary fix, will eventually allow simulations to define seeds
+	// The default seed, for simulations that do not give one
 	initialize_random();
 
 	std::cout << "Luabound version " << LUABOUND_VERSION 
@@ -40,12 +41,15 @@ int main(int argc, char **argv)
 
 void initialize_random()
 {
-	const size_t BYTECOUNT = 4;
+	const size_t BYTECOUNT = 8;
 	char data[BYTECOUNT] = {0};
 	FILE *fp;
 	fp = fopen("/dev/urandom", "r");
 	if (fread(&data, 1, BYTECOUNT, fp)); // Gets rid of GCC compiler warning for unused return value
 	fclose(fp);
 
-	srand(*reinterpret_cast<uint32*>(data));
+	// Kept small enough to be given back in the script, to repeat the run
+	const uint64 seed = *reinterpret_cast<uint64*>(data) % RNG_MAX_SEED;
+	rng::SetSeed(seed);
+	srand(static_cast<uint32>(seed)); // For plugins that use the rebound random functions
 }
\ No newline at end of file
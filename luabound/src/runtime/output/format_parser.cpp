@@ -10,15 +10,9 @@
 
 #include "format_parser.hpp"
 #include "../simulation.hpp"
+#include "../../../io/format_grammar.hpp"
 #include <regex>
 
-// Regex strings for finding patterns
-static const String PUNCTUATION_TOKEN_REGEX_STR = R"([,;:\/\\ \t]+)";
-static const String VALUE_TOKEN_REGEX_STR = R"(#(\w)(\w\w?))";
-static const String LIST_SPECIFIER_REGEX_STR = R"(\{(.*?)\})";
-static const String FORMAT_REGEX_FULL_STR = 
-		"(?:" + LIST_SPECIFIER_REGEX_STR + ")|(?:" + VALUE_TOKEN_REGEX_STR + ")|(?:" + PUNCTUATION_TOKEN_REGEX_STR + ")";
-
 
 namespace
 {
@@ -28,6 +22,7 @@ format_ast::base_node* _parseValueToken(std::smatch& match, bool list)
 	String matchStr = match[0].str();
 	String tag = match[2].str();
 	String value = match[3].str();
+	const bool filtered = match[4].matched;
 	ValueGroup group = token_utils::StringToValueGroup(tag);
 
 	if (group == ValueGroup::INVALID) {
@@ -40,9 +35,13 @@ format_ast::base_node* _parseValueToken(std::smatch& match, bool list)
 			lerr(strfmt("The value token %s does not specify a valid simulation value.", matchStr.c_str()));
 			return nullptr;
 		}
+		if (filtered) {
+			lerr(strfmt("The simulation value token %s cannot have a particle filter.", matchStr.c_str()));
+			return nullptr;
+		}
 		return new format_ast::svalue_token_node(stype);
 	}
-	else if (group == ValueGroup::Average || group == ValueGroup::StdDev) {
+	else if (token_utils::IsAggregateGroup(group)) {
 		ValuePType ptype = token_utils::StringToValuePType(value);
 		if (ptype == ValuePType::INVALID) {
 			lerr(strfmt("The value token %s does not specify a valid particle value.", matchStr.c_str()));
@@ -56,7 +55,20 @@ format_ast::base_node* _parseValueToken(std::smatch& match, bool list)
 			lerr("Cannot request global particle hashes.");
 			return nullptr;
 		}
-		return new format_ast::pvalue_token_node(group, ptype);
+		double quantile = 0;
+		if (group == ValueGroup::Percentile) {
+			quantile = atof(tag.c_str() + 1);
+			if (quantile > 100) {
+				lerr(strfmt("The value token %s has a percentile larger than 100.", matchStr.c_str()));
+				return nullptr;
+			}
+		}
+		ParticleFilter filter;
+		if (filtered && !filter.load(match[4].str())) {
+			lerr(strfmt("The value token %s has an invalid particle filter.", matchStr.c_str()));
+			return nullptr;
+		}
+		return new format_ast::pvalue_token_node(group, ptype, quantile, filter);
 	}
 	else if (group == ValueGroup::Particle) {
 		if (!list) {
@@ -68,20 +80,103 @@ format_ast::base_node* _parseValueToken(std::smatch& match, bool list)
 			lerr(strfmt("The value token %s does not specify a valid particle value.", matchStr.c_str()));
 			return nullptr;
 		}
+		if (filtered) {
+			lerr(strfmt("The particle value token %s cannot have a filter, filter the list specifier instead.", 
+				matchStr.c_str()));
+			return nullptr;
+		}
 		return new format_ast::pvalue_token_node(group, ptype);
 	}
 
 	return nullptr;
 }
 
+// Parses a histogram token, "#h(value, min, max, bins)" or "#h2(xvalue, yvalue, xmin, xmax, xbins, ymin, 
+//     ymax, ybins)", with a 'w' after the h (or h2) to weight the bins by mass
+format_ast::base_node* _parseHistogramToken(const String& matchStr)
+{
+	static const std::regex PARTS_REGEX(LBDIO_HISTOGRAM_PARTS_REGEX, std::regex_constants::ECMAScript);
+
+	std::smatch match;
+	if (!std::regex_match(matchStr, match, PARTS_REGEX)) {
+		lerr(strfmt("The histogram token %s is malformed.", matchStr.c_str()));
+		return nullptr;
+	}
+
+	histogram_spec spec;
+	spec.dims = (match[1].length() > 0) ? 2 : 1;
+	spec.weighted = (match[2].length() > 0);
+	spec.ptypes[1] = ValuePType::INVALID;
+	spec.ranges[1] = stats::bin_range{0, 1, 1};
+
+	// Split the arguments, ignoring whitespace
+	StlVector<String> args(1);
+	for (char c : match[3].str()) {
+		if (c == ',')
+			args.emplace_back();
+		else if (!isspace(c))
+			args.back().push_back(c);
+	}
+	if (args.size() != (spec.dims * 4)) {
+		lerr(strfmt("The histogram token %s must have %u arguments.", matchStr.c_str(), spec.dims * 4));
+		return nullptr;
+	}
+
+	for (uint32 d = 0; d < spec.dims; ++d) {
+		const ValuePType ptype = token_utils::StringToValuePType(args[d]);
+		if (ptype == ValuePType::INVALID || token_utils::GetPValueDataType(ptype) == ValueDataType::String || 
+				ptype == ValuePType::EccVec || ptype == ValuePType::AMVec) {
+			lerr(strfmt("The histogram token %s does not bin a valid scalar particle value (\"%s\").", 
+				matchStr.c_str(), args[d].c_str()));
+			return nullptr;
+		}
+		spec.ptypes[d] = ptype;
+
+		const String& minStr = args[spec.dims + (d * 3)];
+		const String& maxStr = args[spec.dims + (d * 3) + 1];
+		const String& binStr = args[spec.dims + (d * 3) + 2];
+		char *minEnd = nullptr, *maxEnd = nullptr, *binEnd = nullptr;
+		const double minVal = strtod(minStr.c_str(), &minEnd);
+		const double maxVal = strtod(maxStr.c_str(), &maxEnd);
+		const long bins = strtol(binStr.c_str(), &binEnd, 10);
+		if (minStr.empty() || *minEnd || maxStr.empty() || *maxEnd || !(maxVal > minVal)) {
+			lerr(strfmt("The histogram token %s must have a range with min < max.", matchStr.c_str()));
+			return nullptr;
+		}
+		if (binStr.empty() || *binEnd || bins < 1 || bins > HISTOGRAM_MAX_BINS) {
+			lerr(strfmt("The histogram token %s must have between 1 and %d bins.", matchStr.c_str(), HISTOGRAM_MAX_BINS));
+			return nullptr;
+		}
+		spec.ranges[d] = stats::bin_range{minVal, maxVal, static_cast<uint32>(bins)};
+	}
+
+	ParticleFilter filter;
+	if (match[4].matched && !filter.load(match[4].str())) {
+		lerr(strfmt("The histogram token %s has an invalid particle filter.", matchStr.c_str()));
+		return nullptr;
+	}
+	return new format_ast::histogram_token_node(spec, filter);
+}
+
 format_ast::base_node* _parseListSpecifier(const String& liststr, bool lastNode)
 {
-	static const std::regex FULL_REGEX(FORMAT_REGEX_FULL_STR, 
+	static const std::regex FULL_REGEX(LBDIO_FORMAT_REGEX_FULL, 
 			std::regex_constants::ECMAScript | std::regex_constants::optimize);
+	static const std::regex FILTER_REGEX(LBDIO_LIST_FILTER_REGEX, std::regex_constants::ECMAScript);
 	
 	std::smatch match;
 	size_t currentStart = 0;
-	String currentListStr = liststr;
+
+	// The list can start with a filter to only loop over some of the particles
+	ParticleFilter filter;
+	if (std::regex_search(liststr, match, FILTER_REGEX)) {
+		if (!filter.load(match[1].str())) {
+			lerr(strfmt("The list specifier \"%s\" has an invalid particle filter.", liststr.c_str()));
+			return nullptr;
+		}
+		currentStart = match.length();
+	}
+	String currentListStr = liststr.substr(currentStart);
 	format_ast::list_node::node_ptr_list nodeList;
 	while (std::regex_search(currentListStr, match, FULL_REGEX, 
 			std::regex_constants::match_continuous | std::regex_constants::match_not_null)) {
@@ -89,7 +184,11 @@ format_ast::base_node* _parseListSpecifier(const String& liststr, bool lastNode)
 
 		format_ast::base_node *node = nullptr;
 		String matchStr = match.str();
-		if (matchStr[0] == '#') { // Value token
+		if (matchStr[0] == '#' && matchStr[1] == 'h') { // Histogram token
+			lerr(strfmt("The histogram token %s cannot be used inside of list specifiers.", matchStr.c_str()));
+			return nullptr;
+		}
+		else if (matchStr[0] == '#') { // Value token
 			node = _parseValueToken(match, true);
 			if (!node)
 				return nullptr;
@@ -114,7 +213,7 @@ format_ast::base_node* _parseListSpecifier(const String& liststr, bool lastNode)
 		return nullptr;
 	}
 
-	return new format_ast::list_node(nodeList, lastNode);
+	return new format_ast::list_node(nodeList, lastNode, filter);
 }
 
 } // namespace
@@ -123,19 +222,25 @@ format_ast::base_node* _parseListSpecifier(const String& liststr, bool lastNode)
 // ================================================================================================
 bool OutputFormat::loadFormat(const String& fmt)
 {
-	static const std::regex FULL_REGEX(FORMAT_REGEX_FULL_STR, 
+	static const std::regex FULL_REGEX(LBDIO_FORMAT_REGEX_FULL, 
 			std::regex_constants::ECMAScript | std::regex_constants::optimize);
 
 	std::smatch match;
 	size_t currentStart = 0;
 	String currentFmtString = fmt;
+	ASTList formats;
 	while (std::regex_search(currentFmtString, match, FULL_REGEX, 
 			std::regex_constants::match_continuous | std::regex_constants::match_not_null)) {
 		currentStart += match.length();
 
 		FormatNode *node = nullptr;
 		String matchStr = match.str();
-		if (matchStr[0] == '#') { // Value token
+		if (matchStr[0] == '#' && matchStr[1] == 'h') { // Histogram token
+			node = _parseHistogramToken(matchStr);
+			if (!node)
+				return false;
+		}
+		else if (matchStr[0] == '#') { // Value token
 			node = _parseValueToken(match, false);
 			if (!node)
 				return false;
@@ -150,7 +255,7 @@ bool OutputFormat::loadFormat(const String& fmt)
 			node = new format_ast::punctuation_node(puncStr);
 		}
 
-		m_formats.emplace_back(std::move(StlUniquePtr<FormatNode>(node)));
+		formats.emplace_back(std::move(StlUniquePtr<FormatNode>(node)));
 		currentFmtString = fmt.substr(currentStart);
 	}
 
@@ -159,13 +264,17 @@ bool OutputFormat::loadFormat(const String& fmt)
 		return false;
 	}
 
+	// Lower the parsed tree into the flat plan, the tree is not needed after this
+	m_plan.clear();
+	for (auto& nodeptr : formats) {
+		nodeptr->lower(m_plan);
+	}
+
 	return true;
 }
 
 // ================================================================================================
-void OutputFormat::generateOutput(LbdSimulation *sim, StringStream& out)
+void OutputFormat::generateOutput(OutputTick& tick, StringStream& out)
 {
-	for (auto& nodeptr : m_formats) {
-		nodeptr->generateOutput(sim, out);
-	}
+	m_plan.execute(tick, out);
 }
\ No newline at end of file
@@ -20,19 +20,24 @@ private:
 	using FormatNode = format_ast::base_node;
 	using ASTList = StlVector<StlUniquePtr<FormatNode>>;
 
-	ASTList m_formats;
+	FormatPlan m_plan;
 
 public:
 	OutputFormat() { }
 	~OutputFormat() {
-		m_formats.clear();
+		m_plan.clear();
 	}
 
 	LUABOUND_DECLARE_CLASS_NONCOPYABLE(OutputFormat)
 
 	bool loadFormat(const String& fmt);
 
-	void generateOutput(LbdSimulation *sim, StringStream& out);
+	inline const FormatPlan& getPlan() const { return m_plan; }
+	inline void setPrecision(int precision) { m_plan.setPrecision(precision); }
+	inline void setSample(double fraction, uint64 seed) { m_plan.setSample(fraction, seed); }
+	inline void setFrame(CoordFrame frame) { m_plan.setFrame(frame); }
+
+	void generateOutput(OutputTick& tick, StringStream& out);
 };
 
 #endif // FORMAT_PARSER_HPP_
\ No newline at end of file
@@ -9,9 +9,15 @@
  */
 
 #include "format_token.hpp"
+#include "output_tick.hpp"
 #include "../simulation.hpp"
+#include "../../util/byte_buffer.hpp"
 #include "../../util/timer.hpp"
 #include "../../util/vec_math.hpp"
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 
 namespace
@@ -21,68 +27,132 @@ namespace
 #define VT_DOUBLE (1)
 #define VT_INT (2)
 
-#define SIMEXT_(token, value) case ValueSType::token: { ss << (value); break; }
-void _printSimulationValue(LbdSimulation *sim, ValueSType type, StringStream& ss)
+// Writes a single value as text, with numbers going through the fast formatting instead of the stream
+inline void _printValue(StringStream& out, int precision, double value) { numfmt::append(out, value, precision); }
+inline void _printValue(StringStream& out, int /*precision*/, uint32 value) { numfmt::append(out, value); }
+inline void _printValue(StringStream& out, int /*precision*/, int64 value) { numfmt::append(out, value); }
+inline void _printValue(StringStream& out, int /*precision*/, const String& value) { out << value; }
+
+// Writes a vector value in the "{{x|y|z}}" format
+void _printVector(StringStream& out, int precision, double x, double y, double z)
 {
+	out << "{{";
+	numfmt::append(out, x, precision);
+	out << '|';
+	numfmt::append(out, y, precision);
+	out << '|';
+	numfmt::append(out, z, precision);
+	out << "}}";
+}
+
+#define SIMEXT_(token, value) case ValueSType::token: { _printValue(ss, precision, (value)); break; }
+void _printSimulationValue(OutputTick& tick, ValueSType type, int precision, StringStream& ss)
+{
+	LbdSimulation *sim = tick.getSimulation();
 	switch (type)
 	{
 		SIMEXT_(Name, sim->getSimulationName())
-		SIMEXT_(Time, sim->getSimulation()->t)
-		SIMEXT_(Lastdt, sim->getSimulation()->dt_last_done)
-		SIMEXT_(PCount, sim->getSimulation()->N)
+		SIMEXT_(Time, tick.getTime())
+		SIMEXT_(Lastdt, tick.getLastdt())
+		SIMEXT_(PCount, tick.getParticleCount())
 		SIMEXT_(IName, sim->getIntegratorName())
-		SIMEXT_(Gravity, sim->getSimulation()->G)
-		SIMEXT_(TimeStep, sim->getTimestepCount())
-		SIMEXT_(WallTime, sim->getElapsedWallTime())
+		SIMEXT_(Gravity, tick.getG())
+		SIMEXT_(TimeStep, tick.getTimestep())
+		SIMEXT_(WallTime, tick.getWallTime())
 		SIMEXT_(WallRes, Timer::GetResolution())
 		default: ss << "INVALID"; break;
 	}
 }
 #undef SIMEXT_
 
-#define PARTEXT_(token, value) case ValuePType::token: { out << (value); break; }
-#define PARTOEXT_(token, omember) case ValuePType::token: { \
-	reb_orbit orbit; \
-	int err = sim->getManager()->getOrbitForParticle(&part, orbit); \
-	if (err) { \
-		lerr(strfmt("Could not get the orbital value, reason: \"%s\".", orbitErrMsg[err])); \
-		throw "Orbit value get error."; \
-	} \
-	out << (orbit.omember); \
-	break; \
-}
+#define PARTEXT_(token, value) case ValuePType::token: { _printValue(out, precision, (value)); break; }
 const char *orbitErrMsg[2] = {
 	"The particle has no mass.",
 	"The particle is in the same place as the primary particle."
 };
-void _printParticleValue(LbdSimulation *sim, uint32 index, ValuePType type, StringStream& out)
+// Reports the orbit error for the particle and throws
+void _throwOrbitError(int err)
+{
+	lerr(strfmt("Could not get the orbital value, reason: \"%s\".", orbitErrMsg[err - 1]));
+	throw "Orbit value get error.";
+}
+
+// Gets the orbits from the heartbeat orbit cache, throwing if the orbit of the particle could not be calculated
+const orbits::orbit_batch& _getParticleOrbits(OutputTick& tick, uint32 index)
+{
+	const orbits::orbit_batch& batch = tick.getOrbits();
+	if (batch.err[index])
+		_throwOrbitError(batch.err[index]);
+	return batch;
+}
+
+// Gets the array for the orbital value in the batch
+const double* _getOrbitalArray(const orbits::orbit_batch& batch, ValuePType type)
+{
+	switch (type) {
+		case ValuePType::SMA: return batch.a.data();
+		case ValuePType::Eccen: return batch.e.data();
+		case ValuePType::Incl: return batch.inc.data();
+		case ValuePType::LAN: return batch.Omega.data();
+		case ValuePType::AP: return batch.omega.data();
+		case ValuePType::TrueAnom: return batch.f.data();
+		case ValuePType::MeanAnom: return batch.M.data();
+		case ValuePType::AngMom: return batch.h.data();
+		default: return nullptr;
+	}
+}
+
+// Gets the distance of the particle from the center of the reference frame
+double _getFrameDistance(const reference_frame& frame, const reb_particle& part)
+{
+	const double dx = part.x - frame.center.x, dy = part.y - frame.center.y, dz = part.z - frame.center.z;
+	return sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+// Gets the eccentricity vector of the particle, relative to the reference frame
+reb_vec3d _getEccentricityVector(const reference_frame& frame, const reb_particle& part)
 {
-	static const auto getEccentricityVector = [sim](const reb_particle& part) -> reb_vec3d {
-		using namespace vecmath;
-		const reb_vec3d pos{part.x, part.y, part.z};
-		const reb_vec3d vel{part.vx, part.vy, part.vz};
-		const double mu = sim->getSimulation()->G * part.m;
+	using namespace vecmath;
+	const reb_vec3d pos{part.x - frame.center.x, part.y - frame.center.y, part.z - frame.center.z};
+	const reb_vec3d vel{part.vx - frame.center.vx, part.vy - frame.center.vy, part.vz - frame.center.vz};
+	const double mu = frame.GM + (frame.G * part.m);
 
-		const double c1 = (lensq(vel) / mu) - (1 / len(pos));
-		const double c2 = dot(pos, vel) / mu;
+	const double c1 = (lensq(vel) / mu) - (1 / len(pos));
+	const double c2 = dot(pos, vel) / mu;
 
-		const reb_vec3d v1 = mul(pos, c1);
-		const reb_vec3d v2 = mul(vel, c2);
-		return sub(v1, v2);
+	const reb_vec3d v1 = mul(pos, c1);
+	const reb_vec3d v2 = mul(vel, c2);
+	return sub(v1, v2);
+}
+
+// Gets the specific angular momentum vector of the particle, relative to the reference frame
+reb_vec3d _getAngMomVector(const reference_frame& frame, const reb_particle& part)
+{
+	using namespace vecmath;
+	const reb_vec3d pos{part.x - frame.center.x, part.y - frame.center.y, part.z - frame.center.z};
+	const reb_vec3d vel{part.vx - frame.center.vx, part.vy - frame.center.vy, part.vz - frame.center.vz};
+	return cross(pos, vel);
+}
+
+#define PARTOEXT_(token, omember) case ValuePType::token: { _printValue(out, precision, _getParticleOrbits(tick, index).omember[index]); break; }
+void _printParticleValue(OutputTick& tick, uint32 index, ValuePType type, CoordFrame cframe, int precision, 
+	StringStream& out)
+{
+	const reference_frame& frame = tick.getFrame();
+	const auto getEccentricityVector = [&frame](const reb_particle& part) -> reb_vec3d {
+		return _getEccentricityVector(frame, part);
 	};
-	static const auto getAngMomVector = [sim](const reb_particle& part) -> reb_vec3d {
-		using namespace vecmath;
-		const reb_vec3d pos{part.x, part.y, part.z};
-		const reb_vec3d vel{part.vx, part.vy, part.vz};
-		return cross(pos, vel);
+	const auto getAngMomVector = [&frame](const reb_particle& part) -> reb_vec3d {
+		return _getAngMomVector(frame, part);
 	};
 
-	const reb_particle& part = sim->getSimulation()->particles[index];
+	const reb_particle& part = tick.getParticle(index);
+	const reb_particle& cpart = tick.getCoordinates(cframe)[index]; // The position and velocity in the frame
 
 	switch (type) {
 		PARTEXT_(Mass, part.m)
 		PARTEXT_(Radius, part.r)
-		PARTEXT_(Name, sim->getManager()->getNameFromHash(part.hash));
+		PARTEXT_(Name, tick.getParticleName(index));
 		PARTEXT_(Hash, part.hash)
 		PARTOEXT_(SMA, a)
 		PARTOEXT_(Eccen, e)
@@ -91,23 +161,23 @@ void _printParticleValue(LbdSimulation *sim, uint32 index, ValuePType type, Stri
 		PARTOEXT_(AP, omega)
 		PARTOEXT_(TrueAnom, f)
 		PARTOEXT_(MeanAnom, M)
-		PARTEXT_(PosX, part.x)
-		PARTEXT_(PosY, part.y)
-		PARTEXT_(PosZ, part.z)
-		PARTEXT_(VelX, part.vx)
-		PARTEXT_(VelY, part.vy)
-		PARTEXT_(VelZ, part.vz)
+		PARTEXT_(PosX, cpart.x)
+		PARTEXT_(PosY, cpart.y)
+		PARTEXT_(PosZ, cpart.z)
+		PARTEXT_(VelX, cpart.vx)
+		PARTEXT_(VelY, cpart.vy)
+		PARTEXT_(VelZ, cpart.vz)
 		PARTEXT_(AccX, part.ax)
 		PARTEXT_(AccY, part.ay)
 		PARTEXT_(AccZ, part.az)
-		PARTEXT_(Distance, sqrt(part.x * part.x + part.y * part.y + part.z * part.z))
-		PARTOEXT_(PDistance, d)
+		PARTEXT_(Distance, sqrt(cpart.x * cpart.x + cpart.y * cpart.y + cpart.z * cpart.z))
+		PARTEXT_(PDistance, _getFrameDistance(frame, part))
 		PARTEXT_(EccX, getEccentricityVector(part).x)
 		PARTEXT_(EccY, getEccentricityVector(part).y)
 		PARTEXT_(EccZ, getEccentricityVector(part).z)
 		case ValuePType::EccVec: {
 			const reb_vec3d ecc = getEccentricityVector(part);
-			out << "{{" << ecc.x << "|" << ecc.y << "|" << ecc.z << "}}";
+			_printVector(out, precision, ecc.x, ecc.y, ecc.z);
 			break;
 		}
 		PARTOEXT_(AngMom, h)
@@ -116,7 +186,7 @@ void _printParticleValue(LbdSimulation *sim, uint32 index, ValuePType type, Stri
 		PARTEXT_(AMZ, getAngMomVector(part).z)
 		case ValuePType::AMVec: {
 			const reb_vec3d am = getAngMomVector(part);
-			out << "{{" << am.x << "|" << am.y << "|" << am.z << "}}";
+			_printVector(out, precision, am.x, am.y, am.z);
 			break;
 		}
 		default: out << "INVALID"; break;
@@ -126,193 +196,747 @@ void _printParticleValue(LbdSimulation *sim, uint32 index, ValuePType type, Stri
 #undef PARTOEXT_
 
 #define PARTEXT_(token, value) case ValuePType::token: { vals[0] = (value); break; }
-#define PARTOEXT_(token, omember) case ValuePType::token: { \
-	reb_orbit orbit; \
-	int err = sim->getManager()->getOrbitForParticle(&part, orbit); \
-	if (err) { \
-		lerr(strfmt("Could not get the orbital value, reason: \"%s\".", orbitErrMsg[err])); \
-		throw "Orbit value get error."; \
-	} \
-	vals[0] = (orbit.omember); \
-	break; \
-}
-void _extractParticleValues(LbdSimulation *sim, ValuePType type, double *vals)
-{
-	static const auto getEccentricityVector = [sim](const reb_particle& part) -> reb_vec3d {
-		using namespace vecmath;
-		const reb_vec3d pos{part.x, part.y, part.z};
-		const reb_vec3d vel{part.vx, part.vy, part.vz};
-		const double mu = sim->getSimulation()->G * part.m;
-
-		const double c1 = (lensq(vel) / mu) - (1 / len(pos));
-		const double c2 = dot(pos, vel) / mu;
-
-		const reb_vec3d v1 = mul(pos, c1);
-		const reb_vec3d v2 = mul(vel, c2);
-		return sub(v1, v2);
+// Gets the values for all of the particles, or only the particles at the indices if they are given.
+//     Vector values are interleaved (xyzxyz...) unless componentMajor is true, in which case all of
+//     the x components come first (xx...yy...zz...). The positions and velocities are in the frame.
+void _extractParticleValues(OutputTick& tick, ValuePType type, CoordFrame cframe, double *vals, 
+	bool componentMajor = false, const uint32 *indices = nullptr, uint32 indexCount = 0)
+{
+	const reference_frame& frame = tick.getFrame();
+	const auto getEccentricityVector = [&frame](const reb_particle& part) -> reb_vec3d {
+		return _getEccentricityVector(frame, part);
 	};
-	static const auto getAngMomVector = [sim](const reb_particle& part) -> reb_vec3d {
-		using namespace vecmath;
-		const reb_vec3d pos{part.x, part.y, part.z};
-		const reb_vec3d vel{part.vx, part.vy, part.vz};
-		return cross(pos, vel);
+	const auto getAngMomVector = [&frame](const reb_particle& part) -> reb_vec3d {
+		return _getAngMomVector(frame, part);
 	};
-	
-	static const auto extractValue = [sim](const reb_particle& part, ValuePType type, double *vals) -> void {
+
+	const auto extractValue = [&frame, &getEccentricityVector, &getAngMomVector](const reb_particle& part, 
+			const reb_particle& cpart, ValuePType type, double *vals, size_t stride) -> void {
 		switch (type) {
 			PARTEXT_(Mass, part.m)
 			PARTEXT_(Radius, part.r)
-			PARTOEXT_(SMA, a)
-			PARTOEXT_(Eccen, e)
-			PARTOEXT_(Incl, inc)
-			PARTOEXT_(LAN, Omega)
-			PARTOEXT_(AP, omega)
-			PARTOEXT_(TrueAnom, f)
-			PARTOEXT_(MeanAnom, M)
-			PARTEXT_(PosX, part.x)
-			PARTEXT_(PosY, part.y)
-			PARTEXT_(PosZ, part.z)
-			PARTEXT_(VelX, part.vx)
-			PARTEXT_(VelY, part.vy)
-			PARTEXT_(VelZ, part.vz)
+			PARTEXT_(Hash, part.hash)
+			PARTEXT_(PosX, cpart.x)
+			PARTEXT_(PosY, cpart.y)
+			PARTEXT_(PosZ, cpart.z)
+			PARTEXT_(VelX, cpart.vx)
+			PARTEXT_(VelY, cpart.vy)
+			PARTEXT_(VelZ, cpart.vz)
 			PARTEXT_(AccX, part.ax)
 			PARTEXT_(AccY, part.ay)
 			PARTEXT_(AccZ, part.az)
-			PARTEXT_(Distance, sqrt(part.x * part.x + part.y * part.y + part.z * part.z))
-			PARTOEXT_(PDistance, d)
+			PARTEXT_(Distance, sqrt(cpart.x * cpart.x + cpart.y * cpart.y + cpart.z * cpart.z))
+			PARTEXT_(PDistance, _getFrameDistance(frame, part))
 			PARTEXT_(EccX, getEccentricityVector(part).x)
 			PARTEXT_(EccY, getEccentricityVector(part).y)
 			PARTEXT_(EccZ, getEccentricityVector(part).z)
 			case ValuePType::EccVec: {
 				const reb_vec3d ecc = getEccentricityVector(part);
 				vals[0] = ecc.x;
-				vals[1] = ecc.y;
-				vals[2] = ecc.z;
+				vals[stride] = ecc.y;
+				vals[2 * stride] = ecc.z;
 				break;
 			}
-			PARTOEXT_(AngMom, h)
 			PARTEXT_(AMX, getAngMomVector(part).x)
 			PARTEXT_(AMY, getAngMomVector(part).y)
 			PARTEXT_(AMZ, getAngMomVector(part).z)
 			case ValuePType::AMVec: {
 				const reb_vec3d am = getAngMomVector(part);
 				vals[0] = am.x;
-				vals[1] = am.y;
-				vals[2] = am.z;
+				vals[stride] = am.y;
+				vals[2 * stride] = am.z;
 				break;
 			}
 			default: break;
 		}
 	};
 
-	const int PCOUNT = sim->getSimulation()->N;
-	const reb_particle *PARTS = sim->getSimulation()->particles;
-	const int MULTIPLIER = (type == ValuePType::EccVec || type == ValuePType::AMVec) ? 3 : 1;
-	for (int i = 0; i < PCOUNT; ++i) {
-		extractValue(PARTS[i], type, &vals[i * MULTIPLIER]);
+	const uint32 COUNT = indices ? indexCount : tick.getParticleCount();
+	if (token_utils::IsOrbitalValue(type)) {
+		// The orbital values are already stored one array per value, so they only need to be copied
+		const orbits::orbit_batch& batch = tick.getOrbits();
+		const double *ovals = _getOrbitalArray(batch, type);
+		const int *errs = batch.err.data();
+		for (uint32 i = 0; i < COUNT; ++i) {
+			const uint32 index = indices ? indices[i] : i;
+			if (errs[index])
+				_throwOrbitError(errs[index]);
+			vals[i] = ovals[index];
+		}
+		return;
+	}
+
+	const reb_particle *PARTS = tick.getParticles();
+	const reb_particle *COORDS = tick.getCoordinates(cframe);
+	const uint32 MULTIPLIER = (componentMajor || !(type == ValuePType::EccVec || type == ValuePType::AMVec)) ? 1 : 3;
+	const size_t STRIDE = componentMajor ? COUNT : 1;
+	for (uint32 i = 0; i < COUNT; ++i) {
+		const uint32 index = indices ? indices[i] : i;
+		extractValue(PARTS[index], COORDS[index], type, &vals[i * MULTIPLIER], STRIDE);
 	}
 }
 #undef PARTEXT_
-#undef PARTOEXT_
+
+// Gets the values of the particle quantity from the tick cache, extracting them on the first use. If
+//     the subset is given, the column only has the values for the particles in the subset.
+aggregate_column& _getAggregateColumn(OutputTick& tick, ValuePType type, CoordFrame cframe, particle_subset *subset = nullptr)
+{
+	aggregate_column& column = subset ? subset->columns[token_utils::GetColumnIndex(type, cframe)] : 
+		tick.getColumn(type, cframe);
+	if (!column.valuesValid) {
+		const bool ISVEC = (type == ValuePType::EccVec || type == ValuePType::AMVec);
+		const uint32 COUNT = subset ? static_cast<uint32>(subset->indices.size()) : tick.getParticleCount();
+		column.values.resize(COUNT * (ISVEC ? 3 : 1));
+		_extractParticleValues(tick, type, cframe, column.values.data(), true, 
+			subset ? subset->indices.data() : nullptr, COUNT);
+		column.valuesValid = true;
+	}
+	return column;
+}
+
+#define FILTERTEST_(token, test) case FilterOp::token: { \
+		for (uint32 i = 0; i < count; ++i) { \
+			const uint32 index = indices[i]; \
+			const double value = values[index]; \
+			indices[kept] = index; \
+			kept += ((test) && !(errs && errs[index])) ? 1 : 0; \
+		} \
+		break; }
+// Gets the particles selected by the filter from the tick cache, evaluating the filter on the first use.
+//     Each clause compacts the index list in place, so later clauses only test the particles that
+//     passed the earlier ones. The value tests read from the (shared) aggregate columns, except for
+//     the orbital values, which are read from the orbit cache so that the particles without an orbit
+//     (such as the primary) fail the test instead of throwing.
+particle_subset& _getParticleSubset(OutputTick& tick, const ParticleFilter& filter)
+{
+	particle_subset& subset = tick.getSubset(filter.getKey());
+	if (subset.indicesValid)
+		return subset;
+
+	StlVector<uint32>& indexList = subset.indices;
+	indexList.resize(tick.getParticleCount());
+	for (uint32 i = 0; i < indexList.size(); ++i)
+		indexList[i] = i;
+
+	uint32 *indices = indexList.data();
+	uint32 count = static_cast<uint32>(indexList.size());
+	for (const auto& clause : filter.getClauses()) {
+		uint32 kept = 0;
+		if (clause.op == FilterOp::NameMatch) {
+			for (uint32 i = 0; i < count; ++i) {
+				const uint32 index = indices[i];
+				indices[kept] = index;
+				kept += ParticleFilter::MatchName(clause.pattern, tick.getParticleName(index)) ? 1 : 0;
+			}
+		}
+		else if (clause.op == FilterOp::Sample) {
+			const reb_particle *PARTS = tick.getParticles();
+			const uint64 THRESHOLD = ParticleFilter::SampleThreshold(clause.low);
+			for (uint32 i = 0; i < count; ++i) {
+				const uint32 index = indices[i];
+				indices[kept] = index;
+				kept += (ParticleFilter::SampleHash(PARTS[index].hash, clause.seed) < THRESHOLD) ? 1 : 0;
+			}
+		}
+		else {
+			const double *values = nullptr;
+			const int *errs = nullptr;
+			if (token_utils::IsOrbitalValue(clause.ptype)) {
+				const orbits::orbit_batch& batch = tick.getOrbits();
+				values = _getOrbitalArray(batch, clause.ptype);
+				errs = batch.err.data();
+			}
+			else
+				values = _getAggregateColumn(tick, clause.ptype, filter.getFrame()).values.data();
+			const double LOW = clause.low, HIGH = clause.high;
+			switch (clause.op) {
+				FILTERTEST_(Less, value < LOW)
+				FILTERTEST_(LessEqual, value <= LOW)
+				FILTERTEST_(Greater, value > LOW)
+				FILTERTEST_(GreaterEqual, value >= LOW)
+				FILTERTEST_(Equal, value == LOW)
+				FILTERTEST_(NotEqual, value != LOW)
+				FILTERTEST_(Range, (value >= LOW) && (value <= HIGH))
+				default: kept = count; break;
+			}
+		}
+		count = kept;
+	}
+
+	indexList.resize(count);
+	subset.indicesValid = true;
+	return subset;
+}
+#undef FILTERTEST_
+
+// Calculates a statistic of a particle value over all of the particles, vector values fill all three
+//     entries of the output, otherwise only the first entry is filled. All of the non-percentile 
+//     statistics for a value are calculated together, and cached in the tick (or the subset, if the
+//     statistic is only over the particles selected by a filter).
+void _calculateAggregateValue(OutputTick& tick, ValueGroup group, ValuePType type, double quantile, 
+	CoordFrame cframe, particle_subset *subset, double *result)
+{
+	const uint32 COMPONENTS = (type == ValuePType::EccVec || type == ValuePType::AMVec) ? 3 : 1;
+	aggregate_column& column = _getAggregateColumn(tick, type, cframe, subset);
+	const size_t PCOUNT = column.values.size() / COMPONENTS;
+
+	if (group == ValueGroup::Median || group == ValueGroup::Percentile) {
+		if (!column.sortedValid) {
+			column.sorted.assign(column.values.begin(), column.values.end());
+			for (uint32 c = 0; c < COMPONENTS; ++c)
+				std::sort(column.sorted.begin() + (c * PCOUNT), column.sorted.begin() + ((c + 1) * PCOUNT));
+			column.sortedValid = true;
+		}
+		const double PCT = (group == ValueGroup::Median) ? 50.0 : quantile;
+		for (uint32 c = 0; c < COMPONENTS; ++c)
+			result[c] = stats::percentile(column.sorted.data() + (c * PCOUNT), PCOUNT, PCT);
+		return;
+	}
+
+	const bool WEIGHTED = (group == ValueGroup::WeightedMean);
+	if (!column.statsValid || (WEIGHTED && !column.weighted)) {
+		const double *weights = WEIGHTED ? _getAggregateColumn(tick, ValuePType::Mass, cframe, subset).values.data() : nullptr;
+		for (uint32 c = 0; c < COMPONENTS; ++c)
+			stats::reduce(column.values.data() + (c * PCOUNT), weights, PCOUNT, column.stats[c]);
+		column.statsValid = true;
+		column.weighted = WEIGHTED;
+	}
+
+	for (uint32 c = 0; c < COMPONENTS; ++c) {
+		const stats::column_stats& cs = column.stats[c];
+		switch (group) {
+			case ValueGroup::Average: result[c] = cs.mean; break;
+			case ValueGroup::StdDev: result[c] = cs.stddev; break;
+			case ValueGroup::Min: result[c] = cs.min; break;
+			case ValueGroup::Max: result[c] = cs.max; break;
+			case ValueGroup::WeightedMean: result[c] = cs.wmean; break;
+			default: result[c] = 0; break;
+		}
+	}
+}
+
+// Writes a statistic of a particle value over all of the particles (or the particles in the subset)
+void _printAggregateValue(OutputTick& tick, ValueGroup group, ValuePType type, double quantile, 
+	CoordFrame cframe, particle_subset *subset, int precision, StringStream& out)
+{
+	double result[3];
+	_calculateAggregateValue(tick, group, type, quantile, cframe, subset, result);
+
+	if (type == ValuePType::EccVec || type == ValuePType::AMVec)
+		_printVector(out, precision, result[0], result[1], result[2]);
+	else
+		numfmt::append(out, result[0], precision);
+}
+
+// Fills the histogram bins from the tick aggregate columns (or the subset columns, if the histogram is
+//     filtered), so binning a value that is also used by an aggregate token does not extract it again
+void _calculateHistogram(OutputTick& tick, const histogram_spec& spec, CoordFrame cframe, particle_subset *subset, 
+	double *bins)
+{
+	const aggregate_column& xcol = _getAggregateColumn(tick, spec.ptypes[0], cframe, subset);
+	const double *y = (spec.dims == 2) ? _getAggregateColumn(tick, spec.ptypes[1], cframe, subset).values.data() : nullptr;
+	const double *weights = spec.weighted ? _getAggregateColumn(tick, ValuePType::Mass, cframe, subset).values.data() : nullptr;
+	stats::histogram(xcol.values.data(), y, weights, xcol.values.size(), spec.ranges[0], spec.ranges[1], bins);
+}
+
+// Writes the histogram bins in the same "{{a|b|...}}" format as the vector values
+void _printHistogram(StringStream& out, int precision, const double *bins, size_t count)
+{
+	out << "{{";
+	for (size_t i = 0; i < count; ++i) {
+		if (i > 0)
+			out << '|';
+		numfmt::append(out, bins[i], precision);
+	}
+	out << "}}";
+}
+
+// Writes the binary value of a numeric simulation value
+void _writeSimulationValue(OutputTick& tick, ValueSType type, ByteBuffer& out)
+{
+	switch (type)
+	{
+		case ValueSType::Time: out.writeDouble(tick.getTime()); break;
+		case ValueSType::Lastdt: out.writeDouble(tick.getLastdt()); break;
+		case ValueSType::PCount: out.writeUInt32(tick.getParticleCount()); break;
+		case ValueSType::Gravity: out.writeDouble(tick.getG()); break;
+		case ValueSType::TimeStep: out.writeInt64(tick.getTimestep()); break;
+		case ValueSType::WallTime: out.writeDouble(tick.getWallTime()); break;
+		case ValueSType::WallRes: out.writeDouble(Timer::GetResolution()); break;
+		default: break; // String values are rejected when the plan is checked for binary output
+	}
+}
 
 } // namespace 
 
 
-namespace format_ast
+// ================================================================================================
+plan_instruction& FormatPlan::addInstruction(PlanOp op)
 {
+	plan_instruction inst;
+	inst.op = op;
+	inst.group = ValueGroup::INVALID;
+	inst.ptype = ValuePType::INVALID;
+	inst.stype = ValueSType::INVALID;
+	inst.quantile = 0;
+	inst.arg = 0;
+	inst.filter = PLAN_NO_FILTER;
+	m_instructions.push_back(inst);
+	return m_instructions.back();
+}
 
 // ================================================================================================
-void punctuation_node::generateOutput(LbdSimulation *sim, StringStream& out)
+void FormatPlan::addLiteral(const String& str)
 {
-	out << pstring;
+	// Merge runs of literals into one, so they are written with a single instruction
+	if (m_instructions.size() && m_instructions.back().op == PlanOp::Literal) {
+		m_literals[m_instructions.back().arg] += str;
+		return;
+	}
+
+	addInstruction(PlanOp::Literal).arg = static_cast<uint32>(m_literals.size());
+	m_literals.push_back(str);
 }
 
 // ================================================================================================
-void pvalue_token_node::generateOutput(LbdSimulation *sim, StringStream& out)
+void FormatPlan::addSeparator(const String& str)
 {
-	if (valueGroup == ValueGroup::Particle)
-		_printParticleValue(sim, pIndex, valueType, out);
-	else {
-		const int PCOUNT = sim->getSimulation()->N;
-		const bool ISVEC = (valueType == ValuePType::EccVec || valueType == ValuePType::AMVec);
-		double *vals = new double[PCOUNT * (ISVEC ? 3 : 1)];
-		_extractParticleValues(sim, valueType, vals);
-
-		if (ISVEC) {
-			double sumx = 0, sumy = 0, sumz = 0;
-			for (int i = 0; i < PCOUNT; ++i) {
-				const int IDX = i * 3;
-				sumx += vals[IDX + 0];
-				sumy += vals[IDX + 1];
-				sumz += vals[IDX + 2];
-			}
-			const double MEANX = sumx / PCOUNT;
-			const double MEANY = sumy / PCOUNT;
-			const double MEANZ = sumz / PCOUNT;
-
-			if (valueGroup == ValueGroup::StdDev) {
-				sumx = sumy = sumz = 0;
-				for (int i = 0; i < PCOUNT; ++i) {
-					const int IDX = i * 3;
-					sumx += pow(vals[IDX + 0] - MEANX, 2);
-					sumy += pow(vals[IDX + 1] - MEANY, 2);
-					sumz += pow(vals[IDX + 2] - MEANZ, 2);
-				}
-				out << "{{" << sqrt(sumx / PCOUNT) << "|" << sqrt(sumy / PCOUNT) << "|" 
-					<< sqrt(sumz / PCOUNT) << "}}";
-			}
-			else
-				out << "{{" << MEANX << "|" << MEANY << "|" << MEANZ << "}}";
+	addInstruction(PlanOp::Separator).arg = static_cast<uint32>(m_literals.size());
+	m_literals.push_back(str);
+}
+
+// ================================================================================================
+void FormatPlan::addParticleValue(ValuePType type)
+{
+	addInstruction(PlanOp::ParticleValue).ptype = type;
+}
+
+// ================================================================================================
+void FormatPlan::addAggregateValue(ValueGroup group, ValuePType type, double quantile, uint32 filter)
+{
+	plan_instruction& inst = addInstruction(PlanOp::AggregateValue);
+	inst.group = group;
+	inst.ptype = type;
+	inst.quantile = quantile;
+	inst.filter = filter;
+}
+
+// ================================================================================================
+void FormatPlan::addSimValue(ValueSType type)
+{
+	addInstruction(PlanOp::SimValue).stype = type;
+}
+
+// ================================================================================================
+void FormatPlan::addHistogram(const histogram_spec& spec, uint32 filter)
+{
+	plan_instruction& inst = addInstruction(PlanOp::Histogram);
+	inst.arg = static_cast<uint32>(m_histograms.size());
+	inst.filter = filter;
+	m_histograms.push_back(spec);
+}
+
+// ================================================================================================
+uint32 FormatPlan::addFilter(const ParticleFilter& filter)
+{
+	for (uint32 i = 0; i < m_filters.size(); ++i) {
+		if (m_filters[i].getKey() == filter.getKey())
+			return i;
+	}
+
+	m_filters.push_back(filter);
+	return static_cast<uint32>(m_filters.size() - 1);
+}
+
+// ================================================================================================
+uint32 FormatPlan::beginLoop(uint32 filter)
+{
+	addInstruction(PlanOp::LoopBegin).filter = filter;
+	return static_cast<uint32>(m_instructions.size() - 1);
+}
+
+// ================================================================================================
+void FormatPlan::endLoop(uint32 begin)
+{
+	addInstruction(PlanOp::LoopEnd).arg = begin;
+	m_instructions[begin].arg = static_cast<uint32>(m_instructions.size() - 1);
+}
+
+// ================================================================================================
+void FormatPlan::setSample(double fraction, uint64 seed)
+{
+	for (auto& inst : m_instructions) {
+		if (inst.op != PlanOp::LoopBegin)
+			continue;
+
+		ParticleFilter filter = (inst.filter == PLAN_NO_FILTER) ? ParticleFilter{} : m_filters[inst.filter];
+		filter.addSample(fraction, seed);
+		filter.setFrame(m_frame);
+		inst.filter = addFilter(filter);
+	}
+}
+
+// ================================================================================================
+void FormatPlan::setFrame(CoordFrame frame)
+{
+	m_frame = frame;
+	for (auto& filter : m_filters)
+		filter.setFrame(frame);
+}
+
+// ================================================================================================
+void FormatPlan::clear()
+{
+	m_instructions.clear();
+	m_literals.clear();
+	m_filters.clear();
+	m_histograms.clear();
+}
+
+// ================================================================================================
+bool FormatPlan::hasParticleValue(ValuePType type) const
+{
+	for (const auto& inst : m_instructions) {
+		if (inst.op == PlanOp::ParticleValue && inst.ptype == type)
+			return true;
+	}
+	return false;
+}
+
+// ================================================================================================
+bool FormatPlan::usesParticleNames() const
+{
+	for (const auto& filter : m_filters) {
+		if (filter.usesNames())
+			return true;
+	}
+	return hasParticleValue(ValuePType::Name);
+}
+
+// ================================================================================================
+inline void FormatPlan::executeValue(OutputTick& tick, const plan_instruction& inst, uint32 index, bool last, 
+	StringStream& out) const
+{
+	switch (inst.op) {
+		case PlanOp::Literal: out << m_literals[inst.arg]; break;
+		case PlanOp::Separator: {
+			if (!last)
+				out << m_literals[inst.arg];
+			break;
 		}
-		else {
-			double sum = std::accumulate(&(vals[0]), &(vals[PCOUNT]), 0.0);
-			const double MEAN = sum / PCOUNT;
+		case PlanOp::ParticleValue: _printParticleValue(tick, index, inst.ptype, m_frame, m_precision, out); break;
+		case PlanOp::AggregateValue: {
+			particle_subset *subset = (inst.filter == PLAN_NO_FILTER) ? nullptr : 
+				&_getParticleSubset(tick, m_filters[inst.filter]);
+			_printAggregateValue(tick, inst.group, inst.ptype, inst.quantile, m_frame, subset, m_precision, out);
+			break;
+		}
+		case PlanOp::SimValue: _printSimulationValue(tick, inst.stype, m_precision, out); break;
+		case PlanOp::Histogram: {
+			particle_subset *subset = (inst.filter == PLAN_NO_FILTER) ? nullptr : 
+				&_getParticleSubset(tick, m_filters[inst.filter]);
+			const histogram_spec& spec = m_histograms[inst.arg];
+			m_columnBuffer.resize(spec.getBinCount());
+			_calculateHistogram(tick, spec, m_frame, subset, m_columnBuffer.data());
+			_printHistogram(out, m_precision, m_columnBuffer.data(), m_columnBuffer.size());
+			break;
+		}
+		default: break; // Loops are run by executeLoop()
+	}
+}
 
-			if (valueGroup == ValueGroup::StdDev) {
-				sum = 0;
-				for (int i = 0; i < PCOUNT; ++i) {
-					sum += pow(vals[i] - MEAN, 2);
-				}
-				out << sqrt(sum / PCOUNT);
-			}
-			else
-				out << MEAN;
+// ================================================================================================
+void FormatPlan::execute(OutputTick& tick, StringStream& out) const
+{
+	const plan_instruction *INSTS = m_instructions.data();
+	const size_t ICOUNT = m_instructions.size();
+
+	for (size_t ip = 0; ip < ICOUNT; ++ip) {
+		const plan_instruction& inst = INSTS[ip];
+		if (inst.op == PlanOp::LoopBegin) {
+			executeLoop(tick, ip, out);
+			ip = inst.arg; // Skip to the LoopEnd, which is then stepped past
+		}
+		else
+			executeValue(tick, inst, 0, true, out);
+	}
+}
+
+// ================================================================================================
+void FormatPlan::executeLoop(OutputTick& tick, size_t begin, StringStream& out) const
+{
+	// Loops over filtered lists go through the subset indices, otherwise the loop index is the particle index
+	const plan_instruction& loop = m_instructions[begin];
+	const uint32 *indices = nullptr;
+	uint32 count = tick.getParticleCount();
+	if (loop.filter != PLAN_NO_FILTER) {
+		const particle_subset& subset = _getParticleSubset(tick, m_filters[loop.filter]);
+		indices = subset.indices.data();
+		count = static_cast<uint32>(subset.indices.size());
+	}
+	if (count == 0)
+		return;
+
+#ifdef _OPENMP
+	const int THREADS = omp_get_max_threads();
+	if ((count >= PLAN_PARALLEL_LOOP_SIZE) && (THREADS > 1) && prepareParallelLoop(tick, begin)) {
+		// Each thread formats a contiguous chunk of the particles into its own buffer, and then the buffers are
+		//     written in order, which gives exactly the same text as formatting the particles one at a time
+		if (m_chunkBuffers.size() < static_cast<size_t>(THREADS))
+			m_chunkBuffers.resize(THREADS);
+		#pragma omp parallel num_threads(THREADS)
+		{
+			const int TID = omp_get_thread_num();
+			const int TCOUNT = omp_get_num_threads();
+			const uint32 FIRST = static_cast<uint32>((static_cast<uint64>(count) * TID) / TCOUNT);
+			const uint32 LAST = static_cast<uint32>((static_cast<uint64>(count) * (TID + 1)) / TCOUNT);
+			StringStream& chunk = m_chunkBuffers[TID];
+			chunk.str("");
+			chunk.clear();
+			executeLoopRange(tick, begin, indices, count, FIRST, LAST, chunk);
+		}
+		// The chunks are streamed straight from their buffers, instead of being copied out with str() first
+		for (int t = 0; t < THREADS; ++t) {
+			if (m_chunkBuffers[t].tellp() > 0)
+				out << m_chunkBuffers[t].rdbuf();
 		}
+		return;
+	}
+#endif
+
+	executeLoopRange(tick, begin, indices, count, 0, count, out);
+}
 
-		delete vals;
+// ================================================================================================
+bool FormatPlan::prepareParallelLoop(OutputTick& tick, size_t begin) const
+{
+	// Histograms write their bins into the shared column buffer. The parser does not allow them in lists, but
+	//     the plan itself does, so those loops are kept on one thread.
+	const size_t BODY_END = m_instructions[begin].arg;
+	for (size_t ip = begin + 1; ip < BODY_END; ++ip) {
+		if (m_instructions[ip].op == PlanOp::Histogram)
+			return false;
 	}
+
+	// The tick calculates its cached values the first time they are used, which is not thread safe, so
+	//     everything that the loop body reads is calculated before the threads start
+	tick.getFrame();
+	tick.getCoordinates(m_frame);
+	for (size_t ip = begin + 1; ip < BODY_END; ++ip) {
+		const plan_instruction& inst = m_instructions[ip];
+		if (inst.op == PlanOp::ParticleValue && token_utils::IsOrbitalValue(inst.ptype))
+			tick.getOrbits();
+		else if (inst.op == PlanOp::AggregateValue) {
+			particle_subset *subset = (inst.filter == PLAN_NO_FILTER) ? nullptr : 
+				&_getParticleSubset(tick, m_filters[inst.filter]);
+			double result[3];
+			_calculateAggregateValue(tick, inst.group, inst.ptype, inst.quantile, m_frame, subset, result);
+		}
+	}
+	return true;
 }
 
 // ================================================================================================
-void svalue_token_node::generateOutput(LbdSimulation *sim, StringStream& out)
+void FormatPlan::executeLoopRange(OutputTick& tick, size_t begin, const uint32 *indices, uint32 count, 
+	uint32 first, uint32 last, StringStream& out) const
 {
-	_printSimulationValue(sim, valueType, out);
+	const plan_instruction *INSTS = m_instructions.data();
+	const size_t BODY_BEGIN = begin + 1;
+	const size_t BODY_END = INSTS[begin].arg; // The LoopEnd
+
+	for (uint32 li = first; li < last; ++li) {
+		const uint32 index = indices ? indices[li] : li;
+		const bool LAST = ((li + 1) == count);
+		for (size_t ip = BODY_BEGIN; ip < BODY_END; ++ip)
+			executeValue(tick, INSTS[ip], index, LAST, out);
+	}
 }
 
+
 // ================================================================================================
-void list_node::generateOutput(LbdSimulation *sim, StringStream& out)
+bool FormatPlan::checkBinary() const
 {
-	const int pCount = sim->getSimulation()->N;
+	for (const auto& inst : m_instructions) {
+		bool isString = false;
+		if (inst.op == PlanOp::SimValue)
+			isString = (token_utils::GetSValueDataType(inst.stype) == ValueDataType::String);
+		else if (inst.op == PlanOp::ParticleValue)
+			isString = (token_utils::GetPValueDataType(inst.ptype) == ValueDataType::String);
 
-	StringStream listss;
-	for (int i = 0; i < pCount; ++i) {
-		for (auto& node : nodeList) {
-			node->pIndex = static_cast<uint32>(i);
-			node->generateOutput(sim, listss);
+		if (isString) {
+			lerr(strfmt("The %s value cannot be written to binary output, because it is a string.",
+				(inst.op == PlanOp::SimValue) ? token_utils::ValueSTypeToString(inst.stype).c_str() :
+				token_utils::ValuePTypeToString(inst.ptype).c_str()));
+			return false;
 		}
 	}
 
-	String liststr = listss.str();
-	if (last) { // Trim the last punctuation token if necessary
-		base_node *node = nodeList.at(nodeList.size() - 1).get();
-		punctuation_node *pnode = nullptr;
-		if ((pnode = dynamic_cast<punctuation_node*>(node)) != nullptr) {
-			size_t len = pnode->pstring.length();
-			liststr.erase(liststr.size() - len);
+	return true;
+}
+
+// ================================================================================================
+void FormatPlan::describeBinary(ByteBuffer& out) const
+{
+	uint32 columnCount = 0;
+	for (const auto& inst : m_instructions) {
+		if (inst.op == PlanOp::SimValue || inst.op == PlanOp::ParticleValue || inst.op == PlanOp::AggregateValue ||
+				inst.op == PlanOp::Histogram)
+			++columnCount;
+	}
+	out.writeUInt32(columnCount);
+
+	// Each column is described by four bytes: data type, component count, list index, reserved
+	uint8 listIndex = BINARY_NO_LIST;
+	uint8 listCount = 0;
+	uint8 listFlags = 0;
+	for (const auto& inst : m_instructions) {
+		switch (inst.op) {
+			case PlanOp::SimValue: {
+				out.writeUInt8(static_cast<uint8>(token_utils::GetSValueDataType(inst.stype)));
+				out.writeUInt8(1);
+				out.writeUInt8(BINARY_NO_LIST);
+				out.writeUInt8(0);
+				break;
+			}
+			case PlanOp::ParticleValue:
+			case PlanOp::AggregateValue: {
+				const bool ISVEC = (inst.ptype == ValuePType::EccVec || inst.ptype == ValuePType::AMVec);
+				out.writeUInt8(static_cast<uint8>(token_utils::GetPValueDataType(inst.ptype)));
+				out.writeUInt8(ISVEC ? 3 : 1);
+				out.writeUInt8((inst.op == PlanOp::ParticleValue) ? listIndex : BINARY_NO_LIST);
+				out.writeUInt8((inst.op == PlanOp::ParticleValue) ? listFlags : 0);
+				break;
+			}
+			case PlanOp::Histogram: {
+				out.writeUInt8(static_cast<uint8>(ValueDataType::Double));
+				out.writeUInt8(BINARY_WIDE_COLUMN);
+				out.writeUInt8(BINARY_NO_LIST);
+				out.writeUInt8(0);
+				out.writeUInt32(m_histograms[inst.arg].getBinCount());
+				break;
+			}
+			case PlanOp::LoopBegin: {
+				listIndex = listCount++;
+				listFlags = (inst.filter == PLAN_NO_FILTER) ? 0 : BINARY_FILTERED_LIST;
+				break;
+			}
+			case PlanOp::LoopEnd: listIndex = BINARY_NO_LIST; break;
+			default: break;
 		}
 	}
+}
+
+// ================================================================================================
+void FormatPlan::executeBinary(OutputTick& tick, ByteBuffer& out) const
+{
+	const uint32 PCOUNT = tick.getParticleCount();
+	const size_t ICOUNT = m_instructions.size();
 
-	out << liststr;
+	out.writeUInt32(PCOUNT);
+	for (size_t ip = 0; ip < ICOUNT; ++ip) {
+		const plan_instruction& inst = m_instructions[ip];
+		switch (inst.op) {
+			case PlanOp::SimValue: _writeSimulationValue(tick, inst.stype, out); break;
+			case PlanOp::AggregateValue: {
+				particle_subset *subset = (inst.filter == PLAN_NO_FILTER) ? nullptr : 
+					&_getParticleSubset(tick, m_filters[inst.filter]);
+				double result[3];
+				_calculateAggregateValue(tick, inst.group, inst.ptype, inst.quantile, m_frame, subset, result);
+				const bool ISVEC = (inst.ptype == ValuePType::EccVec || inst.ptype == ValuePType::AMVec);
+				out.writeDoubles(result, ISVEC ? 3 : 1);
+				break;
+			}
+			case PlanOp::Histogram: {
+				particle_subset *subset = (inst.filter == PLAN_NO_FILTER) ? nullptr : 
+					&_getParticleSubset(tick, m_filters[inst.filter]);
+				const histogram_spec& spec = m_histograms[inst.arg];
+				m_columnBuffer.resize(spec.getBinCount());
+				_calculateHistogram(tick, spec, m_frame, subset, m_columnBuffer.data());
+				out.writeDoubles(m_columnBuffer.data(), m_columnBuffer.size());
+				break;
+			}
+			case PlanOp::LoopBegin: {
+				// Lists are written one whole column at a time, instead of one particle at a time. Filtered
+				//     lists write their particle count before their first column.
+				const uint32 *indices = nullptr;
+				uint32 count = PCOUNT;
+				if (inst.filter != PLAN_NO_FILTER) {
+					const particle_subset& subset = _getParticleSubset(tick, m_filters[inst.filter]);
+					indices = subset.indices.data();
+					count = static_cast<uint32>(subset.indices.size());
+				}
+
+				bool firstColumn = true;
+				for (size_t lp = ip + 1; lp < inst.arg; ++lp) {
+					const plan_instruction& linst = m_instructions[lp];
+					if (linst.op != PlanOp::ParticleValue)
+						continue;
+					if (firstColumn && indices)
+						out.writeUInt32(count);
+					firstColumn = false;
+
+					const bool ISVEC = (linst.ptype == ValuePType::EccVec || linst.ptype == ValuePType::AMVec);
+					const size_t VCOUNT = count * (ISVEC ? 3 : 1);
+					m_columnBuffer.resize(VCOUNT);
+					_extractParticleValues(tick, linst.ptype, m_frame, m_columnBuffer.data(), false, indices, count);
+					if (token_utils::GetPValueDataType(linst.ptype) == ValueDataType::Int)
+						out.writeDoublesAsUInt32(m_columnBuffer.data(), VCOUNT);
+					else
+						out.writeDoubles(m_columnBuffer.data(), VCOUNT);
+				}
+				ip = inst.arg; // Skip to the LoopEnd
+				break;
+			}
+			default: break; // Literals are not written to binary output
+		}
+	}
+}
+
+
+namespace format_ast
+{
+
+// ================================================================================================
+void punctuation_node::lower(FormatPlan& plan) const
+{
+	plan.addLiteral(pstring);
+}
+
+// ================================================================================================
+void pvalue_token_node::lower(FormatPlan& plan) const
+{
+	if (valueGroup == ValueGroup::Particle)
+		plan.addParticleValue(valueType);
+	else
+		plan.addAggregateValue(valueGroup, valueType, quantile, filter.empty() ? PLAN_NO_FILTER : plan.addFilter(filter));
+}
+
+// ================================================================================================
+void svalue_token_node::lower(FormatPlan& plan) const
+{
+	plan.addSimValue(valueType);
+}
+
+// ================================================================================================
+void histogram_token_node::lower(FormatPlan& plan) const
+{
+	plan.addHistogram(spec, filter.empty() ? PLAN_NO_FILTER : plan.addFilter(filter));
+}
+
+// ================================================================================================
+void list_node::lower(FormatPlan& plan) const
+{
+	const uint32 begin = plan.beginLoop(filter.empty() ? PLAN_NO_FILTER : plan.addFilter(filter));
+	for (size_t i = 0; i < count; ++i) {
+		const base_node *node = nodeList[i].get();
+		
+		// The trailing punctuation of the last list is only written between particles, not after them
+		if (last && (i == (count - 1)) && (node->tokenType == TokenType::Punctuation))
+			plan.addSeparator(static_cast<const punctuation_node*>(node)->pstring);
+		else
+			node->lower(plan);
+	}
+	plan.endLoop(begin);
 }
 
 } // namespace format_ast
@@ -329,6 +953,11 @@ ValueGroup StringToValueGroup(const String& str)
 	else STRVG_("d", StdDev)
 	else STRVG_("p", Particle)
 	else STRVG_("s", Simulation)
+	else STRVG_("n", Min)
+	else STRVG_("x", Max)
+	else STRVG_("m", Median)
+	else STRVG_("w", WeightedMean)
+	else if ((str.length() > 1) && (str[0] == 'q')) { return ValueGroup::Percentile; } // The number is checked by the parser
 	else return ValueGroup::INVALID;
 }
 #undef STRVG_
@@ -411,6 +1040,11 @@ String ValueGroupToString(ValueGroup grp)
 		VGSTR_(StdDev, "Global Standard Deviation")
 		VGSTR_(Particle, "Particle")
 		VGSTR_(Simulation, "Simulation")
+		VGSTR_(Min, "Global Minimum")
+		VGSTR_(Max, "Global Maximum")
+		VGSTR_(Median, "Global Median")
+		VGSTR_(Percentile, "Global Percentile")
+		VGSTR_(WeightedMean, "Global Mass-Weighted Average")
 		default: return "INVALID";
 	}
 }
@@ -476,6 +1110,34 @@ String ValueSTypeToString(ValueSType type)
 }
 #undef VSTSTR_
 
+// ================================================================================================
+#define STRCF_(name, token) if (str == name) { return CoordFrame::token; }
+CoordFrame StringToCoordFrame(const String& str)
+{
+	STRCF_("inertial", Inertial)
+	else STRCF_("barycentric", Barycentric)
+	else STRCF_("heliocentric", Heliocentric)
+	else STRCF_("jacobi", Jacobi)
+	else STRCF_("democratic", Democratic)
+	else return CoordFrame::INVALID;
+}
+#undef STRCF_
+
+// ================================================================================================
+#define CFSTR_(token, name) case CoordFrame::token: return name;
+String CoordFrameToString(CoordFrame frame)
+{
+	switch (frame) {
+		CFSTR_(Inertial, "inertial")
+		CFSTR_(Barycentric, "barycentric")
+		CFSTR_(Heliocentric, "heliocentric")
+		CFSTR_(Jacobi, "jacobi")
+		CFSTR_(Democratic, "democratic")
+		default: return "INVALID";
+	}
+}
+#undef CFSTR_
+
 // ================================================================================================
 ValueDataType GetSValueDataType(ValueSType type)
 {
@@ -507,4 +1169,50 @@ ValueDataType GetPValueDataType(ValuePType type)
 	}
 }
 
+// ================================================================================================
+bool IsOrbitalValue(ValuePType type)
+{
+	switch (type) {
+		case ValuePType::SMA:
+		case ValuePType::Eccen:
+		case ValuePType::Incl:
+		case ValuePType::LAN:
+		case ValuePType::AP:
+		case ValuePType::TrueAnom:
+		case ValuePType::MeanAnom:
+		case ValuePType::AngMom:
+			return true;
+		default:
+			return false;
+	}
+}
+
+// ================================================================================================
+bool IsFrameValue(ValuePType type)
+{
+	return ((type >= ValuePType::PosX) && (type <= ValuePType::VelZ)) || (type == ValuePType::Distance);
+}
+
+// ================================================================================================
+size_t GetColumnIndex(ValuePType type, CoordFrame frame)
+{
+	// The frame columns come after the inertial columns, in the order PosX-VelZ, Distance for each frame
+	if (frame == CoordFrame::Inertial || !IsFrameValue(type))
+		return static_cast<size_t>(type);
+	const size_t slot = (type == ValuePType::Distance) ? 6 : (static_cast<size_t>(type) - static_cast<size_t>(ValuePType::PosX));
+	return static_cast<size_t>(ValuePType::INVALID) + ((static_cast<size_t>(frame) - 1) * FRAME_VALUE_COUNT) + slot;
+}
+
+// ================================================================================================
+bool IsAggregateGroup(ValueGroup grp)
+{
+	return (grp != ValueGroup::Particle) && (grp != ValueGroup::Simulation) && (grp != ValueGroup::INVALID);
+}
+
+// ================================================================================================
+const StlVector<uint32>& SelectParticles(OutputTick& tick, const ParticleFilter& filter)
+{
+	return _getParticleSubset(tick, filter).indices;
+}
+
 } // namespace token_utils
\ No newline at end of file
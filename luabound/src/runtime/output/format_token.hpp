@@ -12,6 +12,9 @@
 #define FORMAT_TOKEN_HPP_
 
 #include "../../luabound.hpp"
+#include "../../util/number_format.hpp"
+#include "../../util/stats.hpp"
+#include "particle_filter.hpp"
 
 class OutputFormat;
 
@@ -25,14 +28,19 @@ enum class TokenType :
 	INVALID
 };
 
-// The type of the value token (global average, global std.dev., particle, or simulation)
+// The type of the value token (a global statistic over all particles, particle, or simulation)
 enum class ValueGroup :
 	uint8
 {
-	Average,
-	StdDev,
-	Particle,
-	Simulation,
+	Average,      // Global average (a)
+	StdDev,       // Global standard deviation (d)
+	Particle,     // Individual particle (p)
+	Simulation,   // Simulation (s)
+	Min,          // Global minimum (n)
+	Max,          // Global maximum (x)
+	Median,       // Global median (m)
+	Percentile,   // Global percentile, with the percentile given after the q (q<number>)
+	WeightedMean, // Global mass-weighted average (w)
 	INVALID
 };
 
@@ -90,6 +98,27 @@ enum class ValueSType :
 	INVALID
 };
 
+// The coordinate frame that the position and velocity values are written in, which is set for each output
+//     file. The heliocentric, Jacobi, and democratic heliocentric frames use the first particle as the
+//     central body, like the rebound integrators that use them.
+enum class CoordFrame :
+	uint8
+{
+	Inertial,     // The simulation coordinates (inertial)
+	Barycentric,  // Relative to the center of mass (barycentric)
+	Heliocentric, // Relative to the first particle (heliocentric)
+	Jacobi,       // Relative to the center of mass of the particles before each one (jacobi)
+	Democratic,   // Heliocentric positions and barycentric velocities (democratic)
+	INVALID
+};
+
+// The particle values that change with the coordinate frame
+#define FRAME_VALUE_COUNT (7)
+// The number of aggregate columns, which is one for each particle value, plus one for each frame value
+//     in each frame besides the inertial frame
+#define AGGREGATE_COLUMN_COUNT (static_cast<size_t>(ValuePType::INVALID) + \
+	((static_cast<size_t>(CoordFrame::INVALID) - 1) * FRAME_VALUE_COUNT))
+
 // The data type that the token represents
 enum class ValueDataType :
 	uint8
@@ -101,8 +130,147 @@ enum class ValueDataType :
 };
 
 
-// Forward declaration of LbdSimulation class
+// Forward declaration of LbdSimulation, OutputTick, and ByteBuffer classes
 class LbdSimulation;
+class OutputTick;
+class ByteBuffer;
+
+
+// The operations that make up a compiled format plan
+enum class PlanOp :
+	uint8
+{
+	Literal,        // Write a literal string
+	Separator,      // Write a literal string, unless on the last particle of a loop
+	ParticleValue,  // Write a value for the current loop particle
+	AggregateValue, // Write a statistic over all of the particles
+	SimValue,       // Write a simulation value
+	Histogram,      // Write the bins of a histogram over the particles
+	LoopBegin,      // Loop the instructions up to the matching LoopEnd over the (filtered) particles
+	LoopEnd         // The end of the loop body
+};
+
+// A single instruction in a compiled format plan
+struct plan_instruction
+{
+	PlanOp op;
+	ValueGroup group; // Only used by AggregateValue
+	ValuePType ptype; // Only used by ParticleValue and AggregateValue
+	ValueSType stype; // Only used by SimValue
+	double quantile; // The percentile (0 to 100), only used by AggregateValue with the Percentile group
+	uint32 arg; // The literal index for Literal and Separator, the histogram index for Histogram, or the jump
+	            //     target for LoopBegin and LoopEnd
+	uint32 filter; // The particle filter index for LoopBegin, AggregateValue, and Histogram, or PLAN_NO_FILTER
+};
+
+// The filter index for instructions that use all of the particles
+#define PLAN_NO_FILTER (0xFFFFFFFF)
+// The number of particles needed before a text list is split between threads, when built with OpenMP
+#define PLAN_PARALLEL_LOOP_SIZE (4096)
+
+// The most bins along one axis of a histogram
+#define HISTOGRAM_MAX_BINS (65536)
+
+// A histogram of one or two particle values over evenly spaced bins, written as a single vector value
+//     of all of the bins (row-major for two values). Only scalar particle values can be binned.
+struct histogram_spec
+{
+	uint32 dims; // The number of values (1 or 2)
+	ValuePType ptypes[2];
+	stats::bin_range ranges[2];
+	bool weighted; // If the bins are the total particle mass, instead of the particle count
+
+	inline uint32 getBinCount() const { return ranges[0].bins * ((dims == 2) ? ranges[1].bins : 1); }
+};
+
+// The list index written for binary columns that are not part of a list
+#define BINARY_NO_LIST (0xFF)
+// The binary column flag for list columns whose list is filtered, these lists write their own count
+#define BINARY_FILTERED_LIST (0x01)
+// The binary column component count for columns with more than 255 components (histograms), which is
+//     followed by the real component count as a uint32
+#define BINARY_WIDE_COLUMN (0)
+
+// A format string that has been lowered from its parsed tree into a flat list of instructions, which
+//     is run by switch-dispatched loops instead of walking the tree for every particle. All of the
+//     decisions that can be made when the format is loaded (such as trimming trailing list 
+//     punctuation) are baked into the instructions. Large text lists are formatted in chunks on
+//     multiple threads when built with OpenMP.
+class FormatPlan
+{
+public:
+	using InstructionList = StlVector<plan_instruction>;
+
+private:
+	InstructionList m_instructions;
+	StlVector<String> m_literals;
+	StlVector<ParticleFilter> m_filters;
+	StlVector<histogram_spec> m_histograms;
+	mutable StlVector<double> m_columnBuffer; // Reused between outputs to hold a list column or histogram bins
+	mutable StlVector<StringStream> m_chunkBuffers; // Reused between outputs to hold the text of each thread
+	int m_precision; // The significant digits for text values, or NUMFMT_ROUNDTRIP
+	CoordFrame m_frame;
+
+public:
+	FormatPlan() : m_precision{NUMFMT_ROUNDTRIP}, m_frame{CoordFrame::Inertial} { }
+	~FormatPlan() { }
+
+	LUABOUND_DECLARE_CLASS_NONCOPYABLE(FormatPlan)
+
+	inline const InstructionList& getInstructions() const { return m_instructions; }
+
+	void addLiteral(const String& str);
+	void addSeparator(const String& str);
+	void addParticleValue(ValuePType type);
+	void addAggregateValue(ValueGroup group, ValuePType type, double quantile, uint32 filter = PLAN_NO_FILTER);
+	void addSimValue(ValueSType type);
+	void addHistogram(const histogram_spec& spec, uint32 filter = PLAN_NO_FILTER);
+	// Returns the index to pass to the instructions that use the filter, filters with the same text share an index
+	uint32 addFilter(const ParticleFilter& filter);
+	// Returns the index of the LoopBegin instruction, to pass to endLoop()
+	uint32 beginLoop(uint32 filter = PLAN_NO_FILTER);
+	void endLoop(uint32 begin);
+
+	void clear();
+
+	inline int getPrecision() const { return m_precision; }
+	inline void setPrecision(int precision) { m_precision = precision; }
+	// Makes every list only loop over a stable random sample of the particles (on top of any list filter),
+	//     the aggregate values and histograms are still over all of the particles
+	void setSample(double fraction, uint64 seed);
+	inline CoordFrame getFrame() const { return m_frame; }
+	// Sets the frame of the position and velocity values, including the ones tested by the filters
+	void setFrame(CoordFrame frame);
+
+	// Gets if the plan writes the particle value type for individual particles
+	bool hasParticleValue(ValuePType type) const;
+	// Gets if the plan needs the particle names, either to write them or to filter by them
+	bool usesParticleNames() const;
+
+	void execute(OutputTick& tick, StringStream& out) const;
+
+	// Binary output writes each list as one contiguous column per value token, instead of one row per
+	//     particle, and skips all punctuation. String values cannot be written as binary.
+	bool checkBinary() const;
+	void describeBinary(ByteBuffer& out) const;
+	void executeBinary(OutputTick& tick, ByteBuffer& out) const;
+
+private:
+	plan_instruction& addInstruction(PlanOp op);
+
+	// Writes a single instruction that is not part of the loop control, for the particle at the index (if
+	//     the instruction is in a loop), where last is true if it is the last particle of the loop
+	void executeValue(OutputTick& tick, const plan_instruction& inst, uint32 index, bool last, StringStream& out) const;
+	// Writes the loop that starts at the LoopBegin instruction, splitting large loops between threads
+	void executeLoop(OutputTick& tick, size_t begin, StringStream& out) const;
+	// Calculates the cached tick values that the loop body reads, so that the threads only read from the tick.
+	//     Returns false if the loop has to be run on one thread.
+	bool prepareParallelLoop(OutputTick& tick, size_t begin) const;
+	// Writes the loop body for the loop indices [first, last) out of the count, mapped through the indices if
+	//     they are given
+	void executeLoopRange(OutputTick& tick, size_t begin, const uint32 *indices, uint32 count, uint32 first, 
+		uint32 last, StringStream& out) const;
+};
 
 namespace format_ast
 {
@@ -110,14 +278,16 @@ namespace format_ast
 struct base_node
 {
 public:
-	uint32 pIndex; // Only used by pvalue nodes, but defined here for speed
+	const TokenType tokenType;
 
 public:
-	base_node() :
-		pIndex{0}
+	base_node(TokenType type) :
+		tokenType{type}
 	{ }
+	virtual ~base_node() { }
 
-	virtual void generateOutput(LbdSimulation *sim, StringStream& out) = 0;
+	// Appends the instructions for this node to the end of the plan
+	virtual void lower(FormatPlan& plan) const = 0;
 };
 
 struct punctuation_node :
@@ -128,10 +298,10 @@ public:
 
 public:
 	punctuation_node(const String& pstr) :
-		pstring{pstr}
+		base_node(TokenType::Punctuation), pstring{pstr}
 	{ }
 
-	void generateOutput(LbdSimulation *sim, StringStream& out) override;
+	void lower(FormatPlan& plan) const override;
 };
 
 struct pvalue_token_node :
@@ -140,13 +310,15 @@ struct pvalue_token_node :
 public:
 	const ValueGroup valueGroup;
 	const ValuePType valueType;
+	const double quantile; // Only used by the Percentile group
+	const ParticleFilter filter; // Only used by the aggregate groups
 
 public:
-	pvalue_token_node(ValueGroup vg, ValuePType vt) :
-		valueGroup{vg}, valueType{vt}
+	pvalue_token_node(ValueGroup vg, ValuePType vt, double q = 0, const ParticleFilter& f = ParticleFilter{}) :
+		base_node(TokenType::ValueToken), valueGroup{vg}, valueType{vt}, quantile{q}, filter{f}
 	{ }
 
-	void generateOutput(LbdSimulation *sim, StringStream& out) override;
+	void lower(FormatPlan& plan) const override;
 };
 
 struct svalue_token_node :
@@ -157,10 +329,25 @@ public:
 
 public:
 	svalue_token_node(ValueSType vt) :
-		valueType{vt}
+		base_node(TokenType::ValueToken), valueType{vt}
 	{ }
 
-	void generateOutput(LbdSimulation *sim, StringStream& out) override;
+	void lower(FormatPlan& plan) const override;
+};
+
+struct histogram_token_node :
+	base_node
+{
+public:
+	const histogram_spec spec;
+	const ParticleFilter filter;
+
+public:
+	histogram_token_node(const histogram_spec& hs, const ParticleFilter& f = ParticleFilter{}) :
+		base_node(TokenType::ValueToken), spec(hs), filter{f}
+	{ }
+
+	void lower(FormatPlan& plan) const override;
 };
 
 struct list_node :
@@ -173,13 +360,15 @@ public:
 	const node_list nodeList;
 	const size_t count;
 	const bool last; // If this is true, the trailing punctuation will be cut out of the last list item
+	const ParticleFilter filter; // The particles to loop over, all of them if the filter is empty
 
 public:
-	list_node(node_ptr_list& list, bool lastn) :
-		nodeList(std::move(constructVector(list))), count(list.size()), last{lastn}
+	list_node(node_ptr_list& list, bool lastn, const ParticleFilter& f = ParticleFilter{}) :
+		base_node(TokenType::ListSpecifier), nodeList(std::move(constructVector(list))), count(list.size()), 
+		last{lastn}, filter{f}
 	{ }
 
-	void generateOutput(LbdSimulation *sim, StringStream& out) override;
+	void lower(FormatPlan& plan) const override;
 
 private:
 	static node_list constructVector(node_ptr_list& list)
@@ -205,10 +394,25 @@ extern String TokenTypeToString(TokenType type);
 extern String ValueGroupToString(ValueGroup grp);
 extern String ValuePTypeToString(ValuePType type);
 extern String ValueSTypeToString(ValueSType type);
+extern CoordFrame StringToCoordFrame(const String& str);
+extern String CoordFrameToString(CoordFrame frame);
 
 extern ValueDataType GetSValueDataType(ValueSType type);
 extern ValueDataType GetPValueDataType(ValuePType type);
 
+// Gets if the value is calculated from the particle orbit
+extern bool IsOrbitalValue(ValuePType type);
+// Gets if the value changes with the coordinate frame
+extern bool IsFrameValue(ValuePType type);
+// Gets the index of the aggregate column for the value in the frame
+extern size_t GetColumnIndex(ValuePType type, CoordFrame frame);
+// Gets if the group is a statistic calculated over all of the particles
+extern bool IsAggregateGroup(ValueGroup grp);
+
+// Gets the indices of the particles that pass the filter, which are cached in the tick and shared with
+//     any format tokens that use a filter with the same text
+extern const StlVector<uint32>& SelectParticles(OutputTick& tick, const ParticleFilter& filter);
+
 } // namespace token_utils
 
 #endif // FORMAT_TOKEN_HPP_
\ No newline at end of file
@@ -11,79 +11,430 @@
 #include "output_manager.hpp"
 #include "../simulation.hpp"
 #include "../../util/clock.hpp"
+#include <algorithm>
+
+
+namespace
+{
+
+// Gets how close the simulation time has to be to an output time to count as reaching it, which
+//     covers the rounding in t + dt when the timestep was shortened to land on the output time
+inline double _getTimeTolerance(double time, double interval)
+{
+	return 1e-12 * std::max(fabs(time), interval);
+}
+
+// Reads a little-endian uint32 from the bytes
+inline uint32 _readUInt32(const uint8 *bytes)
+{
+	return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32>(bytes[3]) << 24);
+}
+
+} // namespace
 
 
 // ================================================================================================
-OutputFile::OutputFile(LbdSimulation *sim, const String& file, double time) :
+OutputFile::OutputFile(LbdSimulation *sim, const String& file, double time, bool binary) :
 	m_sim{sim},
 	m_format{nullptr},
 	m_fileName{file},
 	m_formatString{""},
 	m_time{time},
-	m_lastOutTime{0},
-	m_fileHandle{nullptr},
+	m_startTime{0},
+	m_outputCount{0},
+	m_fileSink{nullptr},
+	m_indexSink{nullptr},
+	m_indexed{false},
+	m_fileOffset{0},
 	m_firstRun{true},
-	m_isStdOut{file.find("stdout") == 0}
+	m_isStdOut{file.find("stdout") == 0},
+	m_isShm{file.find(SHM_OUTPUT_PREFIX) == 0},
+	m_isBinary{binary},
+	m_binaryBuffer{},
+	m_textStream{""},
+	m_indexBuffer{},
+	m_keyframe{0},
+	m_mantissaBits{0},
+	m_columns{},
+	m_encoder{},
+	m_blockBits{},
+	m_blockRecords{0},
+	m_blockOffset{0},
+	m_trigger{},
+	m_ring{},
+	m_shmSize{static_cast<uint64>(SHM_DEFAULT_SIZE) << 20},
+	m_flushPolicy{binary ? FlushPolicy::Close : FlushPolicy::Tick},
+	m_flushInterval{0},
+	m_syncFlush{false},
+	m_flushTimer{},
+	m_unflushed{false}
 {
 	m_format = new OutputFormat;
 
-	if (!m_isStdOut)
-		m_fileHandle = new std::ofstream;
+	if (!m_isShm)
+		m_fileSink = new FileSink;
 }
 
 // ================================================================================================
 OutputFile::~OutputFile()
 {
+	close(); // Does nothing if the file was already closed, and reports its own errors
 	delete m_format;
-	if (!m_isStdOut) {
-		if (m_fileHandle->is_open())
-			m_fileHandle->close();
-		delete m_fileHandle;
+	delete m_fileSink;
+	delete m_indexSink;
+}
+
+// ================================================================================================
+bool OutputFile::close()
+{
+	bool good = true;
+	if (m_fileSink && m_fileSink->isOpen()) {
+		if (m_blockRecords > 0)
+			good = writeCompressedBlock();
+		if (m_syncFlush)
+			good = flushFile() && good; // Syncs the last records
+		if (!m_fileSink->close()) {
+			lerr(strfmt("Could not finish writing output file \"%s\", reason: %s.", m_fileName.c_str(),
+				m_fileSink->getError().c_str()));
+			good = false;
+		}
+	}
+	if (m_indexSink && m_indexSink->isOpen() && !m_indexSink->close()) {
+		lerr(strfmt("Could not finish writing the index for output file \"%s\", reason: %s.", m_fileName.c_str(),
+			m_indexSink->getError().c_str()));
+		good = false;
 	}
+
+	return good;
 }
 
 // ================================================================================================
 bool OutputFile::loadFormat(const String& fmt)
 {
 	m_formatString = fmt;
-	return m_format->loadFormat(fmt);
+	if (!m_format->loadFormat(fmt))
+		return false;
+
+	if (m_isBinary) {
+		if (m_isStdOut) {
+			lerr("Terminal output cannot be binary.");
+			return false;
+		}
+		if (!m_format->getPlan().checkBinary())
+			return false;
+	}
+
+	return true;
 }
 
 // ================================================================================================
-bool OutputFile::update()
+void OutputFile::setFlushPolicy(FlushPolicy policy, double interval, bool sync)
 {
-	const bool needsUpdate = (m_time < 0.0) 
-			|| ((m_sim->getSimulation()->t - m_lastOutTime) >= m_time)
-			|| m_firstRun;
+	m_flushPolicy = policy;
+	m_flushInterval = interval;
+	m_syncFlush = sync;
+}
 
-	if (m_firstRun && !m_isStdOut) {
-		m_fileHandle->open(m_fileName.c_str(), std::ios_base::out | std::ios_base::trunc);
-		if (m_fileHandle->fail()) {
-			lerr(strfmt("Could not open output file \"%s\" for writing, reason: (%d) \"%s\".", 
-				m_fileName.c_str(), errno, strerror(errno)));
+// ================================================================================================
+void OutputFile::startSchedule(double time)
+{
+	m_startTime = time;
+	m_outputCount = 0;
+}
+
+// ================================================================================================
+void OutputFile::advanceSchedule(double time)
+{
+	const double steps = floor((time + _getTimeTolerance(time, m_time) - m_startTime) / m_time);
+	m_outputCount = std::max(m_outputCount + 1, static_cast<uint64>(std::max(steps, 0.0)) + 1);
+}
+
+// ================================================================================================
+bool OutputFile::write(OutputTick& tick)
+{
+	if (m_firstRun && m_fileSink) {
+		const bool opened = m_isStdOut ? m_fileSink->openStdOut() : m_fileSink->open(m_fileName);
+		if (!opened) {
+			lerr(strfmt("Could not open output file \"%s\" for writing, reason: %s.", m_fileName.c_str(),
+				m_fileSink->getError().c_str()));
 			return false;
 		}
+		m_flushTimer.start();
+	}
+	if (m_firstRun && !m_isStdOut) {
+
+		if (m_indexed) {
+			const String indexName = m_fileName + INDEX_FILE_EXTENSION;
+			m_indexSink = new FileSink(INDEX_SINK_SIZE);
+			if (!m_indexSink->open(indexName)) {
+				lerr(strfmt("Could not open index file \"%s\" for writing, reason: %s.", indexName.c_str(),
+					m_indexSink->getError().c_str()));
+				return false;
+			}
+			m_indexBuffer.clear();
+			m_indexBuffer.writeBytes(INDEX_FILE_MAGIC, 4);
+			m_indexBuffer.writeUInt32(INDEX_FILE_VERSION);
+			if (!m_indexSink->write(m_indexBuffer.data(), m_indexBuffer.size())) {
+				lerr(strfmt("Could not write the index for output file \"%s\", reason: %s.", m_fileName.c_str(),
+					m_indexSink->getError().c_str()));
+				return false;
+			}
+		}
 
-		(*m_fileHandle) << "# filename: " << m_fileName << "\n"
-						<< "# timestamp: " << Clock::GetFormattedTime(Clock::TIMEFMT_LONG) << "\n"
-						<< "# output timing: " << m_time << "\n"
-						<< "# format: " << m_formatString << std::endl;
+		if (m_isBinary) {
+			if (!writeBinaryHeader())
+				return false;
+		}
+		else {
+			StringStream header{""};
+			header << "# filename: " << m_fileName << "\n"
+				   << "# timestamp: " << Clock::GetFormattedTime(Clock::TIMEFMT_LONG) << "\n"
+				   << "# output timing: " << m_time << "\n"
+				   << "# format: " << m_formatString << "\n";
+			const String headerStr = header.str();
+			if (!writeHeader(reinterpret_cast<const uint8*>(headerStr.data()), headerStr.size()))
+				return false;
+		}
 	}
 	m_firstRun = false;
 
-	if (needsUpdate)
-	{
-		StringStream outstr{""};
-		m_format->generateOutput(m_sim, outstr);
+	// Compressed records are indexed by the block that they are in
+	const uint64 recordOffset = isCompressed() ? m_blockOffset : m_fileOffset;
+	if (m_isBinary) {
+		m_binaryBuffer.clear();
+		m_format->getPlan().executeBinary(tick, m_binaryBuffer);
+		if (m_isShm) {
+			if (!publishRecord(tick, m_binaryBuffer.data(), m_binaryBuffer.size()))
+				return false;
+		}
+		else if (isCompressed()) {
+			if (!writeCompressedRecord())
+				return false;
+		}
+		else {
+			if (!m_fileSink->write(m_binaryBuffer.data(), m_binaryBuffer.size())) {
+				lerr(strfmt("Could not write to output file \"%s\", reason: %s.", m_fileName.c_str(),
+					m_fileSink->getError().c_str()));
+				return false;
+			}
+			m_fileOffset += m_binaryBuffer.size();
+		}
+	}
+	else {
+		m_textStream.str("");
+		m_textStream.clear();
+		m_format->generateOutput(tick, m_textStream);
 
-		if (m_isStdOut)
-			lsim(outstr.str());
-		else
-			(*m_fileHandle) << outstr.str() << std::endl;
+		if (m_isShm) {
+			// The lines are published without the newline, because each record already has its size
+			const String line = m_textStream.str();
+			if (!publishRecord(tick, reinterpret_cast<const uint8*>(line.data()), line.size()))
+				return false;
+		}
+		else if (!writeTextRecord())
+			return false;
+	}
+
+	// The index record is written after the output record, so it never points past the written data
+	if (m_indexed && !writeIndexRecord(tick, recordOffset))
+		return false;
+
+	if (m_fileSink) {
+		m_unflushed = true;
+		const bool flushNow = (m_flushPolicy == FlushPolicy::Line) || 
+			((m_flushPolicy == FlushPolicy::Seconds) && (m_flushTimer.getElapsed() >= m_flushInterval));
+		if (flushNow && !flushFile())
+			return false;
+	}
+
+	return true;
+}
+
+// ================================================================================================
+bool OutputFile::flushTick()
+{
+	if (!m_unflushed)
+		return true;
+
+	const bool flushNow = (m_flushPolicy == FlushPolicy::Tick) || 
+		((m_flushPolicy == FlushPolicy::Seconds) && (m_flushTimer.getElapsed() >= m_flushInterval));
+	return !flushNow || flushFile();
+}
+
+// ================================================================================================
+bool OutputFile::writeHeader(const uint8 *data, size_t size)
+{
+	// Shared memory output keeps the header in the ring, so readers that attach later can still parse it
+	if (m_isShm) {
+		const String ringName = m_fileName.substr(strlen(SHM_OUTPUT_PREFIX));
+		if (!m_ring.create(ringName, m_shmSize, data, size, m_isBinary)) {
+			lerr(strfmt("Could not create the shared memory for output \"%s\", reason: %s", m_fileName.c_str(),
+				m_ring.getError().c_str()));
+			return false;
+		}
+	}
+	else if (!m_fileSink->write(data, size) || !m_fileSink->flush()) {
+		lerr(strfmt("Could not write the header of output file \"%s\", reason: %s.", m_fileName.c_str(),
+			m_fileSink->getError().c_str()));
+		return false;
+	}
+
+	m_fileOffset = m_blockOffset = size;
+	return true;
+}
+
+// ================================================================================================
+bool OutputFile::writeBinaryHeader()
+{
+	// The header is the magic string, the version, the same information as the text header, then the
+	//     column descriptions. Each record after the header starts with its particle count.
+	//     Compressed files have the same header, with their own magic string and version, and the
+	//     keyframe interval and the mantissa bits after the column descriptions.
+	ByteBuffer header;
+	header.writeBytes(isCompressed() ? COMPRESSED_OUTPUT_MAGIC : BINARY_OUTPUT_MAGIC, 4);
+	header.writeUInt32(isCompressed() ? COMPRESSED_OUTPUT_VERSION : BINARY_OUTPUT_VERSION);
+	header.writeString(m_fileName);
+	header.writeString(Clock::GetFormattedTime(Clock::TIMEFMT_LONG));
+	header.writeDouble(m_time);
+	header.writeString(m_formatString);
+	const size_t columnStart = header.size();
+	m_format->getPlan().describeBinary(header);
+
+	if (isCompressed()) {
+		// The encoder walks the records with the same column descriptions that the readers use
+		const uint8 *desc = header.data() + columnStart;
+		const uint32 columnCount = _readUInt32(desc);
+		desc += 4;
+		m_columns.resize(columnCount);
+		for (auto& col : m_columns) {
+			col.type = desc[0];
+			col.width = desc[1];
+			col.list = desc[2];
+			col.flags = desc[3];
+			desc += 4;
+			if (col.width == BINARY_WIDE_COLUMN) {
+				col.width = _readUInt32(desc);
+				desc += 4;
+			}
+		}
+		m_encoder.setColumns(m_columns);
+		m_encoder.setMantissaBits(m_mantissaBits);
+		m_encoder.reset();
+		header.writeUInt32(m_keyframe);
+		header.writeUInt32(m_mantissaBits); // So that readers know if the values are exact
+	}
+
+	return writeHeader(header.data(), header.size());
+}
+
+// ================================================================================================
+bool OutputFile::writeCompressedRecord()
+{
+	if (!m_encoder.encode(m_binaryBuffer.data(), m_binaryBuffer.size(), m_blockBits)) {
+		lerr(strfmt("Could not compress the record for output file \"%s\".", m_fileName.c_str()));
+		return false;
+	}
+
+	if (++m_blockRecords == m_keyframe)
+		return writeCompressedBlock();
+	return true;
+}
+
+// ================================================================================================
+bool OutputFile::writeCompressedBlock()
+{
+	// Each block is the record count, the encoded size, then the encoded records. The encoder is reset
+	//     so the first record of the next block is a keyframe, which lets readers start at any block.
+	m_blockBits.flush();
+	const auto& bits = m_blockBits.getData();
+	ByteBuffer header;
+	header.writeUInt32(m_blockRecords);
+	header.writeUInt64(bits.size());
+	if (!m_fileSink->write(header.data(), header.size()) || !m_fileSink->write(bits.data(), bits.size())) {
+		lerr(strfmt("Could not write to output file \"%s\", reason: %s.", m_fileName.c_str(),
+			m_fileSink->getError().c_str()));
+		return false;
+	}
+	m_fileOffset += header.size() + bits.size();
 
-		m_lastOutTime = m_sim->getSimulation()->t;
+	m_blockOffset = m_fileOffset;
+	m_blockRecords = 0;
+	m_blockBits.clear();
+	m_encoder.reset();
+	return true;
+}
+
+// ================================================================================================
+bool OutputFile::writeIndexRecord(const OutputTick& tick, uint64 offset)
+{
+	m_indexBuffer.clear();
+	m_indexBuffer.writeDouble(tick.getTime());
+	m_indexBuffer.writeInt64(tick.getTimestep());
+	m_indexBuffer.writeUInt64(offset);
+	if (!m_indexSink->write(m_indexBuffer.data(), m_indexBuffer.size())) {
+		lerr(strfmt("Could not write the index for output file \"%s\", reason: %s.", m_fileName.c_str(),
+			m_indexSink->getError().c_str()));
+		return false;
+	}
+
+	return true;
+}
+
+// ================================================================================================
+bool OutputFile::writeTextRecord()
+{
+	// The line is moved straight from the stream into the sink, instead of through a copy from str(), which
+	//     matters for the large list lines. Terminal lines get the same tag that lsim() would give them.
+	bool good = true;
+	if (m_isStdOut) {
+		const String tag = lsimTag();
+		good = m_fileSink->write(tag.data(), tag.size());
+	}
+	size_t size = 0;
+	good = good && m_fileSink->write(m_textStream.rdbuf(), size) && m_fileSink->write("\n", 1);
+	if (!good) {
+		lerr(strfmt("Could not write to output file \"%s\", reason: %s.", m_fileName.c_str(),
+			m_fileSink->getError().c_str()));
+		return false;
+	}
+
+	m_fileOffset += size + 1;
+	return true;
+}
+
+// ================================================================================================
+bool OutputFile::flushFile()
+{
+	const bool fileGood = m_syncFlush ? m_fileSink->sync() : m_fileSink->flush();
+	if (!fileGood) {
+		lerr(strfmt("Could not flush output file \"%s\", reason: %s.", m_fileName.c_str(),
+			m_fileSink->getError().c_str()));
+		return false;
+	}
+	if (m_indexSink) {
+		const bool indexGood = m_syncFlush ? m_indexSink->sync() : m_indexSink->flush();
+		if (!indexGood) {
+			lerr(strfmt("Could not flush the index for output file \"%s\", reason: %s.", m_fileName.c_str(),
+				m_indexSink->getError().c_str()));
+			return false;
+		}
+	}
+
+	m_unflushed = false;
+	m_flushTimer.reset();
+	return true;
+}
+
+// ================================================================================================
+bool OutputFile::publishRecord(const OutputTick& tick, const uint8 *data, size_t size)
+{
+	if (!m_ring.write(data, size, tick.getTime(), tick.getTimestep())) {
+		lerr(strfmt("Could not publish the record for output \"%s\" (%llu bytes), reason: %s", m_fileName.c_str(),
+			static_cast<unsigned long long>(size), m_ring.getError().c_str()));
+		return false;
 	}
 
+	m_fileOffset += size;
 	return true;
 }
 
@@ -91,7 +442,33 @@ bool OutputFile::update()
 // ================================================================================================
 OutputManager::OutputManager(LbdSimulation *sim) :
 	m_sim{sim},
-	m_files{}
+	m_files{},
+	m_needsNames{false},
+	m_dueFiles{},
+	m_events{},
+	m_everyStepFiles{},
+	m_triggerFiles{},
+	m_triggerRing{},
+	m_triggerHead{0},
+	m_triggerNames{false},
+	m_collisionCount{0},
+	m_exactTiming{false},
+	m_clampedStep{false},
+	m_fullDt{0},
+	m_clampedDt{0},
+	m_threaded{false},
+	m_queueSize{4},
+	m_overflow{OverflowPolicy::Block},
+	m_jobs{},
+	m_freeJobs{},
+	m_readyJobs{},
+	m_writer{},
+	m_jobMutex{},
+	m_freeCondition{},
+	m_readyCondition{},
+	m_stopping{false},
+	m_writeError{false},
+	m_droppedCount{0}
 {
 
 }
@@ -99,7 +476,60 @@ OutputManager::OutputManager(LbdSimulation *sim) :
 // ================================================================================================
 OutputManager::~OutputManager()
 {
+	finish();
+}
+
+// ================================================================================================
+bool OutputManager::loadSettings(sol::table& table)
+{
+	sol::object setting;
+
+	// ===== Exact Timing =====
+	if ((setting = table["exact"]) != sol::nil) {
+		if (setting.get_type() != sol::type::boolean) {
+			lerr("The output setting 'exact' must be specified as a boolean.");
+			return false;
+		}
+		m_exactTiming = setting.as<bool>();
+	}
+
+	// ===== Threaded =====
+	if ((setting = table["threaded"]) != sol::nil) {
+		if (setting.get_type() != sol::type::boolean) {
+			lerr("The output setting 'threaded' must be specified as a boolean.");
+			return false;
+		}
+		m_threaded = setting.as<bool>();
+	}
+
+	// ===== Queue Size =====
+	if ((setting = table["queue"]) != sol::nil) {
+		if (setting.get_type() != sol::type::number || setting.as<double>() < 1) {
+			lerr("The output setting 'queue' must be specified as a number of at least 1.");
+			return false;
+		}
+		m_queueSize = static_cast<uint32>(setting.as<double>());
+	}
 
+	// ===== Overflow Policy =====
+	if ((setting = table["overflow"]) != sol::nil) {
+		const String policy = (setting.get_type() == sol::type::string) ? setting.as<String>() : "";
+		if (policy == "block")
+			m_overflow = OverflowPolicy::Block;
+		else if (policy == "drop")
+			m_overflow = OverflowPolicy::Drop;
+		else {
+			lerr("The output setting 'overflow' must be either \"block\" or \"drop\".");
+			return false;
+		}
+	}
+
+	if (m_exactTiming)
+		linfo("Using exact output timing, the timesteps will be shortened to land on the output times.");
+	if (m_threaded)
+		linfo(strfmt("Using threaded output, with a queue size of %u and the \"%s\" overflow policy.", m_queueSize,
+			(m_overflow == OverflowPolicy::Block) ? "block" : "drop"));
+	return true;
 }
 
 // ================================================================================================
@@ -127,19 +557,64 @@ bool OutputManager::loadOutput(sol::table& table)
 		}
 		sol::table valueTable = value.as<sol::table>();
 
-		// Extract time value
+		// Extract the optional trigger, and the snapshots to write before and after it fires
 		sol::object tableObject;
+		OutputTrigger *fileTrigger = nullptr;
+		if ((tableObject = valueTable["trigger"]) != sol::nil) {
+			if (tableObject.get_type() != sol::type::string) {
+				lerr(strfmt("The trigger for output file \"%s\" must be specified as a string.", fileName.c_str()));
+				good = false;
+				return;
+			}
+			const String triggerText = tableObject.as<String>();
+
+			uint32 snapshots[2] = { 0, 0 };
+			const char* const SNAPSHOT_KEYS[2] = { "pre", "post" };
+			for (uint32 i = 0; i < 2; ++i) {
+				sol::object countObject = valueTable[SNAPSHOT_KEYS[i]];
+				if (countObject == sol::nil)
+					continue;
+				if (countObject.get_type() != sol::type::number || countObject.as<double>() < 0 ||
+						countObject.as<double>() > TRIGGER_MAX_SNAPSHOTS) {
+					lerr(strfmt("The %s snapshots for output file \"%s\" must be a number between 0 and %d.",
+						SNAPSHOT_KEYS[i], fileName.c_str(), TRIGGER_MAX_SNAPSHOTS));
+					good = false;
+					return;
+				}
+				snapshots[i] = static_cast<uint32>(countObject.as<double>());
+			}
+
+			fileTrigger = new OutputTrigger;
+			if (!fileTrigger->load(triggerText, snapshots[0], snapshots[1])) {
+				delete fileTrigger;
+				good = false;
+				return;
+			}
+		}
+
+		// Extract time value, which triggered files do not have
+		double fileTime = 0;
 		if ((tableObject = valueTable["time"]) == sol::nil) {
-			lerr(strfmt("A time must be specified for the output file \"%s\".", fileName.c_str()));
+			if (!fileTrigger) {
+				lerr(strfmt("A time or a trigger must be specified for the output file \"%s\".", fileName.c_str()));
+				good = false;
+				return;
+			}
+		}
+		else if (fileTrigger) {
+			lerr(strfmt("The output file \"%s\" cannot have both a time and a trigger.", fileName.c_str()));
+			delete fileTrigger;
 			good = false;
 			return;
 		}
-		if (tableObject.get_type() != sol::type::number) {
+		else if (tableObject.get_type() != sol::type::number) {
 			lerr(strfmt("The time for output file \"%s\" must be specified as a number.", fileName.c_str()));
 			good = false;
 			return;
 		}
-		double fileTime = tableObject.as<double>();
+		else
+			fileTime = tableObject.as<double>();
+		StlUniquePtr<OutputTrigger> triggerOwner{fileTrigger}; // Freed on any of the errors below
 
 		// Extract the format string
 		if ((tableObject = valueTable["format"]) == sol::nil) {
@@ -154,14 +629,256 @@ bool OutputManager::loadOutput(sol::table& table)
 		}
 		String fileFormat = tableObject.as<String>();
 
-		OutputFile *outFile = new OutputFile(m_sim, fileName, fileTime);
+		// Extract the optional binary flag
+		bool fileBinary = false;
+		if ((tableObject = valueTable["binary"]) != sol::nil) {
+			if (tableObject.get_type() != sol::type::boolean) {
+				lerr(strfmt("The binary flag for output file \"%s\" must be specified as a boolean.", fileName.c_str()));
+				good = false;
+				return;
+			}
+			fileBinary = tableObject.as<bool>();
+		}
+
+		// Extract the optional text precision
+		int filePrecision = NUMFMT_ROUNDTRIP;
+		if ((tableObject = valueTable["precision"]) != sol::nil) {
+			const bool isRoundtrip = (tableObject.get_type() == sol::type::string) && 
+				(tableObject.as<String>() == "roundtrip");
+			const bool isDigits = (tableObject.get_type() == sol::type::number) && 
+				(tableObject.as<double>() >= 1) && (tableObject.as<double>() <= NUMFMT_MAX_PRECISION);
+			if (!isRoundtrip && !isDigits) {
+				lerr(strfmt("The precision for output file \"%s\" must be \"roundtrip\", or a number between 1 and %d.",
+					fileName.c_str(), NUMFMT_MAX_PRECISION));
+				good = false;
+				return;
+			}
+			if (isDigits)
+				filePrecision = static_cast<int>(tableObject.as<double>());
+		}
+
+		// Extract the optional coordinate frame of the positions and velocities
+		CoordFrame fileFrame = CoordFrame::Inertial;
+		if ((tableObject = valueTable["frame"]) != sol::nil) {
+			fileFrame = (tableObject.get_type() == sol::type::string) ? 
+				token_utils::StringToCoordFrame(tableObject.as<String>()) : CoordFrame::INVALID;
+			if (fileFrame == CoordFrame::INVALID) {
+				lerr(strfmt("The frame for output file \"%s\" must be one of \"inertial\", \"barycentric\", "
+					"\"heliocentric\", \"jacobi\", or \"democratic\".", fileName.c_str()));
+				good = false;
+				return;
+			}
+		}
+
+		// Extract the optional particle sample, which only keeps the same random fraction of the particles in
+		//     the lists for every output
+		double sampleFraction = 1;
+		uint64 sampleSeed = 0;
+		if ((tableObject = valueTable["sample"]) != sol::nil) {
+			if (!tableObject.is<sol::table>()) {
+				lerr(strfmt("The sample for output file \"%s\" must be a table with a fraction, and an optional seed.",
+					fileName.c_str()));
+				good = false;
+				return;
+			}
+			sol::table sampleTable = tableObject.as<sol::table>();
+			sol::object sampleObject = sampleTable["fraction"];
+			if (sampleObject.get_type() != sol::type::number || sampleObject.as<double>() <= 0 || 
+					sampleObject.as<double>() > 1) {
+				lerr(strfmt("The sample fraction for output file \"%s\" must be a number greater than 0, and at most 1.",
+					fileName.c_str()));
+				good = false;
+				return;
+			}
+			sampleFraction = sampleObject.as<double>();
+			if ((sampleObject = sampleTable["seed"]) != sol::nil) {
+				const double seed = (sampleObject.get_type() == sol::type::number) ? sampleObject.as<double>() : -1;
+				if (seed < 0 || seed != floor(seed) || seed > 9007199254740992.0) {
+					lerr(strfmt("The sample seed for output file \"%s\" must be a whole number of at least 0.",
+						fileName.c_str()));
+					good = false;
+					return;
+				}
+				sampleSeed = static_cast<uint64>(seed);
+			}
+		}
+
+		// Extract the optional compression flag and keyframe interval, compressed files are always binary
+		uint32 fileKeyframe = 0;
+		if ((tableObject = valueTable["compress"]) != sol::nil) {
+			if (tableObject.get_type() != sol::type::boolean) {
+				lerr(strfmt("The compress flag for output file \"%s\" must be specified as a boolean.", fileName.c_str()));
+				good = false;
+				return;
+			}
+			if (tableObject.as<bool>()) {
+				fileBinary = true;
+				fileKeyframe = COMPRESSED_DEFAULT_KEYFRAME;
+			}
+		}
+		if ((tableObject = valueTable["keyframe"]) != sol::nil) {
+			if (tableObject.get_type() != sol::type::number || tableObject.as<double>() < 1 || 
+					tableObject.as<double>() > COMPRESSED_MAX_KEYFRAME) {
+				lerr(strfmt("The keyframe interval for output file \"%s\" must be a number between 1 and %d.",
+					fileName.c_str(), COMPRESSED_MAX_KEYFRAME));
+				good = false;
+				return;
+			}
+			if (fileKeyframe > 0)
+				fileKeyframe = static_cast<uint32>(tableObject.as<double>());
+			else
+				lwarn(strfmt("The keyframe interval for output file \"%s\" is ignored, because it is not compressed.",
+					fileName.c_str()));
+		}
+
+		// Extract the optional mantissa bits, which make the compression lossy, so they are never implied by
+		//     any other option
+		uint32 fileMantissaBits = 0;
+		if ((tableObject = valueTable["mantissa_bits"]) != sol::nil) {
+			const double bits = (tableObject.get_type() == sol::type::number) ? tableObject.as<double>() : -1;
+			if (bits < 1 || bits > LBDIO_MAX_MANTISSA_BITS || bits != floor(bits)) {
+				lerr(strfmt("The mantissa bits for output file \"%s\" must be a whole number between 1 and %d.",
+					fileName.c_str(), LBDIO_MAX_MANTISSA_BITS));
+				good = false;
+				return;
+			}
+			if (fileKeyframe > 0)
+				fileMantissaBits = static_cast<uint32>(bits);
+			else
+				lwarn(strfmt("The mantissa bits for output file \"%s\" are ignored, because it is not compressed.",
+					fileName.c_str()));
+		}
+
+		// Extract the optional index flag
+		bool fileIndex = true;
+		if ((tableObject = valueTable["index"]) != sol::nil) {
+			if (tableObject.get_type() != sol::type::boolean) {
+				lerr(strfmt("The index flag for output file \"%s\" must be specified as a boolean.", fileName.c_str()));
+				good = false;
+				return;
+			}
+			fileIndex = tableObject.as<bool>();
+		}
+
+		// Extract the optional flush policy, and if each flush waits for the data to reach the disk
+		FlushPolicy filePolicy = fileBinary ? FlushPolicy::Close : FlushPolicy::Tick;
+		double fileFlushInterval = 0;
+		bool hasFlush = false;
+		if ((tableObject = valueTable["flush"]) != sol::nil) {
+			hasFlush = true;
+			const String policy = (tableObject.get_type() == sol::type::string) ? tableObject.as<String>() : "";
+			const size_t SECONDS_LEN = strlen("seconds:");
+			if (policy == "line")
+				filePolicy = FlushPolicy::Line;
+			else if (policy == "tick")
+				filePolicy = FlushPolicy::Tick;
+			else if (policy == "close")
+				filePolicy = FlushPolicy::Close;
+			else if (policy.compare(0, SECONDS_LEN, "seconds:") == 0) {
+				const char *start = policy.c_str() + SECONDS_LEN;
+				char *end = nullptr;
+				fileFlushInterval = strtod(start, &end);
+				filePolicy = FlushPolicy::Seconds;
+				if ((end == start) || (*end != '\0') || !(fileFlushInterval > 0)) {
+					lerr(strfmt("The flush interval for output file \"%s\" must be a number of seconds greater than 0.",
+						fileName.c_str()));
+					good = false;
+					return;
+				}
+			}
+			else {
+				lerr(strfmt("The flush policy for output file \"%s\" must be \"line\", \"tick\", \"seconds:<seconds>\", "
+					"or \"close\".", fileName.c_str()));
+				good = false;
+				return;
+			}
+		}
+		bool fileSync = false;
+		if ((tableObject = valueTable["sync"]) != sol::nil) {
+			hasFlush = true;
+			if (tableObject.get_type() != sol::type::boolean) {
+				lerr(strfmt("The sync flag for output file \"%s\" must be specified as a boolean.", fileName.c_str()));
+				good = false;
+				return;
+			}
+			fileSync = tableObject.as<bool>();
+		}
+
+		// Validate the shared memory name, and extract the optional ring size
+		const bool fileShm = (fileName.find(SHM_OUTPUT_PREFIX) == 0);
+		uint64 fileShmSize = static_cast<uint64>(SHM_DEFAULT_SIZE) << 20;
+		if (fileShm) {
+			const String ringName = fileName.substr(strlen(SHM_OUTPUT_PREFIX));
+			if (ringName.empty() || ringName.find('/') != String::npos) {
+				lerr(strfmt("The shared memory output \"%s\" must have a name without any '/' after \"%s\".",
+					fileName.c_str(), SHM_OUTPUT_PREFIX));
+				good = false;
+				return;
+			}
+			if (fileKeyframe > 0) {
+				lerr(strfmt("The shared memory output \"%s\" cannot be compressed.", fileName.c_str()));
+				good = false;
+				return;
+			}
+			if (hasFlush)
+				lwarn(strfmt("The flush policy for output \"%s\" is ignored, because it is shared memory.",
+					fileName.c_str()));
+		}
+		if ((tableObject = valueTable["shm_size"]) != sol::nil) {
+			if (tableObject.get_type() != sol::type::number || tableObject.as<double>() < 1 ||
+					tableObject.as<double>() > SHM_MAX_SIZE) {
+				lerr(strfmt("The shared memory size for output \"%s\" must be a number of MiB between 1 and %d.",
+					fileName.c_str(), SHM_MAX_SIZE));
+				good = false;
+				return;
+			}
+			if (fileShm)
+				fileShmSize = static_cast<uint64>(tableObject.as<double>() * (1 << 20));
+			else
+				lwarn(strfmt("The shared memory size for output file \"%s\" is ignored, because it is not shared memory.",
+					fileName.c_str()));
+		}
+
+		OutputFile *outFile = new OutputFile(m_sim, fileName, fileTime, fileBinary);
 		good = outFile->loadFormat(fileFormat);
 		if (good) {
+			outFile->setPrecision(filePrecision);
+			outFile->setFrame(fileFrame);
+			if (sampleFraction < 1) {
+				outFile->setSample(sampleFraction, sampleSeed);
+				linfo(strfmt("The lists in output file \"%s\" only write %g%% of the particles (seed %llu).",
+					fileName.c_str(), sampleFraction * 100, static_cast<unsigned long long>(sampleSeed)));
+			}
+			if (fileFrame != CoordFrame::Inertial)
+				linfo(strfmt("The positions and velocities in output file \"%s\" are in the %s frame.", fileName.c_str(),
+					token_utils::CoordFrameToString(fileFrame).c_str()));
+			outFile->setIndexed(fileIndex);
+			outFile->setKeyframe(fileKeyframe);
+			outFile->setMantissaBits(fileMantissaBits);
+			if (fileMantissaBits > 0)
+				linfo(strfmt("The doubles in output file \"%s\" are rounded to %u mantissa bits before compression.",
+					fileName.c_str(), fileMantissaBits));
+			outFile->setShmSize(fileShmSize);
+			outFile->setFlushPolicy(filePolicy, fileFlushInterval, fileSync);
+			if (fileSync && !fileShm && !outFile->isStdOut())
+				linfo(strfmt("The output file \"%s\" is synced to the disk every time that it is flushed.",
+					fileName.c_str()));
+			outFile->setTrigger(triggerOwner.release());
 			m_files.push_back(StlSharedPtr<OutputFile>(outFile));
+			if (!outFile->isTriggered()) // Triggered files capture their own snapshots
+				m_needsNames = m_needsNames || outFile->getFormat()->getPlan().usesParticleNames();
 			if (outFile->isStdOut())
 				linfo(strfmt("Loaded terminal output with format \"%s\".", fileFormat.c_str()));
+			else if (outFile->isShm())
+				linfo(strfmt("Loaded %sshared memory output \"%s\" (%.0f MiB) with format \"%s\".",
+					fileBinary ? "binary " : "", fileName.c_str(), fileShmSize / 1048576.0, fileFormat.c_str()));
+			else if (outFile->isTriggered())
+				linfo(strfmt("Loaded triggered output file \"%s\" with trigger \"%s\" and format \"%s\".",
+					fileName.c_str(), outFile->getTrigger()->getText().c_str(), fileFormat.c_str()));
 			else
-				linfo(strfmt("Loaded output file \"%s\" with format \"%s\".", fileName.c_str(), fileFormat.c_str()));
+				linfo(strfmt("Loaded %soutput file \"%s\" with format \"%s\".", 
+					(fileKeyframe > 0) ? "compressed " : fileBinary ? "binary " : "", 
+					fileName.c_str(), fileFormat.c_str()));
 		}
 		else
 			lerr(strfmt("Could not load the format string for output file \"%s\".", fileName.c_str()));
@@ -170,13 +887,241 @@ bool OutputManager::loadOutput(sol::table& table)
 	return good;
 }
 
+// ================================================================================================
+void OutputManager::start()
+{
+	m_dueFiles.resize(m_files.size());
+
+	// Every file is written on the first heartbeat, which happens before the first timestep
+	const double time = m_sim->getSimulation()->t;
+	uint32 ringSize = 0;
+	for (uint32 i = 0; i < m_files.size(); ++i) {
+		if (m_files[i]->isTriggered()) {
+			OutputTrigger *trigger = m_files[i]->getTrigger();
+			trigger->start();
+			m_triggerFiles.push_back(i);
+			m_triggerNames = m_triggerNames || m_files[i]->getFormat()->getPlan().usesParticleNames() ||
+				trigger->usesParticleNames();
+			ringSize = std::max(ringSize, trigger->getPre() + 1);
+		}
+		else if (m_files[i]->isEveryStep())
+			m_everyStepFiles.push_back(i);
+		else {
+			m_files[i]->startSchedule(time);
+			m_events.push({ m_files[i]->getNextTime(), i });
+		}
+	}
+
+	m_triggerRing.clear();
+	for (uint32 i = 0; i < ringSize; ++i)
+		m_triggerRing.emplace_back(new OutputTick(m_sim));
+	m_triggerHead = 0;
+
+	const uint32 jobCount = m_threaded ? m_queueSize : 1;
+	for (uint32 i = 0; i < jobCount; ++i) {
+		output_job *job = new output_job;
+		job->tick.reset(new OutputTick(m_sim));
+		job->due.resize(m_files.size());
+		m_jobs.emplace_back(job);
+		m_freeJobs.push(job);
+	}
+
+	if (m_threaded)
+		m_writer = std::thread(&OutputManager::writerThread, this);
+}
+
+// ================================================================================================
+void OutputManager::finish()
+{
+	if (m_writer.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock{m_jobMutex};
+			m_stopping = true;
+		}
+		m_readyCondition.notify_all();
+		m_writer.join();
+	}
+
+	for (const uint32 index : m_triggerFiles) {
+		linfo(strfmt("The output file \"%s\" was triggered %llu time(s).", m_files[index]->getFileName().c_str(),
+			static_cast<unsigned long long>(m_files[index]->getTrigger()->getFireCount())));
+	}
+	m_triggerFiles.clear();
+	m_triggerRing.clear();
+	m_triggerNames = false;
+
+	// The files are closed here instead of in their destructors, so that a failed final write is reported
+	//     with the rest of the run
+	bool closed = true;
+	for (auto& file : m_files)
+		closed = file->close() && closed;
+	if (!closed)
+		lerr("Not all of the output files could be finished, so they may be missing their last records.");
+
+	if (m_droppedCount > 0) {
+		lwarn(strfmt("The threaded output queue was full, so %llu output(s) were dropped.", 
+			static_cast<unsigned long long>(m_droppedCount)));
+		m_droppedCount = 0;
+	}
+}
+
 // ================================================================================================
 bool OutputManager::update()
 {
+	if (m_jobs.empty())
+		start(); // Make sure there is always a snapshot available, even if start() was not called
+
+	reb_simulation *sim = m_sim->getSimulation();
+	const double time = sim->t;
+
+	// Give back the timestep that was taken away to land on the output time, unless the integrator has chosen a new
+	//     one since (such as IAS15 shrinking it), which is then kept
+	if (m_clampedStep) {
+		if (sim->dt == m_clampedDt)
+			sim->dt = m_fullDt;
+		m_clampedStep = false;
+	}
+
+	// Only the earliest output time needs to be checked to know if anything is due
+	const auto isDue = [this, time]() -> bool {
+		const double next = m_events.top().time;
+		return (time + _getTimeTolerance(next, m_files[m_events.top().file]->getInterval())) >= next;
+	};
+	const bool anyDue = !m_everyStepFiles.empty() || (!m_events.empty() && isDue());
+	if (anyDue) {
+		std::fill(m_dueFiles.begin(), m_dueFiles.end(), false);
+		for (const uint32 index : m_everyStepFiles)
+			m_dueFiles[index] = true;
+		while (!m_events.empty() && isDue()) {
+			const uint32 index = m_events.top().file;
+			m_events.pop();
+			m_dueFiles[index] = true;
+			m_files[index]->advanceSchedule(time);
+			m_events.push({ m_files[index]->getNextTime(), index });
+		}
+	}
+
+	// Triggered files are checked every heartbeat, and are rare enough to write on this thread. Their snapshot
+	//     is also written to the due files when those are written on this thread, instead of capturing another.
+	const bool shareTick = anyDue && !m_threaded;
+	OutputTick *triggerTick = nullptr;
+	if (!m_triggerFiles.empty() && !updateTriggers(shareTick && m_needsNames, triggerTick))
+		return false;
+	m_collisionCount = 0;
+	if (!anyDue)
+		return true;
+
+	if (!m_threaded) {
+		if (triggerTick)
+			return writeFiles(m_dueFiles, *triggerTick);
+		OutputTick& tick = *(m_jobs[0]->tick);
+		tick.capture(m_needsNames);
+		return writeFiles(m_dueFiles, tick);
+	}
+
+	// Get a free snapshot, waiting for one or dropping this output if there are none
+	output_job *job = nullptr;
+	{
+		std::unique_lock<std::mutex> lock{m_jobMutex};
+		if (m_writeError)
+			return false;
+		if (m_freeJobs.empty() && (m_overflow == OverflowPolicy::Drop)) {
+			++m_droppedCount;
+			return true;
+		}
+		m_freeCondition.wait(lock, [this]() { return !m_freeJobs.empty(); });
+		job = m_freeJobs.front();
+		m_freeJobs.pop();
+	}
+
+	job->due = m_dueFiles;
+	job->tick->capture(m_needsNames);
+
+	{
+		std::lock_guard<std::mutex> lock{m_jobMutex};
+		m_readyJobs.push(job);
+	}
+	m_readyCondition.notify_one();
+
+	return true;
+}
+
+// ================================================================================================
+void OutputManager::limitTimestep()
+{
+	if (!m_exactTiming || m_events.empty())
+		return;
+
+	reb_simulation *sim = m_sim->getSimulation();
+	const double next = m_events.top().time;
+	if ((sim->dt > 0) && ((sim->t + sim->dt) > next)) {
+		if (!m_clampedStep)
+			m_fullDt = sim->dt;
+		sim->dt = next - sim->t;
+		m_clampedDt = sim->dt;
+		m_clampedStep = true;
+	}
+}
+
+// ================================================================================================
+bool OutputManager::updateTriggers(bool names, OutputTick*& captured)
+{
+	captured = nullptr;
+	bool capture = false;
+	for (const uint32 index : m_triggerFiles)
+		capture = capture || m_files[index]->getTrigger()->needsSnapshot(m_collisionCount);
+	const uint32 SIZE = static_cast<uint32>(m_triggerRing.size());
+	if (capture) {
+		m_triggerHead = (m_triggerHead + 1) % SIZE;
+		captured = m_triggerRing[m_triggerHead].get();
+		captured->capture(m_triggerNames || names);
+	}
+
 	bool good = true;
+	for (const uint32 index : m_triggerFiles) {
+		OutputFile& file = *(m_files[index]);
+		const uint32 count = capture ? file.getTrigger()->update(*captured, m_collisionCount) : 0;
+		for (uint32 i = count; i > 0; --i)
+			good = file.write(*(m_triggerRing[(m_triggerHead + SIZE - (i - 1)) % SIZE])) && good;
+		good = file.flushTick() && good;
+	}
 
-	for (auto& file : m_files)
-		good = good && file->update();
+	return good;
+}
+
+// ================================================================================================
+bool OutputManager::writeFiles(const StlVector<bool>& due, OutputTick& tick)
+{
+	bool good = true;
+	for (size_t i = 0; i < m_files.size(); ++i) {
+		if (due[i])
+			good = m_files[i]->write(tick) && m_files[i]->flushTick() && good;
+	}
 
 	return good;
+}
+
+// ================================================================================================
+void OutputManager::writerThread()
+{
+	while (true) {
+		output_job *job = nullptr;
+		{
+			std::unique_lock<std::mutex> lock{m_jobMutex};
+			m_readyCondition.wait(lock, [this]() { return m_stopping || !m_readyJobs.empty(); });
+			if (m_readyJobs.empty())
+				return; // Only happens when stopping, after all of the queued snapshots are written
+			job = m_readyJobs.front();
+			m_readyJobs.pop();
+		}
+
+		const bool good = writeFiles(job->due, *(job->tick));
+
+		{
+			std::lock_guard<std::mutex> lock{m_jobMutex};
+			m_writeError = m_writeError || !good;
+			m_freeJobs.push(job);
+		}
+		m_freeCondition.notify_one();
+	}
 }
\ No newline at end of file
@@ -13,11 +13,45 @@
 
 #include "../../luabound.hpp"
 #include "format_parser.hpp"
-#include <fstream>
+#include "output_tick.hpp"
+#include "output_trigger.hpp"
+#include "../../util/byte_buffer.hpp"
+#include "../../util/file_sink.hpp"
+#include "../../util/timer.hpp"
+#include "../../../io/shm_ring.hpp"
+#include "../../../io/xor_codec.hpp"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 // Forward declare LbdSimulation
 class LbdSimulation;
 
+// The first bytes and the version of the binary output files
+#define BINARY_OUTPUT_MAGIC ("LBDB")
+#define BINARY_OUTPUT_VERSION (1)
+// The first bytes and the version of the compressed output files, which have the binary header, the
+//     keyframe interval, and the mantissa bits, then blocks of records that are XOR encoded against the
+//     previous record
+#define COMPRESSED_OUTPUT_MAGIC ("LBDZ")
+#define COMPRESSED_OUTPUT_VERSION (1)
+// The default and largest number of records in each compressed block, each block starts with a keyframe
+#define COMPRESSED_DEFAULT_KEYFRAME (64)
+#define COMPRESSED_MAX_KEYFRAME (65536)
+// The index files written next to the output files, which have the first bytes and the version, then a
+//     fixed-size record for each output record: the time, the timestep, and the byte offset into the file
+#define INDEX_FILE_EXTENSION (".idx")
+#define INDEX_FILE_MAGIC ("LBDI")
+#define INDEX_FILE_VERSION (1)
+#define INDEX_RECORD_SIZE (24)
+// Output files with names that start with this are published to a shared memory ring with the rest of
+//     the name, instead of being written to disk. The ring size is given in MiB.
+#define SHM_OUTPUT_PREFIX ("shm:")
+#define SHM_DEFAULT_SIZE (64)
+#define SHM_MAX_SIZE (16384)
+// The buffer size of the index files, which only have small fixed-size records
+#define INDEX_SINK_SIZE (16 * 1024)
+
 class OutputFile
 {
 private:
@@ -26,29 +60,176 @@ private:
 	String m_fileName;
 	String m_formatString;
 	double m_time;
-	double m_lastOutTime;
-	std::ofstream *m_fileHandle;
-	bool m_firstRun;
+	double m_startTime; // The schedule is only used on the simulation thread
+	uint64 m_outputCount;
+	FileSink *m_fileSink; // Also used for terminal output, but not for shared memory output
+	FileSink *m_indexSink; // Only opened if the index is enabled
+	bool m_indexed;
+	uint64 m_fileOffset; // The number of bytes written to the file, tracked instead of calling tellp()
+	bool m_firstRun; // Only used by write(), which might be on the writer thread
 	const bool m_isStdOut;
+	const bool m_isShm;
+	const bool m_isBinary;
+	ByteBuffer m_binaryBuffer; // Reused between updates for binary files
+	StringStream m_textStream; // Reused between updates for text files, so the lines keep their memory
+	ByteBuffer m_indexBuffer;
+	uint32 m_keyframe; // The records in each compressed block, or 0 if the file is not compressed
+	uint32 m_mantissaBits; // The mantissa bits that compressed doubles are rounded to, or 0 for lossless
+	StlVector<lbdio::column_desc> m_columns; // Only used by compressed files
+	lbdio::XorEncoder m_encoder;
+	lbdio::BitWriter m_blockBits;
+	uint32 m_blockRecords;
+	uint64 m_blockOffset; // The offset of the current compressed block in the file
+	StlUniquePtr<OutputTrigger> m_trigger; // Only set for triggered files, which are not scheduled
+	lbdio::ShmRingWriter m_ring; // Only used by shared memory output
+	uint64 m_shmSize; // The size of the shared memory ring, in bytes
+	FlushPolicy m_flushPolicy;
+	double m_flushInterval; // The seconds between flushes for FlushPolicy::Seconds
+	bool m_syncFlush; // If the data is synced to the disk at every flush
+	Timer m_flushTimer;
+	bool m_unflushed; // If there are records since the last flush
 
 public:
-	OutputFile(LbdSimulation *sim, const String& file, double time);
+	OutputFile(LbdSimulation *sim, const String& file, double time, bool binary);
 	~OutputFile();
 
+	inline const String& getFileName() const { return m_fileName; }
 	bool isStdOut() const { return m_isStdOut; }
+	bool isShm() const { return m_isShm; }
+	bool isBinary() const { return m_isBinary; }
+	bool isCompressed() const { return m_keyframe > 0; }
+
+	inline const OutputFormat* getFormat() const { return m_format; }
+	// Sets the significant digits for text values, or NUMFMT_ROUNDTRIP for the shortest exact values
+	inline void setPrecision(int precision) { m_format->setPrecision(precision); }
+	// Makes the lists only write a stable random sample of the particles, picked from the particle hashes
+	inline void setSample(double fraction, uint64 seed) { m_format->setSample(fraction, seed); }
+	// Sets the coordinate frame of the position and velocity values
+	inline void setFrame(CoordFrame frame) { m_format->setFrame(frame); }
 
 	bool loadFormat(const String& fmt);
-	bool update();
+	// Sets if the index file is written next to the output file, which is ignored for terminal and shared
+	//     memory output
+	inline void setIndexed(bool indexed) { m_indexed = indexed && !m_isStdOut && !m_isShm; }
+	inline bool isIndexed() const { return m_indexed; }
+	// Sets the records in each block of a compressed binary file, or 0 to write uncompressed records
+	inline void setKeyframe(uint32 keyframe) { m_keyframe = m_isBinary ? keyframe : 0; }
+	// Sets the mantissa bits (1 to 52) that the doubles in a compressed file are rounded to before they are
+	//     encoded, or 0 to keep the exact values
+	inline void setMantissaBits(uint32 bits) { m_mantissaBits = bits; }
+	// Sets the size of the shared memory ring in bytes, which must hold at least one record
+	inline void setShmSize(uint64 size) { m_shmSize = size; }
+
+	// Sets when the buffered records are flushed to the file, and if each flush waits for the data to reach the
+	//     disk. The interval is only used by FlushPolicy::Seconds.
+	void setFlushPolicy(FlushPolicy policy, double interval, bool sync);
+	inline FlushPolicy getFlushPolicy() const { return m_flushPolicy; }
+
+	// Takes ownership of the trigger, which makes the file only written when the trigger fires
+	inline void setTrigger(OutputTrigger *trigger) { m_trigger.reset(trigger); }
+	inline OutputTrigger* getTrigger() const { return m_trigger.get(); }
+	inline bool isTriggered() const { return m_trigger.get() != nullptr; }
+
+	// Files with a time of zero or less are written every heartbeat, instead of being scheduled
+	inline bool isEveryStep() const { return m_time <= 0.0; }
+	inline double getInterval() const { return m_time; }
+	// Scheduled output times are always start + n * time, so they never drift with the timestep
+	void startSchedule(double time);
+	inline double getNextTime() const { return m_startTime + (m_outputCount * m_time); }
+	// Moves to the next output time after the simulation time, skipping any that were stepped over
+	void advanceSchedule(double time);
+	// Writes the captured state to the file
+	bool write(OutputTick& tick);
+	// Flushes the records written this heartbeat, if the flush policy asks for it
+	bool flushTick();
+	// Writes the last compressed block, then closes the file and its index. Returns false if any of it could not
+	//     be written. Closing a file that is not open does nothing.
+	bool close();
+
+private:
+	bool writeHeader(const uint8 *data, size_t size);
+	bool writeBinaryHeader();
+	bool writeCompressedRecord();
+	bool writeCompressedBlock();
+	bool writeIndexRecord(const OutputTick& tick, uint64 offset);
+	bool writeTextRecord();
+	// Flushes (and syncs) the file, then the index, so the index never points past the data in the file
+	bool flushFile();
+	bool publishRecord(const OutputTick& tick, const uint8 *data, size_t size);
+};
+
+
+// What to do when a heartbeat has output to write, but the threaded output queue is full
+enum class OverflowPolicy :
+	uint8
+{
+	Block, // Wait for the writer thread to free up a snapshot
+	Drop   // Skip the output, and count how many were skipped
+};
+
+// The next output time for a scheduled output file
+struct output_event
+{
+	double time;
+	uint32 file;
+
+	inline bool operator > (const output_event& other) const { return time > other.time; }
+};
+
+// A captured simulation state, and the files that need to be written with it
+struct output_job
+{
+	StlUniquePtr<OutputTick> tick; // Shared by all of the files, so cached values are only calculated once
+	StlVector<bool> due;
 };
 
 
+// The output files are scheduled with a min-heap of their next output times, so each heartbeat only
+//     has to check the earliest time instead of every file. With exact timing, the timestep before
+//     an output time is shortened to land on it. Triggered files are not scheduled, and are instead
+//     checked every heartbeat against one snapshot, which is kept in a ring for the pre snapshots.
+// When threaded output is enabled, the heartbeat only checks which files are due and copies the
+//     simulation state into a free snapshot from a preallocated pool. A writer thread does all of
+//     the formatting and file writing from the snapshots. Otherwise, the same snapshot is written
+//     immediately on the simulation thread.
 class OutputManager
 {
 private:
 	using FileList = StlVector<StlSharedPtr<OutputFile>>;
+	using JobList = StlVector<StlUniquePtr<output_job>>;
+	using EventQueue = StlPriorityQueue<output_event, StlVector<output_event>, std::greater<output_event>>;
 
 	LbdSimulation *m_sim;
 	FileList m_files;
+	bool m_needsNames; // If any of the formats use particle names, which then need to be captured
+	StlVector<bool> m_dueFiles;
+
+	EventQueue m_events;
+	StlVector<uint32> m_everyStepFiles;
+	StlVector<uint32> m_triggerFiles;
+	StlVector<StlUniquePtr<OutputTick>> m_triggerRing; // The last snapshots for the triggers, the most pre + 1
+	uint32 m_triggerHead; // The newest snapshot in the trigger ring
+	bool m_triggerNames; // If any of the triggered files or triggers use particle names
+	uint32 m_collisionCount; // The collisions since the last heartbeat
+	bool m_exactTiming;
+	bool m_clampedStep; // If the last timestep was shortened to hit an output time
+	double m_fullDt; // The timestep from before it was shortened
+	double m_clampedDt; // The shortened timestep, to tell if the integrator has changed it since
+
+	bool m_threaded;
+	uint32 m_queueSize;
+	OverflowPolicy m_overflow;
+
+	JobList m_jobs;
+	StlQueue<output_job*> m_freeJobs;
+	StlQueue<output_job*> m_readyJobs;
+	std::thread m_writer;
+	std::mutex m_jobMutex;
+	std::condition_variable m_freeCondition;
+	std::condition_variable m_readyCondition;
+	bool m_stopping;
+	bool m_writeError;
+	uint64 m_droppedCount;
 
 public:
 	OutputManager(LbdSimulation *sim);
@@ -56,8 +237,29 @@ public:
 
 	LUABOUND_DECLARE_CLASS_NONCOPYABLE(OutputManager)
 
+	bool loadSettings(sol::table& table);
 	bool loadOutput(sol::table& table);
+
+	// Schedules the files and prepares the snapshots, and starts the writer thread if threaded output
+	//     is enabled
+	void start();
+	// Waits for the writer thread to write all of the queued snapshots, then stops it
+	void finish();
+
 	bool update();
+	// Counts a collision for the collision triggers, which is called when a collision is resolved
+	inline void notifyCollision() { ++m_collisionCount; }
+	// Shortens the next timestep to land on the next output time, if exact timing is enabled. This must
+	//     be called from the pre-timestep callback, after the integrator has been synchronized.
+	void limitTimestep();
+
+private:
+	// Checks the triggered files, and writes them on the simulation thread if they fire. The snapshot of the
+	//     heartbeat is captured once for all of the triggers (with names if any of them, or the caller, need them),
+	//     and is given back, or null if none of the triggers needed it.
+	bool updateTriggers(bool names, OutputTick*& captured);
+	bool writeFiles(const StlVector<bool>& due, OutputTick& tick);
+	void writerThread();
 };
 
 #endif // LUABOUND_OUTPUT_MANAGER_HPP_
\ No newline at end of file
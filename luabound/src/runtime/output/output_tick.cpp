@@ -0,0 +1,215 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file implements the OutputTick class, which holds the state for a single output heartbeat that
+ *     is shared between all of the output files and format tokens.
+ */
+
+#include "output_tick.hpp"
+#include "../simulation.hpp"
+
+
+namespace
+{
+
+// Gets the center of mass of the particles, the same as reb_get_com()
+reb_particle _getCenterOfMass(const StlVector<reb_particle>& particles)
+{
+	reb_particle com{};
+	for (const auto& part : particles) {
+		com.x += part.x * part.m;
+		com.y += part.y * part.m;
+		com.z += part.z * part.m;
+		com.vx += part.vx * part.m;
+		com.vy += part.vy * part.m;
+		com.vz += part.vz * part.m;
+		com.ax += part.ax * part.m;
+		com.ay += part.ay * part.m;
+		com.az += part.az * part.m;
+		com.m += part.m;
+	}
+	if (com.m > 0) {
+		com.x /= com.m; com.y /= com.m; com.z /= com.m;
+		com.vx /= com.m; com.vy /= com.m; com.vz /= com.m;
+		com.ax /= com.m; com.ay /= com.m; com.az /= com.m;
+	}
+	return com;
+}
+
+// Moves the positions and velocities of the particles to be relative to the center
+void _subtractCenter(reb_particle *particles, size_t count, const reb_particle& center)
+{
+	for (size_t i = 0; i < count; ++i) {
+		reb_particle& part = particles[i];
+		part.x -= center.x; part.y -= center.y; part.z -= center.z;
+		part.vx -= center.vx; part.vy -= center.vy; part.vz -= center.vz;
+	}
+}
+
+} // namespace
+
+
+// ================================================================================================
+OutputTick::OutputTick(LbdSimulation *sim) :
+	m_sim{sim},
+	m_particles{},
+	m_names{},
+	m_primaryIndex{-1},
+	m_time{0},
+	m_lastdt{0},
+	m_G{0},
+	m_wallTime{0},
+	m_timestep{0},
+	m_orbits{},
+	m_orbitsValid{false},
+	m_frame{},
+	m_frameValid{false},
+	m_coords{},
+	m_coordsValid{},
+	m_columns{},
+	m_subsets{}
+{
+	InvalidateColumns(m_columns.data(), m_columns.size());
+}
+
+// ================================================================================================
+OutputTick::~OutputTick()
+{
+
+}
+
+// ================================================================================================
+void OutputTick::capture(bool names)
+{
+	reb_simulation *rsim = m_sim->getSimulation();
+	ParticleManager *pm = m_sim->getManager();
+
+	m_particles.assign(rsim->particles, rsim->particles + rsim->N);
+	if (names) {
+		m_names.resize(rsim->N);
+		for (int i = 0; i < rsim->N; ++i)
+			m_names[i] = pm->getNameFromHash(rsim->particles[i].hash);
+	}
+
+	const reb_particle *primary = pm->getPrimaryParticle();
+	m_primaryIndex = primary ? static_cast<int>(primary - rsim->particles) : -1;
+	m_time = rsim->t;
+	m_lastdt = rsim->dt_last_done;
+	m_G = rsim->G;
+	m_wallTime = m_sim->getElapsedWallTime();
+	m_timestep = m_sim->getTimestepCount();
+
+	m_orbitsValid = false;
+	m_frameValid = false;
+	m_coordsValid.fill(false);
+	InvalidateColumns(m_columns.data(), m_columns.size());
+	for (auto& subset : m_subsets) {
+		subset->indicesValid = false;
+		InvalidateColumns(subset->columns.data(), subset->columns.size());
+	}
+}
+
+// ================================================================================================
+const orbits::orbit_batch& OutputTick::getOrbits()
+{
+	if (!m_orbitsValid)
+		calculateOrbits();
+
+	return m_orbits;
+}
+
+// ================================================================================================
+const reference_frame& OutputTick::getFrame()
+{
+	if (!m_frameValid)
+		calculateFrame();
+
+	return m_frame;
+}
+
+// ================================================================================================
+const reb_particle* OutputTick::getCoordinates(CoordFrame frame)
+{
+	if (frame == CoordFrame::Inertial)
+		return m_particles.data();
+
+	const size_t index = static_cast<size_t>(frame);
+	if (!m_coordsValid[index])
+		calculateCoordinates(frame);
+	return m_coords[index].data();
+}
+
+// ================================================================================================
+particle_subset& OutputTick::getSubset(const String& key)
+{
+	for (auto& subset : m_subsets) {
+		if (subset->key == key)
+			return *subset;
+	}
+
+	particle_subset *subset = new particle_subset;
+	subset->key = key;
+	subset->indicesValid = false;
+	InvalidateColumns(subset->columns.data(), subset->columns.size());
+	m_subsets.emplace_back(subset);
+	return *subset;
+}
+
+// ================================================================================================
+void OutputTick::calculateOrbits()
+{
+	// The batch keeps its old capacity, so this only allocates when the particle count grows
+	const reference_frame& frame = getFrame();
+	orbits::calculate(frame.G, m_particles.data(), m_particles.size(), frame.center, m_orbits);
+
+	m_orbitsValid = true;
+}
+
+// ================================================================================================
+void OutputTick::calculateFrame()
+{
+	m_frame.isPrimary = (m_primaryIndex >= 0);
+	if (m_frame.isPrimary)
+		m_frame.center = m_particles[m_primaryIndex];
+	else
+		m_frame.center = _getCenterOfMass(m_particles);
+	m_frame.G = m_G;
+	m_frame.GM = m_G * m_frame.center.m;
+
+	m_frameValid = true;
+}
+
+// ================================================================================================
+void OutputTick::calculateCoordinates(CoordFrame frame)
+{
+	// The copy keeps the values that do not change with the frame, and then all of the particles are converted
+	//     in one pass, the Jacobi and democratic heliocentric frames use the rebound transformations
+	StlVector<reb_particle>& coords = m_coords[static_cast<size_t>(frame)];
+	coords.assign(m_particles.begin(), m_particles.end());
+	const int PCOUNT = static_cast<int>(m_particles.size());
+	if (PCOUNT > 0) {
+		switch (frame) {
+			case CoordFrame::Barycentric: _subtractCenter(coords.data(), PCOUNT, _getCenterOfMass(m_particles)); break;
+			case CoordFrame::Heliocentric: _subtractCenter(coords.data(), PCOUNT, m_particles[0]); break;
+			case CoordFrame::Jacobi:
+				reb_transformations_inertial_to_jacobi_posvel(m_particles.data(), coords.data(), m_particles.data(), PCOUNT);
+				break;
+			case CoordFrame::Democratic:
+				reb_transformations_inertial_to_democraticheliocentric_posvel(m_particles.data(), coords.data(), PCOUNT);
+				break;
+			default: break;
+		}
+	}
+
+	m_coordsValid[static_cast<size_t>(frame)] = true;
+}
+
+// ================================================================================================
+void OutputTick::InvalidateColumns(aggregate_column *columns, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+		columns[i].valuesValid = columns[i].statsValid = columns[i].weighted = columns[i].sortedValid = false;
+}
\ No newline at end of file
@@ -0,0 +1,136 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file declares the OutputTick class, which holds the state for a single output heartbeat that
+ *     is shared between all of the output files and format tokens.
+ */
+
+#ifndef LUABOUND_OUTPUT_TICK_HPP_
+#define LUABOUND_OUTPUT_TICK_HPP_
+
+#include "../../luabound.hpp"
+#include "format_token.hpp"
+#include "../../util/stats.hpp"
+#include "../../sim/orbit_batch.hpp"
+
+// Forward declare LbdSimulation
+class LbdSimulation;
+
+// The reference frame that all orbits and relative values are calculated against for a single tick
+struct reference_frame
+{
+	reb_particle center; // The primary particle, or the center of mass if there is no primary
+	double G; // The gravitational constant
+	double GM; // G * center.m
+	bool isPrimary; // If the center is the primary particle (false = center of mass)
+};
+
+// The values of one particle quantity over all of the particles, and their statistics, which are
+//     shared by all of the aggregate tokens for that quantity
+struct aggregate_column
+{
+	StlVector<double> values; // Vector quantities are stored one whole component after another
+	StlVector<double> sorted; // The values with each component sorted, only made for percentiles
+	stats::column_stats stats[3];
+	bool valuesValid;
+	bool statsValid;
+	bool weighted; // If the stats include the mass-weighted mean
+	bool sortedValid;
+};
+
+// The particles selected by a filter, which is shared by every list and aggregate token that uses a
+//     filter with the same text, along with the aggregate values over only those particles
+struct particle_subset
+{
+	String key; // The filter text
+	StlVector<uint32> indices; // The selected particle indices, in increasing order
+	bool indicesValid;
+	StlArray<aggregate_column, AGGREGATE_COLUMN_COUNT> columns;
+};
+
+// Holds a copy of the simulation state for a single heartbeat, which is shared between all of the
+//     output files and format tokens. Because the output only reads from this copy, it can be
+//     written on another thread while the simulation continues. The derived values (the frame and
+//     the orbits) are calculated lazily the first time that they are requested, and are thrown out
+//     when the next state is captured.
+class OutputTick
+{
+private:
+	LbdSimulation *m_sim;
+
+	// The captured simulation state
+	StlVector<reb_particle> m_particles;
+	StlVector<String> m_names; // Only captured if one of the formats uses particle names
+	int m_primaryIndex; // The index of the primary particle, or -1 if there is no primary
+	double m_time;
+	double m_lastdt;
+	double m_G;
+	double m_wallTime;
+	int64 m_timestep;
+
+	orbits::orbit_batch m_orbits;
+	bool m_orbitsValid;
+
+	reference_frame m_frame;
+	bool m_frameValid;
+
+	// The particles with their positions and velocities in each coordinate frame (besides the inertial frame)
+	StlArray<StlVector<reb_particle>, static_cast<size_t>(CoordFrame::INVALID)> m_coords;
+	StlArray<bool, static_cast<size_t>(CoordFrame::INVALID)> m_coordsValid;
+
+	StlArray<aggregate_column, AGGREGATE_COLUMN_COUNT> m_columns;
+	StlVector<StlUniquePtr<particle_subset>> m_subsets;
+
+public:
+	OutputTick(LbdSimulation *sim);
+	~OutputTick();
+
+	LUABOUND_DECLARE_CLASS_NONCOPYABLE(OutputTick)
+
+	inline LbdSimulation* getSimulation() const { return m_sim; }
+
+	// Copies the current state of the simulation, which invalidates all of the cached values. This
+	//     will only allocate if the particle count has grown past any previous capture.
+	void capture(bool names);
+
+	inline uint32 getParticleCount() const { return static_cast<uint32>(m_particles.size()); }
+	inline const reb_particle* getParticles() const { return m_particles.data(); }
+	inline const reb_particle& getParticle(uint32 index) const { return m_particles[index]; }
+	inline const String& getParticleName(uint32 index) const { return m_names[index]; }
+	inline double getTime() const { return m_time; }
+	inline double getLastdt() const { return m_lastdt; }
+	inline double getG() const { return m_G; }
+	inline double getWallTime() const { return m_wallTime; }
+	inline int64 getTimestep() const { return m_timestep; }
+
+	// Gets the orbits for all of the particles, calculating them all at once if they have not yet been
+	//     calculated for this state. The error code for each particle is in the err array.
+	const orbits::orbit_batch& getOrbits();
+
+	// Gets the reference frame, calculating it if it has not yet been calculated for this state.
+	const reference_frame& getFrame();
+	// Gets the particles with their positions and velocities in the coordinate frame, converting all of the
+	//     particles at once if they have not yet been converted for this state. Only the positions and
+	//     velocities are valid in the frames besides the inertial frame.
+	const reb_particle* getCoordinates(CoordFrame frame);
+
+	// Gets the aggregate cache for the particle quantity, which is filled by the format tokens. The
+	//     values are kept between captures to reuse their memory, but are marked as invalid.
+	inline aggregate_column& getColumn(ValuePType type, CoordFrame frame) { 
+		return m_columns[token_utils::GetColumnIndex(type, frame)]; 
+	}
+	// Gets the subset cache for the filter text, which is filled by the format plans. Like the columns,
+	//     the subsets are kept between captures but are marked as invalid.
+	particle_subset& getSubset(const String& key);
+
+private:
+	void calculateOrbits();
+	void calculateFrame();
+	void calculateCoordinates(CoordFrame frame);
+	static void InvalidateColumns(aggregate_column *columns, size_t count);
+};
+
+#endif // LUABOUND_OUTPUT_TICK_HPP_
\ No newline at end of file
@@ -0,0 +1,106 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file implements the OutputTrigger class, which decides when an event-based output file is
+ *     written, and keeps the snapshots from before the event.
+ */
+
+#include "output_trigger.hpp"
+#include "format_token.hpp"
+#include <algorithm>
+
+
+// ================================================================================================
+OutputTrigger::OutputTrigger() :
+	m_type{TriggerType::Collision},
+	m_filter{},
+	m_text{},
+	m_pre{0},
+	m_post{0},
+	m_stored{0},
+	m_postLeft{0},
+	m_lastHashes{},
+	m_hashes{},
+	m_fireCount{0}
+{
+
+}
+
+// ================================================================================================
+OutputTrigger::~OutputTrigger()
+{
+
+}
+
+// ================================================================================================
+bool OutputTrigger::load(const String& text, uint32 pre, uint32 post)
+{
+	m_text = text;
+	m_pre = pre;
+	m_post = post;
+	if (text == "collision") {
+		m_type = TriggerType::Collision;
+		return true;
+	}
+
+	m_type = TriggerType::Condition;
+	if (!m_filter.load((text == "escape") ? "e>=1" : text)) {
+		lerr(strfmt("The trigger \"%s\" must be \"collision\", \"escape\", or a particle filter.", text.c_str()));
+		return false;
+	}
+	return true;
+}
+
+// ================================================================================================
+void OutputTrigger::start()
+{
+	m_stored = 0;
+	m_postLeft = 0;
+	m_lastHashes.clear();
+}
+
+// ================================================================================================
+bool OutputTrigger::needsSnapshot(uint32 collisions) const
+{
+	return (m_type == TriggerType::Condition) || (m_pre > 0) || (collisions > 0) || (m_postLeft > 0);
+}
+
+// ================================================================================================
+uint32 OutputTrigger::update(OutputTick& tick, uint32 collisions)
+{
+	m_stored = std::min(m_stored + 1, m_pre + 1);
+
+	bool fire = false;
+	if (m_type == TriggerType::Collision)
+		fire = (collisions > 0);
+	else {
+		// Conditions fire when any particle starts passing, so a particle that stays past the threshold only
+		//     fires once, but it does not hide the particles that pass after it
+		const StlVector<uint32>& indices = token_utils::SelectParticles(tick, m_filter);
+		m_hashes.clear();
+		for (const uint32 index : indices)
+			m_hashes.push_back(tick.getParticle(index).hash);
+		std::sort(m_hashes.begin(), m_hashes.end());
+		fire = !std::includes(m_lastHashes.begin(), m_lastHashes.end(), m_hashes.begin(), m_hashes.end());
+		m_lastHashes.swap(m_hashes);
+	}
+
+	uint32 count = 0;
+	if (fire) {
+		++m_fireCount;
+		count = m_stored;
+		m_postLeft = m_post;
+	}
+	else if (m_postLeft > 0) {
+		count = 1;
+		--m_postLeft;
+	}
+
+	// Written snapshots are not kept for the next trigger
+	if (count > 0)
+		m_stored = 0;
+	return count;
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file declares the OutputTrigger class, which decides when an event-based output file is
+ *     written, and keeps the snapshots from before the event.
+ */
+
+#ifndef LUABOUND_OUTPUT_TRIGGER_HPP_
+#define LUABOUND_OUTPUT_TRIGGER_HPP_
+
+#include "../../luabound.hpp"
+#include "particle_filter.hpp"
+#include "output_tick.hpp"
+
+// Forward declare LbdSimulation
+class LbdSimulation;
+
+// The most snapshots that can be kept from before a trigger, or written after one
+#define TRIGGER_MAX_SNAPSHOTS (1024)
+
+// The event that a trigger waits for
+enum class TriggerType :
+	uint8
+{
+	Collision, // A collision was resolved since the last heartbeat
+	Condition  // A particle passes the filter that did not pass it on the last heartbeat
+};
+
+// A trigger is checked every heartbeat, and fires on a collision, or when a particle condition (written
+//     with the particle filter syntax, like "e>0.99" or "star*&R<0.01") becomes true for any particle.
+//     The snapshots are captured into a ring that is shared by all of the triggers (see OutputManager),
+//     and the last pre heartbeats in it are written along with the heartbeat that fired, then the next
+//     post heartbeats are written after it.
+class OutputTrigger
+{
+private:
+	TriggerType m_type;
+	ParticleFilter m_filter; // Only used by conditions
+	String m_text;
+	uint32 m_pre;
+	uint32 m_post;
+
+	uint32 m_stored; // The snapshots in the shared ring that have not been written by this trigger
+	uint32 m_postLeft;
+	StlVector<uint32> m_lastHashes; // The sorted hashes of the particles that passed the condition last time
+	StlVector<uint32> m_hashes; // The hashes for the current heartbeat, kept to reuse the memory
+	uint64 m_fireCount;
+
+public:
+	OutputTrigger();
+	~OutputTrigger();
+
+	LUABOUND_DECLARE_CLASS_NONCOPYABLE(OutputTrigger)
+
+	// Parses the trigger, which is "collision", "escape" (the same as "e>=1"), or a particle filter
+	bool load(const String& text, uint32 pre, uint32 post);
+
+	inline TriggerType getType() const { return m_type; }
+	inline const String& getText() const { return m_text; }
+	inline uint32 getPre() const { return m_pre; }
+	inline uint64 getFireCount() const { return m_fireCount; }
+	inline bool usesParticleNames() const { return (m_type == TriggerType::Condition) && m_filter.usesNames(); }
+
+	// Resets the trigger, which must be done before the first update
+	void start();
+	// Gets if the trigger needs a snapshot of this heartbeat, given the number of collisions since the last
+	//     heartbeat. Collision triggers only need the state when it might be written.
+	bool needsSnapshot(uint32 collisions) const;
+	// Checks the trigger against the snapshot of this heartbeat, which is called for every heartbeat that a
+	//     snapshot is captured for. Returns how many of the newest snapshots in the shared ring to write, which
+	//     always includes this one if it is more than zero.
+	uint32 update(OutputTick& tick, uint32 collisions);
+};
+
+#endif // LUABOUND_OUTPUT_TRIGGER_HPP_
\ No newline at end of file
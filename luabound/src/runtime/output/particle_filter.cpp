@@ -0,0 +1,211 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file implements the ParticleFilter class, which selects the subset of the particles used by a
+ *     list specifier or an aggregate value token.
+ */
+
+#include "particle_filter.hpp"
+#include "format_token.hpp"
+#include <regex>
+
+// Regex string for a value test clause (value, operator, number)
+static const String VALUE_CLAUSE_REGEX_STR = R"(^(\w\w?)(<=|>=|!=|<|>|=)(.+)$)";
+static const String NAME_CLAUSE_REGEX_STR = R"(^[\w\*]+$)";
+
+
+namespace
+{
+
+// Parses the entire string as a number
+bool _parseNumber(const String& str, double& value)
+{
+	if (str.empty())
+		return false;
+
+	char *end = nullptr;
+	value = strtod(str.c_str(), &end);
+	return (*end == '\0');
+}
+
+} // namespace
+
+
+// ================================================================================================
+ParticleFilter::ParticleFilter() :
+	m_text{},
+	m_key{},
+	m_clauses{},
+	m_frame{CoordFrame::Inertial}
+{
+
+}
+
+// ================================================================================================
+bool ParticleFilter::load(const String& text)
+{
+	static const std::regex VALUE_REGEX(VALUE_CLAUSE_REGEX_STR, std::regex_constants::ECMAScript);
+	static const std::regex NAME_REGEX(NAME_CLAUSE_REGEX_STR, std::regex_constants::ECMAScript);
+
+	m_text.clear();
+	m_clauses.clear();
+	for (char c : text) {
+		if (!isspace(c))
+			m_text.push_back(c);
+	}
+	if (m_text.empty()) {
+		lerr("A particle filter cannot be empty.");
+		return false;
+	}
+
+	size_t start = 0;
+	while (start <= m_text.length()) {
+		size_t end = m_text.find('&', start);
+		if (end == String::npos)
+			end = m_text.length();
+		const String clauseStr = m_text.substr(start, end - start);
+		start = end + 1;
+
+		filter_clause clause;
+		clause.op = FilterOp::NameMatch;
+		clause.ptype = ValuePType::INVALID;
+		clause.low = clause.high = 0;
+		clause.seed = 0;
+
+		std::smatch match;
+		if (std::regex_match(clauseStr, match, VALUE_REGEX)) {
+			clause.ptype = token_utils::StringToValuePType(match[1].str());
+			if (clause.ptype == ValuePType::INVALID) {
+				lerr(strfmt("The filter clause \"%s\" does not test a valid particle value.", clauseStr.c_str()));
+				return false;
+			}
+			if (token_utils::GetPValueDataType(clause.ptype) == ValueDataType::String) {
+				lerr(strfmt("The filter clause \"%s\" tests a string, use a name pattern instead.", clauseStr.c_str()));
+				return false;
+			}
+			if (clause.ptype == ValuePType::EccVec || clause.ptype == ValuePType::AMVec) {
+				lerr(strfmt("The filter clause \"%s\" cannot test a vector value.", clauseStr.c_str()));
+				return false;
+			}
+
+			const String opStr = match[2].str();
+			const String numStr = match[3].str();
+			const size_t rangePos = numStr.find("..");
+			bool valid = false;
+			if (opStr == "=" && rangePos != String::npos) {
+				clause.op = FilterOp::Range;
+				valid = _parseNumber(numStr.substr(0, rangePos), clause.low) &&
+					_parseNumber(numStr.substr(rangePos + 2), clause.high);
+			}
+			else {
+				if (opStr == "<") clause.op = FilterOp::Less;
+				else if (opStr == "<=") clause.op = FilterOp::LessEqual;
+				else if (opStr == ">") clause.op = FilterOp::Greater;
+				else if (opStr == ">=") clause.op = FilterOp::GreaterEqual;
+				else if (opStr == "=") clause.op = FilterOp::Equal;
+				else clause.op = FilterOp::NotEqual;
+				valid = _parseNumber(numStr, clause.low);
+			}
+			if (!valid) {
+				lerr(strfmt("The filter clause \"%s\" does not compare against a valid number.", clauseStr.c_str()));
+				return false;
+			}
+		}
+		else if (std::regex_match(clauseStr, NAME_REGEX)) {
+			clause.pattern = clauseStr;
+		}
+		else {
+			lerr(strfmt("The filter clause \"%s\" is not a valid name pattern or value test.", clauseStr.c_str()));
+			return false;
+		}
+
+		m_clauses.push_back(clause);
+	}
+
+	updateKey();
+	return true;
+}
+
+// ================================================================================================
+bool ParticleFilter::usesNames() const
+{
+	for (const auto& clause : m_clauses) {
+		if (clause.op == FilterOp::NameMatch)
+			return true;
+	}
+	return false;
+}
+
+// ================================================================================================
+void ParticleFilter::addSample(double fraction, uint64 seed)
+{
+	filter_clause clause;
+	clause.op = FilterOp::Sample;
+	clause.ptype = ValuePType::INVALID;
+	clause.low = fraction;
+	clause.high = 0;
+	clause.seed = seed;
+
+	// The sample is tested first, because it is the cheapest clause and usually removes the most particles.
+	//     The text is not valid filter syntax, so it cannot clash with a filter written in the format.
+	m_clauses.insert(m_clauses.begin(), clause);
+	const String sampleText = strfmt("%%sample(%.17g,%llu)", fraction, static_cast<unsigned long long>(seed));
+	m_text = m_text.empty() ? sampleText : (sampleText + "&" + m_text);
+	updateKey();
+}
+
+// ================================================================================================
+bool ParticleFilter::usesFrameValues() const
+{
+	for (const auto& clause : m_clauses) {
+		if (clause.op != FilterOp::NameMatch && clause.op != FilterOp::Sample && token_utils::IsFrameValue(clause.ptype))
+			return true;
+	}
+	return false;
+}
+
+// ================================================================================================
+void ParticleFilter::setFrame(CoordFrame frame)
+{
+	m_frame = frame;
+	updateKey();
+}
+
+// ================================================================================================
+void ParticleFilter::updateKey()
+{
+	m_key = m_text;
+	if (m_frame != CoordFrame::Inertial && usesFrameValues())
+		m_key += "@" + token_utils::CoordFrameToString(m_frame);
+}
+
+// ================================================================================================
+bool ParticleFilter::MatchName(const String& pattern, const String& name)
+{
+	// Greedy wildcard match, which backtracks to the last '*' on a mismatch
+	size_t p = 0, n = 0;
+	size_t star = String::npos, starMatch = 0;
+	while (n < name.length()) {
+		if (p < pattern.length() && pattern[p] == '*') {
+			star = p++;
+			starMatch = n;
+		}
+		else if (p < pattern.length() && pattern[p] == name[n]) {
+			++p;
+			++n;
+		}
+		else if (star != String::npos) {
+			p = star + 1;
+			n = ++starMatch;
+		}
+		else
+			return false;
+	}
+
+	while (p < pattern.length() && pattern[p] == '*')
+		++p;
+	return (p == pattern.length());
+}
\ No newline at end of file
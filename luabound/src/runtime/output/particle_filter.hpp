@@ -0,0 +1,94 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file declares the ParticleFilter class, which selects the subset of the particles used by a
+ *     list specifier or an aggregate value token.
+ */
+
+#ifndef LUABOUND_PARTICLE_FILTER_HPP_
+#define LUABOUND_PARTICLE_FILTER_HPP_
+
+#include "../../luabound.hpp"
+
+// Declared in format_token.hpp
+enum class ValuePType : uint8;
+enum class CoordFrame : uint8;
+
+// The test made by a single filter clause
+enum class FilterOp :
+	uint8
+{
+	Less,         // value < low (<)
+	LessEqual,    // value <= low (<=)
+	Greater,      // value > low (>)
+	GreaterEqual, // value >= low (>=)
+	Equal,        // value == low (=)
+	NotEqual,     // value != low (!=)
+	Range,        // low <= value <= high (=low..high)
+	NameMatch,    // The particle name matches the pattern, where '*' matches any run of characters
+	Sample        // The particle hash is in the stable random sample, which keeps the fraction low of the particles
+};
+
+// A single test in a filter, the particle must pass all of the clauses to be selected
+struct filter_clause
+{
+	FilterOp op;
+	ValuePType ptype; // Not used by NameMatch
+	double low;
+	double high; // Only used by Range
+	String pattern; // Only used by NameMatch
+	uint64 seed; // Only used by Sample
+};
+
+// A filter is written in square brackets, as one or more clauses separated by '&'. A clause is either
+//     a name pattern ("star*"), or a test on a particle value ("e<1", "a>=0.5", "h=100..199"). The
+//     filter is evaluated once per tick, and the selected particles are shared by everything that
+//     uses a filter with the same text.
+class ParticleFilter
+{
+private:
+	String m_text; // The filter text, with the whitespace removed
+	String m_key; // The text, plus the frame if the filter tests values in a frame besides the inertial frame
+	StlVector<filter_clause> m_clauses;
+	CoordFrame m_frame;
+
+public:
+	ParticleFilter();
+
+	// Parses the filter text (without the square brackets), reporting any errors
+	bool load(const String& text);
+
+	inline bool empty() const { return m_clauses.empty(); }
+	inline const String& getText() const { return m_text; }
+	// Gets the text that the selected particles are cached with, which is different for each frame
+	inline const String& getKey() const { return m_key; }
+	inline const StlVector<filter_clause>& getClauses() const { return m_clauses; }
+	bool usesNames() const;
+	bool usesFrameValues() const;
+	inline CoordFrame getFrame() const { return m_frame; }
+	// Sets the frame of the position and velocity values that are tested
+	void setFrame(CoordFrame frame);
+	// Adds a clause that only keeps a stable random sample of the particles, which is used for the sample
+	//     option of the output files instead of being written in the filter text
+	void addSample(double fraction, uint64 seed);
+
+	static bool MatchName(const String& pattern, const String& name);
+	// Gets the threshold on SampleHash() that keeps the fraction of the particles
+	static inline uint64 SampleThreshold(double fraction) { return static_cast<uint64>(fraction * 4294967296.0); }
+	// Mixes the particle hash with the seed, so each particle is in or out of the sample for its whole life,
+	//     no matter which particles are added or removed around it
+	static inline uint64 SampleHash(uint32 hash, uint64 seed) {
+		uint64 x = hash + (seed * 0x9E3779B97F4A7C15ull);
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+		return (x ^ (x >> 31)) >> 32;
+	}
+
+private:
+	void updateKey();
+};
+
+#endif // LUABOUND_PARTICLE_FILTER_HPP_
\ No newline at end of file
@@ -42,4 +42,27 @@ String NameFactory::getNext(const String& name)
 {
 	addName(name);
 	return strfmt("%s%d", name.c_str(), (m_names[name]++));
+}
+
+// ================================================================================================
+void NameFactory::getNext(const String& name, uint32 count, StlVector<String>& out)
+{
+	uint32& next = m_names[name];
+	out.clear();
+	out.reserve(count);
+
+	// The same names as getNext(), but the numbers are written directly instead of through strfmt()
+	char digits[10];
+	char * const digitsEnd = digits + sizeof(digits);
+	for (uint32 i = 0; i < count; ++i) {
+		uint32 value = (next++);
+		char *pos = digitsEnd;
+		do {
+			*(--pos) = static_cast<char>('0' + (value % 10));
+			value /= 10;
+		} while (value > 0);
+
+		out.emplace_back(name);
+		out.back().append(pos, digitsEnd);
+	}
 }
\ No newline at end of file
@@ -28,6 +28,8 @@ public:
 	void addName(const String& name);
 
 	String getNext(const String& name);
+	// Gets the next names in the sequence for many particles at once, which only looks up the name once
+	void getNext(const String& name, uint32 count, StlVector<String>& out);
 };
 
 #endif // LUABOUND_NAME_FACTORY_HPP_
\ No newline at end of file
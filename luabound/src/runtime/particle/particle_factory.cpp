@@ -10,12 +10,19 @@
  */
 
 #include "particle_factory.hpp"
+#ifdef _OPENMP
+#	include <omp.h>
+#endif
 
 // ================================================================================================
 ParticleFactory::ParticleFactory(reb_simulation *sim) :
 	m_sim{sim},
 	m_names{nullptr},
-	m_lastHash{0}
+	m_lastHash{0},
+	m_threads{0},
+	m_batch{},
+	m_streams{},
+	m_masses{}
 {
 	m_names = new NameFactory;
 }
@@ -48,25 +55,89 @@ reb_particle ParticleFactory::createParticle(sol::object& mass, sol::object& rad
 		return part;
 	}
 
-	part.m = pmass.generate();
-	part.r = pradius.generate();
+	generateParticles(pmass, pradius, pplace, prefpart, 1, &part);
+	return part;
+}
 
-	double pos[9];
-	pplace.generate(prefpart, part.m, pos);
-	part.x = pos[0];
-	part.y = pos[1];
-	part.z = pos[2];
-	part.vx = pos[3];
-	part.vy = pos[4];
-	part.vz = pos[5];
-	part.ax = pos[6];
-	part.ay = pos[7];
-	part.az = pos[8];
+// ================================================================================================
+bool ParticleFactory::createParticles(sol::object& mass, sol::object& radius, sol::object& place,
+	sol::object& refpart, const String& name, uint32 count, StlVector<reb_particle>& parts, StlVector<String>& names)
+{
+	value_distribution pmass;
+	value_distribution pradius;
+	body_placement_ref pplace;
+	sim_particle_ref prefpart;
 
-	// Give it a unique hash
-	part.hash = (m_lastHash++);
+	if (!parseMass(mass, &pmass) || !parseRadius(radius, &pradius) 
+			|| !parsePlacement(place, &pplace) || !parseRefPart(refpart, &prefpart)) {
+		return false;
+	}
 
-	return part;
+	m_names->getNext(name, count, names);
+	parts.resize(count);
+	generateParticles(pmass, pradius, pplace, prefpart, count, parts.data());
+	return true;
+}
+
+// ================================================================================================
+void ParticleFactory::generateParticles(const value_distribution& mass, const value_distribution& radius,
+	const body_placement_ref& place, const sim_particle_ref& refpart, uint32 count, reb_particle *out)
+{
+	const uint64 seed = rng::GetSeed();
+	const uint32 batchSize = std::min(count, static_cast<uint32>(PARTICLE_FACTORY_BATCH_SIZE));
+	m_streams.resize(batchSize, random_stream{seed, 0});
+	m_masses.resize(batchSize);
+
+	// The hashes are only taken once every batch is generated, so a placement that fails does not change the
+	//     hashes (and so the random values) of the particles that are created after it
+	const uint32 baseHash = m_lastHash;
+	for (uint32 start = 0; start < count; start += batchSize) {
+		const uint32 bcount = std::min(batchSize, count - start);
+		reb_particle *bout = out + start;
+		const uint32 firstHash = baseHash + start;
+
+#ifdef _OPENMP
+		const int THREADS = (m_threads == 0) ? omp_get_max_threads() : static_cast<int>(m_threads);
+		#pragma omp parallel num_threads(THREADS) if ((bcount >= PLACEMENT_PARALLEL_SIZE) && (THREADS > 1))
+#endif
+		{
+#ifdef _OPENMP
+			const int TID = omp_get_thread_num();
+			const int TCOUNT = omp_get_num_threads();
+#else
+			const int TID = 0;
+			const int TCOUNT = 1;
+#endif
+			const uint32 FIRST = static_cast<uint32>((static_cast<uint64>(bcount) * TID) / TCOUNT);
+			const uint32 LAST = static_cast<uint32>((static_cast<uint64>(bcount) * (TID + 1)) / TCOUNT);
+			// Each particle gets a unique hash, which also picks its random values, and the placement needs
+			//     the masses, so the masses and radii are drawn first
+			for (uint32 i = FIRST; i < LAST; ++i) {
+				reb_particle& part = bout[i];
+				part = reb_particle{};
+				part.hash = firstHash + i;
+				random_stream& rng = m_streams[i];
+				rng = random_stream{seed, part.hash};
+				part.m = m_masses[i] = mass.generate(rng);
+				part.r = radius.generate(rng);
+			}
+		}
+
+		place.generateBatch(refpart, m_masses.data(), m_streams.data(), bcount, m_batch, m_threads);
+		for (uint32 i = 0; i < bcount; ++i) {
+			reb_particle& part = bout[i];
+			part.x = m_batch.values[0][i];
+			part.y = m_batch.values[1][i];
+			part.z = m_batch.values[2][i];
+			part.vx = m_batch.values[3][i];
+			part.vy = m_batch.values[4][i];
+			part.vz = m_batch.values[5][i];
+			part.ax = m_batch.values[6][i];
+			part.ay = m_batch.values[7][i];
+			part.az = m_batch.values[8][i];
+		}
+	}
+	m_lastHash = baseHash + count;
 }
 
 // ================================================================================================
@@ -18,12 +18,19 @@
 #include "../../sim/placement.hpp"
 #include "name_factory.hpp"
 
+// The number of particles that are generated together, which bounds the memory of the batch arrays
+#define PARTICLE_FACTORY_BATCH_SIZE (65536)
+
 class ParticleFactory
 {
 private:
 	reb_simulation *m_sim;
 	NameFactory *m_names;
 	uint32 m_lastHash;
+	uint32 m_threads; // The threads to generate batches with, 0 for all of the OpenMP threads
+	placement_batch m_batch;
+	StlVector<random_stream> m_streams;
+	StlVector<double> m_masses;
 
 public:
 	ParticleFactory(reb_simulation *sim);
@@ -31,9 +38,21 @@ public:
 
 	LUABOUND_DECLARE_CLASS_NONCOPYABLE(ParticleFactory)
 
+	inline uint32 getThreads() const { return m_threads; }
+	inline void setThreads(uint32 threads) { m_threads = threads; }
+
 	// Returned mass = -1 on error, the passed name will the changed to the final particle name
 	reb_particle createParticle(sol::object& mass, sol::object& radius, sol::object& place, 
 		sol::object& refpart, String& name, bool multi);
+	// Creates many particles with the same arguments, which are only parsed once. The particles are generated
+	//     into the parts array, with the next names in the sequence for the name. Returns false on error.
+	bool createParticles(sol::object& mass, sol::object& radius, sol::object& place, sol::object& refpart,
+		const String& name, uint32 count, StlVector<reb_particle>& parts, StlVector<String>& names);
+	// Generates particles from parsed arguments. The random values of each particle only depend on the seed and
+	//     the hash that it is given, not on the other particles, so the particles are generated in batches
+	//     that are split between the threads.
+	void generateParticles(const value_distribution& mass, const value_distribution& radius,
+		const body_placement_ref& place, const sim_particle_ref& refpart, uint32 count, reb_particle *out);
 
 private:
 	bool parseMass(sol::object& mass, value_distribution *outmass);
@@ -10,13 +10,17 @@
  */
 
 #include "particle_manager.hpp"
+#include <algorithm>
 
 // ================================================================================================
 ParticleManager::ParticleManager(reb_simulation *sim) :
 	m_sim{sim},
 	m_hashNameMap{},
 	m_nameHashMap{},
-	m_primaryParticle{nullptr}
+	m_primaryParticle{nullptr},
+	m_indices{},
+	m_indexedCount{0},
+	m_collisionSlots{}
 {
 
 }
@@ -37,13 +41,59 @@ reb_particle* ParticleManager::addParticle(const String& name, reb_particle part
 		removeParticleByName(name, nullptr);
 	}
 
+	updateIndices();
 	reb_add(m_sim, part);
+	if (m_sim->N > m_indexedCount) {
+		m_indices.set(part.hash, static_cast<uint32>(m_sim->N - 1));
+		m_indexedCount = m_sim->N;
+	}
 	reb_particle *pt = &(m_sim->particles[m_sim->N - 1]);
 	m_hashNameMap.insert(std::make_pair(pt->hash, name));
 	m_nameHashMap.insert(std::make_pair(name, pt->hash));
 	return pt;
 }
 
+// ================================================================================================
+void ParticleManager::addParticles(const StlVector<String>& names, const StlVector<reb_particle>& parts)
+{
+	// The existing particles with the same names are removed first, so the new particles stay together
+	for (const auto& name : names) {
+		if (m_nameHashMap.find(name) != m_nameHashMap.end()) {
+			lwarn(strfmt("Overwriting particle with name '%s' with new particle.", name.c_str()));
+			removeParticleByName(name, nullptr);
+		}
+	}
+
+	updateIndices();
+	reserve(static_cast<uint32>(m_sim->N + parts.size()));
+	m_indices.reserve(static_cast<uint32>(m_sim->N + parts.size()));
+	m_hashNameMap.reserve(m_hashNameMap.size() + parts.size());
+	m_nameHashMap.reserve(m_nameHashMap.size() + parts.size());
+	for (size_t i = 0; i < parts.size(); ++i) {
+		const int lastN = m_sim->N;
+		reb_add(m_sim, parts[i]);
+		if (m_sim->N == lastN)
+			continue; // Rebound did not add the particle, and reported why
+		m_indices.set(parts[i].hash, static_cast<uint32>(lastN));
+		m_indexedCount = m_sim->N;
+		m_hashNameMap.insert(std::make_pair(parts[i].hash, names[i]));
+		m_nameHashMap.insert(std::make_pair(names[i], parts[i].hash));
+	}
+}
+
+// ================================================================================================
+void ParticleManager::reserve(uint32 count)
+{
+	if (static_cast<int>(count) <= m_sim->allocatedN)
+		return;
+
+	const uint32 primaryHash = m_primaryParticle ? m_primaryParticle->hash : 0;
+	m_sim->particles = static_cast<reb_particle*>(realloc(m_sim->particles, sizeof(reb_particle) * count));
+	m_sim->allocatedN = static_cast<int>(count);
+	if (m_primaryParticle)
+		m_primaryParticle = getParticleByHash(primaryHash);
+}
+
 // ================================================================================================
 void ParticleManager::removeParticleByName(const String& name, reb_particle *out)
 {
@@ -54,11 +104,12 @@ void ParticleManager::removeParticleByName(const String& name, reb_particle *out
 		return;
 	}
 
-	reb_particle *part = reb_get_particle_by_hash(m_sim, it->second);
-	if (part) {
+	const int64 index = findIndex(it->second);
+	if (index >= 0) {
+		reb_particle *part = &(m_sim->particles[index]);
 		if (out)
 			*out = *part;
-		reb_remove_by_hash(m_sim, it->second, 1);
+		removeIndex(static_cast<uint32>(index), it->second);
 
 		if (m_primaryParticle == part)
 			m_primaryParticle = nullptr;
@@ -70,11 +121,12 @@ void ParticleManager::removeParticleByName(const String& name, reb_particle *out
 // ================================================================================================
 void ParticleManager::removeParticleByHash(uint32 hash, reb_particle *out)
 {
-	reb_particle *part = reb_get_particle_by_hash(m_sim, hash);
-	if (part) {
+	const int64 index = findIndex(hash);
+	if (index >= 0) {
+		reb_particle *part = &(m_sim->particles[index]);
 		if (out)
 			*out = *part;
-		reb_remove_by_hash(m_sim, hash, 1);
+		removeIndex(static_cast<uint32>(index), hash);
 
 		if (m_primaryParticle == part)
 			m_primaryParticle = nullptr;
@@ -91,16 +143,21 @@ void ParticleManager::removeParticleByHash(uint32 hash, reb_particle *out)
 }
 
 // ================================================================================================
-void ParticleManager::removeParticleName(uint32 hash)
+void ParticleManager::removeCollisionParticle(uint32 index)
 {
-	reb_particle *part = reb_get_particle_by_hash(m_sim, hash);
-	if (part) {
-		if (m_primaryParticle == part)
-			m_primaryParticle = nullptr;
-	}
-	else
+	if (static_cast<int>(index) >= m_sim->N)
 		return;
 
+	reb_particle *part = &(m_sim->particles[index]);
+	const uint32 hash = part->hash;
+	if (m_primaryParticle == part)
+		m_primaryParticle = nullptr;
+
+	// The indices of the particles that rebound moves into the slot are updated at the next lookup
+	m_indices.erase(hash);
+	m_collisionSlots.push_back(index);
+	--m_indexedCount;
+
 	auto it = m_hashNameMap.find(hash);
 	if (it == m_hashNameMap.end())
 		return;
@@ -116,15 +173,15 @@ reb_particle* ParticleManager::getParticleByName(const String& name)
 	if (it == m_nameHashMap.end())
 		return nullptr;
 
-	reb_particle* part = reb_get_particle_by_hash(m_sim, it->second);
-	return part;
+	const int64 index = findIndex(it->second);
+	return (index >= 0) ? &(m_sim->particles[index]) : nullptr;
 }
 
 // ================================================================================================
 reb_particle* ParticleManager::getParticleByHash(uint32 hash)
 {
-	reb_particle* part = reb_get_particle_by_hash(m_sim, hash);
-	return part;
+	const int64 index = findIndex(hash);
+	return (index >= 0) ? &(m_sim->particles[index]) : nullptr;
 }
 
 // ================================================================================================
@@ -174,13 +231,78 @@ bool ParticleManager::setPrimaryParticle(uint32 hash)
 }
 
 // ================================================================================================
-int ParticleManager::getOrbitForParticle(const reb_particle * const part, reb_orbit& orbit)
+void ParticleManager::updateIndices()
 {
-	int err = 0;
-	if (m_primaryParticle)
-		orbit = reb_tools_particle_to_orbit_err(m_sim->G, *part, *m_primaryParticle, &err);
-	else
-		orbit = reb_tools_particle_to_orbit_err(m_sim->G, *part, reb_get_com(m_sim), &err);
-	
-	return err;
+	if (m_indexedCount != m_sim->N) {
+		rebuildIndices();
+		return;
+	}
+	if (m_collisionSlots.empty())
+		return;
+
+	// Rebound either shifts all of the particles after each removed particle down, or moves the last particle
+	//     into the removed slot, so only those particles have new indices
+	const reb_particle * const particles = m_sim->particles;
+	const uint32 count = static_cast<uint32>(m_sim->N);
+	if (m_sim->collision_resolve_keep_sorted) {
+		const uint32 first = *std::min_element(m_collisionSlots.begin(), m_collisionSlots.end());
+		for (uint32 i = first; i < count; ++i)
+			m_indices.set(particles[i].hash, i);
+	}
+	else {
+		for (const uint32 slot : m_collisionSlots) {
+			if (slot < count)
+				m_indices.set(particles[slot].hash, slot);
+		}
+	}
+	m_collisionSlots.clear();
+}
+
+// ================================================================================================
+void ParticleManager::rebuildIndices()
+{
+	const uint32 count = static_cast<uint32>(m_sim->N);
+	m_indices.clear();
+	m_indices.reserve(count);
+	for (uint32 i = 0; i < count; ++i)
+		m_indices.set(m_sim->particles[i].hash, i);
+	m_indexedCount = m_sim->N;
+	m_collisionSlots.clear();
+}
+
+// ================================================================================================
+int64 ParticleManager::findIndex(uint32 hash)
+{
+	updateIndices();
+	int64 index = m_indices.find(hash);
+	// A wrong index means that something outside of the manager moved the particles without changing the count.
+	//     A miss is only stale for a particle the manager added (they are all named), so looking up a particle
+	//     that does not exist stays a single lookup.
+	const bool stale = (index >= 0) ? (m_sim->particles[index].hash != hash) :
+		(m_hashNameMap.find(hash) != m_hashNameMap.end());
+	if (stale) {
+		rebuildIndices();
+		index = m_indices.find(hash);
+	}
+	return index;
+}
+
+// ================================================================================================
+void ParticleManager::removeIndex(uint32 index, uint32 hash)
+{
+	reb_remove(m_sim, static_cast<int>(index), 1);
+	if (m_sim->N != (m_indexedCount - 1))
+		return; // Rebound did not remove the particle and reported why, or the next update rebuilds the indices
+
+	// The particles after the removed one were all shifted down, which is cheaper to apply to the whole table at
+	//     once than to look up each of them, unless they are only the last few
+	m_indices.erase(hash);
+	const uint32 count = static_cast<uint32>(m_sim->N);
+	if ((count - index) > (m_indices.capacity() / PARTICLE_MANAGER_SHIFT_RATIO))
+		m_indices.shiftDown(index);
+	else {
+		for (uint32 i = index; i < count; ++i)
+			m_indices.set(m_sim->particles[i].hash, i);
+	}
+	m_indexedCount = m_sim->N;
 }
\ No newline at end of file
@@ -14,6 +14,10 @@
 
 #include "../../luabound.hpp"
 #include "../../sim/particle.hpp"
+#include "../../util/hash_index.hpp"
+
+// Shifting every index in the table costs about as much as setting the index of one particle for this many slots
+#define PARTICLE_MANAGER_SHIFT_RATIO (24)
 
 class ParticleManager
 {
@@ -26,17 +30,26 @@ private:
 	HashNameLookup m_hashNameMap;
 	NameHashLookup m_nameHashMap;
 	reb_particle* m_primaryParticle;
+	HashIndexTable m_indices; // The index of each particle in the rebound array, from its hash
+	int m_indexedCount; // The particle count that the indices match, anything else means the array changed elsewhere
+	StlVector<uint32> m_collisionSlots; // The indices of the particles that collisions removed since the last update
 
 public:
 	ParticleManager(reb_simulation *sim);
 	~ParticleManager();
 
 	reb_particle* addParticle(const String& name, reb_particle part);
+	// Adds many particles at once, with the space for all of them reserved first
+	void addParticles(const StlVector<String>& names, const StlVector<reb_particle>& parts);
+	// Grows the rebound particle array to fit the particle count, which rebound would otherwise grow by 128
+	//     particles at a time. The primary particle is kept pointing at the same particle.
+	void reserve(uint32 count);
 
 	void removeParticleByName(const String& name, reb_particle *out);
 	void removeParticleByHash(uint32 hash, reb_particle *out);
 
-	void removeParticleName(uint32 hash); // Used by the collision callback
+	// Used by the collision callback, before rebound removes the particle at the index
+	void removeCollisionParticle(uint32 index);
 
 	reb_particle* getParticleByName(const String& name);
 	reb_particle* getParticleByHash(uint32 hash);
@@ -49,8 +62,17 @@ public:
 	bool setPrimaryParticle(const String& name);
 	bool setPrimaryParticle(uint32 hash);
 
-	int getOrbitForParticle(const reb_particle * const part, reb_orbit& orbit); // Might move this elsewhere eventually
-	
+private:
+	// Updates the indices of the particles that rebound moved while removing collided particles, or rebuilds
+	//     all of them if the particles were added or removed outside of the manager
+	void updateIndices();
+	void rebuildIndices();
+	// Gives the index of the particle with the hash, or -1 if there is no such particle. The indices are only
+	//     rebuilt if they are stale, which a miss only is for a particle that the manager knows.
+	int64 findIndex(uint32 hash);
+	// Removes the particle with rebound, keeping the rest in order, then shifts the indices after it
+	void removeIndex(uint32 index, uint32 hash);
+
 	LUABOUND_DECLARE_CLASS_NONCOPYABLE(ParticleManager)
 };
 
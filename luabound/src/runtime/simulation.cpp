@@ -10,6 +10,7 @@
 
 #include "simulation.hpp"
 #include "integrator_parser.hpp"
+#include "../util/counter_rng.hpp"
 
 namespace
 {
@@ -135,6 +136,32 @@ bool LbdSimulation::parseSimulationResults(sol::table& table)
 		linfo(strfmt("Loading new simulation with name '%s'.", m_simName.c_str()));
 	}
 
+	// ===== Random Seed =====
+	sol::object seedObj;
+	if ((seedObj = table["seed"]) == sol::nil) {
+		linfo(strfmt("No seed was given, using the random seed %llu.", static_cast<unsigned long long>(rng::GetSeed())));
+	}
+	else {
+		const double seed = (seedObj.get_type() == sol::type::number) ? seedObj.as<double>() : -1;
+		if (seed < 0 || seed != floor(seed) || seed > RNG_MAX_SEED) {
+			lerr("The simulation seed must be a whole number of at least 0.");
+			return false;
+		}
+		rng::SetSeed(static_cast<uint64>(seed));
+		linfo(strfmt("Using the seed %llu.", static_cast<unsigned long long>(rng::GetSeed())));
+	}
+
+	// ===== Populate Threads =====
+	sol::object threadsObj;
+	if ((threadsObj = table["populate_threads"]) != sol::nil) {
+		const double threads = (threadsObj.get_type() == sol::type::number) ? threadsObj.as<double>() : -1;
+		if (threads < 0 || threads != floor(threads) || threads > UINT32_MAX) {
+			lerr("The simulation 'populate_threads' entry must be a whole number of at least 0.");
+			return false;
+		}
+		m_pFactory->setThreads(static_cast<uint32>(threads));
+	}
+
 	// ===== Simulation Constants =====
 	sol::object constantsTableObj;
 	if ((constantsTableObj = table["constants"]) == sol::nil) {
@@ -222,6 +249,19 @@ bool LbdSimulation::parseSimulationResults(sol::table& table)
 		linfo("Loaded file output settings.");
 	}
 
+	// ===== File Output Settings Table =====
+	sol::object outputSettingsObj;
+	if ((outputSettingsObj = table["output_settings"]) != sol::nil) {
+		if (!outputSettingsObj.is<sol::table>()) {
+			lerr("The simulation 'output_settings' entry was not a table.");
+			return false;
+		}
+		sol::table outputSettings = outputSettingsObj.as<sol::table>();
+		if (!m_oManager->loadSettings(outputSettings)) {
+			return false;
+		}
+	}
+
 	lsetPrefix("");
 	linfo(String(header.length(), '='));
 
@@ -239,7 +279,9 @@ void LbdSimulation::runSimulation()
 
 	reb_move_to_com(m_sim);
 	m_wallTimer.start();
+	m_oManager->start();
 	reb_integrate(m_sim, m_simMaxTime);
+	m_oManager->finish();
 
 	m_pluginManager->shutdown(m_sim);
 }
@@ -361,6 +403,7 @@ void LbdSimulation::additionalForcesCallback(reb_simulation *sim)
 void LbdSimulation::preTimestepCallback(reb_simulation *sim)
 {
 	m_pluginManager->preTimestep(sim);
+	m_oManager->limitTimestep();
 }
 
 // ================================================================================================
@@ -387,11 +430,12 @@ void LbdSimulation::heartbeatCallback(reb_simulation *sim)
 int LbdSimulation::collisionCallback(reb_simulation *sim, reb_collision col)
 {
 	int rem = m_pluginManager->collision(sim, col);
+	m_oManager->notifyCollision();
 	if (rem == 1 || rem == 3) {
-		m_pManager->removeParticleName(col.p1);
+		m_pManager->removeCollisionParticle(static_cast<uint32>(col.p1));
 	}
 	if (rem == 2 || rem == 3) {
-		m_pManager->removeParticleName(col.p2);
+		m_pManager->removeCollisionParticle(static_cast<uint32>(col.p2));
 	}
 
 	return rem;
@@ -467,15 +511,13 @@ void RegisterSimulationGlobals(sol::state& lua)
 					throw "Logic Error";
 				}
 
-				for (int i = 0; i < pcount; ++i) {
-					String thisname = pname;
-					reb_particle part = pf->createParticle(mass, radius, place, refpart, thisname, true);
-					if (part.m < 0.0) {
-						throw "Logic Error"; // The createParticle() function should report the error, only exit here
-					}
-
-					reb_particle *npart = pm->addParticle(thisname, part);
+				// The arguments are parsed once, and all of the particles are generated before any are added
+				StlVector<reb_particle> parts;
+				StlVector<String> names;
+				if (!pf->createParticles(mass, radius, place, refpart, pname, static_cast<uint32>(pcount), parts, names)) {
+					throw "Logic Error"; // The createParticles() function should report the error, only exit here
 				}
+				pm->addParticles(names, parts);
 			}
 		),
 		"getParticle", sol::overload(
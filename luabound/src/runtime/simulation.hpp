@@ -91,6 +91,7 @@ public:
 
 	inline ParticleManager* getManager() { return m_pManager; }
 	inline ParticleFactory* getFactory() { return m_pFactory; }
+	inline OutputManager* getOutputManager() { return m_oManager; }
 	inline reb_simulation* const getSimulation() { return m_sim; }
 
 	void forceExit();
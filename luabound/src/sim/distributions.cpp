@@ -10,19 +10,30 @@
 #include "distributions.hpp"
 
 // ================================================================================================
-double value_distribution::generate() const
+double value_distribution::generate(random_stream& rng) const
 {
 	switch (type) {
 		case DIST_TYPE_UNIFORM: 
-			return reb_random_uniform(uniform.min, uniform.max);
-		case DIST_TYPE_POWERLAW:
-			return reb_random_powerlaw(powerlaw.min, powerlaw.max, powerlaw.slope);
-		case DIST_TYPE_NORMAL:
-			return normal.mean + reb_random_normal(normal.variance);
+			return uniform.min + (uniform.max - uniform.min) * rng.uniform();
+		case DIST_TYPE_POWERLAW: {
+			const double y = rng.uniform();
+			if (powerlaw.slope == -1)
+				return exp(y * log(powerlaw.max / powerlaw.min) + log(powerlaw.min));
+			const double pmin = pow(powerlaw.min, powerlaw.slope + 1);
+			const double pmax = pow(powerlaw.max, powerlaw.slope + 1);
+			return pow((pmax - pmin) * y + pmin, 1 / (powerlaw.slope + 1));
+		}
+		case DIST_TYPE_NORMAL: {
+			// Box-Muller instead of Rebound's polar method, so a value never needs more than one field
+			double u1, u2;
+			rng.uniform2(u1, u2);
+			return normal.mean + sqrt(-2 * log(u1) * normal.variance) * cos(2 * M_PI * u2);
+		}
 		case DIST_TYPE_RAYLEIGH:
-			return reb_random_rayleigh(rayleigh.sigma);
+			return rayleigh.sigma * sqrt(-2 * log(rng.uniform()));
 		case DIST_TYPE_SINGULAR: 
 		default:
+			rng.skip();
 			return singular.value;
 	}
 }
@@ -37,7 +48,7 @@ void RegisterDistributionGlobals(sol::state& lua)
 	//     construct it directly
 	lua.new_usertype<value_distribution>("__value_distribution_",
 		"new", sol::no_constructor,
-		"generate", &value_distribution::generate,
+		"generate", &value_distribution::luaGenerate,
 		"type", sol::readonly(&value_distribution::type),
 		"min", sol::readonly_property(&value_distribution::getMin),
 		"max", sol::readonly_property(&value_distribution::getMax),
@@ -6,14 +6,15 @@
  *
  * This file declares the structure that is used in the Lua code to generate distributions
  *     and values for simulation parameters. These distributions match the reb_random_* functions
- *     present in the Rebound source code, and use these functions internally, to ensure maximum
- *     compliance with Rebound code.
+ *     present in the Rebound source code, but draw from the counter-based generator instead of
+ *     rand(), so that the values do not depend on the order they are generated in.
  */
  
 #ifndef LUABOUND_DISTRIBUTIONS_HPP_
 #define LUABOUND_DISTRIBUTIONS_HPP_
 
 #include "../luabound.hpp"
+#include "../util/counter_rng.hpp"
 
 // Used to represent a distribution of values with the ability to generate random values from
 //     the given distribution. Internally, uses a union to hold the various potential
@@ -94,7 +95,11 @@ public:
 		return (type == DIST_TYPE_RAYLEIGH) ? rayleigh.sigma : 0.0;
 	}
 
-	double generate() const;
+	// Generates the value for the next field of the stream. Every distribution uses exactly one field,
+	//     including singular distributions, so the fields after it never depend on the types before it.
+	double generate(random_stream& rng) const;
+	// Generates the next value from the script stream, for dist:generate() in lua
+	inline double luaGenerate() const { return generate(random_stream::Script()); }
 
 	inline static bool FromLuaObject(sol::object& obj, value_distribution *dist) {
 		if (obj.is<value_distribution>()) {
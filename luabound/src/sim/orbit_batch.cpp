@@ -0,0 +1,462 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file implements the functions used to convert between the orbital elements and the cartesian coordinates
+ *     of many particles at once, against a shared primary.
+ */
+
+#include "orbit_batch.hpp"
+#include <algorithm>
+#include <limits>
+
+// The number of particles in each block, small enough that the values passed between the loops stay in
+//     the cache
+#define ORBIT_BLOCK_SIZE (256)
+// The same limits as in rebound/tools.c
+#define ORBIT_TINY (1.E-308)
+#define ORBIT_MIN_INC (1.e-8)
+// The largest angle that _sincos reduces accurately, larger angles use the rebound functions
+#define ORBIT_SINCOS_LIMIT (823549.6)
+// The Danby iterations for Kepler's equation, which converge to the last bits for any e < 1
+#define ORBIT_KEPLER_ITERATIONS (5)
+
+
+namespace
+{
+
+// The values for a block of particles that are passed between the loops. The positions and velocities relative
+//     to the primary are copied out of the particles first, so the arithmetic loop only reads contiguous arrays.
+struct orbit_block
+{
+	double dx[ORBIT_BLOCK_SIZE], dy[ORBIT_BLOCK_SIZE], dz[ORBIT_BLOCK_SIZE];
+	double dvx[ORBIT_BLOCK_SIZE], dvy[ORBIT_BLOCK_SIZE], dvz[ORBIT_BLOCK_SIZE];
+	double m[ORBIT_BLOCK_SIZE];
+	double hz[ORBIT_BLOCK_SIZE];
+	double vr[ORBIT_BLOCK_SIZE];
+	double ex[ORBIT_BLOCK_SIZE], ey[ORBIT_BLOCK_SIZE], ez[ORBIT_BLOCK_SIZE];
+	double nx[ORBIT_BLOCK_SIZE], ny[ORBIT_BLOCK_SIZE], n[ORBIT_BLOCK_SIZE];
+	double inc[ORBIT_BLOCK_SIZE], Omega[ORBIT_BLOCK_SIZE], omega[ORBIT_BLOCK_SIZE], f[ORBIT_BLOCK_SIZE];
+	double ea[ORBIT_BLOCK_SIZE];
+};
+
+// The inputs and outputs for a block of particles in the conversions to cartesian coordinates. The values are copied
+//     in and out of the block, so that the arithmetic loop only uses arrays that cannot overlap.
+struct cartesian_block
+{
+	double in[7][ORBIT_BLOCK_SIZE]; // The mass, then the elements in the order of the function arguments
+	double out[6][ORBIT_BLOCK_SIZE]; // x, y, z, vx, vy, vz
+};
+
+// The coefficients of the rational approximation to asin used by acos in fdlibm (e_acos.c)
+const double ACOS_PS0 =  1.66666666666666657415e-01;
+const double ACOS_PS1 = -3.25565818622400915405e-01;
+const double ACOS_PS2 =  2.01212532134862925881e-01;
+const double ACOS_PS3 = -4.00555345006794114027e-02;
+const double ACOS_PS4 =  7.91534994289814532176e-04;
+const double ACOS_PS5 =  3.47933107596021167570e-05;
+const double ACOS_QS1 = -2.40339491173441421878e+00;
+const double ACOS_QS2 =  2.02094576023350569471e+00;
+const double ACOS_QS3 = -6.88283971605453293030e-01;
+const double ACOS_QS4 =  7.70381505559019352791e-02;
+const double ACOS_PIO2_HI = 1.57079632679489655800e+00;
+const double ACOS_PIO2_LO = 6.12323399573676603587e-17;
+
+// The same algorithm as acos in fdlibm (within 1 ulp of the libm acos), but with every branch calculated and
+//     then selected, so that loops calling it can be vectorized. Only valid for -1 <= x <= 1.
+inline double _acos(double x)
+{
+	const double ax = fabs(x);
+	const double z = (ax < 0.5) ? (x * x) : ((1. - ax) * 0.5);
+	const double p = z * (ACOS_PS0 + z * (ACOS_PS1 + z * (ACOS_PS2 + z * (ACOS_PS3 + z * (ACOS_PS4 + z * ACOS_PS5)))));
+	const double q = 1. + z * (ACOS_QS1 + z * (ACOS_QS2 + z * (ACOS_QS3 + z * ACOS_QS4)));
+	const double r = p / q;
+
+	// |x| < 0.5
+	const double small = ACOS_PIO2_HI - (x - (ACOS_PIO2_LO - x * r));
+	// x <= -0.5
+	const double s = sqrt(z);
+	const double negative = 2. * (ACOS_PIO2_HI - (s + (r * s - ACOS_PIO2_LO)));
+	// x >= 0.5, where s is split into a high part with the low 32 bits cleared and a correction
+	uint64 sbits;
+	memcpy(&sbits, &s, sizeof(double));
+	sbits &= 0xFFFFFFFF00000000ULL;
+	double df;
+	memcpy(&df, &sbits, sizeof(double));
+	const double c = (s > 0.) ? ((z - df * df) / (s + df)) : 0.;
+	const double positive = 2. * (df + (r * s + c));
+
+	return (ax < 0.5) ? small : ((x < 0.) ? negative : positive);
+}
+
+// The same as acos2 in rebound/tools.c, which gets the angle from the cosine, with the sign of the disambiguator.
+//     Cosines outside of (-1, 1) are clamped instead of branching, which gives the same values, and NaN gives 0.
+inline double _acos2(double num, double denom, double disambiguator)
+{
+	const double cosine = num / denom;
+	const double clamped = (cosine < 1.) ? ((cosine > -1.) ? cosine : -1.) : 1.;
+	const double val = _acos((cosine == cosine) ? clamped : 1.);
+	return (disambiguator < 0.) ? ((cosine > -1.) ? (0. - val) : val) : val; // 0 - val keeps acos(1) from being -0
+}
+
+
+// The parts of pi/2 for the argument reduction in fdlibm (e_rem_pio2.c), each with 33 bits, and the tail of the second
+const double SC_INVPIO2 = 6.36619772367581382433e-01;
+const double SC_PIO2_1 = 1.57079632673412561417e+00;
+const double SC_PIO2_2 = 6.07710050630396597660e-11;
+const double SC_PIO2_2T = 2.02226624879595063154e-21;
+// Adding and subtracting this rounds to the nearest whole number, for values below 2^51
+const double SC_ROUND = 6755399441055744.0;
+// The coefficients of the sine and cosine polynomials in fdlibm (k_sin.c and k_cos.c)
+const double SIN_S1 = -1.66666666666666324348e-01;
+const double SIN_S2 =  8.33333333332248946124e-03;
+const double SIN_S3 = -1.98412698298579493134e-04;
+const double SIN_S4 =  2.75573137070700676789e-06;
+const double SIN_S5 = -2.50507602534068634195e-08;
+const double SIN_S6 =  1.58969099521155010221e-10;
+const double COS_C1 =  4.16666666666666019037e-02;
+const double COS_C2 = -1.38888888888741095749e-03;
+const double COS_C3 =  2.48015872894767294178e-05;
+const double COS_C4 = -2.75573143513906633035e-07;
+const double COS_C5 =  2.08757232129817482790e-09;
+const double COS_C6 = -1.13596475577881948265e-11;
+
+// The same algorithm as sin and cos in fdlibm (within 1 ulp of the libm functions), for both at once, but with every
+//     quadrant calculated and then selected, so that loops calling it can be vectorized. Only accurate for |x| below
+//     ORBIT_SINCOS_LIMIT, where two parts of pi/2 are enough for the reduction.
+inline void _sincos(double x, double& sinx, double& cosx)
+{
+	// Reduce to y + yl in [-pi/4, pi/4], with x = y + yl + n * pi/2
+	const double fn = (x * SC_INVPIO2 + SC_ROUND) - SC_ROUND;
+	const double t = x - fn * SC_PIO2_1;
+	const double w = fn * SC_PIO2_2;
+	const double r = t - w;
+	const double wt = fn * SC_PIO2_2T - ((t - r) - w);
+	const double y = r - wt;
+	const double yl = (r - y) - wt;
+
+	const double z = y * y;
+	const double v = z * y;
+	const double sr = SIN_S2 + z * (SIN_S3 + z * (SIN_S4 + z * (SIN_S5 + z * SIN_S6)));
+	const double sn = y - ((z * (0.5 * yl - v * sr) - yl) - v * SIN_S1);
+	const double zz = z * z;
+	const double cr = z * (COS_C1 + z * (COS_C2 + z * COS_C3)) + zz * zz * (COS_C4 + z * (COS_C5 + z * COS_C6));
+	const double hz = 0.5 * z;
+	const double cw = 1. - hz;
+	const double cs = cw + (((1. - cw) - hz) + (z * cr - y * yl));
+
+	// The quadrant is n mod 4, as a value in [-2, 2], so that it is selected on without leaving the vector registers
+	const double quadrant = fn - 4. * ((fn * 0.25 + SC_ROUND) - SC_ROUND);
+	const double absQuadrant = fabs(quadrant);
+	const bool swap = (absQuadrant == 1.);
+	const bool sinNegative = (quadrant > 1.5) || (quadrant < -0.5); // 2 or 3
+	const bool cosNegative = (absQuadrant > 1.5) || (quadrant == 1.); // 1 or 2
+	const double s0 = swap ? cs : sn;
+	const double c0 = swap ? sn : cs;
+	sinx = sinNegative ? -s0 : s0;
+	cosx = cosNegative ? -c0 : c0;
+}
+
+} // namespace
+
+
+namespace orbits
+{
+
+// ================================================================================================
+void orbit_batch::resize(size_t count)
+{
+	a.resize(count);
+	e.resize(count);
+	inc.resize(count);
+	Omega.resize(count);
+	omega.resize(count);
+	f.resize(count);
+	M.resize(count);
+	h.resize(count);
+	d.resize(count);
+	err.resize(count);
+}
+
+// ================================================================================================
+void calculate(double G, const reb_particle *particles, size_t count, const reb_particle& primary,
+	orbit_batch& out)
+{
+	static const double NaN = std::numeric_limits<double>::quiet_NaN();
+
+	out.resize(count);
+	if (count == 0)
+		return;
+
+	// A massless primary fails for every particle
+	if (primary.m <= ORBIT_TINY) {
+		for (auto arr : { &out.a, &out.e, &out.inc, &out.Omega, &out.omega, &out.f, &out.M, &out.h, &out.d })
+			std::fill(arr->begin(), arr->end(), NaN);
+		std::fill(out.err.begin(), out.err.end(), 1);
+		return;
+	}
+
+	const double PX = primary.x, PY = primary.y, PZ = primary.z;
+	const double PVX = primary.vx, PVY = primary.vy, PVZ = primary.vz;
+	const double PM = primary.m;
+	orbit_block block;
+	for (size_t base = 0; base < count; base += ORBIT_BLOCK_SIZE) {
+		const size_t BCOUNT = std::min(count - base, static_cast<size_t>(ORBIT_BLOCK_SIZE));
+		const reb_particle * const PARTS = particles + base;
+		double * const A = out.a.data() + base;
+		double * const E = out.e.data() + base;
+		double * const H = out.h.data() + base;
+		double * const D = out.d.data() + base;
+
+		// Copy the values relative to the primary into the block
+		for (size_t i = 0; i < BCOUNT; ++i) {
+			const reb_particle& p = PARTS[i];
+			block.dx[i] = p.x - PX; block.dy[i] = p.y - PY; block.dz[i] = p.z - PZ;
+			block.dvx[i] = p.vx - PVX; block.dvy[i] = p.vy - PVY; block.dvz[i] = p.vz - PVZ;
+			block.m[i] = p.m;
+		}
+
+		// Everything besides the angles, in the same order of operations as reb_tools_particle_to_orbit_err
+		for (size_t i = 0; i < BCOUNT; ++i) {
+			const double mu = G * (block.m[i] + PM);
+			const double dx = block.dx[i], dy = block.dy[i], dz = block.dz[i];
+			const double dvx = block.dvx[i], dvy = block.dvy[i], dvz = block.dvz[i];
+			const double dist = sqrt(dx * dx + dy * dy + dz * dz);
+
+			const double vsquared = dvx * dvx + dvy * dvy + dvz * dvz;
+			const double vcircsquared = mu / dist;
+			A[i] = -mu / (vsquared - 2. * vcircsquared);
+
+			const double hx = (dy * dvz - dz * dvy);
+			const double hy = (dz * dvx - dx * dvz);
+			const double hz = (dx * dvy - dy * dvx);
+			H[i] = sqrt(hx * hx + hy * hy + hz * hz);
+
+			const double vdiffsquared = vsquared - vcircsquared;
+			const double vr = (dx * dvx + dy * dvy + dz * dvz) / dist;
+			const double rvr = dist * vr;
+			const double muinv = 1. / mu;
+			const double ex = muinv * (vdiffsquared * dx - rvr * dvx);
+			const double ey = muinv * (vdiffsquared * dy - rvr * dvy);
+			const double ez = muinv * (vdiffsquared * dz - rvr * dvz);
+			E[i] = sqrt(ex * ex + ey * ey + ez * ez);
+
+			D[i] = dist;
+			block.hz[i] = hz;
+			block.vr[i] = vr;
+			block.ex[i] = ex; block.ey[i] = ey; block.ez[i] = ez;
+			block.nx[i] = -hy; block.ny[i] = hx;
+			block.n[i] = sqrt(hy * hy + hx * hx);
+		}
+
+		// The angles, with the planar or non-planar formulas picked for each particle instead of branching. The planar
+		//     formulas use the true longitude and the longitude of pericenter, and the non-planar formulas use the
+		//     argument of latitude (omega + f) and the argument of pericenter. These are written to the block, so
+		//     that the loop does not need to check if the output arrays overlap.
+		for (size_t i = 0; i < BCOUNT; ++i) {
+			const double e = E[i], dist = D[i];
+			const double dx = block.dx[i], dy = block.dy[i], dz = block.dz[i];
+			const double ex = block.ex[i], ey = block.ey[i], ez = block.ez[i];
+			const double nx = block.nx[i], ny = block.ny[i], n = block.n[i];
+
+			const double inc = _acos2(block.hz[i], H[i], 1.);
+			const double Omega = _acos2(nx, n, ny);
+			const bool planar = (inc < ORBIT_MIN_INC) | (inc > M_PI - ORBIT_MIN_INC);
+			const double pos = _acos2(planar ? dx : (nx * dx + ny * dy), planar ? dist : (n * dist), planar ? dy : dz);
+			const double peri = _acos2(planar ? ex : (nx * ex + ny * ey), planar ? e : (n * e), planar ? ey : ez);
+			const bool retrograde = planar & (inc >= M_PI / 2.);
+
+			const double planarOmega = retrograde ? (Omega - peri) : (peri - Omega);
+			const double omega = planar ? planarOmega : peri;
+			const double f = retrograde ? (peri - pos) : (pos - peri);
+
+			block.inc[i] = inc;
+			block.Omega[i] = Omega;
+			block.omega[i] = omega;
+			block.f[i] = f;
+			block.ea[i] = _acos2(1. - dist / A[i], e, block.vr[i]);
+		}
+
+		// The mean anomaly and the errors, which are rare enough that the branches are cheap
+		double * const INC = out.inc.data() + base;
+		double * const BOMEGA = out.Omega.data() + base;
+		double * const SOMEGA = out.omega.data() + base;
+		double * const F = out.f.data() + base;
+		double * const MA = out.M.data() + base;
+		int * const ERR = out.err.data() + base;
+		for (size_t i = 0; i < BCOUNT; ++i) {
+			if (D[i] <= ORBIT_TINY) { // The particle is on top of the primary
+				ERR[i] = 2;
+				A[i] = E[i] = INC[i] = BOMEGA[i] = SOMEGA[i] = F[i] = MA[i] = H[i] = D[i] = NaN;
+				continue;
+			}
+
+			const double e = E[i];
+			if (e < 1.) {
+				const double ea = block.ea[i];
+				MA[i] = ea - e * sin(ea);
+			}
+			else {
+				double ea = acosh((1. - D[i] / A[i]) / e);
+				if (block.vr[i] < 0.)
+					ea = -ea;
+				MA[i] = e * sinh(ea) - ea;
+			}
+			ERR[i] = 0;
+			INC[i] = block.inc[i];
+			BOMEGA[i] = block.Omega[i];
+			SOMEGA[i] = block.omega[i];
+			F[i] = block.f[i];
+		}
+	}
+}
+
+
+
+// ================================================================================================
+void elements_to_cartesian(double G, const reb_particle& primary, const double *m, const double *a, const double *e,
+	const double *inc, const double *Omega, const double *omega, const double *f, size_t count, double * const *out,
+	int *err)
+{
+	static const double NaN = std::numeric_limits<double>::quiet_NaN();
+
+	const double PX = primary.x, PY = primary.y, PZ = primary.z;
+	const double PVX = primary.vx, PVY = primary.vy, PVZ = primary.vz;
+	const double PM = primary.m;
+	const double * const INPUTS[7] = { m, a, e, inc, Omega, omega, f };
+	cartesian_block block;
+	for (size_t base = 0; base < count; base += ORBIT_BLOCK_SIZE) {
+		const size_t BCOUNT = std::min(count - base, static_cast<size_t>(ORBIT_BLOCK_SIZE));
+		for (uint32 v = 0; v < 7; ++v)
+			std::copy(INPUTS[v] + base, INPUTS[v] + base + BCOUNT, block.in[v]);
+
+		// The same order of operations as reb_tools_orbit_to_particle_err
+		for (size_t i = 0; i < BCOUNT; ++i) {
+			const double bm = block.in[0][i], ba = block.in[1][i], be = block.in[2][i];
+			double cO, sO, co, so, cf, sf, ci, si;
+			_sincos(block.in[4][i], sO, cO);
+			_sincos(block.in[5][i], so, co);
+			_sincos(block.in[6][i], sf, cf);
+			_sincos(block.in[3][i], si, ci);
+
+			const double r = ba * (1 - be * be) / (1 + be * cf);
+			const double v0 = sqrt(G * (bm + PM) / ba / (1. - be * be));
+
+			// Murray & Dermott Eq 2.122
+			block.out[0][i] = PX + r * (cO * (co * cf - so * sf) - sO * (so * cf + co * sf) * ci);
+			block.out[1][i] = PY + r * (sO * (co * cf - so * sf) + cO * (so * cf + co * sf) * ci);
+			block.out[2][i] = PZ + r * (so * cf + co * sf) * si;
+			// Murray & Dermott Eq. 2.36 after applying the 3 rotation matrices from Sec. 2.8 to the velocities in
+			//     the orbital plane
+			block.out[3][i] = PVX + v0 * ((be + cf) * (-ci * co * sO - cO * so) - sf * (co * cO - ci * so * sO));
+			block.out[4][i] = PVY + v0 * ((be + cf) * (ci * co * cO - sO * so) - sf * (co * sO + ci * so * cO));
+			block.out[5][i] = PVZ + v0 * ((be + cf) * co * si - sf * si * so);
+		}
+
+		for (uint32 v = 0; v < 6; ++v)
+			std::copy(block.out[v], block.out[v] + BCOUNT, out[v] + base);
+	}
+
+	// The errors, and the angles that are too large for the fast reduction (or not finite), are rare enough to check
+	//     one at a time. The errors are checked in the same order as rebound, and only hyperbolic orbits can be past
+	//     their asymptotes.
+	for (size_t i = 0; i < count; ++i) {
+		const int code = (e[i] == 1.) ? 1 : (e[i] < 0.) ? 2 : (e[i] > 1.) ? ((a[i] > 0.) ? 3 : 0) : ((a[i] < 0.) ? 4 : 0);
+		err[i] = ((code == 0) && (e[i] > 1.) && (e[i] * cos(f[i]) < -1.)) ? 5 : code;
+		if (err[i] != 0) {
+			for (uint32 v = 0; v < 6; ++v)
+				out[v][i] = NaN;
+			continue;
+		}
+
+		const double maxAngle = std::max(std::max(fabs(Omega[i]), fabs(omega[i])), std::max(fabs(f[i]), fabs(inc[i])));
+		if (maxAngle < ORBIT_SINCOS_LIMIT)
+			continue;
+		const reb_particle p = reb_tools_orbit_to_particle_err(G, primary, m[i], a[i], e[i], inc[i], Omega[i], omega[i],
+			f[i], &err[i]);
+		out[0][i] = p.x; out[1][i] = p.y; out[2][i] = p.z;
+		out[3][i] = p.vx; out[4][i] = p.vy; out[5][i] = p.vz;
+	}
+}
+
+// ================================================================================================
+void pal_to_cartesian(double G, const reb_particle& primary, const double *m, const double *a, const double *lambda,
+	const double *k, const double *h, const double *ix, const double *iy, size_t count, double * const *out)
+{
+	const double PX = primary.x, PY = primary.y, PZ = primary.z;
+	const double PVX = primary.vx, PVY = primary.vy, PVZ = primary.vz;
+	const double PM = primary.m;
+	const double * const INPUTS[7] = { m, a, lambda, k, h, ix, iy };
+	cartesian_block block;
+	for (size_t base = 0; base < count; base += ORBIT_BLOCK_SIZE) {
+		const size_t BCOUNT = std::min(count - base, static_cast<size_t>(ORBIT_BLOCK_SIZE));
+		for (uint32 v = 0; v < 7; ++v)
+			std::copy(INPUTS[v] + base, INPUTS[v] + base + BCOUNT, block.in[v]);
+
+		for (size_t i = 0; i < BCOUNT; ++i) {
+			const double bm = block.in[0][i], ba = block.in[1][i], bl = block.in[2][i];
+			const double bk = block.in[3][i], bh = block.in[4][i], bix = block.in[5][i], biy = block.in[6][i];
+
+			// Kepler's equation for the eccentric longitude F = lambda + p is F - k sin(F) + h cos(F) = lambda, which
+			//     is solved with Danby's quartic iteration, from Danby's starter for the eccentric anomaly
+			double sl, cl;
+			_sincos(bl, sl, cl);
+			const double ecc = sqrt(bk * bk + bh * bh);
+			const double esinM = bk * sl - bh * cl; // e * sin(lambda - pomega)
+			double F = bl + 0.85 * ((esinM < 0.) ? -ecc : ecc);
+			#pragma GCC unroll 8
+			for (int it = 0; it < ORBIT_KEPLER_ITERATIONS; ++it) {
+				double sF, cF;
+				_sincos(F, sF, cF);
+				const double esinE = bk * sF - bh * cF;
+				const double ecosE = bk * cF + bh * sF;
+				const double g = F - esinE - bl;
+				const double g1 = 1. - ecosE;
+				const double d1 = -g / g1;
+				const double d2 = -g / (g1 + 0.5 * d1 * esinE);
+				const double d3 = -g / (g1 + 0.5 * d2 * esinE + d2 * d2 * ecosE / 6.);
+				F += d3;
+			}
+			double slp, clp;
+			_sincos(F, slp, clp);
+			const double p = bk * slp - bh * clp;
+			const double q = bk * clp + bh * slp;
+
+			// The rest is the same as reb_tools_pal_to_particle
+			const double l = 1. - sqrt(1. - bh * bh - bk * bk);
+			const double xi = ba * (clp + p / (2. - l) * bh - bk);
+			const double eta = ba * (slp - p / (2. - l) * bk - bh);
+
+			const double iz = sqrt(fabs(4. - bix * bix - biy * biy));
+			const double W = eta * bix - xi * biy;
+
+			block.out[0][i] = PX + xi + 0.5 * biy * W;
+			block.out[1][i] = PY + eta - 0.5 * bix * W;
+			block.out[2][i] = PZ + 0.5 * iz * W;
+
+			const double an = sqrt(G * (bm + PM) / ba);
+			const double dxi = an / (1. - q) * (-slp + q / (2. - l) * bh);
+			const double deta = an / (1. - q) * (+clp - q / (2. - l) * bk);
+			const double dW = deta * bix - dxi * biy;
+
+			block.out[3][i] = PVX + dxi + 0.5 * biy * dW;
+			block.out[4][i] = PVY + deta - 0.5 * bix * dW;
+			block.out[5][i] = PVZ + 0.5 * iz * dW;
+		}
+
+		for (uint32 v = 0; v < 6; ++v)
+			std::copy(block.out[v], block.out[v] + BCOUNT, out[v] + base);
+	}
+
+	for (size_t i = 0; i < count; ++i) {
+		if (fabs(lambda[i]) < ORBIT_SINCOS_LIMIT)
+			continue;
+		const reb_particle p = reb_tools_pal_to_particle(G, primary, m[i], a[i], lambda[i], k[i], h[i], ix[i], iy[i]);
+		out[0][i] = p.x; out[1][i] = p.y; out[2][i] = p.z;
+		out[3][i] = p.vx; out[4][i] = p.vy; out[5][i] = p.vz;
+	}
+}
+
+} // namespace orbits
\ No newline at end of file
@@ -0,0 +1,66 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file declares the functions used to convert between the orbital elements and the cartesian coordinates
+ *     of many particles at once, against a shared primary.
+ */
+
+#ifndef LUABOUND_ORBIT_BATCH_HPP_
+#define LUABOUND_ORBIT_BATCH_HPP_
+
+#include "../luabound.hpp"
+
+namespace orbits
+{
+
+// The orbital elements of a set of particles, with one array per element (the same names and meanings as
+//     the members of reb_orbit). The error codes are the same as reb_tools_particle_to_orbit_err (0 = no
+//     error, 1 = the primary has no mass, 2 = the particle is on top of the primary), and the elements of
+//     particles with an error are all NaN.
+struct orbit_batch
+{
+	StlVector<double> a;
+	StlVector<double> e;
+	StlVector<double> inc;
+	StlVector<double> Omega;
+	StlVector<double> omega;
+	StlVector<double> f;
+	StlVector<double> M;
+	StlVector<double> h;
+	StlVector<double> d;
+	StlVector<int> err;
+
+	// Resizes all of the arrays, which only allocates if the count has grown past any previous size
+	void resize(size_t count);
+	inline size_t size() const { return a.size(); }
+};
+
+// Calculates the orbits of the particles against the primary, with the same formulas as
+//     reb_tools_particle_to_orbit_err, but without the per-particle branches. The particles are processed in
+//     small blocks, with one loop over each block for the lengths and vectors, and one for the angles, which
+//     both vectorize. The acos is a branch-free version of the libm acos, so the angles can differ from rebound
+//     in the last bit. The out batch is resized to the particle count.
+void calculate(double G, const reb_particle *particles, size_t count, const reb_particle& primary,
+	orbit_batch& out);
+
+// Calculates the positions and velocities of particles from their orbital elements against the primary, with the
+//     same formulas and error codes as reb_tools_orbit_to_particle_err, but without the per-particle branches. The
+//     out arrays are {x, y, z, vx, vy, vz}, which are NaN for the particles with an error. The sines and cosines are
+//     a branch-free version of the libm functions, so the values can differ from rebound in the last bits.
+void elements_to_cartesian(double G, const reb_particle& primary, const double *m, const double *a, const double *e,
+	const double *inc, const double *Omega, const double *omega, const double *f, size_t count, double * const *out,
+	int *err);
+
+// Calculates the positions and velocities of particles from their Pal (2009) elements against the primary, with the
+//     same formulas as reb_tools_pal_to_particle. Instead of the iterative solver in reb_tools_solve_kepler_pal,
+//     Kepler's equation is solved for the eccentric longitude with a fixed number of Danby iterations, which
+//     converges to the last bits for any e < 1. The out arrays are the same as elements_to_cartesian().
+void pal_to_cartesian(double G, const reb_particle& primary, const double *m, const double *a, const double *lambda,
+	const double *k, const double *h, const double *ix, const double *iy, size_t count, double * const *out);
+
+} // namespace orbits
+
+#endif // LUABOUND_ORBIT_BATCH_HPP_
\ No newline at end of file
@@ -46,6 +46,7 @@ public:
 		}
 		else
 			m_ref = other.m_ref;
+		return *this;
 	}
 	~sim_particle_ref()
 	{
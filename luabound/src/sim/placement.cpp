@@ -10,34 +10,118 @@
  */
 
 #include "placement.hpp"
+#include "orbit_batch.hpp"
 #include "../runtime/simulation.hpp" // This is a gross coupling problem, find a way around this
+#ifdef _OPENMP
+#	include <omp.h>
+#endif
+
+namespace
+{
+
+// The reason for an error code from reb_tools_orbit_to_particle_err
+String _keplerErrorString(int err)
+{
+	return (err == 1) ? "Can't set e exactly to 1" :
+		   (err == 2) ? "Eccentricity cannot be less than 0" :
+		   (err == 3) ? "Bound orbit (a > 0) cannot have e > 1" :
+		   (err == 4) ? "Unbound orbit (a < 0) cannot have e < 1" :
+		   (err == 5) ? "Unbound orbit can’t have f set beyond the asymptotes defining the particle" :
+		   "Unknown";
+}
+
+// The arrays in the batch for the positions and velocities of the range that starts at the index
+inline void _cartesianArrays(placement_batch& batch, uint32 first, double **arrays)
+{
+	for (uint32 v = 0; v < 6; ++v)
+		arrays[v] = batch.values[v].data() + first;
+}
+
+// Sets the accelerations in the batch to zero for the range, which the orbital placements do not generate
+inline void _clearAccelerations(placement_batch& batch, uint32 first, uint32 last)
+{
+	for (uint32 v = 6; v < PLACEMENT_VALUE_COUNT; ++v)
+		std::fill(batch.values[v].begin() + first, batch.values[v].begin() + last, 0.0);
+}
+
+} // namespace
 
 // ================================================================================================
-void cart_body_placement::generate(sim_particle_ref refpart, double mass, double *vals) const
+void body_placement::generateBatch(sim_particle_ref refpart, const double *masses, random_stream *streams,
+	uint32 count, placement_batch& out, uint32 threads) const
 {
-	vals[0] = m_x.generate();
-	vals[1] = m_y.generate();
-	vals[2] = m_z.generate();
-	vals[3] = m_vx.generate();
-	vals[4] = m_vy.generate();
-	vals[5] = m_vz.generate();
-	vals[6] = m_ax.generate();
-	vals[7] = m_ay.generate();
-	vals[8] = m_az.generate();
+	out.resize(count);
+
+#ifdef _OPENMP
+	const int THREADS = (threads == 0) ? omp_get_max_threads() : static_cast<int>(threads);
+	if ((count >= PLACEMENT_PARALLEL_SIZE) && (THREADS > 1)) {
+		// Exceptions cannot leave the parallel region, so the generation errors (which are already
+		//     reported) are caught on each thread, and thrown again once all of the threads are done
+		bool failed = false;
+		#pragma omp parallel num_threads(THREADS)
+		{
+			const int TID = omp_get_thread_num();
+			const int TCOUNT = omp_get_num_threads();
+			const uint32 FIRST = static_cast<uint32>((static_cast<uint64>(count) * TID) / TCOUNT);
+			const uint32 LAST = static_cast<uint32>((static_cast<uint64>(count) * (TID + 1)) / TCOUNT);
+			sim_particle_ref threadRef{refpart};
+			try {
+				generateRange(threadRef, masses, streams, FIRST, LAST, out);
+			}
+			catch (...) {
+				#pragma omp atomic write
+				failed = true;
+			}
+		}
+		if (failed)
+			throw "Logic Error";
+		return;
+	}
+#else
+	(void)threads;
+#endif
+
+	generateRange(refpart, masses, streams, 0, count, out);
+}
+
+// ================================================================================================
+void body_placement::generateRange(sim_particle_ref& refpart, const double *masses, random_stream *streams,
+	uint32 first, uint32 last, placement_batch& out) const
+{
+	double vals[PLACEMENT_VALUE_COUNT];
+	for (uint32 i = first; i < last; ++i) {
+		generate(refpart, masses[i], vals, streams[i]);
+		for (uint32 v = 0; v < PLACEMENT_VALUE_COUNT; ++v)
+			out.values[v][i] = vals[v];
+	}
+}
+
+// ================================================================================================
+void cart_body_placement::generate(sim_particle_ref refpart, double mass, double *vals, random_stream& rng) const
+{
+	vals[0] = m_x.generate(rng);
+	vals[1] = m_y.generate(rng);
+	vals[2] = m_z.generate(rng);
+	vals[3] = m_vx.generate(rng);
+	vals[4] = m_vy.generate(rng);
+	vals[5] = m_vz.generate(rng);
+	vals[6] = m_ax.generate(rng);
+	vals[7] = m_ay.generate(rng);
+	vals[8] = m_az.generate(rng);
 }
 
 // ================================================================================================
-void spherical_body_placement::generate(sim_particle_ref refpart, double mass, double *vals) const
+void spherical_body_placement::generate(sim_particle_ref refpart, double mass, double *vals, random_stream& rng) const
 {
-	const double r = m_r.generate();
-	const double t = m_t.generate();
-	const double p = m_p.generate();
-	const double vr = m_vr.generate();
-	const double vt = m_vt.generate();
-	const double vp = m_vp.generate();
-	const double ar = m_ar.generate();
-	const double at = m_at.generate();
-	const double ap = m_ap.generate();
+	const double r = m_r.generate(rng);
+	const double t = m_t.generate(rng);
+	const double p = m_p.generate(rng);
+	const double vr = m_vr.generate(rng);
+	const double vt = m_vt.generate(rng);
+	const double vp = m_vp.generate(rng);
+	const double ar = m_ar.generate(rng);
+	const double at = m_at.generate(rng);
+	const double ap = m_ap.generate(rng);
 
 	// Precalculate commonly used values
 	const double SP = sin(p);
@@ -78,15 +162,15 @@ void spherical_body_placement::generate(sim_particle_ref refpart, double mass, d
 }
 
 // ================================================================================================
-void kepler_body_placement::generate(sim_particle_ref refpart, double mass, double *vals) const
+void kepler_body_placement::generate(sim_particle_ref refpart, double mass, double *vals, random_stream& rng) const
 {
 	const double G = LbdSimulation::GetInstance()->getSimulation()->G;
-	const double a = m_a.generate();
-	const double e = m_e.generate();
-	const double i = m_i.generate();
-	const double O = m_O.generate();
-	const double o = m_o.generate();
-	const double f = m_f.generate();
+	const double a = m_a.generate(rng);
+	const double e = m_e.generate(rng);
+	const double i = m_i.generate(rng);
+	const double O = m_O.generate(rng);
+	const double o = m_o.generate(rng);
+	const double f = m_f.generate(rng);
 
 	if (!(refpart.get())) {
 		lerr("Kepler orbit generation requires a non-nil reference body.");
@@ -96,13 +180,7 @@ void kepler_body_placement::generate(sim_particle_ref refpart, double mass, doub
 	int err = 0;
 	reb_particle outpart = reb_tools_orbit_to_particle_err(G, *(refpart.get()), mass, a, e, i, O, o, f, &err);
 	if (err) {
-		String errmsg = (err == 1) ? "Can't set e exactly to 1" :
-						(err == 2) ? "Eccentricity cannot be less than 0" :
-						(err == 3) ? "Bound orbit (a > 0) cannot have e > 1" :
-						(err == 4) ? "Unbound orbit (a < 0) cannot have e < 1" :
-						(err == 5) ? "Unbound orbit can’t have f set beyond the asymptotes defining the particle" :
-						"Unknown";
-		lerr(strfmt("Kepler orbit generation error: '%s'.", errmsg.c_str()));
+		lerr(strfmt("Kepler orbit generation error: '%s'.", _keplerErrorString(err).c_str()));
 		throw "Logic Error";
 	}
 	
@@ -118,15 +196,57 @@ void kepler_body_placement::generate(sim_particle_ref refpart, double mass, doub
 }
 
 // ================================================================================================
-void pal_body_placement::generate(sim_particle_ref refpart, double mass, double *vals) const
+void kepler_body_placement::generateRange(sim_particle_ref& refpart, const double *masses, random_stream *streams,
+	uint32 first, uint32 last, placement_batch& out) const
+{
+	const double G = LbdSimulation::GetInstance()->getSimulation()->G;
+	if (!(refpart.get())) {
+		lerr("Kepler orbit generation requires a non-nil reference body.");
+		throw "Logic Error";
+	}
+
+	// The elements are drawn in the same order as generate(), so each particle gets the same random values
+	const uint32 count = last - first;
+	StlVector<double> elements(6 * static_cast<size_t>(count));
+	double * const A = elements.data();
+	double * const E = A + count;
+	double * const I = E + count;
+	double * const BO = I + count;
+	double * const SO = BO + count;
+	double * const F = SO + count;
+	for (uint32 i = 0; i < count; ++i) {
+		random_stream& rng = streams[first + i];
+		A[i] = m_a.generate(rng);
+		E[i] = m_e.generate(rng);
+		I[i] = m_i.generate(rng);
+		BO[i] = m_O.generate(rng);
+		SO[i] = m_o.generate(rng);
+		F[i] = m_f.generate(rng);
+	}
+
+	double *cart[6];
+	_cartesianArrays(out, first, cart);
+	StlVector<int> errors(count);
+	orbits::elements_to_cartesian(G, *(refpart.get()), masses + first, A, E, I, BO, SO, F, count, cart, errors.data());
+	for (uint32 i = 0; i < count; ++i) {
+		if (errors[i]) {
+			lerr(strfmt("Kepler orbit generation error: '%s'.", _keplerErrorString(errors[i]).c_str()));
+			throw "Logic Error";
+		}
+	}
+	_clearAccelerations(out, first, last);
+}
+
+// ================================================================================================
+void pal_body_placement::generate(sim_particle_ref refpart, double mass, double *vals, random_stream& rng) const
 {
 	const double G = LbdSimulation::GetInstance()->getSimulation()->G;
-	const double a = m_a.generate();
-	const double l = m_l.generate();
-	const double k = m_k.generate();
-	const double h = m_h.generate();
-	const double ix = m_ix.generate();
-	const double iy = m_iy.generate();
+	const double a = m_a.generate(rng);
+	const double l = m_l.generate(rng);
+	const double k = m_k.generate(rng);
+	const double h = m_h.generate(rng);
+	const double ix = m_ix.generate(rng);
+	const double iy = m_iy.generate(rng);
 
 	if (!(refpart.get())) {
 		lerr("Pal orbit generation requires a non-nil reference body.");
@@ -146,6 +266,40 @@ void pal_body_placement::generate(sim_particle_ref refpart, double mass, double
 	vals[8] = outpart.az;
 }
 
+// ================================================================================================
+void pal_body_placement::generateRange(sim_particle_ref& refpart, const double *masses, random_stream *streams,
+	uint32 first, uint32 last, placement_batch& out) const
+{
+	const double G = LbdSimulation::GetInstance()->getSimulation()->G;
+	if (!(refpart.get())) {
+		lerr("Pal orbit generation requires a non-nil reference body.");
+		throw "Logic Error";
+	}
+
+	const uint32 count = last - first;
+	StlVector<double> elements(6 * static_cast<size_t>(count));
+	double * const A = elements.data();
+	double * const L = A + count;
+	double * const K = L + count;
+	double * const H = K + count;
+	double * const IX = H + count;
+	double * const IY = IX + count;
+	for (uint32 i = 0; i < count; ++i) {
+		random_stream& rng = streams[first + i];
+		A[i] = m_a.generate(rng);
+		L[i] = m_l.generate(rng);
+		K[i] = m_k.generate(rng);
+		H[i] = m_h.generate(rng);
+		IX[i] = m_ix.generate(rng);
+		IY[i] = m_iy.generate(rng);
+	}
+
+	double *cart[6];
+	_cartesianArrays(out, first, cart);
+	orbits::pal_to_cartesian(G, *(refpart.get()), masses + first, A, L, K, H, IX, IY, count, cart);
+	_clearAccelerations(out, first, last);
+}
+
 namespace luainterop
 {
 
@@ -16,6 +16,25 @@
 #include "distributions.hpp"
 #include "particle.hpp"
 
+// The number of values that a placement generates for each particle
+#define PLACEMENT_VALUE_COUNT (9)
+// Batches with fewer particles than this are always generated on one thread
+#define PLACEMENT_PARALLEL_SIZE (1024)
+
+// The values generated for a batch of particles, with one contiguous array for each value, in the same
+//     order as body_placement::generate(): {x, y, z, vx, vy, vz, ax, ay, az}.
+struct placement_batch
+{
+public:
+	StlVector<double> values[PLACEMENT_VALUE_COUNT];
+
+public:
+	inline void resize(size_t count) {
+		for (auto& v : values)
+			v.resize(count);
+	}
+};
+
 // Base struct for body placement. Because lua has a reference to these, we can use polymorphism
 //     to specify different placements, instead of context typing.
 struct body_placement
@@ -32,10 +51,23 @@ public:
 
 	// Generates the position, velocity, and acceleration information about this placement.
 	// The array passed in must be of at least size 9, and will contain the information after
-	//     calling as follows: {x, y, z, vx, vy, vz, ax, ay, az}.
-	virtual void generate(sim_particle_ref refpart, double mass, double *vals) const = 0;
-
-	void generate(double *vals) { generate(nullptr, 0.0, vals); }
+	//     calling as follows: {x, y, z, vx, vy, vz, ax, ay, az}. The random values are drawn
+	//     from the stream, one field for each distribution of the placement, in order.
+	virtual void generate(sim_particle_ref refpart, double mass, double *vals, random_stream& rng) const = 0;
+
+	void generate(double *vals) { generate(nullptr, 0.0, vals, random_stream::Script()); }
+
+	// Generates the values for a batch of particles into the arrays of the batch, which must hold at least
+	//     count values. Particle i uses masses[i] and draws from streams[i]. The particles are split into
+	//     contiguous ranges for the threads (0 uses all of the OpenMP threads), and since every particle has
+	//     its own stream, the values are exactly the same for any thread count.
+	void generateBatch(sim_particle_ref refpart, const double *masses, random_stream *streams, uint32 count,
+		placement_batch& out, uint32 threads) const;
+
+protected:
+	// Generates the particles [first, last) of a batch, by default with one generate() call for each
+	virtual void generateRange(sim_particle_ref& refpart, const double *masses, random_stream *streams,
+		uint32 first, uint32 last, placement_batch& out) const;
 };
 
 // Structure for defining cartesian style coordinates (x, y, z).
@@ -82,7 +114,7 @@ public:
 		m_ax{ax}, m_ay{ay}, m_az{az}
 	{ }
 
-	void generate(sim_particle_ref refpart, double mass, double *vals) const override;
+	void generate(sim_particle_ref refpart, double mass, double *vals, random_stream& rng) const override;
 };
 
 // Structure for defining polar style coordinates (r, theta, phi).
@@ -130,7 +162,7 @@ public:
 		m_ar{ar}, m_at{at}, m_ap{ap}
 	{ }
 
-	void generate(sim_particle_ref refpart, double mass, double *vals) const override;
+	void generate(sim_particle_ref refpart, double mass, double *vals, random_stream& rng) const override;
 };
 
 // Structure for defining kepler orbital parameters
@@ -166,7 +198,12 @@ public:
 		m_O{O}, m_o{o}, m_f{f}
 	{ }
 
-	void generate(sim_particle_ref refpart, double mass, double *vals) const override;
+	void generate(sim_particle_ref refpart, double mass, double *vals, random_stream& rng) const override;
+
+protected:
+	// Draws the elements of the whole range, then converts them together with the batch functions in orbit_batch.hpp
+	void generateRange(sim_particle_ref& refpart, const double *masses, random_stream *streams,
+		uint32 first, uint32 last, placement_batch& out) const override;
 };
 
 // Structure for defining pal orbital parameters (Pal 2009)
@@ -194,7 +231,12 @@ public:
 		m_h{h}, m_ix{ix}, m_iy{iy}
 	{ }
 
-	void generate(sim_particle_ref refpart, double mass, double *vals) const override;
+	void generate(sim_particle_ref refpart, double mass, double *vals, random_stream& rng) const override;
+
+protected:
+	// Draws the elements of the whole range, then converts them together with the batch functions in orbit_batch.hpp
+	void generateRange(sim_particle_ref& refpart, const double *masses, random_stream *streams,
+		uint32 first, uint32 last, placement_batch& out) const override;
 };
 
 // Lightweight object that is exposed to lua to hold body_placement references.
@@ -216,14 +258,20 @@ public:
 	{ }
 
 	inline const body_placement& get() const { return *m_ref; }
-	inline void generate(sim_particle_ref refpart, double mass, double *vals) const { m_ref->generate(refpart, mass, vals); }
+	inline void generate(sim_particle_ref refpart, double mass, double *vals, random_stream& rng) const {
+		m_ref->generate(refpart, mass, vals, rng);
+	}
+	inline void generateBatch(sim_particle_ref refpart, const double *masses, random_stream *streams, uint32 count,
+			placement_batch& out, uint32 threads) const {
+		m_ref->generateBatch(refpart, masses, streams, count, out, threads);
+	}
 	inline generate_tuple luaGenerateNoArgs() const {
 		if (m_ref->isStrict()) {
 			lerr("Kepler and Pal orbital placement requires arguments of the reference body and mass.");
 			throw "Logic Error";
 		}
 		double vals[9];
-		m_ref->generate(nullptr, 0.0, vals);
+		m_ref->generate(nullptr, 0.0, vals, random_stream::Script());
 		return std::make_tuple(vals[0], vals[1], vals[2],
 							   vals[3], vals[4], vals[5],
 							   vals[6], vals[7], vals[8]);
@@ -238,7 +286,7 @@ public:
 			throw "Logic Error";
 		}
 		double vals[9];
-		m_ref->generate(refpart.as<sim_particle_ref>(), mass.as<double>(), vals);
+		m_ref->generate(refpart.as<sim_particle_ref>(), mass.as<double>(), vals, random_stream::Script());
 		return std::make_tuple(vals[0], vals[1], vals[2],
 							   vals[3], vals[4], vals[5],
 							   vals[6], vals[7], vals[8]);
@@ -0,0 +1,60 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file implements the ByteBuffer class, which is a growable buffer for building binary data that
+ *     is always written in little-endian byte order, no matter the byte order of the host.
+ */
+
+#include "byte_buffer.hpp"
+
+
+// ================================================================================================
+void ByteBuffer::writeBytes(const void *bytes, size_t count)
+{
+	const uint8 *start = static_cast<const uint8*>(bytes);
+	m_data.insert(m_data.end(), start, start + count);
+}
+
+// ================================================================================================
+void ByteBuffer::writeString(const String& str)
+{
+	writeUInt32(static_cast<uint32>(str.length()));
+	writeBytes(str.data(), str.length());
+}
+
+// ================================================================================================
+void ByteBuffer::writeDoubles(const double *values, size_t count)
+{
+	if (IsLittleEndian()) {
+		writeBytes(values, count * sizeof(double));
+		return;
+	}
+
+	for (size_t i = 0; i < count; ++i)
+		writeDouble(values[i]);
+}
+
+// ================================================================================================
+void ByteBuffer::writeDoublesAsUInt32(const double *values, size_t count)
+{
+	const size_t start = m_data.size();
+	m_data.resize(start + (count * sizeof(uint32)));
+	uint8 *out = &(m_data[start]);
+	for (size_t i = 0; i < count; ++i, out += sizeof(uint32)) {
+		const uint32 value = static_cast<uint32>(values[i]);
+		out[0] = static_cast<uint8>(value);
+		out[1] = static_cast<uint8>(value >> 8);
+		out[2] = static_cast<uint8>(value >> 16);
+		out[3] = static_cast<uint8>(value >> 24);
+	}
+}
+
+// ================================================================================================
+bool ByteBuffer::IsLittleEndian()
+{
+	static const uint16 TEST_VALUE = 1;
+	return (*reinterpret_cast<const uint8*>(&TEST_VALUE) == 1);
+}
\ No newline at end of file
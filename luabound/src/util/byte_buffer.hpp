@@ -0,0 +1,62 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file declares the ByteBuffer class, which is a growable buffer for building binary data that
+ *     is always written in little-endian byte order, no matter the byte order of the host.
+ */
+
+#ifndef LUABOUND_BYTE_BUFFER_HPP_
+#define LUABOUND_BYTE_BUFFER_HPP_
+
+#include "../luabound.hpp"
+#include <algorithm>
+
+class ByteBuffer
+{
+private:
+	StlVector<uint8> m_data;
+
+public:
+	ByteBuffer() :
+		m_data{}
+	{ }
+
+	inline const uint8* data() const { return m_data.data(); }
+	inline size_t size() const { return m_data.size(); }
+	// Clears the contents, but keeps the allocated memory for reuse
+	inline void clear() { m_data.clear(); }
+	inline void reserve(size_t size) { m_data.reserve(size); }
+
+	inline void writeUInt8(uint8 value) { m_data.push_back(value); }
+	inline void writeUInt32(uint32 value) { writeLE(value); }
+	inline void writeInt64(int64 value) { writeLE(value); }
+	inline void writeUInt64(uint64 value) { writeLE(value); }
+	inline void writeDouble(double value) { writeLE(value); }
+	void writeBytes(const void *bytes, size_t count);
+	void writeString(const String& str); // Writes the length as a uint32, followed by the characters
+
+	// Writes an array of doubles, which is a single copy on little-endian hosts
+	void writeDoubles(const double *values, size_t count);
+	// Writes an array of doubles as uint32 values (used for whole number values stored as doubles)
+	void writeDoublesAsUInt32(const double *values, size_t count);
+
+	static bool IsLittleEndian();
+
+private:
+	template<typename T>
+	inline void writeLE(T value)
+	{
+		uint8 bytes[sizeof(T)];
+		memcpy(bytes, &value, sizeof(T));
+		if (!IsLittleEndian())
+			std::reverse(bytes, bytes + sizeof(T));
+		m_data.insert(m_data.end(), bytes, bytes + sizeof(T));
+	}
+
+	LUABOUND_DECLARE_CLASS_NONCOPYABLE(ByteBuffer)
+};
+
+#endif // LUABOUND_BYTE_BUFFER_HPP_
\ No newline at end of file
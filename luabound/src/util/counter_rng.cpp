@@ -0,0 +1,95 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file implements the counter-based random number generator that is used to create the initial
+ *     conditions of the particles.
+ */
+
+#include "counter_rng.hpp"
+
+namespace
+{
+
+// The Philox4x32 multipliers and key increments (Weyl sequence)
+const uint32 PHILOX_M0 = 0xD2511F53;
+const uint32 PHILOX_M1 = 0xCD9E8D57;
+const uint32 PHILOX_W0 = 0x9E3779B9;
+const uint32 PHILOX_W1 = 0xBB67AE85;
+
+uint64 g_seed = 0;
+random_stream g_scriptStream{0, RNG_SCRIPT_INDEX};
+
+// Turns the top 52 bits into a value in (0, 1), which can never be exactly 0 or 1
+inline double to_uniform(uint64 bits)
+{
+	return (static_cast<double>(bits >> 12) + 0.5) * (1.0 / 4503599627370496.0);
+}
+
+} // namespace
+
+namespace rng
+{
+
+// ================================================================================================
+void philox4x32(const uint32 *counter, uint64 key, uint32 *out)
+{
+	uint32 c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+	uint32 k0 = static_cast<uint32>(key), k1 = static_cast<uint32>(key >> 32);
+	for (uint32 round = 0; round < 10; ++round) {
+		if (round > 0) {
+			k0 += PHILOX_W0;
+			k1 += PHILOX_W1;
+		}
+		const uint64 p0 = static_cast<uint64>(PHILOX_M0) * c0;
+		const uint64 p1 = static_cast<uint64>(PHILOX_M1) * c2;
+		const uint32 n0 = static_cast<uint32>(p1 >> 32) ^ c1 ^ k0;
+		const uint32 n2 = static_cast<uint32>(p0 >> 32) ^ c3 ^ k1;
+		c1 = static_cast<uint32>(p1);
+		c3 = static_cast<uint32>(p0);
+		c0 = n0;
+		c2 = n2;
+	}
+	out[0] = c0;
+	out[1] = c1;
+	out[2] = c2;
+	out[3] = c3;
+}
+
+// ================================================================================================
+uint64 GetSeed()
+{
+	return g_seed;
+}
+
+// ================================================================================================
+void SetSeed(uint64 seed)
+{
+	g_seed = seed;
+	g_scriptStream = random_stream(seed, RNG_SCRIPT_INDEX);
+}
+
+} // namespace rng
+
+// ================================================================================================
+void random_stream::uniform2(double& u1, double& u2)
+{
+	const uint32 counter[4] = {
+		static_cast<uint32>(field), static_cast<uint32>(field >> 32),
+		static_cast<uint32>(index), static_cast<uint32>(index >> 32)
+	};
+	uint32 bits[4];
+	rng::philox4x32(counter, seed, bits);
+	++field;
+
+	u1 = to_uniform((static_cast<uint64>(bits[0]) << 32) | bits[1]);
+	u2 = to_uniform((static_cast<uint64>(bits[2]) << 32) | bits[3]);
+}
+
+// ================================================================================================
+/* static */ random_stream& random_stream::Script()
+{
+	return g_scriptStream;
+}
\ No newline at end of file
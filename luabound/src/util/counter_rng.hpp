@@ -0,0 +1,70 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file declares the counter-based random number generator that is used to create the initial
+ *     conditions of the particles.
+ */
+
+#ifndef LUABOUND_COUNTER_RNG_HPP_
+#define LUABOUND_COUNTER_RNG_HPP_
+
+#include "../luabound.hpp"
+
+// The stream index of the values that are generated directly from the lua script, which can never be a
+//     particle hash
+#define RNG_SCRIPT_INDEX (0xFFFFFFFFFFFFFFFFull)
+// The largest seed that can be given in the script, which is the largest whole number that lua numbers
+//     can hold exactly
+#define RNG_MAX_SEED (9007199254740992ull)
+
+namespace rng
+{
+
+// The Philox4x32-10 block function (Salmon et al. 2011, "Parallel Random Numbers: As Easy as 1, 2, 3"),
+//     which maps a 128-bit counter and a 64-bit key to 128 random bits
+void philox4x32(const uint32 *counter, uint64 key, uint32 *out);
+
+// The seed that keys every random value in the simulation. It is random until the script sets it.
+uint64 GetSeed();
+// Sets the seed, and restarts the stream of values generated from the script
+void SetSeed(uint64 seed);
+
+} // namespace rng
+
+// The random values for one particle. Each value is a pure function of the seed, the stream index (the
+//     particle hash), and the field (which value of the particle it is: the mass, the radius, then each
+//     value of the placement, in order), so the particles can be generated in any order and on any
+//     number of threads, and are always the same for the same seed. Every field takes one Philox block,
+//     which is enough for the one or two uniform values that each distribution needs.
+struct random_stream
+{
+public:
+	uint64 seed;
+	uint64 index;
+	uint64 field; // The next field
+
+public:
+	random_stream(uint64 seed, uint64 index) :
+		seed{seed}, index{index}, field{0}
+	{ }
+
+	// Gets a uniform value in (0, 1) for the next field
+	inline double uniform() {
+		double u1, u2;
+		uniform2(u1, u2);
+		return u1;
+	}
+	// Gets two independent uniform values in (0, 1) for the next field
+	void uniform2(double& u1, double& u2);
+	// Skips the next field, for the values that are not random, so the fields after it do not move
+	inline void skip() { ++field; }
+
+	// The stream of the values that are generated from the lua script (dist:generate() and
+	//     place:generate()), which are numbered in the order that they are made
+	static random_stream& Script();
+};
+
+#endif // LUABOUND_COUNTER_RNG_HPP_
\ No newline at end of file
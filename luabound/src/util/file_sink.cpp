@@ -0,0 +1,202 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file implements the FileSink class, which is a buffered writer directly on top of a file descriptor,
+ *     for the output files that are written many times per run.
+ */
+
+#include "file_sink.hpp"
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+
+// ================================================================================================
+FileSink::FileSink(size_t capacity) :
+	m_fd{-1},
+	m_ownsFd{false},
+	m_buffer{nullptr},
+	m_capacity{std::max(capacity, static_cast<size_t>(FILE_SINK_ALIGNMENT))},
+	m_used{0},
+	m_error{""}
+{
+
+}
+
+// ================================================================================================
+FileSink::~FileSink()
+{
+	close();
+	free(m_buffer);
+}
+
+// ================================================================================================
+bool FileSink::open(const String& path)
+{
+	if (!close())
+		return false;
+
+	m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (m_fd < 0)
+		return setError("open");
+	m_ownsFd = true;
+	return true;
+}
+
+// ================================================================================================
+bool FileSink::openStdOut()
+{
+	if (!close())
+		return false;
+
+	m_fd = STDOUT_FILENO;
+	m_ownsFd = false;
+	return true;
+}
+
+// ================================================================================================
+bool FileSink::write(const void *data, size_t size)
+{
+	if (!m_buffer && !allocate())
+		return false;
+
+	if (size <= (m_capacity - m_used)) {
+		memcpy(m_buffer + m_used, data, size);
+		m_used += size;
+		return true;
+	}
+
+	// Too big for the rest of the buffer, so the buffer and the data are written in one call without a copy
+	if (m_used == 0)
+		return writeAll(data, size);
+	iovec parts[2] = {
+		{ m_buffer, m_used },
+		{ const_cast<void*>(data), size }
+	};
+	const size_t total = m_used + size;
+	size_t written = 0;
+	while (written < total) {
+		const ssize_t count = ::writev(m_fd, parts, 2);
+		if (count < 0) {
+			if (errno == EINTR)
+				continue;
+			return setError("write");
+		}
+		written += static_cast<size_t>(count);
+		if (written >= m_used)
+			break;
+		parts[0].iov_base = m_buffer + written;
+		parts[0].iov_len = m_used - written;
+	}
+	// Whatever is left is only in the data
+	const size_t dataWritten = written - m_used;
+	m_used = 0;
+	return writeAll(static_cast<const uint8*>(data) + dataWritten, size - dataWritten);
+}
+
+// ================================================================================================
+bool FileSink::write(std::streambuf *source, size_t& size)
+{
+	size = 0;
+	if (!m_buffer && !allocate())
+		return false;
+
+	while (true) {
+		if (m_used == m_capacity && !flush())
+			return false;
+		const size_t space = m_capacity - m_used;
+		const size_t count = static_cast<size_t>(source->sgetn(reinterpret_cast<char*>(m_buffer + m_used),
+			static_cast<std::streamsize>(space)));
+		m_used += count;
+		size += count;
+		if (count < space)
+			return true;
+	}
+}
+
+// ================================================================================================
+bool FileSink::flush()
+{
+	if (m_fd < 0)
+		return true;
+	if (!m_ownsFd)
+		std::cout.flush();
+	if (m_used == 0)
+		return true;
+
+	const size_t used = m_used;
+	m_used = 0;
+	return writeAll(m_buffer, used);
+}
+
+// ================================================================================================
+bool FileSink::sync()
+{
+	if (!flush())
+		return false;
+	if (!m_ownsFd)
+		return true;
+
+#ifdef LUABOUND_PLATFORM_MACOS
+	const int result = ::fsync(m_fd); // There is no fdatasync on macOS
+#else
+	const int result = ::fdatasync(m_fd);
+#endif // LUABOUND_PLATFORM_MACOS
+	return (result == 0) || setError("sync");
+}
+
+// ================================================================================================
+bool FileSink::close()
+{
+	if (m_fd < 0)
+		return true;
+
+	bool good = flush();
+	if (m_ownsFd && (::close(m_fd) != 0))
+		good = setError("close");
+	m_fd = -1;
+	m_ownsFd = false;
+	return good;
+}
+
+// ================================================================================================
+bool FileSink::allocate()
+{
+	void *buffer = nullptr;
+	if (posix_memalign(&buffer, FILE_SINK_ALIGNMENT, m_capacity) != 0) {
+		m_error = "could not allocate the write buffer";
+		return false;
+	}
+
+	m_buffer = static_cast<uint8*>(buffer);
+	return true;
+}
+
+// ================================================================================================
+bool FileSink::writeAll(const void *data, size_t size)
+{
+	const uint8 *bytes = static_cast<const uint8*>(data);
+	while (size > 0) {
+		const ssize_t count = ::write(m_fd, bytes, size);
+		if (count < 0) {
+			if (errno == EINTR)
+				continue;
+			return setError("write");
+		}
+		bytes += count;
+		size -= static_cast<size_t>(count);
+	}
+
+	return true;
+}
+
+// ================================================================================================
+bool FileSink::setError(const char *action)
+{
+	m_error = strfmt("could not %s, (%d) \"%s\"", action, errno, strerror(errno));
+	return false;
+}
\ No newline at end of file
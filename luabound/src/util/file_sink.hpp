@@ -0,0 +1,78 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file declares the FileSink class, which is a buffered writer directly on top of a file descriptor,
+ *     for the output files that are written many times per run.
+ */
+
+#ifndef LUABOUND_FILE_SINK_HPP_
+#define LUABOUND_FILE_SINK_HPP_
+
+#include "../luabound.hpp"
+#include <streambuf>
+
+// The default buffer size, and the alignment of the buffers (a page, so the writes start on page boundaries)
+#define FILE_SINK_DEFAULT_SIZE (256 * 1024)
+#define FILE_SINK_ALIGNMENT (4096)
+
+// When the buffered output of a file is written to the file
+enum class FlushPolicy :
+	uint8
+{
+	Line,    // After every record
+	Tick,    // After every heartbeat that wrote to the file
+	Seconds, // After the first record or heartbeat once the flush interval has passed
+	Close    // Only when the buffer fills, and when the file is closed
+};
+
+// Writes are copied into a page-aligned buffer, and only go to the file when the buffer fills or when
+//     flush() is called. Writes that do not fit in the rest of the buffer are written together with the
+//     buffered data in a single writev(), without being copied, so large records never go through the
+//     buffer. The buffer memory is only touched as it is used, so sinks that only ever hold a short line
+//     before being flushed only use one page of it.
+class FileSink
+{
+private:
+	int m_fd;
+	bool m_ownsFd; // The terminal is not closed with the sink
+	uint8 *m_buffer;
+	size_t m_capacity;
+	size_t m_used;
+	String m_error;
+
+public:
+	FileSink(size_t capacity = FILE_SINK_DEFAULT_SIZE);
+	~FileSink();
+
+	LUABOUND_DECLARE_CLASS_NONCOPYABLE(FileSink)
+
+	// Creates the file, or truncates it if it already exists
+	bool open(const String& path);
+	// Writes to the standard output, which is flushed first so the lines stay in order with the logging
+	bool openStdOut();
+	inline bool isOpen() const { return m_fd >= 0; }
+	// The buffered bytes that have not been written to the file yet
+	inline size_t getBuffered() const { return m_used; }
+	// The reason for the last failed call
+	inline const String& getError() const { return m_error; }
+
+	bool write(const void *data, size_t size);
+	// Moves all of the remaining characters in the stream buffer into the sink, and gives how many there were
+	bool write(std::streambuf *source, size_t& size);
+	// Writes all of the buffered data to the file
+	bool flush();
+	// Flushes, then waits for the file data to reach the disk (fdatasync)
+	bool sync();
+	// Flushes and closes the file, the buffered data is also flushed if the sink is destroyed without this
+	bool close();
+
+private:
+	bool allocate();
+	bool writeAll(const void *data, size_t size);
+	bool setError(const char *action);
+};
+
+#endif // LUABOUND_FILE_SINK_HPP_
\ No newline at end of file
@@ -0,0 +1,121 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file implements the HashIndexTable class, which maps 32-bit hashes to array indices with a flat
+ *     open-addressing table, for finding particles from their hashes without searching.
+ */
+
+#include "hash_index.hpp"
+#include <algorithm>
+
+
+// ================================================================================================
+HashIndexTable::HashIndexTable() :
+	m_keys{},
+	m_indices{},
+	m_mask{0},
+	m_shift{0},
+	m_size{0}
+{
+	rehash(HASH_INDEX_MIN_CAPACITY);
+}
+
+// ================================================================================================
+void HashIndexTable::clear()
+{
+	std::fill(m_indices.begin(), m_indices.end(), 0);
+	m_size = 0;
+}
+
+// ================================================================================================
+void HashIndexTable::reserve(uint32 count)
+{
+	uint32 capacity = m_mask + 1;
+	while (capacity < 2 * static_cast<uint64>(count))
+		capacity *= 2;
+	if (capacity != (m_mask + 1))
+		rehash(capacity);
+}
+
+// ================================================================================================
+void HashIndexTable::set(uint32 key, uint32 index)
+{
+	if (2 * static_cast<uint64>(m_size + 1) > (m_mask + 1))
+		rehash((m_mask + 1) * 2);
+
+	for (uint32 slot = home(key); ; slot = (slot + 1) & m_mask) {
+		if (m_indices[slot] == 0) {
+			m_keys[slot] = key;
+			m_indices[slot] = static_cast<int32>(index + 1);
+			++m_size;
+			return;
+		}
+		if (m_keys[slot] == key) {
+			m_indices[slot] = static_cast<int32>(index + 1);
+			return;
+		}
+	}
+}
+
+// ================================================================================================
+bool HashIndexTable::erase(uint32 key)
+{
+	uint32 slot = home(key);
+	for ( ; ; slot = (slot + 1) & m_mask) {
+		if (m_indices[slot] == 0)
+			return false;
+		if (m_keys[slot] == key)
+			break;
+	}
+
+	// Move the later keys in the run into the hole, unless their home slot is after the hole (cyclically)
+	uint32 hole = slot;
+	for (uint32 next = (hole + 1) & m_mask; m_indices[next] != 0; next = (next + 1) & m_mask) {
+		const uint32 nextHome = home(m_keys[next]);
+		if (((next - nextHome) & m_mask) >= ((next - hole) & m_mask)) {
+			m_keys[hole] = m_keys[next];
+			m_indices[hole] = m_indices[next];
+			hole = next;
+		}
+	}
+	m_indices[hole] = 0;
+	--m_size;
+	return true;
+}
+
+// ================================================================================================
+void HashIndexTable::shiftDown(uint32 index)
+{
+	// The stored indices are one larger, and empty slots are 0, so they are never above the limit
+	const int32 limit = static_cast<int32>(index + 1);
+	int32 * const indices = m_indices.data();
+	const uint32 count = m_mask + 1;
+	for (uint32 i = 0; i < count; ++i)
+		indices[i] -= (indices[i] > limit) ? 1 : 0;
+}
+
+// ================================================================================================
+void HashIndexTable::rehash(uint32 capacity)
+{
+	StlVector<uint32> oldKeys(capacity, 0);
+	StlVector<int32> oldIndices(capacity, 0);
+	oldKeys.swap(m_keys);
+	oldIndices.swap(m_indices);
+	m_mask = capacity - 1;
+	m_shift = 32;
+	for (uint32 c = capacity; c > 1; c >>= 1)
+		--m_shift;
+
+	for (size_t i = 0; i < oldIndices.size(); ++i) {
+		if (oldIndices[i] == 0)
+			continue;
+		uint32 slot = home(oldKeys[i]);
+		while (m_indices[slot] != 0)
+			slot = (slot + 1) & m_mask;
+		m_keys[slot] = oldKeys[i];
+		m_indices[slot] = oldIndices[i];
+	}
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file declares the HashIndexTable class, which maps 32-bit hashes to array indices with a flat
+ *     open-addressing table, for finding particles from their hashes without searching.
+ */
+
+#ifndef LUABOUND_HASH_INDEX_HPP_
+#define LUABOUND_HASH_INDEX_HPP_
+
+#include "../luabound.hpp"
+
+// The smallest number of slots in the table, which is always a power of two
+#define HASH_INDEX_MIN_CAPACITY (16)
+
+// The keys and indices are kept in separate arrays of slots, where the index is stored plus one so that an empty
+//     slot is 0. Collisions are resolved with linear probing, and erased keys shift the later keys in their run
+//     back, so there are never any tombstones to skip. The table is kept at most half full, so lookups almost
+//     always find the key (or the empty slot) in the first slot or two.
+class HashIndexTable
+{
+private:
+	StlVector<uint32> m_keys;
+	StlVector<int32> m_indices; // The index plus one, which is always smaller than the largest rebound particle count
+	uint32 m_mask; // The slot count minus one
+	uint32 m_shift; // 32 minus the log2 of the slot count, to take the top bits of the mixed key
+	uint32 m_size;
+
+public:
+	HashIndexTable();
+
+	inline uint32 size() const { return m_size; }
+	inline uint32 capacity() const { return m_mask + 1; }
+	// Removes all of the keys, but keeps the memory
+	void clear();
+	// Grows the table so that the number of keys fits without growing again
+	void reserve(uint32 count);
+
+	// Adds the key, or replaces its index if it is already in the table
+	void set(uint32 key, uint32 index);
+	// Returns false if the key was not in the table
+	bool erase(uint32 key);
+	// Lowers every index above the index by one, which matches removing that element from the array. This is one
+	//     vectorized pass over the slots, which is faster than setting the keys one at a time for all but a few.
+	void shiftDown(uint32 index);
+	// Gives the index for the key, or -1 if it is not in the table
+	inline int64 find(uint32 key) const
+	{
+		for (uint32 slot = home(key); ; slot = (slot + 1) & m_mask) {
+			const int32 index = m_indices[slot];
+			if (index == 0)
+				return -1;
+			if (m_keys[slot] == key)
+				return index - 1;
+		}
+	}
+
+private:
+	// Fibonacci hashing, since the particle hashes are often consecutive numbers
+	inline uint32 home(uint32 key) const { return (key * 2654435769u) >> m_shift; }
+	void rehash(uint32 capacity);
+
+	LUABOUND_DECLARE_CLASS_NONCOPYABLE(HashIndexTable)
+};
+
+#endif // LUABOUND_HASH_INDEX_HPP_
\ No newline at end of file
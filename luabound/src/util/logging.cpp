@@ -76,6 +76,14 @@ void lsim(const String& msg)
 	std::cout << out << std::endl;
 }
 
+// ================================================================================================
+String lsimTag()
+{
+	String tag;
+	_formatTimeString(SIM_TAG, tag);
+	return tag + prefix;
+}
+
 // ================================================================================================
 void lplugin(const String& msg)
 {
@@ -0,0 +1,450 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file implements the functions used to quickly convert numbers into text for the output files.
+ *     The round-trip formatting uses the Grisu2 algorithm from Florian Loitsch's "Printing
+ *     Floating-Point Numbers Quickly and Accurately with Integers" (2010), with the boundary handling
+ *     that guarantees that the output always reads back as the same double. Grisu2 does not always
+ *     find the shortest digits: for about 0.08% of doubles it writes up to 17 digits where fewer would
+ *     round-trip. Those still read back exactly, so there is no slower Grisu3 or Ryu fallback.
+ */
+
+#include "number_format.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+
+namespace
+{
+
+// A floating point number with a 64-bit significand, as f * 2^e
+struct diy_fp
+{
+	std::uint64_t f;
+	int e;
+};
+
+// The product of two diy_fp values, keeping the (rounded) upper 64 bits of the 128-bit product
+diy_fp _mul(const diy_fp& x, const diy_fp& y)
+{
+	const std::uint64_t xlo = x.f & 0xFFFFFFFFull, xhi = x.f >> 32;
+	const std::uint64_t ylo = y.f & 0xFFFFFFFFull, yhi = y.f >> 32;
+
+	const std::uint64_t p0 = xlo * ylo;
+	const std::uint64_t p1 = xlo * yhi;
+	const std::uint64_t p2 = xhi * ylo;
+	const std::uint64_t p3 = xhi * yhi;
+
+	std::uint64_t mid = (p0 >> 32) + (p1 & 0xFFFFFFFFull) + (p2 & 0xFFFFFFFFull);
+	mid += (1ull << 31); // Round the lower half
+	return { p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32), x.e + y.e + 64 };
+}
+
+// Shifts the value so that the highest bit of the significand is set
+diy_fp _normalize(diy_fp x)
+{
+	while ((x.f >> 63) == 0) {
+		x.f <<= 1;
+		--x.e;
+	}
+	return x;
+}
+
+// The value, and the halfway points to its neighboring doubles, which bound the digits that can be written
+struct fp_boundaries
+{
+	diy_fp w;
+	diy_fp minus;
+	diy_fp plus;
+};
+
+// Must only be called with finite, positive values
+fp_boundaries _getBoundaries(double value)
+{
+	const int BIAS = 1075; // 1023 exponent bias + 52 significand bits
+	const std::uint64_t HIDDEN_BIT = 1ull << 52;
+
+	std::uint64_t bits;
+	memcpy(&bits, &value, sizeof(double));
+	const std::uint64_t E = bits >> 52;
+	const std::uint64_t F = bits & (HIDDEN_BIT - 1);
+
+	const diy_fp v = (E == 0) ? diy_fp{ F, 1 - BIAS } : diy_fp{ F + HIDDEN_BIT, static_cast<int>(E) - BIAS };
+
+	// The gap to the next lower double is half as big when the significand is a power of two
+	const bool lowerCloser = (F == 0) && (E > 1);
+	const diy_fp plus = _normalize({ (v.f << 1) + 1, v.e - 1 });
+	diy_fp minus = lowerCloser ? diy_fp{ (v.f << 2) - 1, v.e - 2 } : diy_fp{ (v.f << 1) - 1, v.e - 1 };
+	minus.f <<= (minus.e - plus.e);
+	minus.e = plus.e;
+
+	return { _normalize(v), minus, plus };
+}
+
+// The exponent range that the scaled values are brought into, so that the integral part of the
+//     value fits into 32 bits, and the fractional part into 64 bits
+#define GRISU_ALPHA (-60)
+#define GRISU_GAMMA (-32)
+
+// Normalized powers of ten, as f * 2^e ~= 10^k, for k = -300, -292, ..., 324
+struct cached_power
+{
+	std::uint64_t f;
+	int e;
+	int k;
+};
+const cached_power CACHED_POWERS[] = {
+	{ 0xAB70FE17C79AC6CAULL, -1060, -300 },
+	{ 0xFF77B1FCBEBCDC4FULL, -1034, -292 },
+	{ 0xBE5691EF416BD60CULL, -1007, -284 },
+	{ 0x8DD01FAD907FFC3CULL,  -980, -276 },
+	{ 0xD3515C2831559A83ULL,  -954, -268 },
+	{ 0x9D71AC8FADA6C9B5ULL,  -927, -260 },
+	{ 0xEA9C227723EE8BCBULL,  -901, -252 },
+	{ 0xAECC49914078536DULL,  -874, -244 },
+	{ 0x823C12795DB6CE57ULL,  -847, -236 },
+	{ 0xC21094364DFB5637ULL,  -821, -228 },
+	{ 0x9096EA6F3848984FULL,  -794, -220 },
+	{ 0xD77485CB25823AC7ULL,  -768, -212 },
+	{ 0xA086CFCD97BF97F4ULL,  -741, -204 },
+	{ 0xEF340A98172AACE5ULL,  -715, -196 },
+	{ 0xB23867FB2A35B28EULL,  -688, -188 },
+	{ 0x84C8D4DFD2C63F3BULL,  -661, -180 },
+	{ 0xC5DD44271AD3CDBAULL,  -635, -172 },
+	{ 0x936B9FCEBB25C996ULL,  -608, -164 },
+	{ 0xDBAC6C247D62A584ULL,  -582, -156 },
+	{ 0xA3AB66580D5FDAF6ULL,  -555, -148 },
+	{ 0xF3E2F893DEC3F126ULL,  -529, -140 },
+	{ 0xB5B5ADA8AAFF80B8ULL,  -502, -132 },
+	{ 0x87625F056C7C4A8BULL,  -475, -124 },
+	{ 0xC9BCFF6034C13053ULL,  -449, -116 },
+	{ 0x964E858C91BA2655ULL,  -422, -108 },
+	{ 0xDFF9772470297EBDULL,  -396, -100 },
+	{ 0xA6DFBD9FB8E5B88FULL,  -369,  -92 },
+	{ 0xF8A95FCF88747D94ULL,  -343,  -84 },
+	{ 0xB94470938FA89BCFULL,  -316,  -76 },
+	{ 0x8A08F0F8BF0F156BULL,  -289,  -68 },
+	{ 0xCDB02555653131B6ULL,  -263,  -60 },
+	{ 0x993FE2C6D07B7FACULL,  -236,  -52 },
+	{ 0xE45C10C42A2B3B06ULL,  -210,  -44 },
+	{ 0xAA242499697392D3ULL,  -183,  -36 },
+	{ 0xFD87B5F28300CA0EULL,  -157,  -28 },
+	{ 0xBCE5086492111AEBULL,  -130,  -20 },
+	{ 0x8CBCCC096F5088CCULL,  -103,  -12 },
+	{ 0xD1B71758E219652CULL,   -77,   -4 },
+	{ 0x9C40000000000000ULL,   -50,    4 },
+	{ 0xE8D4A51000000000ULL,   -24,   12 },
+	{ 0xAD78EBC5AC620000ULL,     3,   20 },
+	{ 0x813F3978F8940984ULL,    30,   28 },
+	{ 0xC097CE7BC90715B3ULL,    56,   36 },
+	{ 0x8F7E32CE7BEA5C70ULL,    83,   44 },
+	{ 0xD5D238A4ABE98068ULL,   109,   52 },
+	{ 0x9F4F2726179A2245ULL,   136,   60 },
+	{ 0xED63A231D4C4FB27ULL,   162,   68 },
+	{ 0xB0DE65388CC8ADA8ULL,   189,   76 },
+	{ 0x83C7088E1AAB65DBULL,   216,   84 },
+	{ 0xC45D1DF942711D9AULL,   242,   92 },
+	{ 0x924D692CA61BE758ULL,   269,  100 },
+	{ 0xDA01EE641A708DEAULL,   295,  108 },
+	{ 0xA26DA3999AEF774AULL,   322,  116 },
+	{ 0xF209787BB47D6B85ULL,   348,  124 },
+	{ 0xB454E4A179DD1877ULL,   375,  132 },
+	{ 0x865B86925B9BC5C2ULL,   402,  140 },
+	{ 0xC83553C5C8965D3DULL,   428,  148 },
+	{ 0x952AB45CFA97A0B3ULL,   455,  156 },
+	{ 0xDE469FBD99A05FE3ULL,   481,  164 },
+	{ 0xA59BC234DB398C25ULL,   508,  172 },
+	{ 0xF6C69A72A3989F5CULL,   534,  180 },
+	{ 0xB7DCBF5354E9BECEULL,   561,  188 },
+	{ 0x88FCF317F22241E2ULL,   588,  196 },
+	{ 0xCC20CE9BD35C78A5ULL,   614,  204 },
+	{ 0x98165AF37B2153DFULL,   641,  212 },
+	{ 0xE2A0B5DC971F303AULL,   667,  220 },
+	{ 0xA8D9D1535CE3B396ULL,   694,  228 },
+	{ 0xFB9B7CD9A4A7443CULL,   720,  236 },
+	{ 0xBB764C4CA7A44410ULL,   747,  244 },
+	{ 0x8BAB8EEFB6409C1AULL,   774,  252 },
+	{ 0xD01FEF10A657842CULL,   800,  260 },
+	{ 0x9B10A4E5E9913129ULL,   827,  268 },
+	{ 0xE7109BFBA19C0C9DULL,   853,  276 },
+	{ 0xAC2820D9623BF429ULL,   880,  284 },
+	{ 0x80444B5E7AA7CF85ULL,   907,  292 },
+	{ 0xBF21E44003ACDD2DULL,   933,  300 },
+	{ 0x8E679C2F5E44FF8FULL,   960,  308 },
+	{ 0xD433179D9C8CB841ULL,   986,  316 },
+	{ 0x9E19DB92B4E31BA9ULL,  1013,  324 },
+};
+#define CACHED_POWERS_MIN_EXP (-300)
+#define CACHED_POWERS_STEP (8)
+
+// Gets the cached power of ten c = f * 2^e, such that ALPHA <= e + c.e + 64 <= GAMMA
+const cached_power& _getCachedPower(int e)
+{
+	// ceil((ALPHA - e - 1) * log10(2)), where 78913 / 2^18 ~= log10(2)
+	const int f = GRISU_ALPHA - e - 1;
+	const int k = ((f * 78913) / (1 << 18)) + ((f > 0) ? 1 : 0);
+	const int index = (-CACHED_POWERS_MIN_EXP + k + (CACHED_POWERS_STEP - 1)) / CACHED_POWERS_STEP;
+	return CACHED_POWERS[index];
+}
+
+// Gets the number of decimal digits in the value, and the largest power of ten not greater than it
+int _findLargestPow10(std::uint32_t value, std::uint32_t& pow10)
+{
+	static const std::uint32_t POWERS[10] = {
+		1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+	};
+	int digits = 10;
+	while ((digits > 1) && (value < POWERS[digits - 1]))
+		--digits;
+	pow10 = POWERS[digits - 1];
+	return digits;
+}
+
+// Moves the last digit towards the value as long as it stays inside of the boundaries
+void _roundWeed(char *buffer, int length, std::uint64_t dist, std::uint64_t delta, std::uint64_t rest, std::uint64_t tenK)
+{
+	while ((rest < dist) && ((delta - rest) >= tenK)
+			&& (((rest + tenK) < dist) || ((dist - rest) > (rest + tenK - dist)))) {
+		--buffer[length - 1];
+		rest += tenK;
+	}
+}
+
+// Generates the shortest digits inside of the (scaled) boundaries, writing them into the buffer
+void _generateDigits(char *buffer, int& length, int& exponent, const diy_fp& minus, const diy_fp& w, 
+	const diy_fp& plus)
+{
+	std::uint64_t delta = plus.f - minus.f;
+	std::uint64_t dist = plus.f - w.f;
+
+	const diy_fp one{ 1ull << -plus.e, plus.e };
+	std::uint32_t p1 = static_cast<std::uint32_t>(plus.f >> -one.e); // The integral part
+	std::uint64_t p2 = plus.f & (one.f - 1); // The fractional part
+
+	// Integral digits
+	std::uint32_t pow10;
+	int n = _findLargestPow10(p1, pow10);
+	while (n > 0) {
+		const std::uint32_t digit = p1 / pow10;
+		p1 %= pow10;
+		buffer[length++] = static_cast<char>('0' + digit);
+		--n;
+
+		const std::uint64_t rest = (static_cast<std::uint64_t>(p1) << -one.e) + p2;
+		if (rest <= delta) {
+			exponent += n;
+			_roundWeed(buffer, length, dist, delta, rest, static_cast<std::uint64_t>(pow10) << -one.e);
+			return;
+		}
+		pow10 /= 10;
+	}
+
+	// Fractional digits
+	int m = 0;
+	while (true) {
+		p2 *= 10;
+		const std::uint64_t digit = p2 >> -one.e;
+		p2 &= (one.f - 1);
+		buffer[length++] = static_cast<char>('0' + digit);
+		++m;
+
+		delta *= 10;
+		dist *= 10;
+		if (p2 <= delta)
+			break;
+	}
+	exponent -= m;
+	_roundWeed(buffer, length, dist, delta, p2, one.f);
+}
+
+// Writes the Grisu2 digits for the finite, positive value, such that value = digits * 10^exponent
+int _grisu2(double value, char *digits, int& exponent)
+{
+	const fp_boundaries bounds = _getBoundaries(value);
+	const cached_power& cached = _getCachedPower(bounds.plus.e);
+	const diy_fp c{ cached.f, cached.e };
+
+	const diy_fp w = _mul(bounds.w, c);
+	diy_fp minus = _mul(bounds.minus, c);
+	diy_fp plus = _mul(bounds.plus, c);
+
+	// The multiplications can be off by one ulp, so shrink the boundaries to stay safe
+	minus.f += 1;
+	plus.f -= 1;
+
+	int length = 0;
+	exponent = -cached.k;
+	_generateDigits(digits, length, exponent, minus, w, plus);
+	return length;
+}
+
+// Writes an exponent in the same style as printf, with a sign and at least two digits
+char* _writeExponent(int exponent, char *buffer)
+{
+	*buffer++ = 'e';
+	if (exponent < 0) {
+		*buffer++ = '-';
+		exponent = -exponent;
+	}
+	else
+		*buffer++ = '+';
+
+	if (exponent >= 100) {
+		*buffer++ = static_cast<char>('0' + (exponent / 100));
+		exponent %= 100;
+	}
+	*buffer++ = static_cast<char>('0' + (exponent / 10));
+	*buffer++ = static_cast<char>('0' + (exponent % 10));
+	return buffer;
+}
+
+// Writes the special values (zero, infinity and NaN), returning zero if the value is not special
+size_t _writeSpecial(double value, char *buffer)
+{
+	if (std::isnan(value)) {
+		memcpy(buffer, "nan", 3);
+		return 3;
+	}
+
+	char *start = buffer;
+	if (std::signbit(value))
+		*buffer++ = '-';
+	if (std::isinf(value)) {
+		memcpy(buffer, "inf", 3);
+		return (buffer - start) + 3;
+	}
+	if (value == 0) {
+		*buffer++ = '0';
+		return buffer - start;
+	}
+	return 0;
+}
+
+thread_local char g_buffer[NUMFMT_BUFFER_SIZE];
+
+} // namespace
+
+
+namespace numfmt
+{
+
+// ================================================================================================
+size_t writeShortest(double value, char *buffer)
+{
+	const size_t special = _writeSpecial(value, buffer);
+	if (special > 0)
+		return special;
+
+	char *out = buffer;
+	if (value < 0) {
+		*out++ = '-';
+		value = -value;
+	}
+
+	// Write the digits after a gap, so they can be moved into place for the different notations
+	char *digits = out + 8;
+	int exponent;
+	const int length = _grisu2(value, digits, exponent);
+	const int point = length + exponent; // The position of the decimal point, relative to the digits
+
+	if ((exponent >= 0) && (point <= 15)) {
+		// Whole number: ddd000
+		memmove(out, digits, length);
+		memset(out + length, '0', exponent);
+		out += point;
+	}
+	else if ((point > 0) && (point <= 15)) {
+		// Decimal point inside of the digits: ddd.ddd
+		memmove(out, digits, point);
+		out[point] = '.';
+		memmove(out + point + 1, digits + point, length - point);
+		out += length + 1;
+	}
+	else if ((point > -4) && (point <= 0)) {
+		// Small value: 0.000ddd
+		memmove(out + 2 - point, digits, length);
+		out[0] = '0';
+		out[1] = '.';
+		memset(out + 2, '0', -point);
+		out += 2 - point + length;
+	}
+	else {
+		// Scientific notation: d.ddde+XX
+		out[0] = digits[0];
+		if (length > 1) {
+			out[1] = '.';
+			memmove(out + 2, digits + 1, length - 1);
+			out += length + 1;
+		}
+		else
+			out += 1;
+		out = _writeExponent(point - 1, out);
+	}
+
+	return out - buffer;
+}
+
+// ================================================================================================
+size_t writePrecision(double value, int precision, char *buffer)
+{
+	if (precision > NUMFMT_MAX_PRECISION)
+		precision = NUMFMT_MAX_PRECISION;
+	const int length = snprintf(buffer, NUMFMT_BUFFER_SIZE, "%.*g", precision, value);
+	return (length > 0) ? static_cast<size_t>(length) : 0;
+}
+
+// ================================================================================================
+size_t writeDouble(double value, int precision, char *buffer)
+{
+	return (precision == NUMFMT_ROUNDTRIP) ? writeShortest(value, buffer) : writePrecision(value, precision, buffer);
+}
+
+// ================================================================================================
+size_t writeInt(std::int64_t value, char *buffer)
+{
+	if (value < 0) {
+		*buffer = '-';
+		// Negate as unsigned, which is also correct for the most negative value
+		return writeUInt(0ull - static_cast<std::uint64_t>(value), buffer + 1) + 1;
+	}
+	return writeUInt(static_cast<std::uint64_t>(value), buffer);
+}
+
+// ================================================================================================
+size_t writeUInt(std::uint64_t value, char *buffer)
+{
+	char digits[20];
+	size_t count = 0;
+	do {
+		digits[count++] = static_cast<char>('0' + (value % 10));
+		value /= 10;
+	} while (value > 0);
+
+	for (size_t i = 0; i < count; ++i)
+		buffer[i] = digits[count - i - 1];
+	return count;
+}
+
+// ================================================================================================
+void append(std::stringstream& out, double value, int precision)
+{
+	out.write(g_buffer, writeDouble(value, precision, g_buffer));
+}
+
+// ================================================================================================
+void append(std::stringstream& out, std::int64_t value)
+{
+	out.write(g_buffer, writeInt(value, g_buffer));
+}
+
+// ================================================================================================
+void append(std::stringstream& out, std::uint64_t value)
+{
+	out.write(g_buffer, writeUInt(value, g_buffer));
+}
+
+} // namespace numfmt
\ No newline at end of file
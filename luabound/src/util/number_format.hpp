@@ -0,0 +1,51 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file declares the functions used to quickly convert numbers into text for the output files.
+ *     ReboundU builds this file too, so it only uses the standard library types.
+ */
+
+#ifndef LUABOUND_NUMBER_FORMAT_HPP_
+#define LUABOUND_NUMBER_FORMAT_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+
+// The precision value that writes the fewest digits (see writeShortest) that read back as exactly the same double
+#define NUMFMT_ROUNDTRIP (0)
+// The largest precision that can be given, which is enough to exactly represent any double
+#define NUMFMT_MAX_PRECISION (17)
+// The size of the character buffer needed to hold any single formatted number
+#define NUMFMT_BUFFER_SIZE (32)
+
+namespace numfmt
+{
+
+// Writes a decimal representation of the value that will parse back into exactly the same double,
+//     using the Grisu2 algorithm. This is the shortest one for almost every double, but for about
+//     0.08% of them Grisu2 gives a few more digits (at most 17) than needed. Values between 1e-4 and
+//     1e15 are written in plain decimal notation, and all others in scientific notation. Returns the
+//     number of characters.
+size_t writeShortest(double value, char *buffer);
+// Writes the value with the given number of significant digits, the same as printf's "%.*g"
+size_t writePrecision(double value, int precision, char *buffer);
+// Writes the value, with the precision being either a digit count or NUMFMT_ROUNDTRIP
+size_t writeDouble(double value, int precision, char *buffer);
+size_t writeInt(std::int64_t value, char *buffer);
+size_t writeUInt(std::uint64_t value, char *buffer);
+
+// These format the value into a thread-local buffer, and then append it to the stream, which
+//     avoids the (slow) formatting and locale machinery of the stream insertion operators
+void append(std::stringstream& out, double value, int precision);
+void append(std::stringstream& out, std::int64_t value);
+void append(std::stringstream& out, std::uint64_t value);
+inline void append(std::stringstream& out, std::int32_t value) { append(out, static_cast<std::int64_t>(value)); }
+inline void append(std::stringstream& out, std::uint32_t value) { append(out, static_cast<std::uint64_t>(value)); }
+
+} // namespace numfmt
+
+#endif // LUABOUND_NUMBER_FORMAT_HPP_
\ No newline at end of file
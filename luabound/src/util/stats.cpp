@@ -0,0 +1,205 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file implements the functions used to calculate statistics over columns of values.
+ */
+
+#include "stats.hpp"
+#include <algorithm>
+#include <limits>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// The number of values in each block, small enough that the second pass over a block hits the cache
+#define STATS_BLOCK_SIZE (256)
+// The number of independent sums in the inner loops, which lets them be vectorized
+#define STATS_LANES (4)
+// The number of values needed before a histogram is split between threads
+#define STATS_PARALLEL_HISTOGRAM_SIZE (32768)
+
+
+namespace
+{
+
+// Sums the lanes in a fixed order, so the results do not depend on how the loops were vectorized
+inline double _sumLanes(const double *lanes)
+{
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+// Gets the bin for the value, or -1 if it is outside of the range (or NaN)
+inline int64 _getBin(double value, const stats::bin_range& range, double scale)
+{
+	const double pos = (value - range.min) * scale;
+	if (!((pos >= 0) && (pos <= range.bins)))
+		return -1;
+	const int64 bin = static_cast<int64>(pos);
+	return (bin == range.bins) ? (bin - 1) : bin;
+}
+
+// Adds the values in [begin, end) to the bins
+void _addToHistogram(const double *x, const double *y, const double *weights, size_t begin, size_t end, 
+	const stats::bin_range& xrange, const stats::bin_range& yrange, double *out)
+{
+	const double XSCALE = xrange.bins / (xrange.max - xrange.min);
+	const double YSCALE = y ? (yrange.bins / (yrange.max - yrange.min)) : 0;
+	for (size_t i = begin; i < end; ++i) {
+		const int64 xbin = _getBin(x[i], xrange, XSCALE);
+		if (xbin < 0)
+			continue;
+		int64 bin = xbin;
+		if (y) {
+			const int64 ybin = _getBin(y[i], yrange, YSCALE);
+			if (ybin < 0)
+				continue;
+			bin = (xbin * yrange.bins) + ybin;
+		}
+		out[bin] += weights ? weights[i] : 1.0;
+	}
+}
+
+} // namespace
+
+
+namespace stats
+{
+
+// ================================================================================================
+void reduce(const double *values, const double *weights, size_t count, column_stats& out)
+{
+	double total = 0, mean = 0, m2 = 0;
+	double wsum = 0, wvsum = 0;
+	double minval = std::numeric_limits<double>::infinity();
+	double maxval = -std::numeric_limits<double>::infinity();
+
+	for (size_t start = 0; start < count; start += STATS_BLOCK_SIZE) {
+		const size_t LEN = std::min(static_cast<size_t>(STATS_BLOCK_SIZE), count - start);
+		const size_t VLEN = LEN - (LEN % STATS_LANES);
+		const double *V = values + start;
+
+		// First pass: sum, min, and max
+		double sum[STATS_LANES] = { 0, 0, 0, 0 };
+		double bmin[STATS_LANES] = { minval, minval, minval, minval };
+		double bmax[STATS_LANES] = { maxval, maxval, maxval, maxval };
+		for (size_t i = 0; i < VLEN; i += STATS_LANES) {
+			for (size_t l = 0; l < STATS_LANES; ++l) {
+				const double v = V[i + l];
+				sum[l] += v;
+				bmin[l] = (v < bmin[l]) ? v : bmin[l];
+				bmax[l] = (v > bmax[l]) ? v : bmax[l];
+			}
+		}
+		for (size_t i = VLEN; i < LEN; ++i) {
+			sum[0] += V[i];
+			bmin[0] = (V[i] < bmin[0]) ? V[i] : bmin[0];
+			bmax[0] = (V[i] > bmax[0]) ? V[i] : bmax[0];
+		}
+		for (size_t l = 0; l < STATS_LANES; ++l) {
+			minval = std::min(minval, bmin[l]);
+			maxval = std::max(maxval, bmax[l]);
+		}
+		const double BMEAN = _sumLanes(sum) / LEN;
+
+		// Second pass (from the cache): squared differences from the block mean, and the weighted sums
+		double sq[STATS_LANES] = { 0, 0, 0, 0 };
+		for (size_t i = 0; i < VLEN; i += STATS_LANES) {
+			for (size_t l = 0; l < STATS_LANES; ++l) {
+				const double d = V[i + l] - BMEAN;
+				sq[l] += d * d;
+			}
+		}
+		for (size_t i = VLEN; i < LEN; ++i)
+			sq[0] += (V[i] - BMEAN) * (V[i] - BMEAN);
+
+		if (weights) {
+			const double *W = weights + start;
+			double ws[STATS_LANES] = { 0, 0, 0, 0 };
+			double wvs[STATS_LANES] = { 0, 0, 0, 0 };
+			for (size_t i = 0; i < VLEN; i += STATS_LANES) {
+				for (size_t l = 0; l < STATS_LANES; ++l) {
+					ws[l] += W[i + l];
+					wvs[l] += W[i + l] * V[i + l];
+				}
+			}
+			for (size_t i = VLEN; i < LEN; ++i) {
+				ws[0] += W[i];
+				wvs[0] += W[i] * V[i];
+			}
+			wsum += _sumLanes(ws);
+			wvsum += _sumLanes(wvs);
+		}
+
+		// Merge the block into the running values
+		const double BCOUNT = static_cast<double>(LEN);
+		const double NEWTOTAL = total + BCOUNT;
+		const double DELTA = BMEAN - mean;
+		mean += DELTA * (BCOUNT / NEWTOTAL);
+		m2 += _sumLanes(sq) + (DELTA * DELTA * total * BCOUNT / NEWTOTAL);
+		total = NEWTOTAL;
+	}
+
+	if (count == 0) {
+		const double NaN = std::numeric_limits<double>::quiet_NaN();
+		out.mean = out.stddev = out.min = out.max = out.wmean = NaN;
+		return;
+	}
+
+	out.mean = mean;
+	out.stddev = sqrt(m2 / total);
+	out.min = minval;
+	out.max = maxval;
+	out.wmean = weights ? (wvsum / wsum) : std::numeric_limits<double>::quiet_NaN();
+}
+
+// ================================================================================================
+double percentile(const double *sorted, size_t count, double pct)
+{
+	if (count == 0)
+		return std::numeric_limits<double>::quiet_NaN();
+
+	const double POS = (pct / 100.0) * (count - 1);
+	const size_t LOW = static_cast<size_t>(floor(POS));
+	if (LOW >= (count - 1))
+		return sorted[count - 1];
+	const double FRAC = POS - LOW;
+	return sorted[LOW] + (FRAC * (sorted[LOW + 1] - sorted[LOW]));
+}
+
+// ================================================================================================
+void histogram(const double *x, const double *y, const double *weights, size_t count, const bin_range& xrange,
+	const bin_range& yrange, double *out)
+{
+	const size_t BINS = static_cast<size_t>(xrange.bins) * (y ? yrange.bins : 1);
+	std::fill(out, out + BINS, 0.0);
+
+#ifdef _OPENMP
+	if ((count >= STATS_PARALLEL_HISTOGRAM_SIZE) && (omp_get_max_threads() > 1)) {
+		// Each thread fills its own bins from a contiguous range, which are added together in thread
+		//     order so that the weighted sums do not depend on the scheduling
+		const int THREADS = omp_get_max_threads();
+		StlVector<double> local(BINS * THREADS, 0.0);
+		#pragma omp parallel num_threads(THREADS)
+		{
+			const int TID = omp_get_thread_num();
+			const int TCOUNT = omp_get_num_threads();
+			const size_t BEGIN = (count * TID) / TCOUNT;
+			const size_t END = (count * (TID + 1)) / TCOUNT;
+			_addToHistogram(x, y, weights, BEGIN, END, xrange, yrange, &local[BINS * TID]);
+		}
+		for (int t = 0; t < THREADS; ++t) {
+			const double *tbins = &local[BINS * t];
+			for (size_t b = 0; b < BINS; ++b)
+				out[b] += tbins[b];
+		}
+		return;
+	}
+#endif
+
+	_addToHistogram(x, y, weights, 0, count, xrange, yrange, out);
+}
+
+} // namespace stats
\ No newline at end of file
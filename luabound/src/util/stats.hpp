@@ -0,0 +1,56 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file declares the functions used to calculate statistics over columns of values.
+ */
+
+#ifndef LUABOUND_STATS_HPP_
+#define LUABOUND_STATS_HPP_
+
+#include "../luabound.hpp"
+
+namespace stats
+{
+
+// The statistics of a column of values, which are all calculated together in a single pass
+struct column_stats
+{
+	double mean;
+	double stddev; // The population standard deviation
+	double min;
+	double max;
+	double wmean; // The weighted mean, only calculated if weights are given
+};
+
+// Calculates the statistics for the values. The values are processed in small blocks that stay in
+//     the cache, with the sums for each block merged using the pairwise (Chan et al.) update, which
+//     is as stable as Welford's method but keeps the inner loops simple enough to vectorize. The
+//     weights can be null, in which case the weighted mean is not calculated.
+void reduce(const double *values, const double *weights, size_t count, column_stats& out);
+
+// Gets the percentile (0 to 100) of the sorted values, interpolating linearly between the closest
+//     ranks (the same as numpy.percentile)
+double percentile(const double *sorted, size_t count, double pct);
+
+// The evenly spaced bins along one axis of a histogram
+struct bin_range
+{
+	double min;
+	double max;
+	uint32 bins;
+};
+
+// Counts the values into evenly spaced bins, adding the weight of each value instead of one if the
+//     weights are given. Like numpy.histogram, values outside of [min, max] are skipped, and a value
+//     exactly at max goes in the last bin. If y is given, the histogram is two dimensional, and the
+//     bins are stored row-major (out[ix * ybins + iy]). The out array is overwritten. Large counts are
+//     split between threads, each with their own bins, when built with OpenMP.
+void histogram(const double *x, const double *y, const double *weights, size_t count, const bin_range& xrange,
+	const bin_range& yrange, double *out);
+
+} // namespace stats
+
+#endif // LUABOUND_STATS_HPP_
\ No newline at end of file
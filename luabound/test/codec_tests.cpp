@@ -0,0 +1,278 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file tests the XOR codec of the compressed output files, both on its own and through the compressed files
+ *     that are written by the output manager and decoded by the io library, with and without rounding.
+ */
+
+#include "test.hpp"
+#include "../io/lbdio.hpp"
+#include "../io/xor_codec.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <random>
+
+namespace
+{
+
+const char * const SCRIPT = R"(
+new_simulation {
+	name = "codec_test",
+	constants = { G = 1, max_time = 1 },
+	integrator = { name = "ias15" },
+	output = {
+		["codec_test.bin"] = { format = "#st {#px,#py,#pz;}", time = 0, binary = true },
+		["codec_test_exact.lbz"] = { format = "#st {#px,#py,#pz;}", time = 0, compress = true, keyframe = 5 },
+		["codec_test_round.lbz"] = { format = "#st {#px,#py,#pz;}", time = 0, compress = true, keyframe = 5,
+			mantissa_bits = %BITS% }
+	},
+	populate = function()
+		sim.addParticle(1, 1e-4, place.cartesian(0.0, 0.0, 0.0), nil, "sun")
+		sim.setPrimaryParticle("sun")
+		sim.addParticle(1e-9, 1e-4, place.cartesian(1.0, 0.0, 0.0, 0.0, 1.0, 0.0), nil, "a")
+		sim.addParticle(1e-9, 1e-4, place.cartesian(-2.0, 0.0, 0.0, 0.0, -0.7, 0.0), nil, "b")
+	end
+}
+)";
+
+const char * const FILES[] = { "codec_test.bin", "codec_test_exact.lbz", "codec_test_round.lbz" };
+const uint32 MANTISSA_BITS = 20;
+const uint32 RECORD_COUNT = 12;
+
+// The double values that need care from the codec, which are cycled through the records
+const double SPECIAL_VALUES[] = {
+	0.0, -0.0,
+	std::numeric_limits<double>::quiet_NaN(),
+	-std::numeric_limits<double>::quiet_NaN(),
+	std::numeric_limits<double>::infinity(),
+	-std::numeric_limits<double>::infinity(),
+	std::numeric_limits<double>::denorm_min(),
+	-std::numeric_limits<double>::denorm_min() * 12345,
+	std::numeric_limits<double>::min() / 3,
+	std::numeric_limits<double>::min(),
+	std::numeric_limits<double>::max(),
+	-std::numeric_limits<double>::max(),
+	1.0 / 3.0
+};
+const uint32 SPECIAL_COUNT = sizeof(SPECIAL_VALUES) / sizeof(double);
+
+inline uint64 _bits(double value)
+{
+	uint64 bits;
+	memcpy(&bits, &value, 8);
+	return bits;
+}
+
+// Checks that the decoded double is the original rounded to the mantissa bits (or exact, for 0 bits). Rounding
+//     adds at most half of the dropped bits to the bit pattern, and NaNs and infinities are never changed.
+bool _checkDouble(uint64 original, uint64 decoded, uint32 bits)
+{
+	const bool special = ((original >> 52) & 0x7FF) == 0x7FF;
+	if (bits == 0 || special)
+		return decoded == original;
+
+	const uint64 half = 1ull << (51 - bits);
+	const uint64 low = (half << 1) - 1;
+	if ((decoded & (1ull << 63)) != (original & (1ull << 63)))
+		return false;
+	// Values that would round up to infinity are kept exact
+	if ((decoded & low) != 0)
+		return decoded == original;
+	const uint64 mag = original & ~(1ull << 63);
+	const uint64 dmag = decoded & ~(1ull << 63);
+	return ((dmag >= mag) ? (dmag - mag) : (mag - dmag)) <= half;
+}
+
+void _putValue(StlVector<uint8>& record, uint64 value, uint32 size)
+{
+	for (uint32 b = 0; b < size; ++b)
+		record.push_back(static_cast<uint8>(value >> (8 * b)));
+}
+
+// Encodes records with a time, a step count, an unfiltered vector list, and a filtered list with an int and a double
+//     column, then decodes them and checks each field against the original
+void _checkCodec(uint32 bits)
+{
+	const StlVector<lbdio::column_desc> columns = {
+		{ LBDIO_TYPE_DOUBLE, 1, LBDIO_NO_LIST, 0 },
+		{ LBDIO_TYPE_LONG, 1, LBDIO_NO_LIST, 0 },
+		{ LBDIO_TYPE_DOUBLE, 3, 0, 0 },
+		{ LBDIO_TYPE_INT, 1, 1, LBDIO_FILTERED_LIST },
+		{ LBDIO_TYPE_DOUBLE, 1, 1, LBDIO_FILTERED_LIST }
+	};
+	lbdio::XorEncoder encoder;
+	encoder.setColumns(columns);
+	encoder.setMantissaBits(bits);
+	lbdio::XorDecoder decoder;
+	decoder.setColumns(columns);
+
+	// The types of each field are kept with the records, with the counts as ints, for checking the decoded records
+	std::mt19937_64 rng{bits + 1};
+	StlVector<StlVector<uint8>> records;
+	StlVector<StlVector<uint8>> types;
+	lbdio::BitWriter writer;
+	uint32 special = 0;
+	for (uint32 r = 0; r < 50; ++r) {
+		StlVector<uint8> record, type;
+		const uint32 count = 1 + (rng() % 4);
+		const uint32 filtered = rng() % (count + 1);
+		auto nextDouble = [&]() {
+			// Mostly smooth values, which take the short encodings, with the special values mixed in
+			const double smooth = (r * 0.01) + (std::uniform_real_distribution<double>(-1, 1)(rng) * 1e-6);
+			return ((rng() % 3) == 0) ? SPECIAL_VALUES[(special++) % SPECIAL_COUNT] : smooth;
+		};
+
+		_putValue(record, count, 4);
+		_putValue(record, _bits(nextDouble()), 8);
+		_putValue(record, static_cast<uint64>(-static_cast<int64>(r) * 1000003), 8);
+		type.insert(type.end(), { LBDIO_TYPE_INT, LBDIO_TYPE_DOUBLE, LBDIO_TYPE_LONG });
+		for (uint32 i = 0; i < count * 3; ++i) {
+			_putValue(record, _bits(nextDouble()), 8);
+			type.push_back(LBDIO_TYPE_DOUBLE);
+		}
+		_putValue(record, filtered, 4);
+		type.push_back(LBDIO_TYPE_INT);
+		for (uint32 i = 0; i < filtered; ++i) {
+			_putValue(record, rng() & 0xFFFFFFFF, 4);
+			type.push_back(LBDIO_TYPE_INT);
+		}
+		for (uint32 i = 0; i < filtered; ++i) {
+			_putValue(record, _bits(nextDouble()), 8);
+			type.push_back(LBDIO_TYPE_DOUBLE);
+		}
+
+		if ((r % 10) == 0)
+			encoder.reset(); // Start a new block, like the keyframes
+		TEST_CHECK(encoder.encode(record.data(), record.size(), writer));
+		records.push_back(record);
+		types.push_back(type);
+	}
+	writer.flush();
+
+	lbdio::BitReader reader{writer.getData().data(), writer.getData().size()};
+	for (uint32 r = 0; r < records.size(); ++r) {
+		if ((r % 10) == 0)
+			decoder.reset();
+		StlVector<uint8> decoded;
+		if (!TEST_CHECK(decoder.decode(reader, decoded)) || !TEST_CHECK(decoded.size() == records[r].size()))
+			return;
+
+		bool good = true;
+		size_t pos = 0;
+		for (const uint8 type : types[r]) {
+			const uint32 size = (type == LBDIO_TYPE_INT) ? 4 : 8;
+			uint64 original = 0, value = 0;
+			memcpy(&original, records[r].data() + pos, size);
+			memcpy(&value, decoded.data() + pos, size);
+			good = good && ((type == LBDIO_TYPE_DOUBLE) ? _checkDouble(original, value, bits) : (value == original));
+			pos += size;
+		}
+		const String text = strfmt("codec record %u round trips with %u mantissa bits", r, bits);
+		test::Check(good, text.c_str(), __FILE__, __LINE__);
+	}
+}
+
+StlVector<uint8> _readFile(const String& path)
+{
+	std::ifstream file{path, std::ios::binary};
+	return StlVector<uint8>{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+// Gives the offset of the first record in the file from its index
+uint64 _getFirstOffset(const char *path)
+{
+	const StlVector<uint8> index = _readFile(String(path) + INDEX_FILE_EXTENSION);
+	uint64 offset = 0;
+	if (TEST_CHECK(index.size() >= (8 + INDEX_RECORD_SIZE)))
+		memcpy(&offset, index.data() + 8 + 16, 8);
+	return offset;
+}
+
+// Writes the special values as the particle positions, then checks the decoded compressed files against the
+//     binary file with the same records
+void _checkFiles()
+{
+	String script = SCRIPT;
+	script.replace(script.find("%BITS%"), 6, std::to_string(MANTISSA_BITS));
+	{
+		StlUniquePtr<LbdSimulation> sim = test::LoadSimulation(script);
+		if (!TEST_CHECK(sim != nullptr))
+			return;
+		reb_simulation *rsim = sim->getSimulation();
+		sim->getOutputManager()->start();
+		for (uint32 beat = 0; beat < RECORD_COUNT; ++beat) {
+			rsim->t = beat * 0.1;
+			for (uint32 p = 1; p < 3; ++p) {
+				rsim->particles[p].x = SPECIAL_VALUES[(beat + p) % SPECIAL_COUNT];
+				rsim->particles[p].y = SPECIAL_VALUES[(beat + (2 * p) + 5) % SPECIAL_COUNT];
+				rsim->particles[p].z = (beat * 0.25) + p;
+			}
+			sim->heartbeatCallback(rsim);
+		}
+		sim->getOutputManager()->finish();
+	}
+
+	// The records after the header, which the decoded files must end with
+	const StlVector<uint8> binary = _readFile(FILES[0]);
+	const uint64 first = _getFirstOffset(FILES[0]);
+	if (!TEST_CHECK((first > 0) && (first < binary.size())))
+		return;
+	const uint64 recordBytes = binary.size() - first;
+	TEST_CHECK(recordBytes == (RECORD_COUNT * (4 + 8 + (9 * 8))));
+
+	for (uint32 f = 1; f < 3; ++f) {
+		const uint32 bits = (f == 1) ? 0 : MANTISSA_BITS;
+		uint32 keyframe = 0, fileBits = 0;
+		TEST_CHECK(lbdio_get_compressed_info(FILES[f], &keyframe, &fileBits) == 1);
+		TEST_CHECK((keyframe == 5) && (fileBits == bits));
+
+		uint8 *data = nullptr;
+		uint64 size = 0;
+		if (!TEST_CHECK(lbdio_decode_compressed(FILES[f], 0, 0, 0, &data, &size) == 1))
+			continue;
+		if (TEST_CHECK((size > recordBytes) && (memcmp(data, LBDIO_BINARY_MAGIC, 4) == 0))) {
+			// Every record is the particle count, then doubles
+			const uint8 *decoded = data + (size - recordBytes);
+			const uint8 *expected = binary.data() + first;
+			bool good = true;
+			for (uint64 pos = 0; pos < recordBytes; ) {
+				if ((pos % (4 + 8 + (9 * 8))) == 0) {
+					good = good && (memcmp(decoded + pos, expected + pos, 4) == 0);
+					pos += 4;
+					continue;
+				}
+				uint64 original, value;
+				memcpy(&original, expected + pos, 8);
+				memcpy(&value, decoded + pos, 8);
+				good = good && _checkDouble(original, value, bits);
+				pos += 8;
+			}
+			const String text = strfmt("the records in \"%s\" match the binary file", FILES[f]);
+			test::Check(good, text.c_str(), __FILE__, __LINE__);
+		}
+		lbdio_free(data);
+	}
+
+	for (const char *file : FILES) {
+		std::remove(file);
+		std::remove((String(file) + INDEX_FILE_EXTENSION).c_str());
+	}
+}
+
+} // namespace
+
+
+// ================================================================================================
+void test_xor_codec()
+{
+	_checkCodec(0);
+	_checkCodec(MANTISSA_BITS);
+	_checkCodec(1);
+	_checkFiles();
+}
\ No newline at end of file
@@ -0,0 +1,203 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file tests the file sink, with writes that fit in the buffer and writes that go around it, and the flush
+ *     policies of the output files, by checking what has reached the file after each write.
+ */
+
+#include "test.hpp"
+#include "../src/util/file_sink.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+
+const char * const SINK_FILE = "sink_test.dat";
+const size_t CAPACITY = FILE_SINK_ALIGNMENT;
+
+const char * const SCRIPT = R"(
+new_simulation {
+	name = "sink_test",
+	constants = { G = 1, max_time = 1 },
+	integrator = { name = "ias15" },
+	output = {
+		["sink_test_line.dat"] = { format = "#st #sts {#px;}", time = 0, flush = "line" },
+		["sink_test_tick.dat"] = { format = "#st #sts {#px;}", time = 0, flush = "tick" },
+		["sink_test_sync.dat"] = { format = "#st #sts {#px;}", time = 0, flush = "line", sync = true },
+		["sink_test_seconds.dat"] = { format = "#st #sts {#px;}", time = 0, flush = "seconds:1000" },
+		["sink_test_close.dat"] = { format = "#st #sts {#px;}", time = 0, flush = "close" }
+	},
+	populate = function()
+		sim.addParticle(1, 1e-4, place.cartesian(0.0, 0.0, 0.0), nil, "sun")
+		sim.setPrimaryParticle("sun")
+		sim.addParticle(1e-9, 1e-4, place.cartesian(1.0, 0.0, 0.0, 0.0, 1.0, 0.0), nil, "a")
+	end
+}
+)";
+
+// The files that are flushed after every heartbeat, then the files that are only flushed when they are closed
+const char * const FILES[] = {
+	"sink_test_line.dat", "sink_test_tick.dat", "sink_test_sync.dat", "sink_test_seconds.dat", "sink_test_close.dat"
+};
+const uint32 FLUSHED_COUNT = 3;
+const uint32 FILE_COUNT = 5;
+const uint32 RECORD_COUNT = 6;
+
+StlVector<uint8> _readFile(const String& path)
+{
+	std::ifstream file{path, std::ios::binary};
+	return StlVector<uint8>{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+// Gives the output file without its first header line, which is the name of the file
+StlVector<uint8> _readOutput(const char *path)
+{
+	StlVector<uint8> contents = _readFile(path);
+	contents.erase(contents.begin(), std::find(contents.begin(), contents.end(), '\n'));
+	return contents;
+}
+
+// Gives bytes that do not repeat at the same offsets, so data that is written out of order does not match
+void _append(StlVector<uint8>& expected, StlVector<uint8>& data, size_t size)
+{
+	data.resize(size);
+	for (size_t i = 0; i < size; ++i)
+		data[i] = static_cast<uint8>((expected.size() + i) * 7 + ((expected.size() + i) >> 8));
+	expected.insert(expected.end(), data.begin(), data.end());
+}
+
+// Checks that the file holds exactly the expected bytes, and that the rest are still in the buffer
+void _checkFile(const FileSink& sink, const StlVector<uint8>& expected, size_t buffered, const char *text)
+{
+	const StlVector<uint8> contents = _readFile(SINK_FILE);
+	const bool good = (sink.getBuffered() == buffered) && ((contents.size() + buffered) == expected.size()) &&
+		std::equal(contents.begin(), contents.end(), expected.begin());
+	test::Check(good, text, __FILE__, __LINE__);
+}
+
+// Writes below, at, and above the buffer size, in every order, and flushes in every way
+void _checkSink()
+{
+	FileSink sink{CAPACITY};
+	if (!TEST_CHECK(sink.open(SINK_FILE)))
+		return;
+	StlVector<uint8> expected, data;
+
+	_append(expected, data, 100);
+	TEST_CHECK(sink.write(data.data(), data.size()));
+	_checkFile(sink, expected, 100, "small writes are buffered");
+	TEST_CHECK(sink.flush());
+	_checkFile(sink, expected, 0, "flush() writes the buffered data");
+
+	// Exactly filling the buffer still buffers, one more byte goes out together with the buffer
+	_append(expected, data, 1000);
+	TEST_CHECK(sink.write(data.data(), data.size()));
+	_append(expected, data, CAPACITY - 1000);
+	TEST_CHECK(sink.write(data.data(), data.size()));
+	_checkFile(sink, expected, CAPACITY, "writes that fill the buffer are buffered");
+	_append(expected, data, 1);
+	TEST_CHECK(sink.write(data.data(), data.size()));
+	_checkFile(sink, expected, 0, "a write past a full buffer writes both");
+
+	// Writes larger than the buffer go straight to the file when it is empty, and with writev() when it is not
+	_append(expected, data, (CAPACITY * 3) + 5);
+	TEST_CHECK(sink.write(data.data(), data.size()));
+	_checkFile(sink, expected, 0, "large writes bypass the empty buffer");
+	_append(expected, data, 10);
+	TEST_CHECK(sink.write(data.data(), data.size()));
+	_append(expected, data, (CAPACITY * 2) + 17);
+	TEST_CHECK(sink.write(data.data(), data.size()));
+	_checkFile(sink, expected, 0, "large writes are written together with the buffer");
+	_append(expected, data, 3000);
+	TEST_CHECK(sink.write(data.data(), data.size()));
+	_append(expected, data, 2000);
+	TEST_CHECK(sink.write(data.data(), data.size()));
+	_checkFile(sink, expected, 0, "writes past a partly full buffer are written together with it");
+
+	// Stream buffers are moved through the buffer, which is flushed every time it fills
+	_append(expected, data, 50);
+	TEST_CHECK(sink.write(data.data(), data.size()));
+	_append(expected, data, (CAPACITY * 2) + 300);
+	StringStream stream{String(data.begin(), data.end())};
+	size_t moved = 0;
+	TEST_CHECK(sink.write(stream.rdbuf(), moved) && (moved == data.size()));
+	_checkFile(sink, expected, (50 + data.size()) % CAPACITY, "stream buffers are written through the buffer");
+
+	TEST_CHECK(sink.sync());
+	_checkFile(sink, expected, 0, "sync() writes the buffered data");
+	_append(expected, data, 20);
+	TEST_CHECK(sink.write(data.data(), data.size()));
+	TEST_CHECK(sink.close() && !sink.isOpen());
+	_checkFile(sink, expected, 0, "close() writes the buffered data");
+
+	// The sink flushes when it is destroyed without being closed
+	{
+		FileSink other{CAPACITY};
+		TEST_CHECK(other.open(SINK_FILE) && other.write(data.data(), data.size()));
+	}
+	TEST_CHECK(_readFile(SINK_FILE) == data);
+	std::remove(SINK_FILE);
+}
+
+// Runs a simulation with one output file for each policy, and checks how much of each file has been written after
+//     each heartbeat. All of the files end up the same once they are closed.
+void _checkPolicies()
+{
+	{
+		StlUniquePtr<LbdSimulation> sim = test::LoadSimulation(SCRIPT);
+		if (!TEST_CHECK(sim != nullptr))
+			return;
+		reb_simulation *rsim = sim->getSimulation();
+		sim->getOutputManager()->start();
+		// The header is written as soon as the file is opened, so the other files only ever hold their header
+		size_t lastSize = 0;
+		StlVector<size_t> headerSizes(FILE_COUNT, 0);
+		for (uint32 beat = 0; beat < RECORD_COUNT; ++beat) {
+			rsim->t = beat * 0.1;
+			rsim->particles[1].x += 0.01;
+			sim->heartbeatCallback(rsim);
+
+			const StlVector<uint8> flushed = _readOutput(FILES[0]);
+			bool good = (flushed.size() > lastSize) && (flushed.back() == '\n');
+			for (uint32 f = 1; f < FLUSHED_COUNT; ++f)
+				good = good && (_readOutput(FILES[f]) == flushed);
+			for (uint32 f = FLUSHED_COUNT; f < FILE_COUNT; ++f) {
+				const StlVector<uint8> held = _readOutput(FILES[f]);
+				headerSizes[f] = (beat == 0) ? held.size() : headerSizes[f];
+				good = good && (held.size() == headerSizes[f]) && (held.size() < flushed.size()) &&
+					std::equal(held.begin(), held.end(), flushed.begin());
+			}
+			const String text = strfmt("only the flushed files are written after heartbeat %u", beat);
+			test::Check(good, text.c_str(), __FILE__, __LINE__);
+			lastSize = flushed.size();
+		}
+		sim->getOutputManager()->finish();
+	}
+
+	const StlVector<uint8> contents = _readOutput(FILES[0]);
+	for (uint32 f = 1; f < FILE_COUNT; ++f) {
+		const String text = strfmt("\"%s\" has all of the records once it is closed", FILES[f]);
+		test::Check(_readOutput(FILES[f]) == contents, text.c_str(), __FILE__, __LINE__);
+	}
+
+	for (const char *file : FILES) {
+		std::remove(file);
+		std::remove((String(file) + INDEX_FILE_EXTENSION).c_str());
+	}
+}
+
+} // namespace
+
+
+// ================================================================================================
+void test_file_sink()
+{
+	_checkSink();
+	_checkPolicies();
+}
\ No newline at end of file
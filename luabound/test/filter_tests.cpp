@@ -0,0 +1,88 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file tests the particle filters in the output formats, with a primary particle, which has no orbit.
+ */
+
+#include "test.hpp"
+#include "../src/runtime/output/format_parser.hpp"
+#include "../src/runtime/output/output_tick.hpp"
+
+namespace
+{
+
+const char * const SCRIPT = R"(
+new_simulation {
+	name = "filter_test",
+	seed = 1,
+	constants = { G = 1, max_time = 1 },
+	integrator = { name = "ias15" },
+	output = { },
+	populate = function()
+		sim.addParticle(1, 1e-4, place.cartesian(0.0, 0.0, 0.0), nil, "sun")
+		sim.setPrimaryParticle("sun")
+		local sun = sim.getParticle("sun")
+		sim.addParticle(1e-3, 1e-4, place.kepler3d(1.0, 0.25, 0.1, 0.0, 0.0, 1.0), sun, "inner")
+		sim.addParticle(1e-3, 1e-4, place.kepler3d(2.0, 0.75, 0.1, 0.0, 0.0, 2.0), sun, "outer")
+		sim.addParticle(1e-9, 1e-4, place.kepler3d(-3.0, 1.5, 0.1, 0.0, 0.0, 0.5), sun, "flyby")
+	end
+}
+)";
+
+String _format(OutputTick& tick, const String& fmt)
+{
+	OutputFormat format;
+	if (!TEST_CHECK(format.loadFormat(fmt)))
+		return "";
+	StringStream out;
+	try {
+		format.generateOutput(tick, out);
+	}
+	catch (...) {
+		test::Check(false, ("the format threw: " + fmt).c_str(), __FILE__, __LINE__);
+		return "";
+	}
+	return out.str();
+}
+
+} // namespace
+
+
+// ================================================================================================
+void test_particle_filters()
+{
+	StlUniquePtr<LbdSimulation> sim = test::LoadSimulation(SCRIPT);
+	if (!TEST_CHECK(sim != nullptr))
+		return;
+	OutputTick tick{sim.get()};
+	tick.capture(true);
+	TEST_CHECK(tick.getParticleCount() == 4);
+	TEST_CHECK(tick.getOrbits().err[0] != 0); // The primary has no orbit
+
+	// Tests on orbital values skip the primary, instead of throwing on its orbit error
+	TEST_CHECK(_format(tick, "{[e<1] #pn;}") == "inner;outer");
+	TEST_CHECK(_format(tick, "{[e>=1] #pn;}") == "flyby");
+	TEST_CHECK(_format(tick, "{[e=0.5..2] #pn;}") == "outer;flyby");
+	TEST_CHECK(_format(tick, "{[a=0.5..2.5] #pn;}") == "inner;outer");
+	TEST_CHECK(_format(tick, "{[i>-1 & e<1] #pn,#pa,#pe;}").find("sun") == String::npos);
+	TEST_CHECK(_format(tick, "{[o* & e<1] #pn;}") == "outer");
+
+	// Tests on the other values still see the primary
+	TEST_CHECK(_format(tick, "{[m>=1] #pn;}") == "sun");
+	TEST_CHECK(_format(tick, "{[R<0.5 & m>0.5] #pn;}") == "sun");
+
+	// Filtered statistics over orbital values
+	TEST_CHECK_CLOSE(std::atof(_format(tick, "#ne[e<1]").c_str()), 0.25, 1e-12);
+	TEST_CHECK_CLOSE(std::atof(_format(tick, "#xe[e<1]").c_str()), 0.75, 1e-12);
+	TEST_CHECK_CLOSE(std::atof(_format(tick, "#aa[e<1]").c_str()), 1.5, 1e-12);
+	TEST_CHECK_CLOSE(std::atof(_format(tick, "#xe[e>=1]").c_str()), 1.5, 1e-12);
+
+	// The escape trigger filter
+	ParticleFilter escape;
+	TEST_CHECK(escape.load("e>=1"));
+	const StlVector<uint32>& escaped = token_utils::SelectParticles(tick, escape);
+	TEST_CHECK((escaped.size() == 1) && (escaped[0] == 3));
+}
\ No newline at end of file
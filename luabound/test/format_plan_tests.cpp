@@ -0,0 +1,98 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file tests that the format plans write the same text when their lists are split between threads.
+ */
+
+#include "test.hpp"
+#include "../src/runtime/output/format_parser.hpp"
+#include "../src/runtime/output/output_tick.hpp"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace
+{
+
+const char * const SCRIPT = R"(
+new_simulation {
+	name = "format_plan_test",
+	seed = 3,
+	constants = { G = 1, max_time = 1 },
+	integrator = { name = "ias15" },
+	output = { },
+	populate = function()
+		sim.addParticle(1, 1e-4, place.cartesian(0.0, 0.0, 0.0), nil, "sun")
+		sim.setPrimaryParticle("sun")
+		local disk = place.kepler3d(dist.uniform(0.5, 2.0), dist.uniform(0.0, 0.9), dist.normal(0.1), 0.0, 0.0,
+			dist.uniform(0, 2 * math.pi))
+		sim.addParticles(10000, dist.uniform(1e-9, 1e-6), 1e-4, disk, sim.getParticle("sun"), "star")
+	end
+}
+)";
+
+// Runs the plan on a new tick, so that none of the cached tick values are shared between the runs
+String _execute(LbdSimulation *sim, const FormatPlan& plan, int threads)
+{
+#ifdef _OPENMP
+	omp_set_num_threads(threads);
+#else
+	(void)threads;
+#endif
+	OutputTick tick{sim};
+	tick.capture(plan.usesParticleNames());
+	StringStream out;
+	plan.execute(tick, out);
+	return out.str();
+}
+
+} // namespace
+
+
+// ================================================================================================
+void test_format_plans()
+{
+	// Histograms cannot be used in lists, since they would be calculated again for every particle
+	OutputFormat histList;
+	TEST_CHECK(!histList.loadFormat("{#ph,#h(a,0,2,8);}"));
+	TEST_CHECK(!histList.loadFormat("{#ph #h2w(a,e,0,2,8,0,1,4);}"));
+
+	StlUniquePtr<LbdSimulation> sim = test::LoadSimulation(SCRIPT);
+	if (!TEST_CHECK(sim != nullptr))
+		return;
+	TEST_CHECK(sim->getSimulation()->N > PLAN_PARALLEL_LOOP_SIZE);
+
+	const char * const FORMATS[] = {
+		"#st: {#px,#py,#pz,#pvx,#pvy,#pvz;}",
+		"{[star* & e<0.5] #pn,#pa,#pe,#ae[e<1],#me[e<0.5];} #sc",
+		"#h(e,0,1,10)[e<1] {#ph,#pm,#q90m;} #hw(a,0.5,2,6)[e>0.5] {[a>1] #pi,#pR,#pRc;}"
+	};
+	for (const char *fmt : FORMATS) {
+		OutputFormat format;
+		if (!TEST_CHECK(format.loadFormat(fmt)))
+			continue;
+		const String serial = _execute(sim.get(), format.getPlan(), 1);
+		TEST_CHECK(serial.length() > 100000);
+		TEST_CHECK(_execute(sim.get(), format.getPlan(), 2) == serial);
+		TEST_CHECK(_execute(sim.get(), format.getPlan(), 4) == serial);
+	}
+
+	// A plan built with a histogram inside of a loop is run on one thread, instead of sharing the histogram bins
+	FormatPlan plan;
+	histogram_spec spec;
+	spec.dims = 1;
+	spec.ptypes[0] = ValuePType::Distance;
+	spec.ranges[0] = { 0.5, 2.0, 4 };
+	spec.weighted = false;
+	const uint32 begin = plan.beginLoop();
+	plan.addParticleValue(ValuePType::Hash);
+	plan.addLiteral(" ");
+	plan.addHistogram(spec);
+	plan.addSeparator(";");
+	plan.endLoop(begin);
+	const String serial = _execute(sim.get(), plan, 1);
+	TEST_CHECK(_execute(sim.get(), plan, 4) == serial);
+}
\ No newline at end of file
@@ -0,0 +1,178 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file tests the index files written next to the output files, by checking the index records against the
+ *     records in the text, binary, and compressed files of a run.
+ */
+
+#include "test.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+
+const char * const SCRIPT = R"(
+new_simulation {
+	name = "index_test",
+	constants = { G = 1, max_time = 1 },
+	integrator = { name = "ias15" },
+	output = {
+		["index_test.dat"] = { format = "#st #sts {#pn;}", time = 0 },
+		["index_test.bin"] = { format = "#st #sts {#px;}", time = 0, binary = true },
+		["index_test.lbz"] = { format = "#st #sts {#px;}", time = 0, compress = true, keyframe = 4 }
+	},
+	populate = function()
+		sim.addParticle(1, 1e-4, place.cartesian(0.0, 0.0, 0.0), nil, "sun")
+		sim.setPrimaryParticle("sun")
+		sim.addParticle(1e-9, 1e-4, place.cartesian(1.0, 0.0, 0.0, 0.0, 1.0, 0.0), nil, "a")
+		sim.addParticle(1e-9, 1e-4, place.cartesian(-2.0, 0.0, 0.0, 0.0, -0.7, 0.0), nil, "b")
+	end
+}
+)";
+
+const char * const FILES[] = { "index_test.dat", "index_test.bin", "index_test.lbz" };
+const uint32 RECORD_COUNT = 10;
+const uint32 KEYFRAME = 4;
+
+struct index_record
+{
+	double time;
+	int64 timestep;
+	uint64 offset;
+};
+
+StlVector<uint8> _readFile(const String& path)
+{
+	std::ifstream file{path, std::ios::binary};
+	return StlVector<uint8>{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+// Reads the index for the output file, and checks its header and size
+StlVector<index_record> _readIndex(const char *path)
+{
+	StlVector<index_record> records;
+	const StlVector<uint8> data = _readFile(String(path) + INDEX_FILE_EXTENSION);
+	uint32 version = 0;
+	if (!TEST_CHECK(data.size() >= 8) || !TEST_CHECK(memcmp(data.data(), INDEX_FILE_MAGIC, 4) == 0))
+		return records;
+	memcpy(&version, data.data() + 4, 4);
+	TEST_CHECK(version == INDEX_FILE_VERSION);
+	if (!TEST_CHECK(((data.size() - 8) % INDEX_RECORD_SIZE) == 0))
+		return records;
+
+	records.resize((data.size() - 8) / INDEX_RECORD_SIZE);
+	for (size_t i = 0; i < records.size(); ++i) {
+		const uint8 *rec = data.data() + 8 + (i * INDEX_RECORD_SIZE);
+		memcpy(&records[i].time, rec, 8);
+		memcpy(&records[i].timestep, rec + 8, 8);
+		memcpy(&records[i].offset, rec + 16, 8);
+	}
+	return records;
+}
+
+// Each heartbeat is one time unit, and counts as one timestep
+void _runHeartbeats()
+{
+	StlUniquePtr<LbdSimulation> sim = test::LoadSimulation(SCRIPT);
+	if (!TEST_CHECK(sim != nullptr))
+		return;
+	reb_simulation *rsim = sim->getSimulation();
+	sim->getOutputManager()->start();
+	for (uint32 beat = 0; beat < RECORD_COUNT; ++beat) {
+		rsim->t = beat;
+		sim->heartbeatCallback(rsim);
+	}
+	sim->getOutputManager()->finish();
+}
+
+// Every index record points to the start of the line for its record
+void _checkText()
+{
+	const StlVector<index_record> index = _readIndex(FILES[0]);
+	const StlVector<uint8> data = _readFile(FILES[0]);
+	if (!TEST_CHECK(index.size() == RECORD_COUNT))
+		return;
+
+	for (uint32 i = 0; i < RECORD_COUNT; ++i) {
+		const index_record& rec = index[i];
+		TEST_CHECK((rec.time == i) && (rec.timestep == (i + 1)));
+		if (!TEST_CHECK((rec.offset > 0) && (rec.offset < data.size())))
+			continue;
+		TEST_CHECK(data[rec.offset - 1] == '\n');
+		const String expected = strfmt("%u %u sun;a;b\n", i, i + 1);
+		const String text = strfmt("text record %u is \"%u %u sun;a;b\"", i, i, i + 1);
+		test::Check(memcmp(data.data() + rec.offset, expected.data(),
+			std::min<size_t>(expected.size(), data.size() - rec.offset)) == 0, text.c_str(), __FILE__, __LINE__);
+	}
+	const String last = strfmt("%u %u sun;a;b\n", RECORD_COUNT - 1, RECORD_COUNT);
+	TEST_CHECK((index.back().offset + last.size()) == data.size());
+}
+
+// Every index record points to the particle count that starts its binary record, and the records fill the file
+void _checkBinary()
+{
+	const StlVector<index_record> index = _readIndex(FILES[1]);
+	const StlVector<uint8> data = _readFile(FILES[1]);
+	if (!TEST_CHECK(index.size() == RECORD_COUNT))
+		return;
+
+	const uint64 recordSize = 4 + 8 + 8 + (3 * 8);
+	for (uint32 i = 0; i < RECORD_COUNT; ++i) {
+		const index_record& rec = index[i];
+		if (!TEST_CHECK((rec.offset + recordSize) <= data.size()))
+			continue;
+		uint32 count;
+		double time;
+		int64 timestep;
+		memcpy(&count, data.data() + rec.offset, 4);
+		memcpy(&time, data.data() + rec.offset + 4, 8);
+		memcpy(&timestep, data.data() + rec.offset + 12, 8);
+		const String text = strfmt("binary record %u matches its index record", i);
+		test::Check((count == 3) && (time == rec.time) && (timestep == rec.timestep) && (time == i) &&
+			(timestep == (i + 1)), text.c_str(), __FILE__, __LINE__);
+		const uint64 end = (i + 1 < RECORD_COUNT) ? index[i + 1].offset : data.size();
+		TEST_CHECK((end - rec.offset) == recordSize);
+	}
+}
+
+// The compressed records point to the start of their block, so the offset only changes at each keyframe
+void _checkCompressed()
+{
+	const StlVector<index_record> index = _readIndex(FILES[2]);
+	const StlVector<uint8> data = _readFile(FILES[2]);
+	if (!TEST_CHECK(index.size() == RECORD_COUNT))
+		return;
+
+	for (uint32 i = 0; i < RECORD_COUNT; ++i) {
+		const index_record& rec = index[i];
+		TEST_CHECK((rec.time == i) && (rec.timestep == (i + 1)) && (rec.offset < data.size()));
+		if ((i % KEYFRAME) == 0)
+			TEST_CHECK((i == 0) ? (rec.offset > 0) : (rec.offset > index[i - 1].offset));
+		else
+			TEST_CHECK(rec.offset == index[i - 1].offset);
+	}
+}
+
+} // namespace
+
+
+// ================================================================================================
+void test_output_index()
+{
+	_runHeartbeats();
+	_checkText();
+	_checkBinary();
+	_checkCompressed();
+
+	for (const char *file : FILES) {
+		std::remove(file);
+		std::remove((String(file) + INDEX_FILE_EXTENSION).c_str());
+	}
+}
\ No newline at end of file
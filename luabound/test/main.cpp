@@ -0,0 +1,61 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file is the entry point for the test executable, which runs all of the test suites, or only the
+ *     ones named on the command line. The exit code is the number of failed checks.
+ */
+
+#include "test.hpp"
+#include <cstring>
+
+struct test_suite
+{
+	const char *name;
+	void (*run)();
+};
+
+static const test_suite SUITES[] = {
+	{ "filters", test_particle_filters },
+	{ "format_plan", test_format_plans },
+	{ "orbit_calculate", test_orbit_calculate },
+	{ "orbit_place", test_orbit_place },
+	{ "rng", test_rng_streams },
+	{ "trigger", test_output_triggers },
+	{ "particles", test_particle_manager },
+	{ "index", test_output_index },
+	{ "codec", test_xor_codec },
+	{ "text_reader", test_text_reader },
+	{ "shm_ring", test_shm_ring },
+	{ "file_sink", test_file_sink }
+};
+
+
+int main(int argc, char **argv)
+{
+	uint32 runCount = 0;
+	for (const test_suite& suite : SUITES) {
+		bool selected = (argc < 2);
+		for (int i = 1; i < argc; ++i)
+			selected = selected || (strcmp(argv[i], suite.name) == 0);
+		if (!selected)
+			continue;
+
+		const uint32 before = test::GetFailureCount();
+		std::cout << "Running '" << suite.name << "'..." << std::endl;
+		try {
+			suite.run();
+		}
+		catch (...) {
+			test::Check(false, "the suite threw an exception", __FILE__, __LINE__);
+		}
+		std::cout << "  " << ((test::GetFailureCount() == before) ? "passed" : "FAILED") << std::endl;
+		++runCount;
+	}
+
+	const uint32 failures = test::GetFailureCount();
+	std::cout << "Ran " << runCount << " suite(s), with " << failures << " failed check(s)." << std::endl;
+	return static_cast<int>(std::min(failures, 255u));
+}
\ No newline at end of file
@@ -0,0 +1,348 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file tests the batch orbit kernels against the rebound functions that they replace, one particle at a time.
+ */
+
+#include "test.hpp"
+#include "../src/sim/orbit_batch.hpp"
+#include <random>
+
+namespace
+{
+
+// The kernels use the same formulas in the same order as rebound, and only the branch-free acos can differ (by
+//     1 ulp, which is at most 8.9e-16 in the angles). The tolerance leaves room for other compilers and targets,
+//     but is still far tighter than any physical use needs. The lengths are compared relative to their size, and
+//     the angles and the eccentricity as absolute differences.
+const double ELEMENT_TOLERANCE = 1e-14;
+// The placement kernels only differ from rebound in the sines and cosines, by a few ulps, which are compared relative
+//     to the distance and the speed against the primary. Near e = 1, the Pal positions are only as accurate as the
+//     eccentric anomaly, which loses digits in proportion to 1 / (1 - e) close to the pericenter.
+const double PLACE_TOLERANCE = 1e-12;
+const double PAL_ANOMALY_TOLERANCE = 1e-14;
+const double TWO_PI = 2 * M_PI;
+
+const double G = 1.3;
+
+struct element_set
+{
+	double a, e, inc, Omega, omega, f;
+};
+
+// The difference between two angles, on the shorter way around the circle
+inline double _angleDiff(double x, double y)
+{
+	return std::fabs(std::remainder(x - y, TWO_PI));
+}
+
+reb_particle _makePrimary()
+{
+	reb_particle primary{};
+	primary.m = 0.8;
+	primary.x = 0.3; primary.y = -0.2; primary.z = 0.05;
+	primary.vx = 0.01; primary.vy = -0.02; primary.vz = 0.003;
+	return primary;
+}
+
+// Converts the particles with both the kernel and rebound, and checks that every element (and the error code) of
+//     every particle matches
+void _checkCalculate(const char *name, const StlVector<element_set>& sets, bool withError)
+{
+	const reb_particle primary = _makePrimary();
+	StlVector<reb_particle> parts;
+	for (const element_set& s : sets)
+		parts.push_back(reb_tools_orbit_to_particle(G, primary, 1e-7, s.a, s.e, s.inc, s.Omega, s.omega, s.f));
+	if (withError) {
+		reb_particle onTop = primary; // A particle on top of the primary has no orbit
+		onTop.m = 1e-7;
+		parts.push_back(onTop);
+	}
+
+	orbits::orbit_batch batch;
+	orbits::calculate(G, parts.data(), parts.size(), primary, batch);
+	if (!test::Check(batch.size() == parts.size(), name, __FILE__, __LINE__))
+		return;
+
+	double maxDiff[9] = { 0 };
+	uint32 errMismatch = 0, nanMismatch = 0;
+	for (size_t i = 0; i < parts.size(); ++i) {
+		int err = 0;
+		const reb_orbit ref = reb_tools_particle_to_orbit_err(G, parts[i], primary, &err);
+		if (err != batch.err[i])
+			++errMismatch;
+		if (err != 0) {
+			nanMismatch += std::isnan(batch.a[i]) && std::isnan(batch.f[i]) ? 0 : 1;
+			continue;
+		}
+
+		const double diffs[9] = {
+			std::fabs(batch.a[i] - ref.a) / std::fabs(ref.a),
+			std::fabs(batch.e[i] - ref.e),
+			_angleDiff(batch.inc[i], ref.inc),
+			_angleDiff(batch.Omega[i], ref.Omega),
+			_angleDiff(batch.omega[i], ref.omega),
+			_angleDiff(batch.f[i], ref.f),
+			_angleDiff(batch.M[i], ref.M),
+			std::fabs(batch.h[i] - ref.h) / ref.h,
+			std::fabs(batch.d[i] - ref.d) / ref.d
+		};
+		for (uint32 el = 0; el < 9; ++el)
+			maxDiff[el] = std::isnan(diffs[el]) ? INFINITY : std::max(maxDiff[el], diffs[el]);
+	}
+
+	const char * const ELEMENTS[9] = { "a", "e", "inc", "Omega", "omega", "f", "M", "h", "d" };
+	for (uint32 el = 0; el < 9; ++el) {
+		const String text = strfmt("%s: largest difference in %s", name, ELEMENTS[el]);
+		test::CheckClose(maxDiff[el], 0, ELEMENT_TOLERANCE, text.c_str(), __FILE__, __LINE__);
+	}
+	test::Check(errMismatch == 0, strfmt("%s: error codes match", name).c_str(), __FILE__, __LINE__);
+	test::Check(nanMismatch == 0, strfmt("%s: orbits with errors are NaN", name).c_str(), __FILE__, __LINE__);
+}
+
+// The largest differences of the batch positions and velocities from the reference particles, relative to the
+//     distance and the speed against the primary. The particles with an error are skipped.
+void _placementDiffs(const reb_particle& primary, const StlVector<reb_particle>& refs,
+	const StlVector<StlVector<double>>& out, const StlVector<int>& errs, double& posDiff, double& velDiff)
+{
+	posDiff = velDiff = 0;
+	for (size_t i = 0; i < refs.size(); ++i) {
+		if (errs[i] != 0)
+			continue;
+		const reb_particle& p = refs[i];
+		const double dist = sqrt(pow(p.x - primary.x, 2) + pow(p.y - primary.y, 2) + pow(p.z - primary.z, 2));
+		const double speed = sqrt(pow(p.vx - primary.vx, 2) + pow(p.vy - primary.vy, 2) + pow(p.vz - primary.vz, 2));
+		const double pos = std::max(std::max(std::fabs(out[0][i] - p.x), std::fabs(out[1][i] - p.y)),
+			std::fabs(out[2][i] - p.z)) / dist;
+		const double vel = std::max(std::max(std::fabs(out[3][i] - p.vx), std::fabs(out[4][i] - p.vy)),
+			std::fabs(out[5][i] - p.vz)) / speed;
+		posDiff = std::isnan(pos) ? INFINITY : std::max(posDiff, pos);
+		velDiff = std::isnan(vel) ? INFINITY : std::max(velDiff, vel);
+	}
+}
+
+void _checkPlacementDiffs(const char *name, const reb_particle& primary, const StlVector<reb_particle>& refs,
+	const StlVector<StlVector<double>>& out, const StlVector<int>& errs, double tolerance)
+{
+	double posDiff, velDiff;
+	_placementDiffs(primary, refs, out, errs, posDiff, velDiff);
+	const String posText = strfmt("%s: largest position difference", name);
+	const String velText = strfmt("%s: largest velocity difference", name);
+	test::CheckClose(posDiff, 0, tolerance, posText.c_str(), __FILE__, __LINE__);
+	test::CheckClose(velDiff, 0, tolerance, velText.c_str(), __FILE__, __LINE__);
+}
+
+// Places the particles from their elements with the kernel and with rebound, and checks that the positions, the
+//     velocities, and the error codes match
+void _checkKeplerPlacement(const char *name, const StlVector<element_set>& sets)
+{
+	const reb_particle primary = _makePrimary();
+	const size_t COUNT = sets.size();
+	StlVector<double> m(COUNT, 1e-7), elements[6];
+	for (const element_set& s : sets) {
+		const double vals[6] = { s.a, s.e, s.inc, s.Omega, s.omega, s.f };
+		for (uint32 el = 0; el < 6; ++el)
+			elements[el].push_back(vals[el]);
+	}
+	StlVector<StlVector<double>> out(6, StlVector<double>(COUNT));
+	double * const outPtrs[6] = { out[0].data(), out[1].data(), out[2].data(), out[3].data(), out[4].data(),
+		out[5].data() };
+	StlVector<int> errs(COUNT);
+	orbits::elements_to_cartesian(G, primary, m.data(), elements[0].data(), elements[1].data(), elements[2].data(),
+		elements[3].data(), elements[4].data(), elements[5].data(), COUNT, outPtrs, errs.data());
+
+	StlVector<reb_particle> refs;
+	uint32 errMismatch = 0, nanMismatch = 0;
+	for (size_t i = 0; i < COUNT; ++i) {
+		int err = 0;
+		const element_set& s = sets[i];
+		refs.push_back(reb_tools_orbit_to_particle_err(G, primary, 1e-7, s.a, s.e, s.inc, s.Omega, s.omega, s.f, &err));
+		errMismatch += (err == errs[i]) ? 0 : 1;
+		nanMismatch += ((errs[i] != 0) && !(std::isnan(out[0][i]) && std::isnan(out[5][i]))) ? 1 : 0;
+	}
+
+	_checkPlacementDiffs(name, primary, refs, out, errs, PLACE_TOLERANCE);
+	test::Check(errMismatch == 0, strfmt("%s: error codes match", name).c_str(), __FILE__, __LINE__);
+	test::Check(nanMismatch == 0, strfmt("%s: placements with errors are NaN", name).c_str(), __FILE__, __LINE__);
+}
+
+// The eccentric anomaly of the mean anomaly on an elliptic orbit, by bisection in long double, which is slow but
+//     is exact to the last bit of a double for any e < 1
+double _exactEccentricAnomaly(double e, long double M)
+{
+	const long double TWO_PI_L = 2 * 3.14159265358979323846264338327950288L;
+	long double mean = fmodl(M, TWO_PI_L);
+	mean += (mean < 0) ? TWO_PI_L : 0;
+	long double lo = 0, hi = TWO_PI_L;
+	for (uint32 i = 0; i < 128; ++i) {
+		const long double mid = (lo + hi) / 2;
+		((mid - e * sinl(mid)) < mean ? lo : hi) = mid;
+	}
+	return static_cast<double>((lo + hi) / 2);
+}
+
+// Places the particles from their Pal elements with the kernel, and checks them against rebound. The f of each set
+//     is used as the mean anomaly. The rebound Pal solver (reb_tools_solve_kepler_pal) stops before it converges for
+//     0.2 < e < 0.3, and for e > 0.8, so it is only used as the reference for e < 0.2 and 0.3 < e < 0.7. The
+//     reference for every set is the same orbit placed with reb_tools_orbit_to_particle, from the true anomaly of
+//     the exact eccentric anomaly.
+void _checkPalPlacement(const char *name, const StlVector<element_set>& sets, double tolerance)
+{
+	const reb_particle primary = _makePrimary();
+	const size_t COUNT = sets.size();
+	StlVector<double> m(COUNT, 1e-7), elements[6];
+	StlVector<reb_particle> palRefs, keplerRefs;
+	StlVector<int> palSkip;
+	for (const element_set& s : sets) {
+		// lambda = M + pomega, (k, h) = e (cos, sin)(pomega), and (ix, iy) = 2 sin(inc / 2) (cos, sin)(Omega)
+		const double pomega = s.Omega + s.omega;
+		const double vals[6] = { s.a, s.f + pomega, s.e * cos(pomega), s.e * sin(pomega),
+			2 * sin(s.inc / 2) * cos(s.Omega), 2 * sin(s.inc / 2) * sin(s.Omega) };
+		for (uint32 el = 0; el < 6; ++el)
+			elements[el].push_back(vals[el]);
+
+		const bool palConverges = (s.e < 0.2) || ((s.e > 0.3) && (s.e < 0.7));
+		palSkip.push_back(palConverges ? 0 : 1);
+		palRefs.push_back(palConverges ?
+			reb_tools_pal_to_particle(G, primary, 1e-7, vals[0], vals[1], vals[2], vals[3], vals[4], vals[5]) :
+			reb_particle{});
+		// The mean anomaly is taken from the rounded lambda, which is exact in long double
+		const double E = _exactEccentricAnomaly(s.e, static_cast<long double>(vals[1]) - pomega);
+		const double f = 2 * atan(sqrt((1 + s.e) / (1 - s.e)) * tan(E / 2));
+		keplerRefs.push_back(reb_tools_orbit_to_particle(G, primary, 1e-7, s.a, s.e, s.inc, s.Omega, s.omega, f));
+	}
+	StlVector<StlVector<double>> out(6, StlVector<double>(COUNT));
+	double * const outPtrs[6] = { out[0].data(), out[1].data(), out[2].data(), out[3].data(), out[4].data(),
+		out[5].data() };
+	orbits::pal_to_cartesian(G, primary, m.data(), elements[0].data(), elements[1].data(), elements[2].data(),
+		elements[3].data(), elements[4].data(), elements[5].data(), COUNT, outPtrs);
+
+	_checkPlacementDiffs(strfmt("%s (pal)", name).c_str(), primary, palRefs, out, palSkip, PLACE_TOLERANCE);
+	_checkPlacementDiffs(strfmt("%s (kepler)", name).c_str(), primary, keplerRefs, out, StlVector<int>(COUNT, 0),
+		tolerance);
+}
+
+} // namespace
+
+
+// ================================================================================================
+void test_orbit_calculate()
+{
+	std::mt19937_64 gen{18};
+	std::uniform_real_distribution<double> unit{0, 1};
+	auto angle = [&]() { return TWO_PI * unit(gen); };
+	// Places the particle at a random true anomaly that is reachable on the orbit (hyperbolic orbits only
+	//     reach |f| < acos(-1/e))
+	auto anomaly = [&](double e) { return (e < 1) ? angle() : 0.95 * acos(-1 / e) * (2 * unit(gen) - 1); };
+
+	// Random elliptic orbits, at every inclination
+	StlVector<element_set> sets;
+	for (uint32 i = 0; i < 5000; ++i) {
+		const double e = 0.99 * unit(gen);
+		sets.push_back({ 0.05 + 50 * unit(gen), e, M_PI * unit(gen), angle(), angle(), anomaly(e) });
+	}
+	_checkCalculate("random", sets, true);
+
+	// Circular and nearly circular orbits
+	sets.clear();
+	for (const double e : { 0.0, 1e-14, 1e-10, 1e-6 }) {
+		for (uint32 i = 0; i < 500; ++i)
+			sets.push_back({ 0.1 + 10 * unit(gen), e, M_PI * unit(gen), angle(), angle(), angle() });
+	}
+	_checkCalculate("e ~ 0", sets, false);
+
+	// Nearly parabolic orbits on both sides of e = 1, with a fixed pericenter distance
+	sets.clear();
+	for (const double de : { -1e-3, -1e-6, -1e-9, 1e-9, 1e-6, 1e-3 }) {
+		const double e = 1 + de;
+		for (uint32 i = 0; i < 500; ++i) {
+			const double q = 0.1 + unit(gen);
+			const double f = (e < 1) ? 3 * (2 * unit(gen) - 1) : anomaly(e);
+			sets.push_back({ q / (1 - e), e, M_PI * unit(gen), angle(), angle(), f });
+		}
+	}
+	_checkCalculate("e ~ 1", sets, false);
+
+	// Hyperbolic orbits
+	sets.clear();
+	for (uint32 i = 0; i < 2000; ++i) {
+		const double e = 1.01 + 4 * unit(gen);
+		sets.push_back({ -(0.1 + 10 * unit(gen)), e, M_PI * unit(gen), angle(), angle(), anomaly(e) });
+	}
+	_checkCalculate("hyperbolic", sets, true);
+
+	// Planar orbits, prograde and retrograde, which have no ascending node
+	sets.clear();
+	for (const double inc : { 0.0, M_PI }) {
+		for (uint32 i = 0; i < 1000; ++i) {
+			const double e = (i % 2) ? 0.9 * unit(gen) : 1.1 + unit(gen);
+			const double a = (e < 1) ? (0.1 + 10 * unit(gen)) : -(0.1 + 10 * unit(gen));
+			sets.push_back({ a, e, inc, angle(), angle(), anomaly(e) });
+		}
+	}
+	_checkCalculate("inc = 0", sets, false);
+}
+
+// ================================================================================================
+void test_orbit_place()
+{
+	std::mt19937_64 gen{24};
+	std::uniform_real_distribution<double> unit{0, 1};
+	auto angle = [&]() { return TWO_PI * unit(gen); };
+
+	// Random elliptic and hyperbolic orbits, at every inclination, with every error code
+	StlVector<element_set> sets;
+	for (uint32 i = 0; i < 5000; ++i) {
+		const double e = 1.5 * unit(gen);
+		const double a = ((i % 3) ? 1 : -1) * (0.05 + 50 * unit(gen));
+		const double f = (e < 1) ? angle() : 1.1 * acos(-1 / e) * (2 * unit(gen) - 1);
+		sets.push_back({ a, e, M_PI * unit(gen), angle(), angle(), f });
+	}
+	sets.push_back({ 1, 1, 0.1, 0.2, 0.3, 0.4 });
+	sets.push_back({ 1, -0.1, 0.1, 0.2, 0.3, 0.4 });
+	_checkKeplerPlacement("kepler random", sets);
+
+	// Nearly parabolic orbits on both sides of e = 1, with a fixed pericenter distance
+	sets.clear();
+	for (const double de : { -1e-3, -1e-6, -1e-9, 1e-9, 1e-6, 1e-3 }) {
+		const double e = 1 + de;
+		for (uint32 i = 0; i < 500; ++i) {
+			const double q = 0.1 + unit(gen);
+			const double fmax = (e < 1) ? 3 : 0.95 * acos(-1 / e);
+			sets.push_back({ q / (1 - e), e, M_PI * unit(gen), angle(), angle(), fmax * (2 * unit(gen) - 1) });
+		}
+	}
+	_checkKeplerPlacement("kepler e ~ 1", sets);
+
+	// Angles that are too large for the fast reduction, which are placed with rebound instead
+	sets.clear();
+	for (uint32 i = 0; i < 100; ++i)
+		sets.push_back({ 1 + unit(gen), 0.5 * unit(gen), 1e6 * unit(gen), angle(), 1e7 * angle(), -1e6 * angle() });
+	_checkKeplerPlacement("kepler large angles", sets);
+
+	// Pal orbits at every eccentricity
+	sets.clear();
+	for (uint32 i = 0; i < 5000; ++i)
+		sets.push_back({ 0.05 + 50 * unit(gen), 0.95 * unit(gen), M_PI * unit(gen), angle(), angle(), angle() });
+	_checkPalPlacement("pal random", sets, PLACE_TOLERANCE);
+
+	// Mean longitudes that are too large for the fast reduction, which are placed with rebound instead. Rebound
+	//     rounds lambda + p to the spacing of the doubles above 1e6 (up to 1e-9), so the positions only match the
+	//     exact anomaly to about that.
+	sets.clear();
+	for (uint32 i = 0; i < 100; ++i)
+		sets.push_back({ 1 + unit(gen), 0.15 * unit(gen), 0.1, angle(), angle(), 1e6 * (1 + angle()) });
+	_checkPalPlacement("pal large longitudes", sets, 1e-8);
+
+	// Nearly parabolic Pal orbits, which are only compared to the exact anomaly
+	for (const double e : { 0.99, 1 - 1e-3, 1 - 1e-6, 1 - 1e-9 }) {
+		sets.clear();
+		for (uint32 i = 0; i < 500; ++i)
+			sets.push_back({ 0.1 + 10 * unit(gen), e, M_PI * unit(gen), angle(), angle(), angle() });
+		const String name = strfmt("pal e = 1 - %g", 1 - e);
+		_checkPalPlacement(name.c_str(), sets, std::max(PLACE_TOLERANCE, PAL_ANOMALY_TOLERANCE / (1 - e)));
+	}
+}
\ No newline at end of file
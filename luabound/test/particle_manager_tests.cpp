@@ -0,0 +1,145 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file tests the hash to index table, and the particle lookups of the particle manager after particles are
+ *     removed through the manager and changed outside of it.
+ */
+
+#include "test.hpp"
+#include "../src/util/hash_index.hpp"
+#include <random>
+#include <unordered_map>
+
+namespace
+{
+
+const char * const SCRIPT = R"(
+new_simulation {
+	name = "particle_manager_test",
+	seed = 9,
+	constants = { G = 1, max_time = 1 },
+	integrator = { name = "ias15" },
+	output = { },
+	populate = function()
+		sim.addParticle(1, 1e-4, place.cartesian(0.0, 0.0, 0.0), nil, "sun")
+		sim.setPrimaryParticle("sun")
+		sim.addParticles(300, 1e-9, 1e-5, place.kepler3d(dist.uniform(0.5, 3), 0.1, 0.0, 0.0, 0.0,
+			dist.uniform(0, 6.28)), sim.getParticle("sun"), "p")
+	end
+}
+)";
+
+// Checks that the table gives the same index as the reference map for every key in it, and the keys that are not
+uint32 _tableMismatches(const HashIndexTable& table, const std::unordered_map<uint32, uint32>& reference,
+	const StlVector<uint32>& missing)
+{
+	uint32 mismatches = (table.size() == reference.size()) ? 0 : 1;
+	for (const auto& pair : reference)
+		mismatches += (table.find(pair.first) == static_cast<int64>(pair.second)) ? 0 : 1;
+	for (const uint32 key : missing)
+		mismatches += (reference.count(key) || (table.find(key) == -1)) ? 0 : 1;
+	return mismatches;
+}
+
+// Checks that every particle in the simulation is found from its hash and name, at its own index
+uint32 _lookupMismatches(LbdSimulation *sim)
+{
+	ParticleManager *manager = sim->getManager();
+	const reb_simulation *rsim = sim->getSimulation();
+	uint32 mismatches = 0;
+	for (int i = 0; i < rsim->N; ++i) {
+		const uint32 hash = rsim->particles[i].hash;
+		mismatches += (manager->getParticleByHash(hash) == &(rsim->particles[i])) ? 0 : 1;
+		mismatches += (manager->getParticleByName(manager->getNameFromHash(hash)) == &(rsim->particles[i])) ? 0 : 1;
+	}
+	return mismatches;
+}
+
+} // namespace
+
+
+// ================================================================================================
+void test_particle_manager()
+{
+	// Random sets and erases, with keys from a small range so that they are often set again after being erased,
+	//     and consecutive keys like the particle hashes
+	{
+		HashIndexTable table;
+		std::unordered_map<uint32, uint32> reference;
+		std::mt19937 gen{25};
+		StlVector<uint32> missing;
+		uint32 mismatches = 0;
+		for (uint32 op = 0; op < 50000; ++op) {
+			const uint32 key = (op % 2) ? (gen() % 4096) : (1000000 + (op % 3000));
+			if (gen() % 3 == 0) {
+				const bool had = reference.erase(key) > 0;
+				mismatches += (table.erase(key) == had) ? 0 : 1;
+			}
+			else {
+				const uint32 index = gen() % 100000;
+				table.set(key, index);
+				reference[key] = index;
+			}
+			if (op % 5000 == 0)
+				mismatches += _tableMismatches(table, reference, missing);
+		}
+		for (uint32 key = 4096; key < 8192; ++key)
+			missing.push_back(key);
+		mismatches += _tableMismatches(table, reference, missing);
+		TEST_CHECK(mismatches == 0);
+		TEST_CHECK(table.capacity() >= 2 * table.size());
+
+		// Shifting down matches removing the element at the index from the array
+		const uint32 REMOVED = 50000;
+		for (auto& pair : reference) {
+			if (pair.second > REMOVED)
+				--pair.second;
+		}
+		table.shiftDown(REMOVED);
+		TEST_CHECK(_tableMismatches(table, reference, missing) == 0);
+
+		table.clear();
+		reference.clear();
+		TEST_CHECK((table.size() == 0) && (table.find(1000000) == -1) && !table.erase(1000000));
+	}
+
+	StlUniquePtr<LbdSimulation> sim = test::LoadSimulation(SCRIPT);
+	if (!TEST_CHECK(sim != nullptr))
+		return;
+	reb_simulation *rsim = sim->getSimulation();
+	ParticleManager *manager = sim->getManager();
+	TEST_CHECK(rsim->N == 301);
+	TEST_CHECK(_lookupMismatches(sim.get()) == 0);
+
+	// Removals near the front shift the whole table down, and removals near the back set the few indices after them
+	StlVector<uint32> removed;
+	for (const int index : { 3, 1, 150, 296, 290, 2 }) {
+		const uint32 hash = rsim->particles[index].hash;
+		reb_particle out{};
+		if (index % 2)
+			manager->removeParticleByHash(hash, &out);
+		else
+			manager->removeParticleByName(manager->getNameFromHash(hash), &out);
+		TEST_CHECK(out.hash == hash);
+		removed.push_back(hash);
+	}
+	TEST_CHECK(rsim->N == 295);
+	TEST_CHECK(_lookupMismatches(sim.get()) == 0);
+	uint32 found = 0;
+	for (const uint32 hash : removed)
+		found += (manager->getParticleByHash(hash) != nullptr) ? 1 : 0;
+	TEST_CHECK(found == 0);
+	TEST_CHECK(manager->getParticleByHash(0xFFFFFFF0) == nullptr);
+	TEST_CHECK(manager->getParticleByName("missing") == nullptr);
+	TEST_CHECK(manager->getPrimaryParticle() == manager->getParticleByName("sun"));
+
+	// Particles moved by rebound without changing the count, and particles removed by rebound
+	std::swap(rsim->particles[10], rsim->particles[200]);
+	std::swap(rsim->particles[50], rsim->particles[rsim->N - 1]);
+	TEST_CHECK(_lookupMismatches(sim.get()) == 0);
+	reb_remove(rsim, 20, 1);
+	TEST_CHECK(_lookupMismatches(sim.get()) == 0);
+}
\ No newline at end of file
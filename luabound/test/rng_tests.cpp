@@ -0,0 +1,184 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file tests the seeded random values, which have to give the same particles for the same seed on any
+ *     number of threads, and follow their distributions.
+ */
+
+#include "test.hpp"
+#include "../src/sim/distributions.hpp"
+#include "../src/sim/placement.hpp"
+#include "../src/runtime/particle/particle_factory.hpp"
+#include "../src/util/counter_rng.hpp"
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+
+// More than one generation batch (65536), so that the batches are also split between the threads
+const char * const SCRIPT = R"(
+new_simulation {
+	name = "rng_test",
+	seed = %SEED%,
+	populate_threads = %THREADS%,
+	constants = { G = 1, max_time = 1 },
+	integrator = { name = "ias15" },
+	output = { },
+	populate = function()
+		sim.addParticle(1, 1e-4, place.cartesian(0.0, 0.0, 0.0), nil, "sun")
+		sim.setPrimaryParticle("sun")
+		local sun = sim.getParticle("sun")
+		sim.addParticles(70000, dist.power(1e-9, 1e-6, -2.5), dist.rayleigh(1e-5),
+			place.kepler3d(dist.uniform(0.5, 3), dist.rayleigh(0.1), dist.normal(1e-3), dist.uniform(0, 6.28),
+				dist.uniform(0, 6.28), dist.uniform(0, 6.28)), sun, "disk")
+		sim.addParticles(5000, 1e-9, 1e-5, place.pal(dist.uniform(4, 5), dist.uniform(0, 6.28), dist.normal(0, 1e-3),
+			dist.normal(0, 1e-3), dist.normal(0, 1e-4), dist.normal(0, 1e-4)), sun, "pal")
+		sim.addParticles(5000, 1e-12, 1e-6, place.cartesian(dist.normal(10, 1), dist.normal(0, 1),
+			dist.uniform(-0.1, 0.1)), nil, "cloud")
+	end
+}
+)";
+
+// A simulation to create particles in directly, through its particle factory
+const char * const FACTORY_SCRIPT = R"(
+new_simulation {
+	name = "rng_factory_test",
+	seed = 42,
+	constants = { G = 1, max_time = 1 },
+	integrator = { name = "ias15" },
+	output = { },
+	populate = function()
+		sim.addParticle(1, 1e-4, place.cartesian(0.0, 0.0, 0.0), nil, "sun")
+	end
+}
+)";
+
+// Loads the script, and copies out the particles, which are compared bit for bit
+StlVector<reb_particle> _populate(uint64 seed, uint32 threads)
+{
+	String script = SCRIPT;
+	script.replace(script.find("%SEED%"), 6, strfmt("%llu", static_cast<unsigned long long>(seed)));
+	script.replace(script.find("%THREADS%"), 9, strfmt("%u", threads));
+	StlUniquePtr<LbdSimulation> sim = test::LoadSimulation(script);
+	if (!TEST_CHECK(sim != nullptr))
+		return {};
+	const reb_simulation *rsim = sim->getSimulation();
+	return StlVector<reb_particle>(rsim->particles, rsim->particles + rsim->N);
+}
+
+bool _sameParticles(const StlVector<reb_particle>& p1, const StlVector<reb_particle>& p2)
+{
+	if (p1.size() != p2.size())
+		return false;
+	for (size_t i = 0; i < p1.size(); ++i) {
+		const reb_particle& a = p1[i];
+		const reb_particle& b = p2[i];
+		const double av[8] = { a.x, a.y, a.z, a.vx, a.vy, a.vz, a.m, a.r };
+		const double bv[8] = { b.x, b.y, b.z, b.vx, b.vy, b.vz, b.m, b.r };
+		if ((a.hash != b.hash) || (memcmp(av, bv, sizeof(av)) != 0))
+			return false;
+	}
+	return true;
+}
+
+// Creates particles before and after a creation that fails, which must not use up any hashes, since the hashes also
+//     pick the random values of the particles
+void _checkFailedCreate()
+{
+	StlUniquePtr<LbdSimulation> sim = test::LoadSimulation(FACTORY_SCRIPT);
+	if (!TEST_CHECK(sim != nullptr))
+		return;
+	ParticleFactory *factory = sim->getFactory();
+	const value_distribution mass{1e-9}, radius{1e-5};
+	const body_placement_ref cloud{new cart_body_placement(value_distribution(value_distribution::DIST_TYPE_NORMAL,
+		10, 1), value_distribution(value_distribution::DIST_TYPE_NORMAL, 0, 1), 0.0)};
+	const body_placement_ref kepler{new kepler_body_placement(1.0, 0.0, 0.0, 0.0)};
+
+	const uint32 COUNT = 100;
+	StlVector<reb_particle> before(COUNT), failed(COUNT), after(COUNT);
+	factory->generateParticles(mass, radius, cloud, sim_particle_ref{}, COUNT, before.data());
+	// Kepler orbits need a reference particle, so the placement fails (and logs an error, which is hidden)
+	bool threw = false;
+	StringStream log;
+	std::streambuf *cerrBuf = std::cerr.rdbuf(log.rdbuf());
+	try {
+		factory->generateParticles(mass, radius, kepler, sim_particle_ref{}, COUNT, failed.data());
+	}
+	catch (...) {
+		threw = true;
+	}
+	std::cerr.rdbuf(cerrBuf);
+	factory->generateParticles(mass, radius, cloud, sim_particle_ref{}, COUNT, after.data());
+
+	TEST_CHECK(threw);
+	bool next = true;
+	for (uint32 i = 0; i < COUNT; ++i)
+		next = next && (after[i].hash == (before.back().hash + 1 + i));
+	TEST_CHECK(next);
+}
+
+// Checks the mean and the variance of the distribution, over the first field of many particle streams, and
+//     over many fields of a single stream. The mean has to be within 5 standard errors, and the variance within
+//     2%, which is more than 5 standard errors for all of these distributions.
+void _checkMoments(const char *name, const value_distribution& dist, double mean, double variance)
+{
+	const uint32 COUNT = 200000;
+	const uint64 SEED = 12345;
+	for (int byField = 0; byField < 2; ++byField) {
+		random_stream single{SEED, 7};
+		double sum = 0, sum2 = 0;
+		for (uint32 i = 0; i < COUNT; ++i) {
+			random_stream particle{SEED, i};
+			const double value = byField ? dist.generate(single) : dist.generate(particle);
+			sum += value;
+			sum2 += value * value;
+		}
+		const double sMean = sum / COUNT;
+		const double sVariance = (sum2 - (sum * sum / COUNT)) / (COUNT - 1);
+		const String text = strfmt("%s mean (%s)", name, byField ? "fields" : "particles");
+		test::CheckClose(sMean, mean, 5 * sqrt(variance / COUNT), text.c_str(), __FILE__, __LINE__);
+		const String vtext = strfmt("%s variance (%s)", name, byField ? "fields" : "particles");
+		test::CheckClose(sVariance, variance, 0.02 * variance, vtext.c_str(), __FILE__, __LINE__);
+	}
+}
+
+// The kth raw moment of the power law distribution with the density x^slope on [min, max]
+double _powerMoment(double min, double max, double slope, int k)
+{
+	auto integral = [&](double p) { return (p == 0) ? log(max / min) : (pow(max, p) - pow(min, p)) / p; };
+	return integral(slope + 1 + k) / integral(slope + 1);
+}
+
+} // namespace
+
+
+// ================================================================================================
+void test_rng_streams()
+{
+	// The same seed gives exactly the same particles for any thread count, including the default (all threads)
+	const StlVector<reb_particle> serial = _populate(42, 1);
+	TEST_CHECK(serial.size() == 80001);
+	for (const uint32 threads : { 2u, 3u, 4u, 0u }) {
+		const String text = strfmt("the particles with %u thread(s) match one thread", threads);
+		test::Check(_sameParticles(_populate(42, threads), serial), text.c_str(), __FILE__, __LINE__);
+	}
+	TEST_CHECK(!_sameParticles(_populate(43, 1), serial));
+	_checkFailedCreate();
+
+	// The distribution moments
+	_checkMoments("uniform(-2, 5)", value_distribution(value_distribution::DIST_TYPE_UNIFORM, -2, 5), 1.5, 49.0 / 12);
+	_checkMoments("normal(1, 4)", value_distribution(value_distribution::DIST_TYPE_NORMAL, 1, 4), 1, 4);
+	const double SIGMA = 0.3;
+	_checkMoments("rayleigh(0.3)", value_distribution(value_distribution::DIST_TYPE_RAYLEIGH, SIGMA),
+		SIGMA * sqrt(M_PI / 2), (4 - M_PI) / 2 * SIGMA * SIGMA);
+	for (const double slope : { -2.5, -1.0, 1.5 }) {
+		const double mean = _powerMoment(0.5, 3, slope, 1);
+		const String name = strfmt("power(0.5, 3, %g)", slope);
+		_checkMoments(name.c_str(), value_distribution(value_distribution::DIST_TYPE_POWERLAW, 0.5, 3, slope), mean,
+			_powerMoment(0.5, 3, slope, 2) - mean * mean);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,183 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file tests the shared memory ring, with one writer and one reader, for the order of the records, wrapping
+ *     around the end of the ring, and detecting the records that were overwritten or torn while they were read.
+ */
+
+#include "test.hpp"
+#include "../io/shm_ring.hpp"
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace
+{
+
+const uint64 CAPACITY = 4096;
+const char BLOB[] = "# format: #st";
+
+// Each record has its own size and contents, so a record that is torn or out of order does not match
+void _makeRecord(int64 step, StlVector<uint8>& data)
+{
+	data.resize(8 + static_cast<size_t>((step * 37) % 200));
+	for (size_t i = 0; i < data.size(); ++i)
+		data[i] = static_cast<uint8>((step * 31) + i);
+}
+
+bool _checkRecord(const lbdio::shm_record& record)
+{
+	StlVector<uint8> expected;
+	_makeRecord(record.timestep, expected);
+	return (record.data == expected) && (record.time == (record.timestep * 0.5));
+}
+
+bool _write(lbdio::ShmRingWriter& writer, int64 step)
+{
+	StlVector<uint8> data;
+	_makeRecord(step, data);
+	return writer.write(data.data(), data.size(), step * 0.5, step);
+}
+
+// Reads each record right after it is written, many times around the ring
+void _checkOrder(const String& name)
+{
+	lbdio::ShmRingWriter writer;
+	if (!TEST_CHECK(writer.create(name, CAPACITY, reinterpret_cast<const uint8*>(BLOB), sizeof(BLOB), false)))
+		return;
+	lbdio::ShmRingReader reader;
+	if (!TEST_CHECK(reader.attach(name)))
+		return;
+	TEST_CHECK(!reader.isBinary() && (reader.getBlobSize() == sizeof(BLOB)) &&
+		(memcmp(reader.getBlob(), BLOB, sizeof(BLOB)) == 0));
+
+	lbdio::shm_record record;
+	TEST_CHECK(!reader.latest(record) && (reader.next(record) == 0));
+	bool good = true;
+	for (int64 step = 0; step < 1000; ++step) {
+		good = good && _write(writer, step) && (reader.next(record) == 1) && (record.timestep == step) &&
+			_checkRecord(record) && (reader.next(record) == 0);
+	}
+	TEST_CHECK(good && (reader.getCount() == 1000));
+
+	// Records that fit in the ring can all be read after they are written, even across the end of the ring
+	for (int64 step = 1000; step < 1010; ++step)
+		TEST_CHECK(_write(writer, step));
+	for (int64 step = 1000; step < 1010; ++step)
+		TEST_CHECK((reader.next(record) == 1) && (record.timestep == step) && _checkRecord(record));
+	TEST_CHECK(reader.latest(record) && (record.timestep == 1009) && (reader.next(record) == 0));
+
+	// Records larger than the ring are rejected
+	StlVector<uint8> large(CAPACITY);
+	TEST_CHECK(!writer.write(large.data(), large.size(), 0.0, 0));
+	TEST_CHECK(!reader.isClosed());
+	writer.close();
+	TEST_CHECK(reader.isClosed());
+}
+
+// Falls more than the whole ring behind, then fakes a record that is being written over the next one to read
+void _checkOverrun(const String& name)
+{
+	lbdio::ShmRingWriter writer;
+	if (!TEST_CHECK(writer.create(name, CAPACITY, reinterpret_cast<const uint8*>(BLOB), sizeof(BLOB), true)))
+		return;
+	lbdio::ShmRingReader reader;
+	if (!TEST_CHECK(reader.attach(name)))
+		return;
+
+	lbdio::shm_record record;
+	for (int64 step = 0; step < 100; ++step)
+		TEST_CHECK(_write(writer, step));
+	TEST_CHECK(reader.next(record) == -1);
+	TEST_CHECK((reader.next(record) == 1) && (record.timestep == 99) && _checkRecord(record));
+	TEST_CHECK(reader.next(record) == 0);
+
+	// The writer reserves the bytes that it is about to write, and the sequence is odd while it writes. This is
+	//     faked with a second writable mapping, since the real writer never stops halfway.
+	const int fd = shm_open(("/" + name).c_str(), O_RDWR, 0);
+	if (!TEST_CHECK(fd >= 0))
+		return;
+	const size_t size = sizeof(lbdio::shm_ring_header);
+	void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (!TEST_CHECK(memory != MAP_FAILED))
+		return;
+	lbdio::shm_ring_header *header = static_cast<lbdio::shm_ring_header*>(memory);
+
+	TEST_CHECK(_write(writer, 100));
+	const uint64 reserved = header->reserved.load();
+	header->reserved.store(header->committed.load() + CAPACITY);
+	TEST_CHECK(reader.next(record) == -1);
+	header->sequence.fetch_add(1);
+	TEST_CHECK(!reader.latest(record) && !reader.getError().empty());
+
+	// Once the write is finished, the same record can be read again
+	header->sequence.fetch_add(1);
+	header->reserved.store(reserved);
+	TEST_CHECK(reader.latest(record) && (record.timestep == 100) && _checkRecord(record));
+	munmap(memory, size);
+}
+
+// Writes as fast as possible while the reader keeps up as well as it can. Every record that the reader gets must be
+//     whole, and in order, and any records that it misses must be reported.
+void _checkThreaded(const String& name)
+{
+	const int64 COUNT = 200000;
+	lbdio::ShmRingWriter writer;
+	if (!TEST_CHECK(writer.create(name, CAPACITY, reinterpret_cast<const uint8*>(BLOB), sizeof(BLOB), true)))
+		return;
+	lbdio::ShmRingReader reader;
+	if (!TEST_CHECK(reader.attach(name)))
+		return;
+
+	std::atomic<bool> writing{true};
+	std::thread thread([&]() {
+		for (int64 step = 0; step < COUNT; ++step)
+			_write(writer, step);
+		writing.store(false);
+	});
+
+	lbdio::shm_record record;
+	int64 lastStep = -1;
+	uint64 readCount = 0, lostCount = 0;
+	bool whole = true, ordered = true, lost = false;
+	for (bool done = false; !done; ) {
+		done = !writing.load(); // Read everything that was written before the writer finished
+		for (int result; (result = reader.next(record)) != 0; ) {
+			if (result < 0) {
+				lost = true;
+				++lostCount;
+				continue;
+			}
+			whole = whole && _checkRecord(record);
+			ordered = ordered && (lost ? (record.timestep > lastStep) : (record.timestep == (lastStep + 1)));
+			lastStep = record.timestep;
+			lost = false;
+			++readCount;
+		}
+	}
+	thread.join();
+
+	TEST_CHECK(whole && ordered);
+	TEST_CHECK((lastStep == (COUNT - 1)) && (readCount > 0));
+	TEST_CHECK((readCount == static_cast<uint64>(COUNT)) || (lostCount > 0));
+}
+
+} // namespace
+
+
+// ================================================================================================
+void test_shm_ring()
+{
+	const String name = strfmt("luabound_test_ring_%d", static_cast<int>(getpid()));
+	_checkOrder(name);
+	_checkOverrun(name);
+	_checkThreaded(name);
+	shm_unlink(("/" + name).c_str());
+}
\ No newline at end of file
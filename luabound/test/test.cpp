@@ -0,0 +1,75 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file implements the checks and helpers shared by the test suites.
+ */
+
+#include "test.hpp"
+#include <cstdio>
+#include <fstream>
+
+static uint32 g_failures = 0;
+
+namespace test
+{
+
+// ================================================================================================
+bool Check(bool cond, const char *text, const char *file, int line)
+{
+	if (!cond) {
+		++g_failures;
+		std::cerr << "  FAILED: " << text << " (" << file << ":" << line << ")" << std::endl;
+	}
+	return cond;
+}
+
+// ================================================================================================
+bool CheckClose(double value, double expected, double tolerance, const char *text, const char *file, int line)
+{
+	const bool close = std::fabs(value - expected) <= tolerance;
+	if (!close) {
+		++g_failures;
+		std::cerr << "  FAILED: " << text << " = " << strfmt("%.17g", value) << ", expected " <<
+			strfmt("%.17g", expected) << " +/- " << strfmt("%g", tolerance) << " (" << file << ":" << line << ")"
+			<< std::endl;
+	}
+	return close;
+}
+
+// ================================================================================================
+uint32 GetFailureCount()
+{
+	return g_failures;
+}
+
+// ================================================================================================
+StlUniquePtr<LbdSimulation> LoadSimulation(const String& script)
+{
+	const String path = "./luabound_test_script.lua";
+	{
+		std::ofstream file{path};
+		file << script;
+	}
+
+	cmd_line_parameters params;
+	params.scriptFile = path;
+
+	// The loading logs a lot of info, which is only useful when the script does not load
+	StringStream log;
+	std::streambuf *coutBuf = std::cout.rdbuf(log.rdbuf());
+	StlUniquePtr<LbdSimulation> sim{new LbdSimulation(params)};
+	const bool loaded = sim->loadFile();
+	std::cout.rdbuf(coutBuf);
+	std::remove(path.c_str());
+
+	if (!loaded) {
+		std::cerr << log.str();
+		sim.reset();
+	}
+	return sim;
+}
+
+} // namespace test
\ No newline at end of file
@@ -0,0 +1,50 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file declares the checks and helpers shared by the test suites, and the suites themselves,
+ *     which are run by the test executable.
+ */
+
+#ifndef LUABOUND_TEST_HPP_
+#define LUABOUND_TEST_HPP_
+
+#include "../src/luabound.hpp"
+#include "../src/runtime/simulation.hpp"
+
+// Checks the condition, and counts it as a failure (but keeps running the test) if it is false
+#define TEST_CHECK(cond) test::Check((cond), #cond, __FILE__, __LINE__)
+// Checks that the value is within the absolute tolerance of the expected value
+#define TEST_CHECK_CLOSE(value, expected, tolerance) \
+	test::CheckClose((value), (expected), (tolerance), #value, __FILE__, __LINE__)
+
+namespace test
+{
+
+bool Check(bool cond, const char *text, const char *file, int line);
+bool CheckClose(double value, double expected, double tolerance, const char *text, const char *file, int line);
+uint32 GetFailureCount();
+
+// Writes the script to a temporary file, and loads the simulation from it, which runs the populate function. The
+//     info output of the load is hidden. Returns nullptr if the script could not be loaded.
+StlUniquePtr<LbdSimulation> LoadSimulation(const String& script);
+
+} // namespace test
+
+// The test suites, which are run in the order that they are listed in main.cpp
+void test_particle_filters();
+void test_format_plans();
+void test_orbit_calculate();
+void test_orbit_place();
+void test_rng_streams();
+void test_output_triggers();
+void test_particle_manager();
+void test_output_index();
+void test_xor_codec();
+void test_text_reader();
+void test_shm_ring();
+void test_file_sink();
+
+#endif // LUABOUND_TEST_HPP_
\ No newline at end of file
@@ -0,0 +1,255 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file tests the text reader of the io library against the format parser and the text output files, by
+ *     comparing the columns that both find for every token, and reading back the records of a run.
+ */
+
+#include "test.hpp"
+#include "../src/runtime/output/format_parser.hpp"
+#include "../src/util/byte_buffer.hpp"
+#include "../io/text_reader.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace
+{
+
+const char * const SCRIPT = R"(
+new_simulation {
+	name = "text_reader_test",
+	constants = { G = 1, max_time = 1 },
+	integrator = { name = "ias15" },
+	output = {
+		["text_reader_test.dat"] = { format = "%FORMAT% {[R>0.1] #ph,#px,#pev,#pn;}", time = 0 },
+		["text_reader_test.bin"] = { format = "%FORMAT% {[R>0.1] #ph,#px,#pev;}", time = 0, binary = true }
+	},
+	populate = function()
+		sim.addParticle(1, 1e-4, place.cartesian(0.0, 0.0, 0.0), nil, "sun")
+		sim.setPrimaryParticle("sun")
+		sim.addParticle(1e-9, 1e-4, place.cartesian(1.0, 0.0, 0.0, 0.0, 1.0, 0.0), nil, "a")
+		sim.addParticle(1e-9, 1e-4, place.cartesian(-2.0, 0.0, 0.0, 0.0, -0.7, 0.0), nil, "b")
+		sim.addParticle(1e-9, 1e-4, place.cartesian(0.0, 1.5, 0.0, -0.9, 0.0, 0.1), nil, "c")
+	end
+}
+)";
+
+// The values outside of the list, which are the same in both files. The list skips the primary, which has no orbit.
+const char * const SCALAR_FORMAT = "#st #sc #sts #ax #q90e[R>0.1] #h(x,-3,3,6)";
+const char * const FILES[] = { "text_reader_test.dat", "text_reader_test.bin" };
+const char * const NAMES[] = { "a", "b", "c" };
+const uint32 RECORD_COUNT = 5;
+const uint32 PARTICLE_COUNT = 3;
+
+// The value tags of the particles, and of the simulation
+const char * const PARTICLE_TAGS[] = {
+	"m", "r", "n", "h", "a", "e", "i", "O", "o", "f", "M", "x", "y", "z", "vx", "vy", "vz", "ax", "ay", "az",
+	"R", "Rc", "ex", "ey", "ez", "ev", "j", "jx", "jy", "jz", "jv"
+};
+const char * const SIMULATION_TAGS[] = { "n", "t", "dt", "c", "i", "G", "ts", "w", "wr" };
+
+// Gets the columns that the binary output finds for the format, with the string values (which cannot be written
+//     to binary files) as LBDIO_TYPE_STRING
+bool _getPlanColumns(const String& fmt, StlVector<lbdio::text_column>& columns)
+{
+	OutputFormat format;
+	if (!format.loadFormat(fmt))
+		return false;
+	ByteBuffer desc;
+	format.getPlan().describeBinary(desc);
+
+	const uint8 *data = desc.data();
+	uint32 count;
+	memcpy(&count, data, 4);
+	data += 4;
+	columns.clear();
+	for (uint32 i = 0; i < count; ++i, data += 4) {
+		lbdio::text_column col{ data[0], data[1], data[2], false };
+		if (data[0] == static_cast<uint8>(ValueDataType::String))
+			col.type = LBDIO_TYPE_STRING;
+		if (col.width == BINARY_WIDE_COLUMN) {
+			memcpy(&col.width, data + 4, 4);
+			data += 4;
+		}
+		columns.push_back(col);
+	}
+	return true;
+}
+
+// Checks that the format parser and the text reader find the same columns (or both reject the format)
+void _checkFormat(const String& fmt)
+{
+	StlVector<lbdio::text_column> planColumns, textColumns;
+	String error;
+	const bool planGood = _getPlanColumns(fmt, planColumns);
+	const bool textGood = lbdio::ParseTextFormat(fmt, textColumns, error);
+	bool same = (planGood == textGood) && (!planGood || (planColumns.size() == textColumns.size()));
+	for (size_t i = 0; same && planGood && (i < planColumns.size()); ++i) {
+		same = (planColumns[i].type == textColumns[i].type) && (planColumns[i].width == textColumns[i].width) &&
+			(planColumns[i].list == textColumns[i].list);
+	}
+	const String text = strfmt("the format parser and the text reader agree on \"%s\"", fmt.c_str());
+	test::Check(same, text.c_str(), __FILE__, __LINE__);
+}
+
+// Parses every token, inside and outside of lists, and in each aggregate group. The format parser logs an error for
+//     each of the invalid formats, which are hidden.
+void _checkTokens()
+{
+	StringStream log;
+	std::streambuf *cerrBuf = std::cerr.rdbuf(log.rdbuf());
+	for (const char *tag : SIMULATION_TAGS)
+		_checkFormat(strfmt("#s%s", tag));
+	for (const char *tag : PARTICLE_TAGS) {
+		_checkFormat(strfmt("{#p%s;}", tag));
+		_checkFormat(strfmt("#sc {[e<1] #ph,#p%s[a>1];}", tag));
+		for (const char *group : { "a", "d", "n", "x", "m", "w", "q90", "q2.5" }) {
+			_checkFormat(strfmt("#%s%s", group, tag));
+			_checkFormat(strfmt("#%s%s[a>1 & e<0.5]", group, tag));
+		}
+	}
+
+	const char * const FORMATS[] = {
+		"#h(a,0,2,8) #hw(e,0,1,4)[e<1]",
+		"#h2(a,e,0,2,8,0,1,4) #h2w(a, e, 0, 2, 8, 0, 1, 4)[a>1]",
+		"#st, #sc: {#ph,#px;} / {#pa;}",
+		"#st\t#sc;{ [ R<2 ] #pn #pev ; }",
+		"{#ph,#h(a,0,2,8);}",
+		"{#ph {#pa;};}",
+		"#px",
+		"#sq",
+		"#st[a>1]",
+		"#q100a #q101a",
+		"#st #sc %"
+	};
+	for (const char *fmt : FORMATS)
+		_checkFormat(fmt);
+	std::cerr.rdbuf(cerrBuf);
+}
+
+StlVector<uint8> _readFile(const String& path)
+{
+	std::ifstream file{path, std::ios::binary};
+	return StlVector<uint8>{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+// Writes the same records to a text and a binary file, then reads the text file back and checks it against the
+//     binary file, which must match exactly since the text values are written with roundtrip precision
+void _checkReadBack()
+{
+	String script = SCRIPT;
+	for (size_t pos; (pos = script.find("%FORMAT%")) != String::npos; )
+		script.replace(pos, 8, SCALAR_FORMAT);
+	{
+		StlUniquePtr<LbdSimulation> sim = test::LoadSimulation(script);
+		if (!TEST_CHECK(sim != nullptr))
+			return;
+		reb_simulation *rsim = sim->getSimulation();
+		sim->getOutputManager()->start();
+		for (uint32 beat = 0; beat < RECORD_COUNT; ++beat) {
+			rsim->t = beat / 3.0;
+			for (uint32 p = 1; p <= PARTICLE_COUNT; ++p)
+				rsim->particles[p].x += (p + beat) / 9.0; // None of them cross the primary
+			sim->heartbeatCallback(rsim);
+		}
+		sim->getOutputManager()->finish();
+	}
+
+	lbdio::TextReader reader;
+	if (!TEST_CHECK(reader.open(FILES[0], 0)))
+		return;
+	TEST_CHECK(reader.getHeader(0) == FILES[0]);
+	TEST_CHECK(reader.getHeader(3) == (String(SCALAR_FORMAT) + " {[R>0.1] #ph,#px,#pev,#pn;}"));
+	if (!TEST_CHECK(reader.read(0, 1 << 20) == RECORD_COUNT))
+		return;
+	const StlVector<lbdio::text_column>& columns = reader.getColumns();
+	const StlVector<uint32>& counts = reader.getCounts();
+	TEST_CHECK(std::all_of(counts.begin(), counts.end(), [](uint32 c) { return c == PARTICLE_COUNT; }));
+
+	// One array for each column, where the last is the names, which are kept in the reader but still need a pointer
+	StlVector<StlVector<double>> arrays(columns.size());
+	StlVector<double*> values(columns.size(), nullptr);
+	for (size_t c = 0; c < columns.size(); ++c) {
+		const uint32 rows = (columns[c].list == LBDIO_NO_LIST) ? RECORD_COUNT : (RECORD_COUNT * PARTICLE_COUNT);
+		arrays[c].resize((columns[c].type == LBDIO_TYPE_STRING) ? 1 : (rows * columns[c].width));
+		values[c] = arrays[c].data();
+	}
+	if (!TEST_CHECK(reader.fill(values.data())))
+		return;
+
+	// The names are separated by '\0', in record order
+	String names;
+	for (uint32 r = 0; r < RECORD_COUNT; ++r) {
+		for (const char *name : NAMES)
+			names.append(name).push_back('\0');
+	}
+	TEST_CHECK(reader.getStrings(static_cast<uint32>(columns.size() - 1)) == names);
+	TEST_CHECK(reader.read(0, 1 << 20) == 0);
+
+	// Walks the binary records in the same column order, where the lists are written one whole column at a time
+	const StlVector<uint8> binary = _readFile(FILES[1]);
+	uint64 pos = 0;
+	const StlVector<uint8> index = _readFile(String(FILES[1]) + INDEX_FILE_EXTENSION);
+	if (!TEST_CHECK(index.size() >= (8 + INDEX_RECORD_SIZE)))
+		return;
+	memcpy(&pos, index.data() + 8 + 16, 8);
+	bool good = true;
+	for (uint32 r = 0; r < RECORD_COUNT && good; ++r) {
+		// The particle count of the simulation, then the filtered count before the first list column
+		uint32 count = 0;
+		memcpy(&count, binary.data() + pos, 4);
+		pos += 4;
+		good = (count == (PARTICLE_COUNT + 1));
+		for (size_t c = 0; good && (c + 1 < columns.size()); ++c) {
+			const bool inList = (columns[c].list != LBDIO_NO_LIST);
+			if (inList && (columns[c - 1].list == LBDIO_NO_LIST)) {
+				memcpy(&count, binary.data() + pos, 4);
+				pos += 4;
+				good = (count == PARTICLE_COUNT);
+			}
+			const uint32 size = (columns[c].type == LBDIO_TYPE_INT) ? 4 : 8;
+			const uint32 fields = columns[c].width * (inList ? count : 1);
+			const double *expected = arrays[c].data() + (r * fields);
+			for (uint32 f = 0; good && (f < fields); ++f, pos += size) {
+				double value;
+				if (columns[c].type == LBDIO_TYPE_DOUBLE)
+					memcpy(&value, binary.data() + pos, 8);
+				else if (columns[c].type == LBDIO_TYPE_INT) {
+					uint32 ivalue;
+					memcpy(&ivalue, binary.data() + pos, 4);
+					value = ivalue;
+				}
+				else {
+					int64 lvalue;
+					memcpy(&lvalue, binary.data() + pos, 8);
+					value = static_cast<double>(lvalue);
+				}
+				good = (value == expected[f]) || (std::isnan(value) && std::isnan(expected[f]));
+			}
+		}
+	}
+	TEST_CHECK(good && (pos == binary.size()));
+}
+
+} // namespace
+
+
+// ================================================================================================
+void test_text_reader()
+{
+	_checkTokens();
+	_checkReadBack();
+
+	for (const char *file : FILES) {
+		std::remove(file);
+		std::remove((String(file) + INDEX_FILE_EXTENSION).c_str());
+	}
+}
\ No newline at end of file
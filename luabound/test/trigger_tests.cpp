@@ -0,0 +1,110 @@
+/**
+ * Copyright Sean Moss (c) 2017
+ * Licensed under the GNU GPL v3 license, the text of which can be found in the LICENSE file in
+ *     this repository. If a copy of this license was not included, it can be found at 
+ *     <http://www.gnu.org/licenses/>.
+ *
+ * This file tests the triggered output files, by moving particles between the heartbeats of the output manager.
+ */
+
+#include "test.hpp"
+#include <cstdio>
+#include <fstream>
+
+namespace
+{
+
+const char * const SCRIPT = R"(
+new_simulation {
+	name = "trigger_test",
+	constants = { G = 1, max_time = 1 },
+	integrator = { name = "ias15" },
+	output = {
+		["trigger_test_escape.dat"] = { format = "#st {[e>=1] #pn;}", trigger = "escape", pre = 1 },
+		["trigger_test_close.dat"] = { format = "#st {[R<0.5] #pn;}", trigger = "b&R<0.5", post = 1 },
+		["trigger_test_all.dat"] = { format = "#st #sc", time = 0 }
+	},
+	output_settings = { threaded = %THREADED% },
+	populate = function()
+		sim.addParticle(1, 1e-4, place.cartesian(0.0, 0.0, 0.0), nil, "sun")
+		sim.setPrimaryParticle("sun")
+		sim.addParticle(1e-9, 1e-4, place.cartesian(1.0, 0.0, 0.0, 0.0, 1.0, 0.0), nil, "a")
+		sim.addParticle(1e-9, 1e-4, place.cartesian(-2.0, 0.0, 0.0, 0.0, -0.7, 0.0), nil, "b")
+	end
+}
+)";
+
+const char * const FILES[] = { "trigger_test_escape.dat", "trigger_test_close.dat", "trigger_test_all.dat" };
+
+StlVector<String> _readLines(const char *path)
+{
+	StlVector<String> lines;
+	std::ifstream file{path};
+	String line;
+	while (std::getline(file, line)) {
+		if (line[0] != '#') // Skip the header
+			lines.push_back(line);
+	}
+	return lines;
+}
+
+// Runs the heartbeats one time unit apart, and sets the particle velocities (and so the orbits) before each one
+void _runHeartbeats(bool threaded)
+{
+	String script = SCRIPT;
+	script.replace(script.find("%THREADED%"), 10, threaded ? "true" : "false");
+	StlUniquePtr<LbdSimulation> sim = test::LoadSimulation(script);
+	if (!TEST_CHECK(sim != nullptr))
+		return;
+	reb_simulation *rsim = sim->getSimulation();
+	OutputManager *manager = sim->getOutputManager();
+	ParticleManager *particles = sim->getManager();
+
+	// The speed of a at each heartbeat, where sqrt(2) escapes, and the same for b (at twice the distance)
+	const double A_SPEEDS[] = { 1.0, 2.0, 2.0, 2.0, 1.0, 2.0 };
+	const double B_SPEEDS[] = { 0.7, 0.7, 0.7, 1.5, 1.5, 1.5 };
+	manager->start();
+	for (uint32 beat = 0; beat < 6; ++beat) {
+		rsim->t = beat;
+		particles->getParticleByName("a")->vy = A_SPEEDS[beat];
+		particles->getParticleByName("b")->vy = -B_SPEEDS[beat];
+		if (beat == 4)
+			particles->getParticleByName("b")->x = -0.25; // Close, and too deep to escape
+		TEST_CHECK(manager->update());
+	}
+	manager->finish();
+
+	// a escapes at 1, b escapes at 3 (while a is still escaping), neither is escaping at 4, and a escapes again at
+	//     5. Each fire also writes the heartbeat before it.
+	const StlVector<String> escapes = _readLines(FILES[0]);
+	const String EXPECTED_ESCAPES[] = { "0 ", "1 a", "2 a", "3 a;b", "4 ", "5 a" };
+	if (TEST_CHECK(escapes.size() == 6)) {
+		for (uint32 i = 0; i < 6; ++i) {
+			const String text = strfmt("escape record %u is \"%s\"", i, EXPECTED_ESCAPES[i].c_str());
+			test::Check(escapes[i] == EXPECTED_ESCAPES[i], text.c_str(), __FILE__, __LINE__);
+		}
+	}
+
+	// The close trigger only fires at 4, and writes the heartbeat after it
+	const StlVector<String> close = _readLines(FILES[1]);
+	TEST_CHECK((close.size() == 2) && (close[0] == "4 sun;b") && (close[1] == "5 sun;b"));
+
+	// The scheduled file shares the snapshot of the triggers, and is still written every heartbeat
+	const StlVector<String> all = _readLines(FILES[2]);
+	TEST_CHECK((all.size() == 6) && (all[0] == "0 3") && (all[5] == "5 3"));
+
+	for (const char *file : FILES) {
+		std::remove(file);
+		std::remove((String(file) + INDEX_FILE_EXTENSION).c_str());
+	}
+}
+
+} // namespace
+
+
+// ================================================================================================
+void test_output_triggers()
+{
+	_runHeartbeats(false);
+	_runHeartbeats(true);
+}
\ No newline at end of file